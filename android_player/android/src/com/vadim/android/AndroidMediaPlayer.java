@@ -2,8 +2,10 @@ package com.vadim.android;
 
 import android.content.Context;
 import android.content.res.AssetFileDescriptor;
+import android.media.MediaMetadataRetriever;
 import android.media.MediaPlayer;
 import android.os.Build;
+import android.os.SystemClock;
 import android.support.annotation.NonNull;
 import android.util.Log;
 import android.view.Surface;
@@ -20,30 +22,78 @@ public final class AndroidMediaPlayer implements
         MediaPlayer.OnSeekCompleteListener,
         MediaPlayer.OnVideoSizeChangedListener {
     private static final String TAG = "AndroidMediaPlayer";
+    private static final boolean DEBUG = BuildConfig.DEBUG;
 
     private final static int FORCE_NONE = 0;
     private final static int FORCE_ANDROID_MEDIAPLAYER = 1;
     private final static int FORCE_RT_MEDIAPLAYER = 2;
     private final static int FORCE_BY_SCORE = 3;
 
+    // onBufferingUpdate fires several times a second while streaming,
+    // forward it to the native side no more often than this.
+    private final static long BUFFERING_UPDATE_INTERVAL_MS = 250;
+
     private MediaPlayer mMediaPlayer;
+    // replaces mMediaPlayer while a "testpattern:" source is playing
+    private TestPatternSource mTestPattern;
+    // next part of a playlist, prepared ahead of the current part's end
+    private MediaPlayer mNextMediaPlayer;
+    private boolean mNextPrepared;
+    private Surface mSurface;
+    // paused by detachSurface(), resumed by attachSurface()
+    private boolean mSuspended;
+    private boolean mUseRTPlayer;
+    // carried over to the next part's MediaPlayer by startNext()
+    private boolean mLooping;
+    private int mVideoScalingMode = MediaPlayer.VIDEO_SCALING_MODE_SCALE_TO_FIT;
+    private float mSpeed = 1;
     private MediaPlayerEventListener mEventListener;
+    private int mLastBufferingPercent = -1;
+    private long mLastBufferingUpdateTime;
+    // position to seek to once prepared, -1 to start from the beginning
+    private long mStartPosition = -1;
 
     public AndroidMediaPlayer() {
-        Log.d(TAG, "AndroidMediaPlayer() called");
-        mMediaPlayer = new MediaPlayer();
-        mMediaPlayer.setOnCompletionListener(this);
-        mMediaPlayer.setOnBufferingUpdateListener(this);
-        mMediaPlayer.setOnErrorListener(this);
-        mMediaPlayer.setOnInfoListener(this);
-        mMediaPlayer.setOnPreparedListener(this);
-        mMediaPlayer.setOnSeekCompleteListener(this);
-        mMediaPlayer.setOnVideoSizeChangedListener(this);
+        if (DEBUG) {
+            Log.d(TAG, "AndroidMediaPlayer() called");
+        }
+        mMediaPlayer = createMediaPlayer();
+    }
+
+    private MediaPlayer createMediaPlayer() {
+        final MediaPlayer mediaPlayer = new MediaPlayer();
+        mediaPlayer.setOnCompletionListener(this);
+        mediaPlayer.setOnBufferingUpdateListener(this);
+        mediaPlayer.setOnErrorListener(this);
+        mediaPlayer.setOnInfoListener(this);
+        mediaPlayer.setOnPreparedListener(this);
+        mediaPlayer.setOnSeekCompleteListener(this);
+        mediaPlayer.setOnVideoSizeChangedListener(this);
+        return mediaPlayer;
+    }
+
+    public static long getMediaDuration(final String source) {
+        final MediaMetadataRetriever retriever = new MediaMetadataRetriever();
+        try {
+            retriever.setDataSource(source);
+            final String duration = retriever.extractMetadata(MediaMetadataRetriever.METADATA_KEY_DURATION);
+            return duration != null ? Long.parseLong(duration) : -1;
+        } catch (Exception e) {
+            e.printStackTrace();
+            return -1;
+        } finally {
+            retriever.release();
+        }
     }
 
     public void setEventListener(MediaPlayerEventListener eventListener) {
-        Log.d(TAG, "setEventListener() called with: eventListener = [" + eventListener + "]");
+        if (DEBUG) {
+            Log.d(TAG, "setEventListener() called with: eventListener = [" + eventListener + "]");
+        }
         mEventListener = eventListener;
+        if (mTestPattern != null) {
+            mTestPattern.setEventListener(eventListener);
+        }
     }
 
     public static AssetFileDescriptor getAssetFileDescriptor(@NonNull Context context, final String source) {
@@ -57,7 +107,14 @@ public final class AndroidMediaPlayer implements
     }
 
     public void setDataSource(final String source) throws Exception {
-        Log.d(TAG, "setDataSource() source: " + source);
+        if (DEBUG) {
+            Log.d(TAG, "setDataSource() source: " + source);
+        }
+        if (TestPatternSource.handles(source)) {
+            releaseTestPattern();
+            mTestPattern = new TestPatternSource(source, mEventListener);
+            return;
+        }
         try {
             mMediaPlayer.setDataSource(source);
         } catch (Exception e) {
@@ -67,7 +124,9 @@ public final class AndroidMediaPlayer implements
     }
 
     public void setDataSource(@NonNull AssetFileDescriptor assetFileDescriptor, long offset, long length) throws Exception {
-        Log.d(TAG, "setDataSource() playing from assets with fd: " + assetFileDescriptor);
+        if (DEBUG) {
+            Log.d(TAG, "setDataSource() playing from assets with fd: " + assetFileDescriptor);
+        }
         try {
             mMediaPlayer.setDataSource(assetFileDescriptor.getFileDescriptor(),
                     assetFileDescriptor.getStartOffset(),
@@ -78,60 +137,230 @@ public final class AndroidMediaPlayer implements
         }
     }
 
-    public void prepare() {
-        Log.d(TAG, "prepare()");
-        mMediaPlayer.prepareAsync();
+    public void setNativeDataSource(long nativeHandle) throws Exception {
+        if (DEBUG) {
+            Log.d(TAG, "setNativeDataSource() nativeHandle: " + nativeHandle);
+        }
+        final NativeMediaDataSource dataSource = new NativeMediaDataSource(nativeHandle);
+        try {
+            mMediaPlayer.setDataSource(dataSource);
+        } catch (Exception e) {
+            e.printStackTrace();
+            dataSource.close();
+            throw e;
+        }
+    }
+
+    public void prepareNext(final String source) {
+        if (DEBUG) {
+            Log.d(TAG, "prepareNext() source: " + source);
+        }
+        releaseNext();
+        mNextMediaPlayer = createMediaPlayer();
+        try {
+            applyRTPlayer(mNextMediaPlayer);
+            mNextMediaPlayer.setDataSource(source);
+            mNextMediaPlayer.prepareAsync();
+        } catch (Exception e) {
+            e.printStackTrace();
+            releaseNext();
+        }
+    }
+
+    public void prepareNextNative(long nativeHandle) {
+        if (DEBUG) {
+            Log.d(TAG, "prepareNextNative() nativeHandle: " + nativeHandle);
+        }
+        releaseNext();
+        final NativeMediaDataSource dataSource = new NativeMediaDataSource(nativeHandle);
+        mNextMediaPlayer = createMediaPlayer();
+        try {
+            applyRTPlayer(mNextMediaPlayer);
+            mNextMediaPlayer.setDataSource(dataSource);
+            mNextMediaPlayer.prepareAsync();
+        } catch (Exception e) {
+            e.printStackTrace();
+            releaseNext();
+            dataSource.close();
+        }
+    }
+
+    private void releaseNext() {
+        if (mNextMediaPlayer != null) {
+            mNextMediaPlayer.release();
+            mNextMediaPlayer = null;
+        }
+        mNextPrepared = false;
+    }
+
+    // Continues with the prepared next part right away instead of going
+    // through reset, setDataSource and prepare at the boundary.
+    private boolean startNext() {
+        if (mNextMediaPlayer == null || !mNextPrepared) {
+            return false;
+        }
+        final MediaPlayer previous = mMediaPlayer;
+        mMediaPlayer = mNextMediaPlayer;
+        mNextMediaPlayer = null;
+        mNextPrepared = false;
+        previous.release();
+        applySurface();
+        mMediaPlayer.setLooping(mLooping);
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.JELLY_BEAN) {
+            mMediaPlayer.setVideoScalingMode(mVideoScalingMode);
+        }
+        if (mSpeed != 1 && Build.VERSION.SDK_INT >= Build.VERSION_CODES.M) {
+            try {
+                mMediaPlayer.setPlaybackParams(mMediaPlayer.getPlaybackParams().setSpeed(mSpeed));
+            } catch (Exception e) {
+                e.printStackTrace();
+            }
+        }
+        mMediaPlayer.start();
+        return true;
+    }
+
+    public void prepare(final long startPosition) {
+        if (DEBUG) {
+            Log.d(TAG, "prepare() startPosition: " + startPosition);
+        }
         if (mEventListener != null) {
             mEventListener.onBuffering(true);
         }
+        if (mTestPattern != null) {
+            mTestPattern.prepare(startPosition);
+            return;
+        }
+        mStartPosition = startPosition;
+        mMediaPlayer.prepareAsync();
+    }
+
+    private void releaseTestPattern() {
+        if (mTestPattern != null) {
+            mTestPattern.release();
+            mTestPattern = null;
+        }
     }
 
     public void stop() {
-        Log.d(TAG, "stop()");
+        if (DEBUG) {
+            Log.d(TAG, "stop()");
+        }
+        if (mTestPattern != null) {
+            mTestPattern.stop();
+            return;
+        }
         mMediaPlayer.stop();
     }
 
-    public void reset() {
-        Log.d(TAG, "reset()");
+    public synchronized void reset() {
+        if (DEBUG) {
+            Log.d(TAG, "reset()");
+        }
+        // a new surface must not start a player that is no longer prepared
+        mSuspended = false;
+        mLastBufferingPercent = -1;
+        mStartPosition = -1;
+        mSpeed = 1;
+        releaseNext();
+        releaseTestPattern();
         mMediaPlayer.reset();
     }
 
     public void release() {
-        Log.d(TAG, "release()");
+        if (DEBUG) {
+            Log.d(TAG, "release()");
+        }
+        releaseNext();
+        releaseTestPattern();
         mMediaPlayer.release();
     }
 
-    public void pause() {
-        Log.d(TAG, "pause()");
-        mMediaPlayer.pause();
+    public synchronized void pause() {
+        if (DEBUG) {
+            Log.d(TAG, "pause()");
+        }
+        mSuspended = false;
+        if (mTestPattern != null) {
+            mTestPattern.pause();
+        } else {
+            mMediaPlayer.pause();
+        }
         if (mEventListener != null) {
             mEventListener.onPause();
         }
     }
 
     public void resume() {
-        Log.d(TAG, "resume()");
+        if (DEBUG) {
+            Log.d(TAG, "resume()");
+        }
         start();
     }
 
     public void seekTo(final long mills) {
-        Log.d(TAG, "seekTo(): " + mills);
+        if (DEBUG) {
+            Log.d(TAG, "seekTo(): " + mills);
+        }
+        if (mTestPattern != null) {
+            mTestPattern.seekTo(mills);
+            return;
+        }
         mMediaPlayer.seekTo((int) mills);
     }
 
+    // Seeks to the sync frame closest to mills, used by trick play which
+    // shows sync frames only and can't afford decoding up to the exact frame.
+    public void seekToSync(final long mills) {
+        if (DEBUG) {
+            Log.d(TAG, "seekToSync(): " + mills);
+        }
+        if (mTestPattern != null) {
+            mTestPattern.seekTo(mills);
+            return;
+        }
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
+            mMediaPlayer.seekTo(mills, MediaPlayer.SEEK_CLOSEST_SYNC);
+        } else {
+            // seeks land on the previous sync frame before API 26
+            mMediaPlayer.seekTo((int) mills);
+        }
+    }
+
     public long getCurrentPosition() {
-        Log.d(TAG, "getCurrentPosition()");
+        if (DEBUG) {
+            Log.d(TAG, "getCurrentPosition()");
+        }
+        if (mTestPattern != null) {
+            return mTestPattern.getCurrentPosition();
+        }
         return mMediaPlayer.getCurrentPosition();
     }
 
     public long getDuration() {
-        Log.d(TAG, "getDuration()");
+        if (DEBUG) {
+            Log.d(TAG, "getDuration()");
+        }
+        if (mTestPattern != null) {
+            return mTestPattern.getDuration();
+        }
         return mMediaPlayer.getDuration();
     }
 
     @Override
     public void onCompletion(MediaPlayer mp) {
-        Log.d(TAG, "onCompletion() called with: mp = [" + mp + "]");
+        if (DEBUG) {
+            Log.d(TAG, "onCompletion() called with: mp = [" + mp + "]");
+        }
+        if (mp != mMediaPlayer) {
+            return;
+        }
+        if (startNext()) {
+            if (mEventListener != null) {
+                mEventListener.onNextPartStarted();
+            }
+            return;
+        }
         if (mEventListener != null) {
             mEventListener.onFinished();
         }
@@ -139,16 +368,40 @@ public final class AndroidMediaPlayer implements
 
     @Override
     public void onBufferingUpdate(MediaPlayer mp, int percent) {
-        Log.d(TAG, "onBufferingUpdate() called with: mp = [" + mp + "], percent = [" + percent + "]");
+        if (mp != mMediaPlayer || percent == mLastBufferingPercent) {
+            return;
+        }
+        final long now = SystemClock.uptimeMillis();
+        if (percent < 100 && mLastBufferingPercent >= 0
+                && now - mLastBufferingUpdateTime < BUFFERING_UPDATE_INTERVAL_MS) {
+            return;
+        }
+        mLastBufferingPercent = percent;
+        mLastBufferingUpdateTime = now;
+        if (mEventListener != null) {
+            mEventListener.onBufferingUpdate(percent);
+        }
     }
 
     @Override
     public boolean onError(MediaPlayer mp, int what, int extra) {
-        Log.d(TAG, "onError() called with: mp = [" + mp + "], what = [" + what + "], extra = [" + extra + "]");
+        if (DEBUG) {
+            Log.d(TAG, "onError() called with: mp = [" + mp + "], what = [" + what + "], extra = [" + extra + "]");
+        }
+        if (mp == mNextMediaPlayer) {
+            // the next part falls back to a regular prepare at the boundary
+            releaseNext();
+            return true;
+        }
         if (mEventListener != null) {
             mEventListener.onError(what, extra);
         }
-        // surface is destroyd. finish playback.
+        // The surface went away while the decoder still held it. Players
+        // rendering into a PlayerSurfaceView or a QSurfaceTexture are
+        // detached before that happens, see detachSurface(); this is left for
+        // a surface set some other way. It can't go through detachSurface()
+        // and attachSurface() here: after onError() MediaPlayer is in the
+        // Error state, which only reset() leaves, and its decoder is gone.
         if (what == 1 && extra == -19) {
             stop();
             reset();
@@ -158,7 +411,12 @@ public final class AndroidMediaPlayer implements
 
     @Override
     public boolean onInfo(MediaPlayer mp, int what, int extra) {
-        Log.d(TAG, "onInfo() called with: mp = [" + mp + "], what = [" + what + "], extra = [" + extra + "]");
+        if (DEBUG) {
+            Log.d(TAG, "onInfo() called with: mp = [" + mp + "], what = [" + what + "], extra = [" + extra + "]");
+        }
+        if (mp != mMediaPlayer) {
+            return false;
+        }
 
         switch (what) {
             case MediaPlayer.MEDIA_INFO_VIDEO_RENDERING_START:
@@ -183,7 +441,17 @@ public final class AndroidMediaPlayer implements
 
     @Override
     public void onPrepared(MediaPlayer mp) {
-        Log.d(TAG, "onPrepared() called with: mp = [" + mp + "]");
+        if (DEBUG) {
+            Log.d(TAG, "onPrepared() called with: mp = [" + mp + "]");
+        }
+        if (mp == mNextMediaPlayer) {
+            mNextPrepared = true;
+            return;
+        }
+        if (mStartPosition > 0) {
+            mp.seekTo((int) mStartPosition);
+        }
+        mStartPosition = -1;
         if (mEventListener != null) {
             mEventListener.onPrepared();
         }
@@ -191,27 +459,88 @@ public final class AndroidMediaPlayer implements
 
     @Override
     public void onSeekComplete(MediaPlayer mp) {
-        Log.d(TAG, "onSeekComplete() called with: mp = [" + mp + "]");
+        if (DEBUG) {
+            Log.d(TAG, "onSeekComplete() called with: mp = [" + mp + "]");
+        }
+        if (mp == mMediaPlayer && mEventListener != null) {
+            mEventListener.onSeekComplete();
+        }
+    }
+
+    public void setLooping(boolean looping) {
+        if (DEBUG) {
+            Log.d(TAG, "setLooping() called with: looping = [" + looping + "]");
+        }
+        if (mTestPattern != null) {
+            mTestPattern.setLooping(looping);
+            return;
+        }
+        mLooping = looping;
+        mMediaPlayer.setLooping(looping);
     }
 
     public void setVideoScalingMode(int mode) {
-        Log.d(TAG, "setVideoScalingMode() called with: mode = [" + mode + "]");
-        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.JELLY_BEAN) {
+        if (DEBUG) {
+            Log.d(TAG, "setVideoScalingMode() called with: mode = [" + mode + "]");
+        }
+        if (mTestPattern == null && Build.VERSION.SDK_INT >= Build.VERSION_CODES.JELLY_BEAN) {
+            mVideoScalingMode = mode;
             mMediaPlayer.setVideoScalingMode(mode);
         }
     }
 
-    public void start() {
-        Log.d(TAG, "start()");
+    public synchronized void start() {
+        if (DEBUG) {
+            Log.d(TAG, "start()");
+        }
+        mSuspended = false;
+        if (mTestPattern != null) {
+            mTestPattern.start();
+            return;
+        }
         mMediaPlayer.start();
     }
 
+    // Changes the playback speed without changing the pitch, used by sync
+    // groups to nudge a player towards the group clock. Returns false if the
+    // speed can't be changed, PlaybackParams need API 23.
+    public synchronized boolean setPlaybackSpeed(float speed) {
+        if (DEBUG) {
+            Log.d(TAG, "setPlaybackSpeed() called with: speed = [" + speed + "]");
+        }
+        if (mTestPattern != null) {
+            mTestPattern.setSpeed(speed);
+            return true;
+        }
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.M) {
+            return false;
+        }
+        try {
+            mMediaPlayer.setPlaybackParams(mMediaPlayer.getPlaybackParams().setSpeed(speed));
+            mSpeed = speed;
+            return true;
+        } catch (Exception e) {
+            e.printStackTrace();
+            return false;
+        }
+    }
+
     public void useRTPlayer(boolean flag) {
-        Log.d(TAG, "useRTPlayer() called with: useRTPlayer = [" + flag + "]");
+        if (DEBUG) {
+            Log.d(TAG, "useRTPlayer() called with: useRTPlayer = [" + flag + "]");
+        }
+        mUseRTPlayer = flag;
+        applyRTPlayer(mMediaPlayer);
+    }
+
+    private void applyRTPlayer(MediaPlayer mediaPlayer) {
+        final boolean flag = mUseRTPlayer;
         try {
-            final Method method = mMediaPlayer.getClass().getMethod("useRTMediaPlayer", int.class);
-            method.invoke(mMediaPlayer, flag ? FORCE_RT_MEDIAPLAYER : FORCE_ANDROID_MEDIAPLAYER);
-            Log.d(TAG, "useRTPlayer() set success: " + (flag ? FORCE_RT_MEDIAPLAYER : FORCE_ANDROID_MEDIAPLAYER));
+            final Method method = mediaPlayer.getClass().getMethod("useRTMediaPlayer", int.class);
+            method.invoke(mediaPlayer, flag ? FORCE_RT_MEDIAPLAYER : FORCE_ANDROID_MEDIAPLAYER);
+            if (DEBUG) {
+                Log.d(TAG, "useRTPlayer() set success: " + (flag ? FORCE_RT_MEDIAPLAYER : FORCE_ANDROID_MEDIAPLAYER));
+            }
         } catch (SecurityException e) {
             e.printStackTrace();
         } catch (NoSuchMethodException e) {
@@ -225,7 +554,12 @@ public final class AndroidMediaPlayer implements
 
     @Override
     public void onVideoSizeChanged(MediaPlayer mp, int width, int height) {
-        Log.d(TAG, "onVideoSizeChanged() called with: mp = [" + mp + "], width = [" + width + "], height = [" + height + "]");
+        if (DEBUG) {
+            Log.d(TAG, "onVideoSizeChanged() called with: mp = [" + mp + "], width = [" + width + "], height = [" + height + "]");
+        }
+        if (mp != mMediaPlayer) {
+            return;
+        }
         if (width == 0 || height == 0) {
             Log.e(TAG, "invalid video width(" + width + ") or height(" + height + ")");
             return;
@@ -235,11 +569,26 @@ public final class AndroidMediaPlayer implements
         }
     }
 
-    public void setSurface(Surface surface) {
-        Log.d(TAG, "setSurface() called with: surface = [" + surface + "]");
+    public synchronized void setSurface(Surface surface) {
+        if (DEBUG) {
+            Log.d(TAG, "setSurface() called with: surface = [" + surface + "]");
+        }
+        if (surface == mSurface) {
+            // already attached by the surface view
+            return;
+        }
+        mSurface = surface;
+        applySurface();
+    }
+
+    private void applySurface() {
+        if (mTestPattern != null) {
+            mTestPattern.setSurface(mSurface != null && mSurface.isValid() ? mSurface : null);
+            return;
+        }
         try {
-            if (surface != null && surface.isValid()) {
-                mMediaPlayer.setSurface(surface);
+            if (mSurface != null && mSurface.isValid()) {
+                mMediaPlayer.setSurface(mSurface);
             } else {
                 mMediaPlayer.setSurface(null);
             }
@@ -247,4 +596,60 @@ public final class AndroidMediaPlayer implements
             e.printStackTrace();
         }
     }
+
+    // Called by PlayerSurfaceView on the UI thread before its surface is
+    // destroyed, and by the native player before a QSurfaceTexture goes. MediaPlayer must let go of the surface before surfaceDestroyed
+    // returns, otherwise the decoder fails with -ENODEV and has to be
+    // prepared again. Playback is paused and the decoder state is kept.
+    synchronized void detachSurface() {
+        if (DEBUG) {
+            Log.d(TAG, "detachSurface()");
+        }
+        mSuspended = false;
+        if (mTestPattern != null) {
+            mSuspended = mTestPattern.detachSurface();
+        } else {
+            try {
+                if (mMediaPlayer.isPlaying()) {
+                    mMediaPlayer.pause();
+                    mSuspended = true;
+                }
+                mMediaPlayer.setSurface(null);
+            } catch (IllegalStateException e) {
+                e.printStackTrace();
+            }
+        }
+        mSurface = null;
+        if (mSuspended && mEventListener != null) {
+            mEventListener.onSuspended(true);
+        }
+    }
+
+    // Called by PlayerSurfaceView on the UI thread when a new surface is
+    // created, or by the native player for a new QSurfaceTexture, resumes
+    // playback paused by detachSurface().
+    synchronized void attachSurface(Surface surface) {
+        if (DEBUG) {
+            Log.d(TAG, "attachSurface() called with: surface = [" + surface + "]");
+        }
+        mSurface = surface;
+        applySurface();
+        if (!mSuspended) {
+            return;
+        }
+        mSuspended = false;
+        if (mTestPattern != null) {
+            mTestPattern.start();
+        } else {
+            try {
+                mMediaPlayer.start();
+            } catch (IllegalStateException e) {
+                e.printStackTrace();
+                return;
+            }
+        }
+        if (mEventListener != null) {
+            mEventListener.onSuspended(false);
+        }
+    }
 }
@@ -6,4 +6,5 @@ import android.view.View;
 public interface IPlayerSurfaceActivity {
     void setPlayerSurfaceGeometry(View surfaceView, int x, int y, int width, int height);
     void addPlayerSurface(View surfaceView, int x, int y, int width, int height);
+    void removePlayerSurface(View surfaceView);
 }
@@ -0,0 +1,70 @@
+package com.vadim.android;
+
+import android.media.MediaExtractor;
+import android.media.MediaFormat;
+import android.util.Log;
+
+// Sync frame times for trick play, called from a native worker thread.
+final class KeyframeIndex {
+    private static final String TAG = "KeyframeIndex";
+    private static final boolean DEBUG = BuildConfig.DEBUG;
+
+    private KeyframeIndex() {
+    }
+
+    // Returns the presentation times in ms of the sync frames of the first
+    // video track in ascending order, or null if the source can't be read.
+    // Only sample headers are read, nothing is decoded.
+    static long[] build(final String source) {
+        if (TestPatternSource.handles(source)) {
+            return TestPatternSource.keyframes(source);
+        }
+        final MediaExtractor extractor = new MediaExtractor();
+        try {
+            extractor.setDataSource(source);
+            int track = -1;
+            for (int i = 0; i < extractor.getTrackCount(); ++i) {
+                final String mime = extractor.getTrackFormat(i).getString(MediaFormat.KEY_MIME);
+                if (mime != null && mime.startsWith("video/")) {
+                    track = i;
+                    break;
+                }
+            }
+            if (track < 0) {
+                return null;
+            }
+            extractor.selectTrack(track);
+
+            // hop from sync frame to sync frame instead of walking every sample
+            long[] times = new long[256];
+            int count = 0;
+            extractor.seekTo(0, MediaExtractor.SEEK_TO_NEXT_SYNC);
+            long time = extractor.getSampleTime();
+            while (time >= 0) {
+                if (count == times.length) {
+                    final long[] grown = new long[times.length * 2];
+                    System.arraycopy(times, 0, grown, 0, count);
+                    times = grown;
+                }
+                times[count++] = time / 1000;
+                extractor.seekTo(time + 1, MediaExtractor.SEEK_TO_NEXT_SYNC);
+                final long next = extractor.getSampleTime();
+                if (next <= time) {
+                    break;
+                }
+                time = next;
+            }
+            if (DEBUG) {
+                Log.d(TAG, "build() " + count + " sync frames in " + source);
+            }
+            final long[] result = new long[count];
+            System.arraycopy(times, 0, result, 0, count);
+            return result;
+        } catch (Exception e) {
+            Log.w(TAG, "can't index " + source, e);
+            return null;
+        } finally {
+            extractor.release();
+        }
+    }
+}
@@ -6,6 +6,10 @@ interface MediaPlayerEventListener {
     void onFinished();
     void onError(int what, int extra);
     void onBuffering(boolean state);
+    void onBufferingUpdate(int percent);
     void onPause();
     void onPrepared();
+    void onSeekComplete();
+    void onNextPartStarted();
+    void onSuspended(boolean suspended);
 }
@@ -0,0 +1,44 @@
+package com.vadim.android;
+
+import android.media.MediaDataSource;
+import android.os.Build;
+import android.support.annotation.RequiresApi;
+
+@RequiresApi(api = Build.VERSION_CODES.M)
+public final class NativeMediaDataSource extends MediaDataSource {
+    private long mNativeHandle;
+
+    public NativeMediaDataSource(long nativeHandle) {
+        mNativeHandle = nativeHandle;
+    }
+
+    @Override
+    public synchronized int readAt(long position, byte[] buffer, int offset, int size) {
+        if (mNativeHandle == 0) {
+            return -1;
+        }
+        return readAt(mNativeHandle, position, buffer, offset, size);
+    }
+
+    @Override
+    public synchronized long getSize() {
+        if (mNativeHandle == 0) {
+            return -1;
+        }
+        return getSize(mNativeHandle);
+    }
+
+    @Override
+    public synchronized void close() {
+        if (mNativeHandle != 0) {
+            close(mNativeHandle);
+            mNativeHandle = 0;
+        }
+    }
+
+    public static native int readAt(long nativeHandle, long position, byte[] buffer, int offset, int size);
+
+    public static native long getSize(long nativeHandle);
+
+    public static native void close(long nativeHandle);
+}
@@ -34,6 +34,11 @@ public final class NativeMediaPlayerEventListener implements MediaPlayerEventLis
         onBuffering(mNativeHandler, state);
     }
 
+    @Override
+    public void onBufferingUpdate(int percent) {
+        onBufferingUpdate(mNativeHandler, percent);
+    }
+
     @Override
     public void onPause() {
         onPause(mNativeHandler);
@@ -44,6 +49,21 @@ public final class NativeMediaPlayerEventListener implements MediaPlayerEventLis
         onPrepared(mNativeHandler);
     }
 
+    @Override
+    public void onSeekComplete() {
+        onSeekComplete(mNativeHandler);
+    }
+
+    @Override
+    public void onNextPartStarted() {
+        onNextPartStarted(mNativeHandler);
+    }
+
+    @Override
+    public void onSuspended(boolean suspended) {
+        onSuspended(mNativeHandler, suspended);
+    }
+
     public static native void onFinished(long nativeHandle);
 
     public static native void onStarted(long nativeHandle);
@@ -52,9 +72,17 @@ public final class NativeMediaPlayerEventListener implements MediaPlayerEventLis
 
     public static native void onBuffering(long nativeHandle, boolean state);
 
+    public static native void onBufferingUpdate(long nativeHandle, int percent);
+
     public static native void onPause(long nativeHandle);
 
     public static native void onPrepared(long nativeHandle);
 
     public static native void onVideoSizeChanged(long nativeHandle, int playerWidth, int playerHeight);
+
+    public static native void onSeekComplete(long nativeHandle);
+
+    public static native void onNextPartStarted(long nativeHandle);
+
+    public static native void onSuspended(long nativeHandle, boolean suspended);
 }
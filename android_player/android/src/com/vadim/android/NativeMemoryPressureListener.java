@@ -0,0 +1,23 @@
+package com.vadim.android;
+
+import android.content.ComponentCallbacks2;
+import android.content.res.Configuration;
+
+public final class NativeMemoryPressureListener implements ComponentCallbacks2 {
+    @Override
+    public void onTrimMemory(int level) {
+        onMemoryTrimmed(level);
+    }
+
+    // the system is low on memory as a whole, the foreground process included
+    @Override
+    public void onLowMemory() {
+        onMemoryTrimmed(TRIM_MEMORY_RUNNING_CRITICAL);
+    }
+
+    @Override
+    public void onConfigurationChanged(Configuration newConfig) {
+    }
+
+    public static native void onMemoryTrimmed(int level);
+}
@@ -10,6 +10,7 @@ import android.widget.LinearLayout;
 
 public class PlayerSurfaceActivity {
     private static final String TAG = PlayerSurfaceActivity.class.getName();
+    private static final boolean DEBUG = BuildConfig.DEBUG;
 
     private FrameLayout playerLayout;
 
@@ -26,7 +27,9 @@ public class PlayerSurfaceActivity {
             layout.setOnHierarchyChangeListener(new ViewGroup.OnHierarchyChangeListener() {
                 @Override
                 public void onChildViewAdded(View parent, View child) {
-                    Log.d(TAG, "onChildViewAdded() called with: parent = [" + parent + "], child = [" + child + "]");
+                    if (DEBUG) {
+                        Log.d(TAG, "onChildViewAdded() called with: parent = [" + parent + "], child = [" + child + "]");
+                    }
                     if ("org.qtproject.qt5.android.QtSurface".equals(child.getClass().getName())) {
                         layout.removeView(playerLayout);
                         layout.addView(playerLayout, 0);
@@ -35,7 +38,9 @@ public class PlayerSurfaceActivity {
 
                 @Override
                 public void onChildViewRemoved(View parent, View child) {
-                    Log.d(TAG, "onChildViewRemoved() called with: parent = [" + parent + "], child = [" + child + "]");
+                    if (DEBUG) {
+                        Log.d(TAG, "onChildViewRemoved() called with: parent = [" + parent + "], child = [" + child + "]");
+                    }
                 }
             });
         } catch (Exception e) {
@@ -44,8 +49,10 @@ public class PlayerSurfaceActivity {
     }
 
     public void setPlayerSurfaceGeometry(View surfaceView, int x, int y, int width, int height) {
-        Log.d(TAG, "setPlayerSurfaceGeometry() surfaceView: " + surfaceView + " x: "
-                + x + " y: " + y + " width: " + width + " height: " + height);
+        if (DEBUG) {
+            Log.d(TAG, "setPlayerSurfaceGeometry() surfaceView: " + surfaceView + " x: "
+                    + x + " y: " + y + " width: " + width + " height: " + height);
+        }
         FrameLayout.LayoutParams lp = new FrameLayout.LayoutParams(width, height);
         lp.leftMargin = x;
         lp.topMargin = y;
@@ -53,8 +60,10 @@ public class PlayerSurfaceActivity {
     }
 
     public void addPlayerSurface(View surfaceView, int x, int y, int width, int height) {
-        Log.d(TAG, "addPlayerSurface() surfaceView: " + surfaceView + " x: " + x
-                + " y: " + y + " width: " + width + " height: " + height);
+        if (DEBUG) {
+            Log.d(TAG, "addPlayerSurface() surfaceView: " + surfaceView + " x: " + x
+                    + " y: " + y + " width: " + width + " height: " + height);
+        }
         FrameLayout.LayoutParams lp;
 
         if (width > 0 && height > 0) {
@@ -69,4 +78,13 @@ public class PlayerSurfaceActivity {
             playerLayout.addView(surfaceView, playerLayout.getChildCount(), lp);
         }
     }
+
+    public void removePlayerSurface(View surfaceView) {
+        if (DEBUG) {
+            Log.d(TAG, "removePlayerSurface() surfaceView: " + surfaceView);
+        }
+        if (playerLayout != null) {
+            playerLayout.removeView(surfaceView);
+        }
+    }
 }
@@ -13,12 +13,14 @@ import android.widget.FrameLayout;
 
 public final class PlayerSurfaceView extends SurfaceView implements SurfaceHolder.Callback {
     private static final String TAG = PlayerSurfaceView.class.getName();
+    private static final boolean DEBUG = BuildConfig.DEBUG;
 
     public static final int SCALING_TO_FILL_MODE = 0;
     public static final int SCALING_TO_FIT_MODE = 1;
     public static final int SCALING_TO_PAN_AND_SCAN_MODE = 2;
 
     private SurfaceChangeListener surfaceChangeListener;
+    private AndroidMediaPlayer mMediaPlayer;
     private int mVideoWidth;
     private int mVideoHeight;
     private int mScalingMode = SCALING_TO_FIT_MODE;
@@ -32,6 +34,15 @@ public final class PlayerSurfaceView extends SurfaceView implements SurfaceHolde
         this.surfaceChangeListener = surfaceChangeListener;
     }
 
+    // The player rendering into this view. It is detached from the surface
+    // synchronously in surfaceDestroyed() and keeps its decoder state.
+    public void setMediaPlayer(AndroidMediaPlayer mediaPlayer) {
+        mMediaPlayer = mediaPlayer;
+        if (mMediaPlayer != null && getHolder().getSurface().isValid()) {
+            mMediaPlayer.attachSurface(getHolder().getSurface());
+        }
+    }
+
     public PlayerSurfaceView(Context context, AttributeSet attrs) {
         super(context, attrs);
         getHolder().addCallback(this);
@@ -57,10 +68,14 @@ public final class PlayerSurfaceView extends SurfaceView implements SurfaceHolde
 
     @Override
     protected void onMeasure(int widthMeasureSpec, int heightMeasureSpec) {
-        Log.d(TAG, "onMeasure() called with: widthMeasureSpec = [" + widthMeasureSpec + "], heightMeasureSpec = [" + heightMeasureSpec + "]");
+        if (DEBUG) {
+            Log.d(TAG, "onMeasure() called with: widthMeasureSpec = [" + widthMeasureSpec + "], heightMeasureSpec = [" + heightMeasureSpec + "]");
+        }
         int width = getDefaultSize(mVideoWidth, widthMeasureSpec);
         int height = getDefaultSize(mVideoHeight, heightMeasureSpec);
-        Log.d(TAG, "onMeasure() width = [" + width + "], height = [" + height + "]");
+        if (DEBUG) {
+            Log.d(TAG, "onMeasure() width = [" + width + "], height = [" + height + "]");
+        }
 
         float aspectWidth = mVideoWidth;
         float aspectHeight = mVideoHeight;
@@ -83,17 +98,23 @@ public final class PlayerSurfaceView extends SurfaceView implements SurfaceHolde
             if (aspectWidth * height > width * aspectHeight) {
                 // increase width
                 width = Math.round(height * aspectWidth / aspectHeight);
-                Log.d(TAG, "onMeasure: increase width: " + width);
+                if (DEBUG) {
+                    Log.d(TAG, "onMeasure: increase width: " + width);
+                }
             } else if (aspectWidth * height  < width * aspectHeight) {
                 // increase height
                 height = Math.round(width * aspectHeight / aspectWidth);
-                Log.d(TAG, "onMeasure: increase height: " + height);
+                if (DEBUG) {
+                    Log.d(TAG, "onMeasure: increase height: " + height);
+                }
             }
         } else if (scaleType == SCALING_TO_FILL_MODE) {
             //
         }
 
-        Log.d(TAG, "onMeasure() width: " + width + " height: " + height);
+        if (DEBUG) {
+            Log.d(TAG, "onMeasure() width: " + width + " height: " + height);
+        }
         setMeasuredDimension(width, height);
         if (parent.getWidth() > 0 && parent.getHeight() > 0 && mVideoWidth > 0 && mVideoHeight > 0) {
             FrameLayout.LayoutParams layoutParams = (FrameLayout.LayoutParams) getLayoutParams();
@@ -107,23 +128,37 @@ public final class PlayerSurfaceView extends SurfaceView implements SurfaceHolde
 
     @Override
     public void surfaceCreated(SurfaceHolder holder) {
-        Log.d(TAG, "surfaceCreated() called with: holder = [" + holder + "]");
+        if (DEBUG) {
+            Log.d(TAG, "surfaceCreated() called with: holder = [" + holder + "]");
+        }
+        if (mMediaPlayer != null) {
+            mMediaPlayer.attachSurface(holder.getSurface());
+        }
         onSurfaceChanged(holder.getSurface());
     }
 
     @Override
     public void surfaceChanged(SurfaceHolder holder, int format, int width, int height) {
-        Log.d(TAG, "surfaceChanged() called with: holder = [" + holder + "], format = [" + format + "], width = [" + width + "], height = [" + height + "]");
+        if (DEBUG) {
+            Log.d(TAG, "surfaceChanged() called with: holder = [" + holder + "], format = [" + format + "], width = [" + width + "], height = [" + height + "]");
+        }
     }
 
     @Override
     public void surfaceDestroyed(SurfaceHolder holder) {
-        Log.d(TAG, "surfaceDestroyed() called with: holder = [" + holder + "]");
+        if (DEBUG) {
+            Log.d(TAG, "surfaceDestroyed() called with: holder = [" + holder + "]");
+        }
+        if (mMediaPlayer != null) {
+            mMediaPlayer.detachSurface();
+        }
         onSurfaceChanged(null);
     }
 
     private void onSurfaceChanged(Surface surface) {
-        Log.d(TAG, "onSurfaceChanged() called with: surface = [" + surface + "]");
+        if (DEBUG) {
+            Log.d(TAG, "onSurfaceChanged() called with: surface = [" + surface + "]");
+        }
         if (surfaceChangeListener != null) {
             surfaceChangeListener.onSurfaceChange(surface);
         }
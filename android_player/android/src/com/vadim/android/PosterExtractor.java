@@ -0,0 +1,53 @@
+package com.vadim.android;
+
+import android.graphics.Bitmap;
+import android.media.MediaMetadataRetriever;
+import android.util.Log;
+
+// Poster frames for VideoGrid, called from the native extraction thread.
+final class PosterExtractor {
+    private static final String TAG = "PosterExtractor";
+    private static final boolean DEBUG = BuildConfig.DEBUG;
+
+    // the very first frames are often black
+    private static final long POSTER_TIME_US = 1000000;
+
+    private PosterExtractor() {
+    }
+
+    // Returns the sync frame closest to POSTER_TIME_US scaled down to fit into
+    // width x height, or null if the source can't be read.
+    static Bitmap extract(final String source, final int width, final int height) {
+        if (DEBUG) {
+            Log.d(TAG, "extract() source: " + source + " " + width + "x" + height);
+        }
+        if (TestPatternSource.handles(source)) {
+            return null;
+        }
+        final MediaMetadataRetriever retriever = new MediaMetadataRetriever();
+        try {
+            retriever.setDataSource(source);
+            Bitmap frame = retriever.getFrameAtTime(POSTER_TIME_US, MediaMetadataRetriever.OPTION_CLOSEST_SYNC);
+            if (frame == null) {
+                return null;
+            }
+            final float scale = Math.min(width / (float) frame.getWidth(), height / (float) frame.getHeight());
+            if (scale < 1) {
+                final Bitmap scaled = Bitmap.createScaledBitmap(frame,
+                        Math.max(1, Math.round(frame.getWidth() * scale)),
+                        Math.max(1, Math.round(frame.getHeight() * scale)),
+                        true);
+                if (scaled != frame) {
+                    frame.recycle();
+                }
+                frame = scaled;
+            }
+            return frame;
+        } catch (RuntimeException e) {
+            Log.w(TAG, "can't extract a poster from " + source, e);
+            return null;
+        } finally {
+            retriever.release();
+        }
+    }
+}
@@ -0,0 +1,351 @@
+package com.vadim.android;
+
+import android.graphics.Canvas;
+import android.graphics.Color;
+import android.graphics.Paint;
+import android.os.Handler;
+import android.os.HandlerThread;
+import android.os.SystemClock;
+import android.util.Log;
+import android.view.Surface;
+
+import java.util.concurrent.CountDownLatch;
+import java.util.regex.Matcher;
+import java.util.regex.Pattern;
+
+// Synthetic video source for deterministic measurements, selected with a
+// source of the form "testpattern:WIDTHxHEIGHT@FPS[/DURATION_MS]", for example
+// "testpattern:1280x720@60/30000". Frames are drawn with the CPU into the
+// surface at the frame rate and every frame carries a marker that a consumer
+// reading the frame back can decode:
+//
+//  - the top of the frame is two rows of MARKER_BITS square blocks spanning
+//    the full width, so a block is width / MARKER_BITS pixels;
+//  - the first row holds the frame index (32 bits) followed by the
+//    SystemClock.uptimeMillis() the frame was posted at (low 32 bits), most
+//    significant bit first, white for 1 and black for 0;
+//  - the second row holds the complement of the first, a block whose two
+//    rows don't differ means the marker was not read correctly.
+//
+// The frame index is derived from the media position, so after a seek it
+// jumps like the position does. A skipped index means a dropped frame and a
+// repeated index a repeated one.
+//
+// As with MEDIA_INFO_VIDEO_RENDERING_START, onStarted() follows the first
+// frame drawn after prepare, after a seek during playback and after looping
+// back to the start, so the gap a loop leaves on screen can be measured.
+//
+// QSurfaceTexture with measureLatency on decodes the marker of the frames it
+// shows.
+//
+// A surface that was drawn into with lockCanvas() stays connected to the CPU
+// producer and can't be handed to MediaPlayer until it is recreated. A
+// SurfaceTexture consumer receives frames at its default buffer size, which
+// QSurfaceTexture sets to the video size.
+final class TestPatternSource {
+    private static final String TAG = "TestPatternSource";
+    private static final boolean DEBUG = BuildConfig.DEBUG;
+
+    static final String SCHEME = "testpattern:";
+    static final int MARKER_BITS = 64;
+
+    private static final Pattern SPEC = Pattern.compile("(\\d+)x(\\d+)@(\\d+)(?:/(\\d+))?");
+    private static final int DEFAULT_WIDTH = 640;
+    private static final int DEFAULT_HEIGHT = 360;
+    private static final int DEFAULT_FPS = 30;
+    private static final long DEFAULT_DURATION_MS = 60000;
+    // the pattern has no real GOP, trick play sees a sync frame every second
+    private static final long KEYFRAME_INTERVAL_MS = 1000;
+
+    private final int mWidth;
+    private final int mHeight;
+    private final int mFps;
+    private final long mDuration;
+    private final HandlerThread mThread;
+    private final Handler mHandler;
+    private final Paint mPaint = new Paint();
+
+    private volatile MediaPlayerEventListener mEventListener;
+    // owned by the render thread, except for the reads of mFrame
+    private Surface mSurface;
+    private volatile long mFrame;
+    private boolean mPlaying;
+    private boolean mLooping;
+    private boolean mStarted;
+    private long mBaseTime;
+    private long mBaseFrame;
+    private float mSpeed = 1;
+
+    static boolean handles(final String source) {
+        return source != null && source.startsWith(SCHEME);
+    }
+
+    static long[] keyframes(final String source) {
+        long duration = DEFAULT_DURATION_MS;
+        final Matcher matcher = SPEC.matcher(source.substring(SCHEME.length()));
+        if (matcher.matches() && matcher.group(4) != null) {
+            duration = Long.parseLong(matcher.group(4));
+        }
+        final long[] times = new long[(int) (duration / KEYFRAME_INTERVAL_MS) + 1];
+        for (int i = 0; i < times.length; ++i) {
+            times[i] = i * KEYFRAME_INTERVAL_MS;
+        }
+        return times;
+    }
+
+    TestPatternSource(final String source, MediaPlayerEventListener eventListener) {
+        int width = DEFAULT_WIDTH;
+        int height = DEFAULT_HEIGHT;
+        int fps = DEFAULT_FPS;
+        long duration = DEFAULT_DURATION_MS;
+        final Matcher matcher = SPEC.matcher(source.substring(SCHEME.length()));
+        if (matcher.matches()) {
+            width = Integer.parseInt(matcher.group(1));
+            height = Integer.parseInt(matcher.group(2));
+            fps = Math.max(1, Integer.parseInt(matcher.group(3)));
+            if (matcher.group(4) != null) {
+                duration = Long.parseLong(matcher.group(4));
+            }
+        } else {
+            Log.w(TAG, "invalid test pattern: " + source + ", using the defaults");
+        }
+        mWidth = width;
+        mHeight = height;
+        mFps = fps;
+        mDuration = duration;
+        mEventListener = eventListener;
+        mThread = new HandlerThread(TAG);
+        mThread.start();
+        mHandler = new Handler(mThread.getLooper());
+        if (DEBUG) {
+            Log.d(TAG, "TestPatternSource() " + mWidth + "x" + mHeight + "@" + mFps + " duration: " + mDuration);
+        }
+    }
+
+    void setEventListener(MediaPlayerEventListener eventListener) {
+        mEventListener = eventListener;
+    }
+
+    void prepare(final long startPosition) {
+        mHandler.post(new Runnable() {
+            @Override
+            public void run() {
+                mFrame = frameAt(Math.max(0, startPosition));
+                final MediaPlayerEventListener eventListener = mEventListener;
+                if (eventListener != null) {
+                    eventListener.onVideoSizeChanged(mWidth, mHeight);
+                    eventListener.onBuffering(false);
+                    eventListener.onPrepared();
+                }
+            }
+        });
+    }
+
+    void start() {
+        mHandler.post(new Runnable() {
+            @Override
+            public void run() {
+                if (mPlaying) {
+                    return;
+                }
+                mPlaying = true;
+                mBaseTime = SystemClock.uptimeMillis();
+                mBaseFrame = mFrame;
+                mHandler.removeCallbacks(mRenderFrame);
+                mHandler.post(mRenderFrame);
+            }
+        });
+    }
+
+    void pause() {
+        mHandler.post(new Runnable() {
+            @Override
+            public void run() {
+                mPlaying = false;
+                mHandler.removeCallbacks(mRenderFrame);
+            }
+        });
+    }
+
+    void stop() {
+        pause();
+    }
+
+    void seekTo(final long position) {
+        mHandler.post(new Runnable() {
+            @Override
+            public void run() {
+                mFrame = frameAt(Math.max(0, Math.min(position, mDuration)));
+                mBaseTime = SystemClock.uptimeMillis();
+                mBaseFrame = mFrame;
+                if (!mPlaying) {
+                    draw(mFrame);
+                } else {
+                    mStarted = false;
+                }
+                final MediaPlayerEventListener eventListener = mEventListener;
+                if (eventListener != null) {
+                    eventListener.onSeekComplete();
+                }
+            }
+        });
+    }
+
+    // Frames are rendered at fps * speed, the position advances with them.
+    void setSpeed(final float speed) {
+        mHandler.post(new Runnable() {
+            @Override
+            public void run() {
+                if (speed <= 0 || speed == mSpeed) {
+                    return;
+                }
+                if (mPlaying) {
+                    // the frame already scheduled keeps its time, the ones
+                    // after it follow the new speed
+                    mBaseTime = frameTime(mFrame);
+                    mBaseFrame = mFrame;
+                }
+                mSpeed = speed;
+            }
+        });
+    }
+
+    void setLooping(final boolean looping) {
+        mHandler.post(new Runnable() {
+            @Override
+            public void run() {
+                mLooping = looping;
+            }
+        });
+    }
+
+    void setSurface(final Surface surface) {
+        mHandler.post(new Runnable() {
+            @Override
+            public void run() {
+                mSurface = surface;
+                if (!mPlaying) {
+                    draw(mFrame);
+                }
+            }
+        });
+    }
+
+    // Stops rendering and waits for a frame in flight, the surface may be
+    // destroyed as soon as this returns. Returns whether it was playing.
+    boolean detachSurface() {
+        final boolean[] playing = new boolean[1];
+        final CountDownLatch done = new CountDownLatch(1);
+        mHandler.post(new Runnable() {
+            @Override
+            public void run() {
+                playing[0] = mPlaying;
+                mPlaying = false;
+                mHandler.removeCallbacks(mRenderFrame);
+                mSurface = null;
+                done.countDown();
+            }
+        });
+        try {
+            done.await();
+        } catch (InterruptedException e) {
+            Thread.currentThread().interrupt();
+        }
+        return playing[0];
+    }
+
+    long getCurrentPosition() {
+        return mFrame * 1000 / mFps;
+    }
+
+    long getDuration() {
+        return mDuration;
+    }
+
+    void release() {
+        mHandler.removeCallbacksAndMessages(null);
+        mThread.quit();
+    }
+
+    private long frameAt(final long position) {
+        return position * mFps / 1000;
+    }
+
+    private long frameTime(final long frame) {
+        return mBaseTime + (long) ((frame - mBaseFrame) * 1000 / (mFps * mSpeed));
+    }
+
+    private final Runnable mRenderFrame = new Runnable() {
+        @Override
+        public void run() {
+            if (!mPlaying) {
+                return;
+            }
+            if (getCurrentPosition() >= mDuration) {
+                if (!mLooping) {
+                    mPlaying = false;
+                    final MediaPlayerEventListener eventListener = mEventListener;
+                    if (eventListener != null) {
+                        eventListener.onFinished();
+                    }
+                    return;
+                }
+                mFrame = 0;
+                mBaseTime = SystemClock.uptimeMillis();
+                mBaseFrame = 0;
+                mStarted = false;
+            }
+            draw(mFrame);
+            if (!mStarted) {
+                mStarted = true;
+                final MediaPlayerEventListener eventListener = mEventListener;
+                if (eventListener != null) {
+                    eventListener.onStarted();
+                }
+            }
+            ++mFrame;
+            // scheduled against the start time so the rate does not drift
+            mHandler.postAtTime(this, frameTime(mFrame));
+        }
+    };
+
+    private void draw(final long frame) {
+        if (mSurface == null || !mSurface.isValid()) {
+            return;
+        }
+        final Canvas canvas;
+        try {
+            canvas = mSurface.lockCanvas(null);
+        } catch (Exception e) {
+            e.printStackTrace();
+            return;
+        }
+        try {
+            canvas.scale(canvas.getWidth() / (float) mWidth, canvas.getHeight() / (float) mHeight);
+            canvas.drawColor(Color.DKGRAY);
+
+            // a bar sweeping across in one second makes stutter visible
+            final float barWidth = mWidth / 16f;
+            final float barX = (frame % mFps) * (mWidth - barWidth) / Math.max(1, mFps - 1);
+            mPaint.setColor(Color.LTGRAY);
+            canvas.drawRect(barX, 0, barX + barWidth, mHeight, mPaint);
+
+            final long timestamp = SystemClock.uptimeMillis() & 0xffffffffL;
+            final long marker = ((frame & 0xffffffffL) << 32) | timestamp;
+            final float block = mWidth / (float) MARKER_BITS;
+            for (int bit = 0; bit < MARKER_BITS; ++bit) {
+                final boolean set = ((marker >>> (MARKER_BITS - 1 - bit)) & 1) != 0;
+                mPaint.setColor(set ? Color.WHITE : Color.BLACK);
+                canvas.drawRect(bit * block, 0, (bit + 1) * block, block, mPaint);
+                mPaint.setColor(set ? Color.BLACK : Color.WHITE);
+                canvas.drawRect(bit * block, block, (bit + 1) * block, 2 * block, mPaint);
+            }
+
+            mPaint.setColor(Color.WHITE);
+            mPaint.setTextSize(mHeight / 12f);
+            canvas.drawText("frame " + frame, block, mHeight - block, mPaint);
+        } finally {
+            mSurface.unlockCanvasAndPost(canvas);
+        }
+    }
+}
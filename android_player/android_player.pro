@@ -6,6 +6,7 @@
 
 QT       += qml quick
 QT       += androidextras
+QT       += concurrent
 
 TARGET = android_player
 TEMPLATE = lib
@@ -23,18 +24,64 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    native/AesCtr.cpp \
+    native/AesCtrDataSource.cpp \
     native/AndroidMediaPlayer.cpp \
     native/AndroidSurfaceView.cpp \
+    native/AsyncReadEngine.cpp \
+    native/AtomicLatencyHistogram.cpp \
+    native/BandwidthEstimator.cpp \
+    native/CallTiming.cpp \
+    native/ClipCache.cpp \
+    native/EventRecorder.cpp \
+    native/FileDataSource.cpp \
+    native/IoScheduler.cpp \
+    native/LatencyHistogram.cpp \
+    native/MediaDataSource.cpp \
+    native/MemoryDataSource.cpp \
+    native/MemoryPressure.cpp \
+    native/PlayerDiagnostics.cpp \
+    native/PlayerLog.cpp \
+    native/PlayerSyncGroup.cpp \
+    native/PosterCache.cpp \
     native/QuickItemSurface.cpp \
-    native/QSurfaceTexture.cpp
+    native/QSurfaceTexture.cpp \
+    native/ResumeStore.cpp \
+    native/Trace.cpp \
+    native/VideoGrid.cpp \
+    native/VirtualTimeline.cpp
 
 HEADERS += \
     native/AndroidMediaPlayer.h \
     native/com_vadim_android_NativeMediaPlayerEventListener.h \
     native/com_vadim_android_NativeSurfaceChangeListener.h \
+    native/com_vadim_android_NativeMediaDataSource.h \
+    native/com_vadim_android_NativeMemoryPressureListener.h \
+    native/AesCtr.h \
+    native/AesCtrDataSource.h \
     native/AndroidSurfaceView.h \
+    native/AsyncReadEngine.h \
+    native/AtomicLatencyHistogram.h \
+    native/BandwidthEstimator.h \
+    native/CallTiming.h \
+    native/ClipCache.h \
+    native/EventRecorder.h \
+    native/FileDataSource.h \
+    native/IoScheduler.h \
+    native/LatencyHistogram.h \
+    native/MediaDataSource.h \
+    native/MemoryDataSource.h \
+    native/MemoryPressure.h \
+    native/PlayerDiagnostics.h \
+    native/PlayerLog.h \
+    native/PlayerSyncGroup.h \
+    native/PosterCache.h \
     native/QuickItemSurface.h \
-    native/QSurfaceTexture.h
+    native/QSurfaceTexture.h \
+    native/ResumeStore.h \
+    native/Trace.h \
+    native/VideoGrid.h \
+    native/VirtualTimeline.h
 
 DISTFILES += \
     android/AndroidManifest.xml \
@@ -47,21 +94,39 @@ DISTFILES += \
     android/local.properties \
     android/src/com/vadim/android/AndroidMediaPlayer.java \
     android/src/com/vadim/android/IPlayerSurfaceActivity.java \
+    android/src/com/vadim/android/KeyframeIndex.java \
     android/src/com/vadim/android/PlayerSurfaceActivity.java \
     android/src/com/vadim/android/SurfaceTextureListener.java \
     android/src/com/vadim/android/PlayerSurfaceView.java \
     android/src/com/vadim/android/SurfaceChangeListener.java \
     android/src/com/vadim/android/NativeSurfaceChangeListener.java \
     android/src/com/vadim/android/MediaPlayerEventListener.java \
-    android/src/com/vadim/android/NativeMediaPlayerEventListener.java
+    android/src/com/vadim/android/NativeMediaPlayerEventListener.java \
+    android/src/com/vadim/android/NativeMediaDataSource.java \
+    android/src/com/vadim/android/NativeMemoryPressureListener.java \
+    android/src/com/vadim/android/PosterExtractor.java \
+    android/src/com/vadim/android/TestPatternSource.java
+
+# AES instructions are only emitted from intrinsics and guarded by a HWCAP check
+contains(ANDROID_TARGET_ARCH,arm64-v8a) {
+    QMAKE_CXXFLAGS += -march=armv8-a+crypto
+}
 
 contains(ANDROID_TARGET_ARCH,armeabi-v7a) {
     ANDROID_PACKAGE_SOURCE_DIR = \
         $$PWD/android
 }
 
+# a debug build gets the debug AAR, where BuildConfig.DEBUG turns the Java
+# logging on; in the release AAR the guarded Log calls are compiled out
+CONFIG(debug, debug|release) {
+    AAR_BUILD_TASK = assembleDebug
+} else {
+    AAR_BUILD_TASK = assembleRelease
+}
+
 AarLibTarget.target = AarLib
 AarLibTarget.depends = FORCE
-AarLibTarget.commands = cd $$PWD/android && bash gradlew assembleRelease -PbuildDir=$$OUT_PWD/aar
+AarLibTarget.commands = cd $$PWD/android && bash gradlew $$AAR_BUILD_TASK -PbuildDir=$$OUT_PWD/aar
 PRE_TARGETDEPS += AarLib
 QMAKE_EXTRA_TARGETS += AarLibTarget
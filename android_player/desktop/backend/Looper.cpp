@@ -0,0 +1,116 @@
+#include "Looper.h"
+
+#include <future>
+
+#include <pthread.h>
+
+Looper::Looper(const char *name) :
+    mName(name),
+    mQuit(false),
+    mThread(&Looper::run, this)
+{
+}
+
+Looper::~Looper()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mWakeup.notify_all();
+    mThread.join();
+}
+
+bool Looper::post(Task task, int token)
+{
+    return postAt(Clock::now(), std::move(task), token);
+}
+
+bool Looper::postDelayed(int64_t delayMs, Task task, int token)
+{
+    return postAt(Clock::now() + std::chrono::milliseconds(delayMs), std::move(task), token);
+}
+
+bool Looper::postAt(Clock::time_point time, Task task, int token)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mQuit) {
+            return false;
+        }
+        // inserted after equal keys, tasks due at the same time keep their order
+        mTasks.emplace(time, Entry{token, std::move(task)});
+    }
+    mWakeup.notify_all();
+    return true;
+}
+
+void Looper::removeCallbacks(int token)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto it = mTasks.begin(); it != mTasks.end();) {
+        it = it->second.token == token ? mTasks.erase(it) : std::next(it);
+    }
+}
+
+void Looper::removeAll()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTasks.clear();
+}
+
+void Looper::runSync(const Task &task)
+{
+    if (isCurrentThread()) {
+        task();
+        return;
+    }
+    std::promise<void> done;
+    const bool posted = post([&task, &done] {
+        task();
+        done.set_value();
+    });
+    if (posted) {
+        done.get_future().wait();
+    }
+}
+
+bool Looper::isCurrentThread() const
+{
+    return std::this_thread::get_id() == mThread.get_id();
+}
+
+size_t Looper::pendingTasks() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mTasks.size();
+}
+
+int64_t Looper::uptimeMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+}
+
+void Looper::run()
+{
+    pthread_setname_np(pthread_self(), mName.substr(0, 15).c_str());
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mQuit) {
+        if (mTasks.empty()) {
+            mWakeup.wait(lock);
+            continue;
+        }
+        const auto first = mTasks.begin();
+        // a copy, the task may be removed while waiting
+        const Clock::time_point due = first->first;
+        if (due > Clock::now()) {
+            mWakeup.wait_until(lock, due);
+            continue;
+        }
+        const Task task = std::move(first->second.task);
+        mTasks.erase(first);
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef LOOPER_H
+#define LOOPER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// A thread running posted tasks in time order, the desktop counterpart of
+// android.os.HandlerThread with its Handler. Tasks posted for the same time
+// run in posting order. A token groups tasks for removeCallbacks(), like the
+// Runnable passed to Handler.removeCallbacks().
+class Looper
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Task = std::function<void()>;
+
+    explicit Looper(const char *name);
+    // Drops the pending tasks and joins the thread.
+    ~Looper();
+
+    // Return false once the looper is shutting down, the task is dropped.
+    bool post(Task task, int token = 0);
+    bool postDelayed(int64_t delayMs, Task task, int token = 0);
+    bool postAt(Clock::time_point time, Task task, int token = 0);
+    void removeCallbacks(int token);
+    void removeAll();
+    // Runs the task on the looper thread and waits for it, runs it in place
+    // when called on the looper thread.
+    void runSync(const Task &task);
+
+    bool isCurrentThread() const;
+    size_t pendingTasks() const;
+
+    // android.os.SystemClock.uptimeMillis()
+    static int64_t uptimeMs();
+
+private:
+    Looper(const Looper &) = delete;
+    Looper &operator=(const Looper &) = delete;
+
+    void run();
+
+    struct Entry
+    {
+        int token;
+        Task task;
+    };
+
+    const std::string mName;
+    mutable std::mutex mMutex;
+    std::condition_variable mWakeup;
+    std::multimap<Clock::time_point, Entry> mTasks;
+    bool mQuit;
+    std::thread mThread;
+};
+
+#endif // LOOPER_H
@@ -0,0 +1,723 @@
+#include "SimulatedBackend.h"
+#include "FakeJni.h"
+#include "com_vadim_android_NativeMediaPlayerEventListener.h"
+#include "com_vadim_android_NativeMemoryPressureListener.h"
+#include "com_vadim_android_NativeSurfaceChangeListener.h"
+
+#include <QOpenGLContext>
+#include <QtAndroid>
+#include <QtGui/qopengl.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <map>
+#include <thread>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <malloc.h>
+#include <unistd.h>
+
+// QSurfaceTexture.cpp, there is no generated header for it
+extern "C" void Java_com_vadim_android_SurfaceTextureListener_frameAvailable(JNIEnv *, jobject, jlong);
+
+namespace {
+
+const char *const PLAYER_CLASS = "com/vadim/android/AndroidMediaPlayer";
+const char *const ACTIVITY_CLASS = "org/qtproject/qt5/android/bindings/QtActivity";
+// what an object costs on the Java heap, Runtime reports the live objects at it
+const int64_t JAVA_OBJECT_BYTES = 64;
+const int64_t JAVA_HEAP_FREE = 4 * 1024 * 1024;
+
+std::string stringArg(const FakeJni::Args &args, size_t index)
+{
+    const auto string = index < args.size() ? FakeJni::cast<FakeJni::String>(args[index].object) : nullptr;
+    return string ? string->value : std::string();
+}
+
+// A Java object holding the handle of its native counterpart.
+class HandleObject : public FakeJni::Object
+{
+public:
+    HandleObject(const char *className, jlong handle) :
+        Object(className),
+        handle(handle)
+    {
+    }
+
+    const jlong handle;
+};
+
+// NativeMediaPlayerEventListener
+class PlayerListener : public HandleObject, public SimulatedMediaPlayer::Listener
+{
+public:
+    explicit PlayerListener(jlong handle) :
+        HandleObject("com/vadim/android/NativeMediaPlayerEventListener", handle)
+    {
+    }
+
+    void onVideoSizeChanged(int width, int height) override
+    {
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onVideoSizeChanged(FakeJni::env(), nullptr,
+                                                                                 handle, width, height);
+    }
+    void onStarted() override
+    {
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onStarted(FakeJni::env(), nullptr, handle);
+    }
+    void onFinished() override
+    {
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onFinished(FakeJni::env(), nullptr, handle);
+    }
+    void onError(int what, int extra) override
+    {
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onError(FakeJni::env(), nullptr, handle, what, extra);
+    }
+    void onBuffering(bool state) override
+    {
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onBuffering(FakeJni::env(), nullptr, handle, state);
+    }
+    void onBufferingUpdate(int percent) override
+    {
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onBufferingUpdate(FakeJni::env(), nullptr,
+                                                                                handle, percent);
+    }
+    void onPause() override
+    {
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onPause(FakeJni::env(), nullptr, handle);
+    }
+    void onPrepared() override
+    {
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onPrepared(FakeJni::env(), nullptr, handle);
+    }
+    void onSeekComplete() override
+    {
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onSeekComplete(FakeJni::env(), nullptr, handle);
+    }
+    void onNextPartStarted() override
+    {
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onNextPartStarted(FakeJni::env(), nullptr, handle);
+    }
+    void onSuspended(bool suspended) override
+    {
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onSuspended(FakeJni::env(), nullptr,
+                                                                          handle, suspended);
+    }
+};
+
+class JavaPlayer : public FakeJni::Object
+{
+public:
+    JavaPlayer() : Object(PLAYER_CLASS) {}
+
+    SimulatedMediaPlayer player;
+};
+
+// native listener handle -> player
+std::mutex playersMutex;
+std::map<jlong, std::weak_ptr<JavaPlayer>> players;
+
+// android.view.Surface, drawing into a consumer
+class JavaSurface : public FakeJni::Object
+{
+public:
+    explicit JavaSurface(std::shared_ptr<SimulatedMediaPlayer::Surface> consumer) :
+        Object("android/view/Surface"),
+        consumer(std::move(consumer))
+    {
+    }
+
+    const std::shared_ptr<SimulatedMediaPlayer::Surface> consumer;
+};
+
+std::atomic<int64_t> viewFrames{0};
+std::atomic<int> viewCount{0};
+std::atomic<int> flags{0};
+
+// The surface of a SurfaceView, composited by the platform.
+class ViewSurface : public SimulatedMediaPlayer::Surface
+{
+public:
+    bool isValid() const override { return !destroyed; }
+    void post(const SimulatedMediaPlayer::Frame &) override { viewFrames.fetch_add(1, std::memory_order_relaxed); }
+
+    std::atomic<bool> destroyed{false};
+};
+
+std::shared_ptr<JavaSurface> surfaceArg(const FakeJni::Args &args)
+{
+    return args.empty() ? nullptr : FakeJni::cast<JavaSurface>(args[0].object);
+}
+
+// PlayerSurfaceView, used on the Android UI thread only like the view.
+class JavaSurfaceView : public FakeJni::Object
+{
+public:
+    JavaSurfaceView() : Object("com/vadim/android/PlayerSurfaceView") {}
+
+    void setMediaPlayer(std::shared_ptr<JavaPlayer> player)
+    {
+        mPlayer = std::move(player);
+        if (mPlayer && mSurface) {
+            mPlayer->player.attachSurface(mSurface->consumer);
+        }
+    }
+
+    // SurfaceHolder.Callback
+    void surfaceCreated()
+    {
+        if (mSurface) {
+            return;
+        }
+        mSurface = std::make_shared<JavaSurface>(std::make_shared<ViewSurface>());
+        if (mPlayer) {
+            mPlayer->player.attachSurface(mSurface->consumer);
+        }
+        onSurfaceChanged(mSurface);
+    }
+
+    void surfaceDestroyed()
+    {
+        if (!mSurface) {
+            return;
+        }
+        if (mPlayer) {
+            mPlayer->player.detachSurface();
+        }
+        std::static_pointer_cast<ViewSurface>(mSurface->consumer)->destroyed = true;
+        mSurface = nullptr;
+        onSurfaceChanged(nullptr);
+    }
+
+    std::shared_ptr<HandleObject> listener;
+
+private:
+    void onSurfaceChanged(const FakeJni::ObjectPtr &surface)
+    {
+        if (listener) {
+            const FakeJni::LocalRef reference(surface);
+            Java_com_vadim_android_NativeSurfaceChangeListener_onSurfaceChanged(FakeJni::env(), nullptr,
+                                                                                listener->handle, reference.get());
+        }
+    }
+
+    std::shared_ptr<JavaPlayer> mPlayer;
+    std::shared_ptr<JavaSurface> mSurface;
+};
+
+// android.graphics.SurfaceTexture. Frames arrive on the player's looper,
+// updateTexImage() runs on the render thread with the context current.
+class JavaSurfaceTexture : public FakeJni::Object, public SimulatedMediaPlayer::Surface
+{
+public:
+    explicit JavaSurfaceTexture(GLuint textureId) :
+        Object("android/graphics/SurfaceTexture"),
+        mTextureId(textureId)
+    {
+    }
+
+    void post(const SimulatedMediaPlayer::Frame &frame) override
+    {
+        jlong listener = 0;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mReleased) {
+                return;
+            }
+            mPending = true;
+            mFrame = frame;
+            mSpec = *frame.spec;
+            listener = mListener;
+        }
+        if (listener) {
+            Java_com_vadim_android_SurfaceTextureListener_frameAvailable(FakeJni::env(), nullptr, listener);
+        }
+    }
+
+    void setListener(jlong listener)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mListener = listener;
+    }
+
+    void setDefaultBufferSize(int width, int height)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWidth = width;
+        mHeight = height;
+    }
+
+    void updateTexImage()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (!mPending) {
+            return;
+        }
+        mPending = false;
+        mTimestampNs = mFrame.uptimeMs * 1000000;
+        const int width = mWidth > 0 ? mWidth : mSpec.width;
+        const int height = mHeight > 0 ? mHeight : mSpec.height;
+        const TestPattern::Spec spec = mSpec;
+        const SimulatedMediaPlayer::Frame frame = mFrame;
+        lock.unlock();
+
+        if (!QOpenGLContext::currentContext()) {
+            return;
+        }
+        mPixels.resize(size_t(width) * size_t(height));
+        TestPattern::paint(mPixels.data(), width, height, width, spec, frame.index, frame.uptimeMs);
+        glBindTexture(GL_TEXTURE_2D, mTextureId);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, mPixels.data());
+    }
+
+    jlong timestamp() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mTimestampNs;
+    }
+
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mReleased = true;
+        mListener = 0;
+    }
+
+private:
+    const GLuint mTextureId;
+    mutable std::mutex mMutex;
+    jlong mListener = 0;
+    bool mPending = false;
+    bool mReleased = false;
+    SimulatedMediaPlayer::Frame mFrame{};
+    TestPattern::Spec mSpec;
+    int mWidth = 0;
+    int mHeight = 0;
+    jlong mTimestampNs = 0;
+    // render thread
+    std::vector<uint32_t> mPixels;
+};
+
+class Bitmap : public FakeJni::Object
+{
+public:
+    Bitmap(int width, int height) :
+        Object("android/graphics/Bitmap"),
+        width(width),
+        height(height),
+        pixels(size_t(width) * size_t(height))
+    {
+    }
+
+    const int width;
+    const int height;
+    std::vector<uint32_t> pixels;
+};
+
+// ComponentCallbacks registered with the activity
+std::mutex callbacksMutex;
+std::vector<FakeJni::ObjectPtr> componentCallbacks;
+
+// TRIM_MEMORY_RUNNING_CRITICAL, for a trim signal sent without a level
+const int DEFAULT_TRIM_LEVEL = 15;
+// the trim signal handler writes levels to it, trimSignalThread reads them
+int trimPipe[2] = {-1, -1};
+
+void onTrimSignal(int, siginfo_t *info, void *)
+{
+    const int savedErrno = errno;
+    const int level = info->si_code == SI_QUEUE ? info->si_value.sival_int : DEFAULT_TRIM_LEVEL;
+    // async-signal-safe, a level is dropped if the pipe is full
+    if (write(trimPipe[1], &level, sizeof(level)) < 0) {
+        // nothing to do in a signal handler
+    }
+    errno = savedErrno;
+}
+
+void trimSignalThread()
+{
+    int level = 0;
+    while (read(trimPipe[0], &level, sizeof(level)) == sizeof(level)) {
+        SimulatedBackend::trimMemory(level);
+    }
+}
+
+// Registers a method of AndroidMediaPlayer implemented on its SimulatedMediaPlayer.
+template<typename Implementation>
+void playerMethod(const char *method, Implementation implementation)
+{
+    FakeJni::registerMethod(PLAYER_CLASS, method, [implementation](FakeJni::Object &self, const FakeJni::Args &args) {
+        SimulatedMediaPlayer &player = static_cast<JavaPlayer &>(self).player;
+        if constexpr (std::is_void<decltype(implementation(player, args))>::value) {
+            implementation(player, args);
+            return FakeJni::Value();
+        } else {
+            return FakeJni::Value(implementation(player, args));
+        }
+    });
+}
+
+void registerPlayer()
+{
+    FakeJni::registerClass(PLAYER_CLASS, [](const char *, const FakeJni::Args &) {
+        return std::make_shared<JavaPlayer>();
+    });
+    FakeJni::registerMethod(PLAYER_CLASS, "setEventListener", [](FakeJni::Object &self, const FakeJni::Args &args) {
+        const auto player = std::static_pointer_cast<JavaPlayer>(self.shared_from_this());
+        const auto listener = args.empty() ? nullptr : FakeJni::cast<PlayerListener>(args[0].object);
+        {
+            std::lock_guard<std::mutex> lock(playersMutex);
+            for (auto it = players.begin(); it != players.end();) {
+                const auto entry = it->second.lock();
+                it = !entry || entry == player ? players.erase(it) : std::next(it);
+            }
+            if (listener) {
+                players[listener->handle] = player;
+            }
+        }
+        player->player.setEventListener(listener);
+        return FakeJni::Value();
+    });
+    playerMethod("setDataSource", [](SimulatedMediaPlayer &player, const FakeJni::Args &args) {
+        player.setDataSource(stringArg(args, 0));
+    });
+    playerMethod("setNativeDataSource", [](SimulatedMediaPlayer &player, const FakeJni::Args &args) {
+        player.setNativeDataSource(args.at(0).i);
+    });
+    playerMethod("prepareNext", [](SimulatedMediaPlayer &player, const FakeJni::Args &args) {
+        player.prepareNext(stringArg(args, 0));
+    });
+    playerMethod("prepareNextNative", [](SimulatedMediaPlayer &player, const FakeJni::Args &args) {
+        player.prepareNextNative(args.at(0).i);
+    });
+    playerMethod("prepare", [](SimulatedMediaPlayer &player, const FakeJni::Args &args) {
+        player.prepare(args.empty() ? 0 : args[0].i);
+    });
+    playerMethod("start", [](SimulatedMediaPlayer &player, const FakeJni::Args &) { player.start(); });
+    playerMethod("resume", [](SimulatedMediaPlayer &player, const FakeJni::Args &) { player.resume(); });
+    playerMethod("pause", [](SimulatedMediaPlayer &player, const FakeJni::Args &) { player.pause(); });
+    playerMethod("stop", [](SimulatedMediaPlayer &player, const FakeJni::Args &) { player.stop(); });
+    playerMethod("reset", [](SimulatedMediaPlayer &player, const FakeJni::Args &) { player.reset(); });
+    playerMethod("release", [](SimulatedMediaPlayer &player, const FakeJni::Args &) { player.release(); });
+    playerMethod("seekTo", [](SimulatedMediaPlayer &player, const FakeJni::Args &args) {
+        player.seekTo(args.at(0).i);
+    });
+    playerMethod("seekToSync", [](SimulatedMediaPlayer &player, const FakeJni::Args &args) {
+        player.seekToSync(args.at(0).i);
+    });
+    playerMethod("getCurrentPosition", [](SimulatedMediaPlayer &player, const FakeJni::Args &) {
+        return jlong(player.getCurrentPosition());
+    });
+    playerMethod("getDuration", [](SimulatedMediaPlayer &player, const FakeJni::Args &) {
+        return jlong(player.getDuration());
+    });
+    playerMethod("setLooping", [](SimulatedMediaPlayer &player, const FakeJni::Args &args) {
+        player.setLooping(args.at(0).i != 0);
+    });
+    playerMethod("setVideoScalingMode", [](SimulatedMediaPlayer &player, const FakeJni::Args &args) {
+        player.setVideoScalingMode(int(args.at(0).i));
+    });
+    playerMethod("setPlaybackSpeed", [](SimulatedMediaPlayer &player, const FakeJni::Args &args) {
+        return player.setPlaybackSpeed(float(args.at(0).f));
+    });
+    playerMethod("useRTPlayer", [](SimulatedMediaPlayer &player, const FakeJni::Args &args) {
+        player.useRTPlayer(args.at(0).i != 0);
+    });
+    playerMethod("setSurface", [](SimulatedMediaPlayer &player, const FakeJni::Args &args) {
+        const auto surface = surfaceArg(args);
+        player.setSurface(surface ? surface->consumer : nullptr);
+    });
+    playerMethod("attachSurface", [](SimulatedMediaPlayer &player, const FakeJni::Args &args) {
+        const auto surface = surfaceArg(args);
+        player.attachSurface(surface ? surface->consumer : nullptr);
+    });
+    playerMethod("detachSurface", [](SimulatedMediaPlayer &player, const FakeJni::Args &) {
+        player.detachSurface();
+    });
+    FakeJni::registerStaticMethod(PLAYER_CLASS, "getMediaDuration", [](const FakeJni::Args &args) {
+        return FakeJni::Value(jlong(SimulatedMediaPlayer::mediaDuration(stringArg(args, 0))));
+    });
+
+    FakeJni::registerClass("com/vadim/android/NativeMediaPlayerEventListener",
+                           [](const char *, const FakeJni::Args &args) {
+        return std::make_shared<PlayerListener>(args.at(0).i);
+    });
+
+    FakeJni::registerStaticMethod("com/vadim/android/KeyframeIndex", "build", [](const FakeJni::Args &args) {
+        const auto keyframes = SimulatedMediaPlayer::keyframes(stringArg(args, 0));
+        if (keyframes.empty()) {
+            return FakeJni::Value();
+        }
+        return FakeJni::Value(FakeJni::newLongArray(std::vector<jlong>(keyframes.begin(), keyframes.end())));
+    });
+}
+
+void registerSurfaces()
+{
+    FakeJni::registerClass("android/view/Surface", [](const char *, const FakeJni::Args &args) {
+        // new Surface(SurfaceTexture)
+        const auto texture = args.empty() ? nullptr : FakeJni::cast<JavaSurfaceTexture>(args[0].object);
+        return std::make_shared<JavaSurface>(texture);
+    });
+    FakeJni::registerMethod("android/view/Surface", "isValid", [](FakeJni::Object &self, const FakeJni::Args &) {
+        const auto &consumer = static_cast<JavaSurface &>(self).consumer;
+        return FakeJni::Value(consumer && consumer->isValid());
+    });
+    FakeJni::registerMethod("android/view/Surface", "release", [](FakeJni::Object &, const FakeJni::Args &) {
+        return FakeJni::Value();
+    });
+
+    const char *const VIEW_CLASS = "com/vadim/android/PlayerSurfaceView";
+    FakeJni::registerClass(VIEW_CLASS, [](const char *, const FakeJni::Args &) {
+        return std::make_shared<JavaSurfaceView>();
+    });
+    FakeJni::registerMethod(VIEW_CLASS, "setSurfaceChangeListener", [](FakeJni::Object &self, const FakeJni::Args &args) {
+        static_cast<JavaSurfaceView &>(self).listener = FakeJni::cast<HandleObject>(args.at(0).object);
+        return FakeJni::Value();
+    });
+    FakeJni::registerMethod(VIEW_CLASS, "setMediaPlayer", [](FakeJni::Object &self, const FakeJni::Args &args) {
+        static_cast<JavaSurfaceView &>(self).setMediaPlayer(FakeJni::cast<JavaPlayer>(args.at(0).object));
+        return FakeJni::Value();
+    });
+    // layout only
+    for (const char *method : {"setFocusable", "setFocusableInTouchMode", "setZOrderMediaOverlay",
+                               "setZOrderOnTop", "setVideoSize", "setScalingMode"}) {
+        FakeJni::registerMethod(VIEW_CLASS, method, [](FakeJni::Object &, const FakeJni::Args &) {
+            return FakeJni::Value();
+        });
+    }
+    FakeJni::registerClass("com/vadim/android/NativeSurfaceChangeListener", [](const char *, const FakeJni::Args &args) {
+        return std::make_shared<HandleObject>("com/vadim/android/NativeSurfaceChangeListener", args.at(0).i);
+    });
+
+    const char *const TEXTURE_CLASS = "android/graphics/SurfaceTexture";
+    FakeJni::registerClass(TEXTURE_CLASS, [](const char *, const FakeJni::Args &args) {
+        return std::make_shared<JavaSurfaceTexture>(GLuint(args.at(0).i));
+    });
+    FakeJni::registerMethod(TEXTURE_CLASS, "setOnFrameAvailableListener", [](FakeJni::Object &self, const FakeJni::Args &args) {
+        const auto listener = FakeJni::cast<HandleObject>(args.at(0).object);
+        static_cast<JavaSurfaceTexture &>(self).setListener(listener ? listener->handle : 0);
+        return FakeJni::Value();
+    });
+    FakeJni::registerMethod(TEXTURE_CLASS, "setDefaultBufferSize", [](FakeJni::Object &self, const FakeJni::Args &args) {
+        static_cast<JavaSurfaceTexture &>(self).setDefaultBufferSize(int(args.at(0).i), int(args.at(1).i));
+        return FakeJni::Value();
+    });
+    FakeJni::registerMethod(TEXTURE_CLASS, "updateTexImage", [](FakeJni::Object &self, const FakeJni::Args &) {
+        static_cast<JavaSurfaceTexture &>(self).updateTexImage();
+        return FakeJni::Value();
+    });
+    FakeJni::registerMethod(TEXTURE_CLASS, "getTransformMatrix", [](FakeJni::Object &, const FakeJni::Args &args) {
+        // frames are uploaded upright, the transform is the identity
+        if (const auto matrix = FakeJni::cast<FakeJni::FloatArray>(args.at(0).object)) {
+            std::fill(matrix->data.begin(), matrix->data.end(), 0.0f);
+            for (size_t i = 0; i < 16 && i < matrix->data.size(); i += 5) {
+                matrix->data[i] = 1;
+            }
+        }
+        return FakeJni::Value();
+    });
+    FakeJni::registerMethod(TEXTURE_CLASS, "getTimestamp", [](FakeJni::Object &self, const FakeJni::Args &) {
+        return FakeJni::Value(static_cast<JavaSurfaceTexture &>(self).timestamp());
+    });
+    FakeJni::registerMethod(TEXTURE_CLASS, "release", [](FakeJni::Object &self, const FakeJni::Args &) {
+        static_cast<JavaSurfaceTexture &>(self).release();
+        return FakeJni::Value();
+    });
+    FakeJni::registerClass("com/vadim/android/SurfaceTextureListener", [](const char *, const FakeJni::Args &args) {
+        return std::make_shared<HandleObject>("com/vadim/android/SurfaceTextureListener", args.at(0).i);
+    });
+}
+
+void registerActivity()
+{
+    FakeJni::registerMethod(ACTIVITY_CLASS, "addPlayerSurface", [](FakeJni::Object &, const FakeJni::Args &args) {
+        const auto view = FakeJni::cast<JavaSurfaceView>(args.at(0).object);
+        if (view) {
+            ++viewCount;
+            // the surface is created in the next layout pass
+            QtAndroid::runOnAndroidThread([view] { view->surfaceCreated(); });
+        }
+        return FakeJni::Value();
+    });
+    FakeJni::registerMethod(ACTIVITY_CLASS, "removePlayerSurface", [](FakeJni::Object &, const FakeJni::Args &args) {
+        // removeView() destroys the surface before it returns
+        if (const auto view = FakeJni::cast<JavaSurfaceView>(args.at(0).object)) {
+            --viewCount;
+            view->surfaceDestroyed();
+        }
+        return FakeJni::Value();
+    });
+    FakeJni::registerMethod(ACTIVITY_CLASS, "setPlayerSurfaceGeometry", [](FakeJni::Object &, const FakeJni::Args &) {
+        return FakeJni::Value();
+    });
+    FakeJni::registerMethod(ACTIVITY_CLASS, "getWindow", [](FakeJni::Object &, const FakeJni::Args &) {
+        static const auto window = std::make_shared<FakeJni::Object>("android/view/Window");
+        return FakeJni::Value(window);
+    });
+    FakeJni::registerMethod("android/view/Window", "addFlags", [](FakeJni::Object &, const FakeJni::Args &args) {
+        flags |= int(args.at(0).i);
+        return FakeJni::Value();
+    });
+    FakeJni::registerMethod("android/view/Window", "clearFlags", [](FakeJni::Object &, const FakeJni::Args &args) {
+        flags &= ~int(args.at(0).i);
+        return FakeJni::Value();
+    });
+    FakeJni::registerMethod(ACTIVITY_CLASS, "registerComponentCallbacks", [](FakeJni::Object &, const FakeJni::Args &args) {
+        std::lock_guard<std::mutex> lock(callbacksMutex);
+        componentCallbacks.push_back(args.at(0).object);
+        return FakeJni::Value();
+    });
+    FakeJni::registerMethod("com/vadim/android/NativeMemoryPressureListener", "onTrimMemory",
+                            [](FakeJni::Object &, const FakeJni::Args &args) {
+        Java_com_vadim_android_NativeMemoryPressureListener_onMemoryTrimmed(FakeJni::env(), nullptr,
+                                                                            jint(args.at(0).i));
+        return FakeJni::Value();
+    });
+}
+
+void registerPlatform()
+{
+    FakeJni::registerStaticMethod("java/lang/Runtime", "getRuntime", [](const FakeJni::Args &) {
+        static const auto runtime = std::make_shared<FakeJni::Object>("java/lang/Runtime");
+        return FakeJni::Value(runtime);
+    });
+    FakeJni::registerMethod("java/lang/Runtime", "totalMemory", [](FakeJni::Object &, const FakeJni::Args &) {
+        return FakeJni::Value(jlong(FakeJni::Object::liveCount() * JAVA_OBJECT_BYTES + JAVA_HEAP_FREE));
+    });
+    FakeJni::registerMethod("java/lang/Runtime", "freeMemory", [](FakeJni::Object &, const FakeJni::Args &) {
+        return FakeJni::Value(jlong(JAVA_HEAP_FREE));
+    });
+    FakeJni::registerStaticMethod("android/os/Debug", "getNativeHeapAllocatedSize", [](const FakeJni::Args &) {
+        return FakeJni::Value(jlong(mallinfo2().uordblks));
+    });
+
+    FakeJni::registerStaticMethod("com/vadim/android/PosterExtractor", "extract", [](const FakeJni::Args &args) {
+        SimulatedMediaPlayer::Media media;
+        if (!SimulatedMediaPlayer::parseSource(stringArg(args, 0), &media)) {
+            return FakeJni::Value();
+        }
+        const int width = args.at(1).i > 0 ? int(args[1].i) : media.video.width;
+        const int height = args.at(2).i > 0 ? int(args[2].i) : media.video.height;
+        const auto bitmap = std::make_shared<Bitmap>(width, height);
+        TestPattern::paint(bitmap->pixels.data(), width, height, width, media.video, 0, 0);
+        return FakeJni::Value(bitmap);
+    });
+    const char *const BITMAP_CLASS = "android/graphics/Bitmap";
+    FakeJni::registerMethod(BITMAP_CLASS, "getWidth", [](FakeJni::Object &self, const FakeJni::Args &) {
+        return FakeJni::Value(jint(static_cast<Bitmap &>(self).width));
+    });
+    FakeJni::registerMethod(BITMAP_CLASS, "getHeight", [](FakeJni::Object &self, const FakeJni::Args &) {
+        return FakeJni::Value(jint(static_cast<Bitmap &>(self).height));
+    });
+    FakeJni::registerMethod(BITMAP_CLASS, "getPixels", [](FakeJni::Object &self, const FakeJni::Args &args) {
+        // getPixels(int[] pixels, int offset, int stride, int x, int y, int width, int height)
+        const Bitmap &bitmap = static_cast<Bitmap &>(self);
+        const auto pixels = FakeJni::cast<FakeJni::IntArray>(args.at(0).object);
+        const int offset = int(args.at(1).i);
+        const int stride = int(args.at(2).i);
+        const int x = int(args.at(3).i);
+        const int y = int(args.at(4).i);
+        const int width = int(args.at(5).i);
+        const int height = int(args.at(6).i);
+        if (!pixels || x < 0 || y < 0 || x + width > bitmap.width || y + height > bitmap.height
+                || offset + (height - 1) * stride + width > pixels->length()) {
+            FakeJni::throwNew("java/lang/IllegalArgumentException", "getPixels");
+            return FakeJni::Value();
+        }
+        for (int row = 0; row < height; ++row) {
+            const uint32_t *source = bitmap.pixels.data() + size_t(y + row) * size_t(bitmap.width) + size_t(x);
+            std::copy(source, source + width, pixels->data.begin() + offset + row * stride);
+        }
+        return FakeJni::Value();
+    });
+    FakeJni::registerMethod(BITMAP_CLASS, "recycle", [](FakeJni::Object &, const FakeJni::Args &) {
+        return FakeJni::Value();
+    });
+}
+
+}
+
+namespace SimulatedBackend {
+
+void install()
+{
+    static std::once_flag once;
+    std::call_once(once, [] {
+        registerPlayer();
+        registerSurfaces();
+        registerActivity();
+        registerPlatform();
+    });
+}
+
+SimulatedMediaPlayer *player(const QObject *androidMediaPlayer)
+{
+    std::lock_guard<std::mutex> lock(playersMutex);
+    const auto it = players.find(jlong(androidMediaPlayer));
+    const auto player = it == players.end() ? nullptr : it->second.lock();
+    // the Java object lives while the AndroidMediaPlayer holds it
+    return player ? &player->player : nullptr;
+}
+
+void trimMemory(int level)
+{
+    QtAndroid::runOnAndroidThread([level] {
+        std::vector<FakeJni::ObjectPtr> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(callbacksMutex);
+            callbacks = componentCallbacks;
+        }
+        for (const auto &callback : callbacks) {
+            FakeJni::call(*callback, "onTrimMemory", "(I)V", {jint(level)});
+        }
+    });
+}
+
+bool installTrimSignal(int signal)
+{
+    static std::once_flag once;
+    static bool piped = false;
+    std::call_once(once, [] {
+        if (pipe2(trimPipe, O_CLOEXEC | O_NONBLOCK) != 0) {
+            return;
+        }
+        // only the writing end may not block
+        fcntl(trimPipe[0], F_SETFL, fcntl(trimPipe[0], F_GETFL) & ~O_NONBLOCK);
+        std::thread(trimSignalThread).detach();
+        piped = true;
+    });
+    if (!piped) {
+        return false;
+    }
+    struct sigaction action = {};
+    action.sa_sigaction = onTrimSignal;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    return sigaction(signal, &action, nullptr) == 0;
+}
+
+void postFrame(const QAndroidJniObject &surfaceTexture, const TestPattern::Spec &spec, int64_t index)
+{
+    if (const auto texture = FakeJni::cast<JavaSurfaceTexture>(FakeJni::resolve(surfaceTexture.object()))) {
+        texture->post({index, index * 1000 / std::max(spec.fps, 1), Looper::uptimeMs(), &spec});
+    }
+}
+
+int64_t surfaceViewFrames()
+{
+    return viewFrames.load();
+}
+
+int surfaceViewCount()
+{
+    return viewCount.load();
+}
+
+int windowFlags()
+{
+    return flags.load();
+}
+
+}
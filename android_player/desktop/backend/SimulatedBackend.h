@@ -0,0 +1,60 @@
+#ifndef SIMULATEDBACKEND_H
+#define SIMULATEDBACKEND_H
+
+#include "SimulatedMediaPlayer.h"
+
+#include <QAndroidJniObject>
+
+#include <csignal>
+#include <cstdint>
+
+class QObject;
+
+// The Java side of the player on the desktop: registers the classes the
+// native sources call through QAndroidJniObject with FakeJni.
+//
+//  - com.vadim.android.AndroidMediaPlayer is a SimulatedMediaPlayer, its
+//    listener calls the NativeMediaPlayerEventListener entry points;
+//  - PlayerSurfaceView gets its surface once the activity added it and loses
+//    it when removed, like SurfaceHolder.Callback, frames drawn on it are
+//    counted;
+//  - SurfaceTexture hands the frames drawn on it to its listener and uploads
+//    the last one to its texture in updateTexImage(). The texture is a
+//    GL_TEXTURE_2D there, see QSurfaceTexture;
+//  - KeyframeIndex, PosterExtractor and getMediaDuration() describe the
+//    simulated media, Runtime and Debug report the process heap;
+//  - the activity keeps the ComponentCallbacks registered with it for
+//    trimMemory(), which a signal can send like the platform does.
+namespace SimulatedBackend {
+
+// Registers the classes, once. Players created before don't work.
+void install();
+
+// The simulated player of the AndroidMediaPlayer, the QObject the native
+// listener handle points to. nullptr if it has none.
+SimulatedMediaPlayer *player(const QObject *androidMediaPlayer);
+
+// Delivers onTrimMemory(level) to the registered ComponentCallbacks on the
+// Android UI thread, like the platform does.
+void trimMemory(int level);
+
+// Linux stand-in for "adb shell am send-trim-memory": when the process
+// receives signal, trimMemory() is delivered with the level sigqueue() sent
+// along, or TRIM_MEMORY_RUNNING_CRITICAL for a plain kill -USR1 <pid>.
+// Returns false if the handler can't be installed.
+bool installTrimSignal(int signal = SIGUSR1);
+
+// Posts frame index of a test pattern to a SurfaceTexture like a decoder,
+// without a player. Does nothing if surfaceTexture isn't one.
+void postFrame(const QAndroidJniObject &surfaceTexture, const TestPattern::Spec &spec, int64_t index);
+
+// Frames drawn on the surfaces of PlayerSurfaceViews.
+int64_t surfaceViewFrames();
+// PlayerSurfaceViews in the activity.
+int surfaceViewCount();
+// Window flags set through getWindow().addFlags()
+int windowFlags();
+
+}
+
+#endif // SIMULATEDBACKEND_H
@@ -0,0 +1,1111 @@
+#include "SimulatedMediaPlayer.h"
+#include "FakeJni.h"
+#include "com_vadim_android_NativeMediaDataSource.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/stat.h>
+
+namespace {
+
+// AndroidMediaPlayer.BUFFERING_UPDATE_INTERVAL_MS
+const int64_t BUFFERING_UPDATE_INTERVAL_MS = 250;
+// how often a downloading media updates its buffer
+const int64_t DOWNLOAD_TICK_MS = 100;
+// media buffered ahead of the position before a stalled player continues
+const int64_t REBUFFER_MS = 2000;
+// MediaPlayer reads ahead in chunks of about this size
+const jint READ_CHUNK = 64 * 1024;
+// android.os.Build.VERSION_CODES.M, PlaybackParams
+const int PLAYBACK_PARAMS_MIN_SDK = 23;
+const int ERROR_SURFACE_LOST = -19;
+
+enum TaskKind {
+    FRAME_TASK,
+    TICK_TASK,
+    OTHER_TASK,
+    TASK_KINDS
+};
+
+std::atomic<int64_t> liveInstances{0};
+
+std::mutex defaultMediaMutex;
+SimulatedMediaPlayer::Media defaultMedia;
+
+int64_t parseInt(const std::string &text, int64_t fallback)
+{
+    char *end = nullptr;
+    const long long value = strtoll(text.c_str(), &end, 10);
+    return end && *end == 0 && !text.empty() ? int64_t(value) : fallback;
+}
+
+bool parseSim(const std::string &source, SimulatedMediaPlayer::Media *media)
+{
+    static const std::string SCHEME = "sim:";
+    if (source.compare(0, SCHEME.size(), SCHEME) != 0) {
+        return false;
+    }
+    const size_t query = source.find('?');
+    media->video.durationMs = parseInt(source.substr(SCHEME.size(), query - SCHEME.size()),
+                                       media->video.durationMs);
+    size_t start = query == std::string::npos ? source.size() : query + 1;
+    while (start < source.size()) {
+        size_t end = source.find('&', start);
+        if (end == std::string::npos) {
+            end = source.size();
+        }
+        const std::string item = source.substr(start, end - start);
+        start = end + 1;
+        const size_t equals = item.find('=');
+        if (equals == std::string::npos) {
+            continue;
+        }
+        const std::string key = item.substr(0, equals);
+        const std::string value = item.substr(equals + 1);
+        if (key == "prepare") {
+            media->prepareMs = parseInt(value, media->prepareMs);
+        } else if (key == "seek") {
+            media->seekMs = parseInt(value, media->seekMs);
+        } else if (key == "render") {
+            media->renderMs = parseInt(value, media->renderMs);
+        } else if (key == "fps") {
+            media->video.fps = int(std::max<int64_t>(1, parseInt(value, media->video.fps)));
+        } else if (key == "width") {
+            media->video.width = int(parseInt(value, media->video.width));
+        } else if (key == "height") {
+            media->video.height = int(parseInt(value, media->video.height));
+        } else if (key == "keyframes") {
+            media->keyframeIntervalMs = std::max<int64_t>(1, parseInt(value, media->keyframeIntervalMs));
+        } else if (key == "download") {
+            media->downloadRate = std::max(0.0, atof(value.c_str()));
+        } else if (key == "clock") {
+            const double rate = atof(value.c_str());
+            media->clockRate = rate > 0 ? rate : media->clockRate;
+        } else if (key == "bitrate") {
+            media->bitrate = std::max<int64_t>(1, parseInt(value, media->bitrate));
+        } else if (key == "error") {
+            if (value == "prepare") {
+                media->prepareError = true;
+            } else {
+                media->errorAtMs = parseInt(value, -1);
+            }
+        } else if (key == "what") {
+            media->errorWhat = int(parseInt(value, media->errorWhat));
+        } else if (key == "extra") {
+            media->errorExtra = int(parseInt(value, media->errorExtra));
+        }
+    }
+    return true;
+}
+
+// NativeMediaDataSource, its methods are synchronized so close() waits for
+// a read in progress.
+class NativeSource
+{
+public:
+    explicit NativeSource(jlong handle) :
+        mHandle(handle),
+        mSize(Java_com_vadim_android_NativeMediaDataSource_getSize(FakeJni::env(), nullptr, handle)),
+        mBuffer(FakeJni::newByteArray(size_t(READ_CHUNK)))
+    {
+    }
+
+    ~NativeSource() { close(); }
+
+    int64_t size() const { return mSize; }
+
+    // Returns the bytes read, 0 at the end and -1 on error.
+    int64_t read(int64_t position, int64_t size)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mHandle) {
+            return -1;
+        }
+        const FakeJni::LocalRef buffer(mBuffer);
+        int64_t total = 0;
+        while (total < size) {
+            if (mSize >= 0 && position + total >= mSize) {
+                break;
+            }
+            const jint chunk = jint(std::min<int64_t>(READ_CHUNK, size - total));
+            const jint read = Java_com_vadim_android_NativeMediaDataSource_readAt(
+                        FakeJni::env(), nullptr, mHandle, position + total, buffer.as<jbyteArray>(), 0, chunk);
+            if (read < 0) {
+                // -1 means the end, reads before the known size must not end
+                return mSize >= 0 && position + total < mSize ? -1 : total;
+            }
+            total += read;
+        }
+        return total;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mHandle) {
+            Java_com_vadim_android_NativeMediaDataSource_close(FakeJni::env(), nullptr, mHandle);
+            mHandle = 0;
+        }
+    }
+
+private:
+    std::mutex mMutex;
+    jlong mHandle;
+    const int64_t mSize;
+    const std::shared_ptr<FakeJni::ByteArray> mBuffer;
+};
+
+}
+
+// One android.media.MediaPlayer.
+struct SimulatedMediaPlayer::Engine
+{
+    enum State {
+        Idle,
+        Initialized,
+        Preparing,
+        Prepared,
+        Started,
+        Paused,
+        PlaybackCompleted,
+        Stopped,
+        Error,
+        End
+    };
+
+    explicit Engine(int id) : id(id) {}
+
+    int token(TaskKind kind) const { return id * TASK_KINDS + kind; }
+
+    bool isPrepared() const
+    {
+        return state == Prepared || state == Started || state == Paused || state == PlaybackCompleted;
+    }
+
+    int64_t position(int64_t now) const
+    {
+        if (state != Started || stalled || now <= baseTime) {
+            return basePosition;
+        }
+        const int64_t position = basePosition + int64_t(double(now - baseTime) * rate());
+        return std::min(position, media.video.durationMs);
+    }
+
+    // media ms per uptime ms
+    double rate() const
+    {
+        return speed * media.clockRate;
+    }
+
+    void rebase(int64_t now)
+    {
+        basePosition = position(now);
+        baseTime = std::max(baseTime, now);
+    }
+
+    int64_t frameAt(int64_t position) const
+    {
+        return position * media.video.fps / 1000;
+    }
+
+    // the media of a native data source follow from its size
+    void setNativeSource(std::shared_ptr<NativeSource> source, jlong handle)
+    {
+        {
+            std::lock_guard<std::mutex> lock(defaultMediaMutex);
+            media = defaultMedia;
+        }
+        media.video.durationMs = std::max<int64_t>(0, source->size()) * 8000 / media.bitrate;
+        nativeSource = std::move(source);
+        this->source = "native:" + std::to_string(handle);
+        state = Initialized;
+    }
+
+    int64_t buffered(int64_t now) const
+    {
+        if (media.downloadRate <= 0) {
+            return media.video.durationMs;
+        }
+        const double buffered = bufferedBase + double(now - downloadStart) * media.downloadRate;
+        return std::min(media.video.durationMs, int64_t(buffered));
+    }
+
+    const int id;
+    State state = Idle;
+    std::string source;
+    Media media;
+    std::shared_ptr<NativeSource> nativeSource;
+    std::shared_ptr<Surface> surface;
+    bool looping = false;
+    int scalingMode = 1;
+    float speed = 1;
+    int64_t basePosition = 0;
+    // uptime the position starts moving from, later than now while the
+    // first frame after a start or seek is on its way
+    int64_t baseTime = 0;
+    bool stalled = false;
+    int64_t lastFrame = -1;
+    bool renderStartPending = false;
+    bool errorReported = false;
+    double bufferedBase = 0;
+    int64_t downloadStart = 0;
+};
+
+SimulatedMediaPlayer::SimulatedMediaPlayer() :
+    mNextPrepared(false),
+    mSuspended(false),
+    mUseRTPlayer(false),
+    mLastBufferingPercent(-1),
+    mLastBufferingUpdateTime(0),
+    mStartPosition(-1),
+    mNextEngineId(1),
+    mLooper(new Looper("SimMediaPlayer"))
+{
+    mPlayer = createEngine();
+    liveInstances.fetch_add(1, std::memory_order_relaxed);
+}
+
+SimulatedMediaPlayer::~SimulatedMediaPlayer()
+{
+    // tasks in flight lock the mutex, none runs after the looper is gone
+    mLooper.reset();
+    releaseEngine(mNextPlayer);
+    releaseEngine(mPlayer);
+    liveInstances.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool SimulatedMediaPlayer::parseSource(const std::string &source, Media *media)
+{
+    {
+        std::lock_guard<std::mutex> lock(defaultMediaMutex);
+        *media = defaultMedia;
+    }
+    if (TestPattern::parse(source, &media->video)) {
+        // frames are drawn as soon as they are due
+        media->prepareMs = 0;
+        media->seekMs = 0;
+        media->renderMs = 0;
+        media->downloadRate = 0;
+        media->keyframeIntervalMs = 1000;
+        media->testPattern = true;
+        return true;
+    }
+    if (parseSim(source, media)) {
+        return true;
+    }
+    struct stat st;
+    if (::stat(source.c_str(), &st) != 0) {
+        return false;
+    }
+    media->video.durationMs = int64_t(st.st_size) * 8000 / media->bitrate;
+    return true;
+}
+
+void SimulatedMediaPlayer::setDefaultMedia(const std::string &source)
+{
+    Media media;
+    parseSim(source, &media);
+    std::lock_guard<std::mutex> lock(defaultMediaMutex);
+    defaultMedia = media;
+}
+
+int64_t SimulatedMediaPlayer::mediaDuration(const std::string &source)
+{
+    Media media;
+    return parseSource(source, &media) ? media.video.durationMs : -1;
+}
+
+std::vector<int64_t> SimulatedMediaPlayer::keyframes(const std::string &source)
+{
+    Media media;
+    std::vector<int64_t> times;
+    if (!parseSource(source, &media)) {
+        return times;
+    }
+    for (int64_t time = 0; time <= media.video.durationMs; time += media.keyframeIntervalMs) {
+        times.push_back(time);
+    }
+    return times;
+}
+
+int64_t SimulatedMediaPlayer::liveCount()
+{
+    return liveInstances.load(std::memory_order_relaxed);
+}
+
+void SimulatedMediaPlayer::setEventListener(std::shared_ptr<Listener> listener)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mListener = std::move(listener);
+}
+
+bool SimulatedMediaPlayer::setDataSource(const std::string &source)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!checkState(mPlayer->state == Engine::Idle, "setDataSource")) {
+        return false;
+    }
+    if (!parseSource(source, &mPlayer->media)) {
+        FakeJni::throwNew("java/io/FileNotFoundException", source);
+        return false;
+    }
+    mPlayer->source = source;
+    mPlayer->state = Engine::Initialized;
+    return true;
+}
+
+bool SimulatedMediaPlayer::setNativeDataSource(jlong handle)
+{
+    auto source = std::make_shared<NativeSource>(handle);
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!checkState(mPlayer->state == Engine::Idle, "setNativeDataSource")) {
+        // Java closes the data source it failed to hand over
+        return false;
+    }
+    mPlayer->setNativeSource(std::move(source), handle);
+    return true;
+}
+
+void SimulatedMediaPlayer::prepareNext(const std::string &source)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    releaseEngine(mNextPlayer);
+    mNextPrepared = false;
+    mNextPlayer = createEngine();
+    if (!parseSource(source, &mNextPlayer->media)) {
+        releaseEngine(mNextPlayer);
+        return;
+    }
+    mNextPlayer->source = source;
+    mNextPlayer->state = Engine::Initialized;
+    prepareEngine(*mNextPlayer);
+}
+
+void SimulatedMediaPlayer::prepareNextNative(jlong handle)
+{
+    auto source = std::make_shared<NativeSource>(handle);
+    std::lock_guard<std::mutex> lock(mMutex);
+    releaseEngine(mNextPlayer);
+    mNextPrepared = false;
+    mNextPlayer = createEngine();
+    mNextPlayer->setNativeSource(std::move(source), handle);
+    prepareEngine(*mNextPlayer);
+}
+
+void SimulatedMediaPlayer::prepare(int64_t startPosition)
+{
+    // before prepareAsync(), a fast prepare must not overtake it
+    notify({[](Listener &listener) { listener.onBuffering(true); }});
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStartPosition = startPosition;
+    if (checkState(mPlayer->state == Engine::Initialized || mPlayer->state == Engine::Stopped, "prepare")) {
+        prepareEngine(*mPlayer);
+    }
+}
+
+void SimulatedMediaPlayer::start()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSuspended = false;
+    startEngine(*mPlayer);
+}
+
+void SimulatedMediaPlayer::resume()
+{
+    start();
+}
+
+void SimulatedMediaPlayer::pause()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mSuspended = false;
+        pauseEngine(*mPlayer);
+    }
+    notify({[](Listener &listener) { listener.onPause(); }});
+}
+
+void SimulatedMediaPlayer::stop()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    Engine &engine = *mPlayer;
+    if (engine.media.testPattern) {
+        // TestPatternSource.stop() pauses
+        pauseEngine(engine);
+        return;
+    }
+    if (!checkState(engine.isPrepared() || engine.state == Engine::Stopped, "stop")) {
+        return;
+    }
+    engine.rebase(Looper::uptimeMs());
+    engine.state = Engine::Stopped;
+    for (int kind = 0; kind < TASK_KINDS; ++kind) {
+        mLooper->removeCallbacks(engine.token(TaskKind(kind)));
+    }
+}
+
+void SimulatedMediaPlayer::reset()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSuspended = false;
+    mLastBufferingPercent = -1;
+    mStartPosition = -1;
+    releaseEngine(mNextPlayer);
+    mNextPrepared = false;
+    if (mPlayer->state == Engine::End) {
+        checkState(false, "reset");
+        return;
+    }
+    releaseEngine(mPlayer);
+    mPlayer = createEngine();
+    applySurface();
+}
+
+void SimulatedMediaPlayer::release()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    releaseEngine(mNextPlayer);
+    mNextPrepared = false;
+    releaseEngine(mPlayer);
+    mPlayer.reset(new Engine(0));
+    mPlayer->state = Engine::End;
+}
+
+void SimulatedMediaPlayer::seekTo(int64_t position)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    seekEngine(*mPlayer, position);
+}
+
+void SimulatedMediaPlayer::seekToSync(int64_t position)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    Engine &engine = *mPlayer;
+    if (!engine.media.testPattern) {
+        // SEEK_CLOSEST_SYNC
+        const int64_t interval = engine.media.keyframeIntervalMs;
+        position = (std::max<int64_t>(0, position) + interval / 2) / interval * interval;
+    }
+    seekEngine(engine, position);
+}
+
+int64_t SimulatedMediaPlayer::getCurrentPosition() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPlayer->state == Engine::Error ? 0 : mPlayer->position(Looper::uptimeMs());
+}
+
+int64_t SimulatedMediaPlayer::getDuration() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPlayer->isPrepared() || mPlayer->media.testPattern ? mPlayer->media.video.durationMs : -1;
+}
+
+void SimulatedMediaPlayer::setLooping(bool looping)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (checkState(mPlayer->state != Engine::Error && mPlayer->state != Engine::End, "setLooping")) {
+        mPlayer->looping = looping;
+    }
+}
+
+void SimulatedMediaPlayer::setVideoScalingMode(int mode)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mPlayer->media.testPattern) {
+        mPlayer->scalingMode = mode;
+    }
+}
+
+bool SimulatedMediaPlayer::setPlaybackSpeed(float speed)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    Engine &engine = *mPlayer;
+    if (!engine.media.testPattern && FakeJni::sdkVersion() < PLAYBACK_PARAMS_MIN_SDK) {
+        return false;
+    }
+    if (speed <= 0 || speed == engine.speed) {
+        // TestPatternSource ignores it, MediaPlayer throws for a negative
+        // speed and pauses for 0, which the player never asks for
+        return engine.media.testPattern || speed == engine.speed;
+    }
+    const int64_t now = Looper::uptimeMs();
+    engine.rebase(now);
+    engine.speed = speed;
+    if (engine.state == Engine::Started && !engine.stalled) {
+        scheduleFrame(engine, now);
+    }
+    return true;
+}
+
+void SimulatedMediaPlayer::useRTPlayer(bool flag)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mUseRTPlayer = flag;
+}
+
+void SimulatedMediaPlayer::setSurface(std::shared_ptr<Surface> surface)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (surface == mSurface) {
+        return;
+    }
+    mSurface = std::move(surface);
+    applySurface();
+}
+
+void SimulatedMediaPlayer::detachSurface()
+{
+    bool suspended = false;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mSuspended = false;
+        if (mPlayer->state == Engine::Started) {
+            pauseEngine(*mPlayer);
+            mSuspended = true;
+        }
+        mPlayer->surface = nullptr;
+        mSurface = nullptr;
+        suspended = mSuspended;
+    }
+    if (suspended) {
+        notify({[](Listener &listener) { listener.onSuspended(true); }});
+    }
+}
+
+void SimulatedMediaPlayer::attachSurface(std::shared_ptr<Surface> surface)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mSurface = std::move(surface);
+        applySurface();
+        if (!mSuspended) {
+            return;
+        }
+        mSuspended = false;
+        // MediaPlayer moves the decoder to the new surface with a seek to the
+        // current position and reports the first frame rendered on it
+        mPlayer->renderStartPending = true;
+        startEngine(*mPlayer);
+    }
+    notify({[](Listener &listener) { listener.onSuspended(false); }});
+}
+
+void SimulatedMediaPlayer::injectError(int what, int extra)
+{
+    int id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        id = mPlayer->id;
+    }
+    mLooper->post([this, id, what, extra] {
+        Notifications notifications;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (Engine *engine = this->engine(id)) {
+                onEngineError(*engine, what, extra, notifications);
+            }
+        }
+        notify(notifications);
+    }, 0);
+}
+
+void SimulatedMediaPlayer::setDownloadRate(double mediaMsPerMs)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    Engine &engine = *mPlayer;
+    const int64_t now = Looper::uptimeMs();
+    engine.bufferedBase = double(engine.buffered(now));
+    engine.downloadStart = now;
+    const bool ticking = engine.media.downloadRate > 0;
+    engine.media.downloadRate = std::max(0.0, mediaMsPerMs);
+    if (!ticking && engine.media.downloadRate > 0 && engine.isPrepared()) {
+        mLooper->postDelayed(DOWNLOAD_TICK_MS, [this, id = engine.id] { onTick(id); },
+                             engine.token(TICK_TASK));
+    }
+}
+
+bool SimulatedMediaPlayer::isPlaying() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPlayer->state == Engine::Started;
+}
+
+bool SimulatedMediaPlayer::isSuspended() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mSuspended;
+}
+
+bool SimulatedMediaPlayer::isLooping() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPlayer->looping;
+}
+
+int SimulatedMediaPlayer::videoScalingMode() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPlayer->scalingMode;
+}
+
+float SimulatedMediaPlayer::playbackSpeed() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPlayer->speed;
+}
+
+std::string SimulatedMediaPlayer::dataSource() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPlayer->source;
+}
+
+SimulatedMediaPlayer::Stats SimulatedMediaPlayer::stats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+std::unique_ptr<SimulatedMediaPlayer::Engine> SimulatedMediaPlayer::createEngine()
+{
+    return std::unique_ptr<Engine>(new Engine(mNextEngineId++));
+}
+
+SimulatedMediaPlayer::Engine *SimulatedMediaPlayer::engine(int id) const
+{
+    if (mPlayer && mPlayer->id == id) {
+        return mPlayer.get();
+    }
+    if (mNextPlayer && mNextPlayer->id == id) {
+        return mNextPlayer.get();
+    }
+    return nullptr;
+}
+
+bool SimulatedMediaPlayer::checkState(bool valid, const char *method)
+{
+    if (!valid) {
+        ++mStats.illegalStateCalls;
+        FakeJni::throwNew("java/lang/IllegalStateException", method);
+    }
+    return valid;
+}
+
+void SimulatedMediaPlayer::notify(const Notifications &notifications)
+{
+    if (notifications.empty()) {
+        return;
+    }
+    std::shared_ptr<Listener> listener;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        listener = mListener;
+    }
+    if (!listener) {
+        return;
+    }
+    for (const Notification &notification : notifications) {
+        notification(*listener);
+    }
+}
+
+void SimulatedMediaPlayer::prepareEngine(Engine &engine)
+{
+    ++mStats.prepares;
+    engine.state = Engine::Preparing;
+    mLooper->postDelayed(engine.media.prepareMs, [this, id = engine.id] { onPrepared(id); },
+                         engine.token(OTHER_TASK));
+}
+
+void SimulatedMediaPlayer::startEngine(Engine &engine)
+{
+    if (!checkState(engine.isPrepared(), "start") || engine.state == Engine::Started) {
+        return;
+    }
+    const int64_t now = Looper::uptimeMs();
+    if (engine.state == Engine::PlaybackCompleted) {
+        engine.basePosition = 0;
+        engine.lastFrame = -1;
+    }
+    // MediaPlayer reports MEDIA_INFO_VIDEO_RENDERING_START for the first
+    // frame after preparing and after every seek
+    engine.renderStartPending = engine.renderStartPending || engine.state == Engine::Prepared
+            || engine.state == Engine::PlaybackCompleted;
+    engine.state = Engine::Started;
+    engine.baseTime = now + (engine.renderStartPending ? engine.media.renderMs : 0);
+    scheduleFrame(engine, now);
+}
+
+void SimulatedMediaPlayer::pauseEngine(Engine &engine)
+{
+    if (engine.media.testPattern && !engine.isPrepared()) {
+        // TestPatternSource.pause() is fine in any state
+        return;
+    }
+    if (!checkState(engine.isPrepared(), "pause") || engine.state != Engine::Started) {
+        return;
+    }
+    engine.rebase(Looper::uptimeMs());
+    engine.state = Engine::Paused;
+    mLooper->removeCallbacks(engine.token(FRAME_TASK));
+}
+
+void SimulatedMediaPlayer::seekEngine(Engine &engine, int64_t position)
+{
+    if (!checkState(engine.isPrepared(), "seekTo")) {
+        return;
+    }
+    ++mStats.seeks;
+    const int64_t now = Looper::uptimeMs();
+    engine.basePosition = std::max<int64_t>(0, std::min(position, engine.media.video.durationMs));
+    engine.baseTime = now + engine.media.seekMs + engine.media.renderMs;
+    engine.lastFrame = -1;
+    engine.stalled = false;
+    if (engine.state == Engine::PlaybackCompleted) {
+        engine.state = Engine::Paused;
+    }
+    engine.renderStartPending = engine.state == Engine::Started;
+    mLooper->removeCallbacks(engine.token(FRAME_TASK));
+    mLooper->postDelayed(engine.media.seekMs, [this, id = engine.id] { onSeekComplete(id); },
+                         engine.token(OTHER_TASK));
+}
+
+void SimulatedMediaPlayer::releaseEngine(std::unique_ptr<Engine> &engine)
+{
+    if (!engine) {
+        return;
+    }
+    if (mLooper) {
+        for (int kind = 0; kind < TASK_KINDS; ++kind) {
+            mLooper->removeCallbacks(engine->token(TaskKind(kind)));
+        }
+    }
+    if (engine->nativeSource) {
+        engine->nativeSource->close();
+    }
+    engine.reset();
+}
+
+void SimulatedMediaPlayer::applySurface()
+{
+    Engine &engine = *mPlayer;
+    engine.surface = mSurface && mSurface->isValid() ? mSurface : nullptr;
+    if (engine.media.testPattern && engine.surface && engine.state != Engine::Started
+            && engine.isPrepared()) {
+        // TestPatternSource draws the current frame into a new surface
+        const int64_t position = engine.position(Looper::uptimeMs());
+        engine.surface->post(Frame{engine.frameAt(position), position, Looper::uptimeMs(),
+                                   &engine.media.video});
+    }
+}
+
+bool SimulatedMediaPlayer::startNext()
+{
+    if (!mNextPlayer || !mNextPrepared) {
+        return false;
+    }
+    // AndroidMediaPlayer.startNext() carries the settings over to the new
+    // MediaPlayer
+    Engine &next = *mNextPlayer;
+    next.looping = mPlayer->looping;
+    next.scalingMode = mPlayer->scalingMode;
+    if (FakeJni::sdkVersion() >= PLAYBACK_PARAMS_MIN_SDK) {
+        next.speed = mPlayer->speed;
+    }
+    releaseEngine(mPlayer);
+    mPlayer = std::move(mNextPlayer);
+    mNextPrepared = false;
+    applySurface();
+    startEngine(*mPlayer);
+    return true;
+}
+
+void SimulatedMediaPlayer::onPrepared(int id)
+{
+    std::shared_ptr<NativeSource> source;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Engine *engine = this->engine(id);
+        if (!engine || engine->state != Engine::Preparing) {
+            return;
+        }
+        source = engine->nativeSource;
+    }
+
+    // the container header, outside the lock like MediaPlayer's reader
+    const int64_t header = source ? source->read(0, READ_CHUNK) : 0;
+
+    Notifications notifications;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Engine *engine = this->engine(id);
+        if (!engine || engine->state != Engine::Preparing) {
+            return;
+        }
+        if (header < 0 || engine->media.prepareError) {
+            mStats.readErrors += header < 0 ? 1 : 0;
+            onEngineError(*engine, engine->media.errorWhat, engine->media.errorExtra, notifications);
+        } else {
+            mStats.bytesRead += header;
+            const int64_t now = Looper::uptimeMs();
+            engine->state = Engine::Prepared;
+            engine->downloadStart = now;
+            engine->bufferedBase = 0;
+            if (engine->media.downloadRate > 0) {
+                mLooper->postDelayed(DOWNLOAD_TICK_MS, [this, id] { onTick(id); }, engine->token(TICK_TASK));
+            }
+            const TestPattern::Spec &video = engine->media.video;
+            if (engine == mNextPlayer.get()) {
+                mNextPrepared = true;
+            } else if (engine->media.testPattern) {
+                engine->basePosition = std::max<int64_t>(0, mStartPosition);
+                mStartPosition = -1;
+                notifications.push_back([video](Listener &listener) {
+                    listener.onVideoSizeChanged(video.width, video.height);
+                    listener.onBuffering(false);
+                    listener.onPrepared();
+                });
+            } else {
+                notifications.push_back([video](Listener &listener) {
+                    listener.onVideoSizeChanged(video.width, video.height);
+                });
+                if (mStartPosition > 0) {
+                    seekEngine(*engine, mStartPosition);
+                }
+                mStartPosition = -1;
+                notifications.push_back([](Listener &listener) { listener.onPrepared(); });
+            }
+        }
+    }
+    notify(notifications);
+}
+
+void SimulatedMediaPlayer::onSeekComplete(int id)
+{
+    bool current = false;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Engine *engine = this->engine(id);
+        if (!engine || !engine->isPrepared()) {
+            return;
+        }
+        const int64_t now = Looper::uptimeMs();
+        if (engine->state == Engine::Started) {
+            scheduleFrame(*engine, now);
+        } else if (engine->surface) {
+            // a paused player shows the frame it seeked to
+            engine->lastFrame = engine->frameAt(engine->basePosition);
+            engine->surface->post(Frame{engine->lastFrame, engine->basePosition, now, &engine->media.video});
+            ++mStats.framesRendered;
+        }
+        current = engine == mPlayer.get();
+    }
+    if (current) {
+        notify({[](Listener &listener) { listener.onSeekComplete(); }});
+    }
+}
+
+void SimulatedMediaPlayer::onFrame(int id)
+{
+    std::shared_ptr<NativeSource> source;
+    int64_t readPosition = 0;
+    int64_t readSize = 0;
+    Notifications notifications;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Engine *engine = this->engine(id);
+        if (!engine || engine->state != Engine::Started || engine->stalled) {
+            return;
+        }
+        const int64_t now = Looper::uptimeMs();
+        int64_t position = engine->position(now);
+        const Media &media = engine->media;
+        if (media.errorAtMs >= 0 && !engine->errorReported && position >= media.errorAtMs) {
+            engine->errorReported = true;
+            onEngineError(*engine, media.errorWhat, media.errorExtra, notifications);
+        } else if (position >= media.video.durationMs && !engine->looping) {
+            engine->basePosition = media.video.durationMs;
+            engine->state = Engine::PlaybackCompleted;
+            onCompletion(*engine, notifications);
+        } else {
+            if (position >= media.video.durationMs) {
+                engine->basePosition = 0;
+                engine->baseTime = now;
+                engine->lastFrame = -1;
+                position = 0;
+                // TestPatternSource reports the first frame of every loop
+                engine->renderStartPending = engine->renderStartPending || media.testPattern;
+            }
+            const int64_t frame = engine->frameAt(position);
+            if (frame != engine->lastFrame) {
+                engine->lastFrame = frame;
+                if (engine->surface) {
+                    engine->surface->post(Frame{frame, position, now, &media.video});
+                }
+                ++mStats.framesRendered;
+                if (engine->renderStartPending) {
+                    engine->renderStartPending = false;
+                    if (engine == mPlayer.get()) {
+                        notifications.push_back([](Listener &listener) { listener.onStarted(); });
+                    }
+                }
+                if (engine->nativeSource) {
+                    source = engine->nativeSource;
+                    readSize = std::max<int64_t>(1, media.bitrate / 8 / media.video.fps);
+                    readPosition = position * (media.bitrate / 8) / 1000;
+                }
+            }
+            scheduleFrame(*engine, now);
+        }
+    }
+    notify(notifications);
+
+    if (!source) {
+        return;
+    }
+    const int64_t read = source->read(readPosition, readSize);
+    Notifications errors;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (read >= 0) {
+            mStats.bytesRead += read;
+            return;
+        }
+        ++mStats.readErrors;
+        Engine *engine = this->engine(id);
+        if (!engine || engine->state != Engine::Started) {
+            return;
+        }
+        onEngineError(*engine, MEDIA_ERROR_UNKNOWN, MEDIA_ERROR_IO, errors);
+    }
+    notify(errors);
+}
+
+void SimulatedMediaPlayer::onTick(int id)
+{
+    Notifications notifications;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Engine *engine = this->engine(id);
+        if (!engine || !engine->isPrepared() || engine->media.downloadRate <= 0) {
+            return;
+        }
+        const int64_t now = Looper::uptimeMs();
+        const int64_t duration = engine->media.video.durationMs;
+        const int64_t buffered = engine->buffered(now);
+        const bool current = engine == mPlayer.get();
+        if (current && duration > 0) {
+            onBufferingUpdate(*engine, int(buffered * 100 / duration), notifications);
+        }
+        if (engine->state == Engine::Started) {
+            const int64_t position = engine->position(now);
+            if (!engine->stalled && buffered < duration && position >= buffered) {
+                // MEDIA_INFO_BUFFERING_START
+                engine->rebase(now);
+                engine->stalled = true;
+                mLooper->removeCallbacks(engine->token(FRAME_TASK));
+                if (current) {
+                    notifications.push_back([](Listener &listener) { listener.onBuffering(true); });
+                }
+            } else if (engine->stalled && buffered >= std::min(duration, position + REBUFFER_MS)) {
+                engine->stalled = false;
+                engine->baseTime = now;
+                scheduleFrame(*engine, now);
+                if (current) {
+                    notifications.push_back([](Listener &listener) { listener.onBuffering(false); });
+                }
+            }
+        }
+        if (buffered < duration || engine->stalled) {
+            mLooper->postDelayed(DOWNLOAD_TICK_MS, [this, id] { onTick(id); }, engine->token(TICK_TASK));
+        }
+    }
+    notify(notifications);
+}
+
+void SimulatedMediaPlayer::onEngineError(Engine &engine, int what, int extra, Notifications &notifications)
+{
+    ++mStats.errors;
+    engine.rebase(Looper::uptimeMs());
+    engine.state = Engine::Error;
+    for (int kind = 0; kind < TASK_KINDS; ++kind) {
+        mLooper->removeCallbacks(engine.token(TaskKind(kind)));
+    }
+    if (&engine == mNextPlayer.get()) {
+        // the next part falls back to a regular prepare at the boundary
+        releaseEngine(mNextPlayer);
+        mNextPrepared = false;
+        return;
+    }
+    notifications.push_back([what, extra](Listener &listener) { listener.onError(what, extra); });
+    if (what == MEDIA_ERROR_UNKNOWN && extra == ERROR_SURFACE_LOST) {
+        // AndroidMediaPlayer.onError() stops and resets, stop() is illegal
+        // in the error state
+        checkState(false, "stop");
+        mSuspended = false;
+        mLastBufferingPercent = -1;
+        mStartPosition = -1;
+        releaseEngine(mNextPlayer);
+        mNextPrepared = false;
+        releaseEngine(mPlayer);
+        mPlayer = createEngine();
+        applySurface();
+    }
+    // the error is not handled, MediaPlayer continues with onCompletion()
+    if (!startNext()) {
+        notifications.push_back([](Listener &listener) { listener.onFinished(); });
+    } else {
+        notifications.push_back([](Listener &listener) { listener.onNextPartStarted(); });
+    }
+}
+
+void SimulatedMediaPlayer::onCompletion(Engine &engine, Notifications &notifications)
+{
+    if (&engine != mPlayer.get()) {
+        return;
+    }
+    if (startNext()) {
+        notifications.push_back([](Listener &listener) { listener.onNextPartStarted(); });
+        return;
+    }
+    notifications.push_back([](Listener &listener) { listener.onFinished(); });
+}
+
+void SimulatedMediaPlayer::onBufferingUpdate(Engine &, int percent, Notifications &notifications)
+{
+    if (percent == mLastBufferingPercent) {
+        return;
+    }
+    const int64_t now = Looper::uptimeMs();
+    if (percent < 100 && mLastBufferingPercent >= 0
+            && now - mLastBufferingUpdateTime < BUFFERING_UPDATE_INTERVAL_MS) {
+        return;
+    }
+    mLastBufferingPercent = percent;
+    mLastBufferingUpdateTime = now;
+    notifications.push_back([percent](Listener &listener) { listener.onBufferingUpdate(percent); });
+}
+
+void SimulatedMediaPlayer::scheduleFrame(Engine &engine, int64_t now)
+{
+    int64_t delay = 0;
+    if (now < engine.baseTime) {
+        delay = engine.baseTime - now;
+    } else {
+        const int64_t frame = engine.frameAt(engine.position(now));
+        if (frame == engine.lastFrame) {
+            // scheduled against the base time so the rate does not drift
+            const int fps = engine.media.video.fps;
+            const int64_t next = ((frame + 1) * 1000 + fps - 1) / fps;
+            const int64_t due = engine.baseTime
+                    + int64_t(std::ceil(double(next - engine.basePosition) / engine.rate()));
+            delay = std::max<int64_t>(1, due - now);
+        }
+    }
+    mLooper->removeCallbacks(engine.token(FRAME_TASK));
+    mLooper->postDelayed(delay, [this, id = engine.id] { onFrame(id); }, engine.token(FRAME_TASK));
+}
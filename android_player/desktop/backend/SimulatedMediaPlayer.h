@@ -0,0 +1,217 @@
+#ifndef SIMULATEDMEDIAPLAYER_H
+#define SIMULATEDMEDIAPLAYER_H
+
+#include "Looper.h"
+#include "TestPattern.h"
+
+#include <jni.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Desktop stand-in for com.vadim.android.AndroidMediaPlayer together with the
+// android.media.MediaPlayer instances it drives. The wrapper logic is a port
+// of the Java class (next part, surface detach, error handling, buffering
+// update throttling), the MediaPlayers are replaced by a timing model that
+// follows the MediaPlayer state machine and draws TestPattern frames.
+//
+// Sources:
+//
+//  - "testpattern:WxH@FPS[/DURATION_MS]" behaves like TestPatternSource;
+//  - "sim:DURATION_MS[?key=value&...]" a media with configurable timing:
+//    prepare, seek and render latency in ms, fps, width, height, keyframes
+//    (sync frame interval in ms), download (media ms buffered per wall ms, 0
+//    for a local file), clock (media ms played per wall ms at normal speed,
+//    a decoder clock running fast or slow), error (position in ms at which
+//    playback fails with what and extra, "prepare" to fail preparing);
+//  - anything else is a file. Its media is the default media (see
+//    setDefaultMedia()) with the duration the size gives at its bitrate.
+//
+// Native data sources are read through the JNI entry points of
+// NativeMediaDataSource like MediaPlayer reads them: the header when
+// preparing and the bytes of every frame during playback, so the IoScheduler
+// and decryption see the load of a playing video.
+//
+// Callbacks arrive on the player's looper thread like MediaPlayer's do on
+// the main looper, except the ones the Java wrapper emits from the calling
+// thread (pause, surface detach and attach). Calls in a state MediaPlayer
+// rejects are ignored, counted and leave an IllegalStateException pending.
+class SimulatedMediaPlayer
+{
+public:
+    // com.vadim.android.MediaPlayerEventListener
+    class Listener
+    {
+    public:
+        virtual ~Listener() = default;
+        virtual void onVideoSizeChanged(int width, int height) = 0;
+        virtual void onStarted() = 0;
+        virtual void onFinished() = 0;
+        virtual void onError(int what, int extra) = 0;
+        virtual void onBuffering(bool state) = 0;
+        virtual void onBufferingUpdate(int percent) = 0;
+        virtual void onPause() = 0;
+        virtual void onPrepared() = 0;
+        virtual void onSeekComplete() = 0;
+        virtual void onNextPartStarted() = 0;
+        virtual void onSuspended(bool suspended) = 0;
+    };
+
+    struct Frame
+    {
+        int64_t index;
+        int64_t positionMs;
+        // uptime the frame was drawn at, the one in its marker
+        int64_t uptimeMs;
+        const TestPattern::Spec *spec;
+    };
+
+    // android.view.Surface. Frames are handed over on the looper thread, a
+    // consumer wanting pixels paints them with TestPattern::paint().
+    class Surface
+    {
+    public:
+        virtual ~Surface() = default;
+        virtual bool isValid() const { return true; }
+        virtual void post(const Frame &frame) = 0;
+    };
+
+    struct Media
+    {
+        TestPattern::Spec video;
+        int64_t prepareMs = 0;
+        int64_t seekMs = 0;
+        // from start or seek to the first frame on the surface
+        int64_t renderMs = 0;
+        int64_t keyframeIntervalMs = 1000;
+        double downloadRate = 0;
+        double clockRate = 1;
+        int64_t bitrate = 4000000;
+        // -1 for none
+        int64_t errorAtMs = -1;
+        bool prepareError = false;
+        int errorWhat = 1;
+        int errorExtra = -1004;
+        bool testPattern = false;
+    };
+
+    struct Stats
+    {
+        int64_t framesRendered = 0;
+        int64_t prepares = 0;
+        int64_t seeks = 0;
+        int64_t bytesRead = 0;
+        int64_t readErrors = 0;
+        int64_t illegalStateCalls = 0;
+        int64_t errors = 0;
+    };
+
+    static const int MEDIA_ERROR_UNKNOWN = 1;
+    static const int MEDIA_ERROR_IO = -1004;
+
+    SimulatedMediaPlayer();
+    ~SimulatedMediaPlayer();
+
+    // Parses a source as described above. Returns false for a file that
+    // can't be opened.
+    static bool parseSource(const std::string &source, Media *media);
+    // Media of files and native data sources, a "sim:" source.
+    static void setDefaultMedia(const std::string &source);
+    // AndroidMediaPlayer.getMediaDuration(), -1 if unknown
+    static int64_t mediaDuration(const std::string &source);
+    // KeyframeIndex.build(), empty if unknown
+    static std::vector<int64_t> keyframes(const std::string &source);
+    // Players alive in the process.
+    static int64_t liveCount();
+
+    void setEventListener(std::shared_ptr<Listener> listener);
+    // Return false where the Java method throws.
+    bool setDataSource(const std::string &source);
+    bool setNativeDataSource(jlong handle);
+    void prepareNext(const std::string &source);
+    void prepareNextNative(jlong handle);
+    void prepare(int64_t startPosition);
+    void start();
+    void resume();
+    void pause();
+    void stop();
+    void reset();
+    void release();
+    void seekTo(int64_t position);
+    void seekToSync(int64_t position);
+    int64_t getCurrentPosition() const;
+    int64_t getDuration() const;
+    void setLooping(bool looping);
+    void setVideoScalingMode(int mode);
+    bool setPlaybackSpeed(float speed);
+    void useRTPlayer(bool flag);
+    void setSurface(std::shared_ptr<Surface> surface);
+    void detachSurface();
+    void attachSurface(std::shared_ptr<Surface> surface);
+
+    // Fails the current MediaPlayer with what and extra the way its decoder
+    // would, through OnErrorListener and then OnCompletionListener.
+    void injectError(int what, int extra);
+    // Changes the download rate of the current media from now on.
+    void setDownloadRate(double mediaMsPerMs);
+
+    // Test hooks, not part of the Java interface.
+    bool isPlaying() const;
+    bool isSuspended() const;
+    bool isLooping() const;
+    int videoScalingMode() const;
+    float playbackSpeed() const;
+    std::string dataSource() const;
+    Stats stats() const;
+
+private:
+    SimulatedMediaPlayer(const SimulatedMediaPlayer &) = delete;
+    SimulatedMediaPlayer &operator=(const SimulatedMediaPlayer &) = delete;
+
+    struct Engine;
+    using Notification = std::function<void(Listener &)>;
+    using Notifications = std::vector<Notification>;
+
+    std::unique_ptr<Engine> createEngine();
+    Engine *engine(int id) const;
+    bool checkState(bool valid, const char *method);
+    void notify(const Notifications &notifications);
+
+    void prepareEngine(Engine &engine);
+    void startEngine(Engine &engine);
+    void pauseEngine(Engine &engine);
+    void seekEngine(Engine &engine, int64_t position);
+    void releaseEngine(std::unique_ptr<Engine> &engine);
+    void applySurface();
+    bool startNext();
+    void onPrepared(int id);
+    void onSeekComplete(int id);
+    void onFrame(int id);
+    void onTick(int id);
+    void onEngineError(Engine &engine, int what, int extra, Notifications &notifications);
+    void onCompletion(Engine &engine, Notifications &notifications);
+    void onBufferingUpdate(Engine &engine, int percent, Notifications &notifications);
+    void scheduleFrame(Engine &engine, int64_t now);
+
+    mutable std::mutex mMutex;
+    std::shared_ptr<Listener> mListener;
+    std::unique_ptr<Engine> mPlayer;
+    std::unique_ptr<Engine> mNextPlayer;
+    bool mNextPrepared;
+    std::shared_ptr<Surface> mSurface;
+    bool mSuspended;
+    bool mUseRTPlayer;
+    int mLastBufferingPercent;
+    int64_t mLastBufferingUpdateTime;
+    int64_t mStartPosition;
+    int mNextEngineId;
+    Stats mStats;
+    // last member, its thread runs tasks touching the ones above
+    std::unique_ptr<Looper> mLooper;
+};
+
+#endif // SIMULATEDMEDIAPLAYER_H
@@ -0,0 +1,93 @@
+#include "TestPattern.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+const uint32_t DARK_GRAY = 0xff444444;
+const uint32_t LIGHT_GRAY = 0xffcccccc;
+
+bool isWhite(uint32_t pixel)
+{
+    // luma of the green channel, enough for black and white blocks
+    return ((pixel >> 8) & 0xff) > 0x80;
+}
+
+void fill(uint32_t *pixels, int stride, int x0, int y0, int x1, int y1, uint32_t color)
+{
+    for (int y = y0; y < y1; ++y) {
+        std::fill(pixels + y * stride + x0, pixels + y * stride + x1, color);
+    }
+}
+
+}
+
+namespace TestPattern {
+
+bool parse(const std::string &source, Spec *spec)
+{
+    static const std::string SCHEME = "testpattern:";
+    if (source.compare(0, SCHEME.size(), SCHEME) != 0) {
+        return false;
+    }
+    int width = 0;
+    int height = 0;
+    int fps = 0;
+    long long duration = -1;
+    char tail = 0;
+    const char *text = source.c_str() + SCHEME.size();
+    const int fields = sscanf(text, "%dx%d@%d/%lld%c", &width, &height, &fps, &duration, &tail);
+    if ((fields == 3 || fields == 4) && width > 0 && height > 0) {
+        spec->width = width;
+        spec->height = height;
+        spec->fps = std::max(1, fps);
+        if (fields == 4) {
+            spec->durationMs = duration;
+        }
+    }
+    return true;
+}
+
+void paint(uint32_t *pixels, int width, int height, int stride, const Spec &spec,
+           int64_t frame, int64_t uptimeMs)
+{
+    fill(pixels, stride, 0, 0, width, height, DARK_GRAY);
+
+    const int barWidth = std::max(1, width / 16);
+    const int barX = int((frame % spec.fps) * (width - barWidth) / std::max(1, spec.fps - 1));
+    fill(pixels, stride, barX, 0, std::min(width, barX + barWidth), height, LIGHT_GRAY);
+
+    const uint64_t value = marker(frame, uptimeMs);
+    const int block = width / MARKER_BITS;
+    if (block == 0 || 2 * block > height) {
+        return;
+    }
+    for (int bit = 0; bit < MARKER_BITS; ++bit) {
+        const bool set = (value >> (MARKER_BITS - 1 - bit)) & 1;
+        const int x0 = bit * width / MARKER_BITS;
+        const int x1 = (bit + 1) * width / MARKER_BITS;
+        fill(pixels, stride, x0, 0, x1, block, set ? WHITE : BLACK);
+        fill(pixels, stride, x0, block, x1, 2 * block, set ? BLACK : WHITE);
+    }
+}
+
+bool decode(const uint32_t *row0, const uint32_t *row1, int width, uint64_t *marker)
+{
+    if (width < MARKER_BITS) {
+        return false;
+    }
+    uint64_t value = 0;
+    for (int bit = 0; bit < MARKER_BITS; ++bit) {
+        const int x = (2 * bit + 1) * width / (2 * MARKER_BITS);
+        const bool set = isWhite(row0[x]);
+        if (set == isWhite(row1[x])) {
+            return false;
+        }
+        value = (value << 1) | (set ? 1 : 0);
+    }
+    *marker = value;
+    return true;
+}
+
+}
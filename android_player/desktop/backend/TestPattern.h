@@ -0,0 +1,53 @@
+#ifndef TESTPATTERN_H
+#define TESTPATTERN_H
+
+#include <cstdint>
+#include <string>
+
+// The frames of TestPatternSource.java, see there for the layout: a dark
+// background, a bar sweeping across once a second and at the top two rows of
+// MARKER_BITS blocks holding the frame index and the uptime the frame was
+// drawn at, the second row the complement of the first.
+namespace TestPattern {
+
+const int MARKER_BITS = 64;
+const uint32_t WHITE = 0xffffffff;
+const uint32_t BLACK = 0xff000000;
+
+struct Spec
+{
+    int width = 640;
+    int height = 360;
+    int fps = 30;
+    int64_t durationMs = 60000;
+};
+
+// Parses "testpattern:WIDTHxHEIGHT@FPS[/DURATION_MS]". Returns false for
+// other sources; an invalid spec leaves the defaults like the Java side.
+bool parse(const std::string &source, Spec *spec);
+
+inline uint64_t marker(int64_t frame, int64_t uptimeMs)
+{
+    return (uint64_t(uint32_t(frame)) << 32) | uint32_t(uptimeMs);
+}
+
+// Draws frame into RGBA pixels (one uint32_t a pixel, alpha in the high
+// byte), scaled to width x height like the Java canvas is.
+void paint(uint32_t *pixels, int width, int height, int stride, const Spec &spec,
+           int64_t frame, int64_t uptimeMs);
+
+// Decodes the marker from one pixel row through each marker row, sampling
+// the middle of every block like QSurfaceTexture::readMarker(). Returns
+// false if the rows are not complementary.
+bool decode(const uint32_t *row0, const uint32_t *row1, int width, uint64_t *marker);
+
+// The pixel row through the middle of marker row 0 or 1 of a frame width
+// pixels wide.
+inline int markerRow(int width, int row)
+{
+    return (2 * row + 1) * width / (2 * MARKER_BITS);
+}
+
+}
+
+#endif // TESTPATTERN_H
@@ -0,0 +1,329 @@
+// Compares a benchmark report with its baseline:
+//
+//   bench_compare REPORT... BASELINE [--update]
+//
+// With several reports of the same suite each metric takes its best value
+// across them, load on the machine comes and goes over seconds, longer than
+// the rounds of one run.
+//
+// A metric regresses when it is worse than the baseline by more than its
+// "tolerance" (relative, default 0.3, one CPU core of a shared machine is
+// noisy). Metrics missing from the baseline and a missing baseline are
+// reported, not failed, so a new bench can land before its baseline. With
+// --update the report replaces the baseline, keeping the tolerances set in
+// it. Exits non-zero on a regression.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const double DEFAULT_TOLERANCE = 0.3;
+
+struct Metric
+{
+    std::string name;
+    double value = 0;
+    std::string unit;
+    bool lowerIsBetter = true;
+    double tolerance = -1;
+};
+
+struct Report
+{
+    std::string suite;
+    std::vector<Metric> metrics;
+};
+
+// Just enough JSON for the reports BenchReport writes.
+class Parser
+{
+public:
+    explicit Parser(const std::string &text) : mText(text), mPos(0) {}
+
+    bool parse(Report *report)
+    {
+        if (!consume('{')) {
+            return false;
+        }
+        do {
+            std::string key;
+            if (!string(&key) || !consume(':')) {
+                return false;
+            }
+            if (key == "suite") {
+                if (!string(&report->suite)) {
+                    return false;
+                }
+            } else if (key == "results") {
+                if (!results(&report->metrics)) {
+                    return false;
+                }
+            } else if (!skipValue()) {
+                return false;
+            }
+        } while (consume(','));
+        return consume('}');
+    }
+
+private:
+    bool results(std::vector<Metric> *metrics)
+    {
+        if (!consume('[')) {
+            return false;
+        }
+        if (consume(']')) {
+            return true;
+        }
+        do {
+            Metric metric;
+            if (!consume('{')) {
+                return false;
+            }
+            do {
+                std::string key;
+                std::string better;
+                if (!string(&key) || !consume(':')) {
+                    return false;
+                }
+                bool ok = true;
+                if (key == "name") {
+                    ok = string(&metric.name);
+                } else if (key == "unit") {
+                    ok = string(&metric.unit);
+                } else if (key == "better") {
+                    ok = string(&better);
+                    metric.lowerIsBetter = better != "higher";
+                } else if (key == "value") {
+                    ok = number(&metric.value);
+                } else if (key == "tolerance") {
+                    ok = number(&metric.tolerance);
+                } else {
+                    ok = skipValue();
+                }
+                if (!ok) {
+                    return false;
+                }
+            } while (consume(','));
+            if (!consume('}')) {
+                return false;
+            }
+            metrics->push_back(metric);
+        } while (consume(','));
+        return consume(']');
+    }
+
+    void skipSpace()
+    {
+        while (mPos < mText.size() && isspace(static_cast<unsigned char>(mText[mPos]))) {
+            ++mPos;
+        }
+    }
+
+    bool consume(char c)
+    {
+        skipSpace();
+        if (mPos < mText.size() && mText[mPos] == c) {
+            ++mPos;
+            return true;
+        }
+        return false;
+    }
+
+    bool string(std::string *value)
+    {
+        if (!consume('"')) {
+            return false;
+        }
+        value->clear();
+        while (mPos < mText.size() && mText[mPos] != '"') {
+            if (mText[mPos] == '\\' && mPos + 1 < mText.size()) {
+                ++mPos;
+            }
+            *value += mText[mPos++];
+        }
+        return consume('"');
+    }
+
+    bool number(double *value)
+    {
+        skipSpace();
+        const char *start = mText.c_str() + mPos;
+        char *end = nullptr;
+        *value = strtod(start, &end);
+        if (end == start) {
+            return false;
+        }
+        mPos += size_t(end - start);
+        return true;
+    }
+
+    bool skipValue()
+    {
+        skipSpace();
+        if (mPos >= mText.size()) {
+            return false;
+        }
+        std::string ignored;
+        double number = 0;
+        switch (mText[mPos]) {
+        case '"':
+            return string(&ignored);
+        case 't':
+        case 'f':
+        case 'n':
+            while (mPos < mText.size() && isalpha(static_cast<unsigned char>(mText[mPos]))) {
+                ++mPos;
+            }
+            return true;
+        default:
+            return this->number(&number);
+        }
+    }
+
+    const std::string &mText;
+    size_t mPos;
+};
+
+bool load(const char *path, Report *report, std::string *text)
+{
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    *text = buffer.str();
+    return Parser(*text).parse(report);
+}
+
+bool write(const char *path, const Report &report)
+{
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+    fprintf(file, "{\n  \"suite\": \"%s\",\n  \"results\": [", report.suite.c_str());
+    for (size_t i = 0; i < report.metrics.size(); ++i) {
+        const Metric &metric = report.metrics[i];
+        fprintf(file, "%s\n    {\"name\": \"%s\", \"value\": %.6g, \"unit\": \"%s\", \"better\": \"%s\"",
+                i ? "," : "", metric.name.c_str(), metric.value, metric.unit.c_str(),
+                metric.lowerIsBetter ? "lower" : "higher");
+        if (metric.tolerance >= 0) {
+            fprintf(file, ", \"tolerance\": %g", metric.tolerance);
+        }
+        fprintf(file, "}");
+    }
+    fprintf(file, "\n  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+// Keeps the better value of each metric of other in report.
+void merge(Report *report, const Report &other)
+{
+    std::map<std::string, Metric *> metrics;
+    for (Metric &metric : report->metrics) {
+        metrics[metric.name] = &metric;
+    }
+    for (const Metric &metric : other.metrics) {
+        const auto it = metrics.find(metric.name);
+        if (it == metrics.end()) {
+            report->metrics.push_back(metric);
+            continue;
+        }
+        Metric &best = *it->second;
+        if (metric.lowerIsBetter ? metric.value < best.value : metric.value > best.value) {
+            best.value = metric.value;
+        }
+    }
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    const bool update = argc > 1 && !strcmp(argv[argc - 1], "--update");
+    const int paths = update ? argc - 2 : argc - 1;
+    if (paths < 2) {
+        fprintf(stderr, "usage: %s REPORT... BASELINE [--update]\n", argv[0]);
+        return 2;
+    }
+    const char *baselinePath = argv[paths];
+
+    Report report;
+    for (int i = 1; i < paths; ++i) {
+        Report run;
+        std::string runText;
+        if (!load(argv[i], &run, &runText)) {
+            fprintf(stderr, "%s: can't read the report\n", argv[i]);
+            return 2;
+        }
+        if (i == 1) {
+            report = run;
+        } else {
+            merge(&report, run);
+        }
+    }
+    Report baseline;
+    std::string baselineText;
+    const bool hasBaseline = load(baselinePath, &baseline, &baselineText);
+    std::map<std::string, const Metric *> expected;
+    for (const Metric &metric : baseline.metrics) {
+        expected[metric.name] = &metric;
+    }
+
+    if (update) {
+        for (Metric &metric : report.metrics) {
+            const auto it = expected.find(metric.name);
+            metric.tolerance = it != expected.end() ? it->second->tolerance : -1;
+        }
+        if (!write(baselinePath, report)) {
+            return 2;
+        }
+        printf("%s: baseline %s updated\n", report.suite.c_str(), baselinePath);
+        return 0;
+    }
+
+    if (!hasBaseline) {
+        printf("%s: no baseline for %zu metrics\n", report.suite.c_str(), report.metrics.size());
+        return 0;
+    }
+
+    int regressions = 0;
+    for (const Metric &metric : report.metrics) {
+        const auto it = expected.find(metric.name);
+        if (it == expected.end()) {
+            printf("  new        %-52s %12.4g %s\n", metric.name.c_str(), metric.value, metric.unit.c_str());
+            continue;
+        }
+        const Metric &base = *it->second;
+        const double tolerance = base.tolerance >= 0 ? base.tolerance : DEFAULT_TOLERANCE;
+        // positive is worse
+        double change = 0;
+        if (base.value != 0) {
+            change = (metric.value - base.value) / std::fabs(base.value);
+        } else if (metric.value != 0) {
+            change = metric.value > 0 ? 1 : -1;
+        }
+        if (!metric.lowerIsBetter) {
+            change = -change;
+        }
+        const bool regressed = change > tolerance;
+        regressions += regressed ? 1 : 0;
+        printf("  %-10s %-52s %12.4g %s (baseline %.4g, %+.1f%%)\n", regressed ? "REGRESSED" : "ok",
+               metric.name.c_str(), metric.value, metric.unit.c_str(), base.value, change * 100);
+    }
+    if (regressions) {
+        fprintf(stderr, "%s: %d metric(s) regressed\n", report.suite.c_str(), regressions);
+        return 1;
+    }
+    printf("%s: no regressions\n", report.suite.c_str());
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "BenchReport.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// rounds of a measurement, the fastest is reported: other load on the
+// machine only ever makes a round slower
+const int ROUNDS = 15;
+const int64_t ROUND_NS = 20 * 1000 * 1000;
+const int64_t QUICK_ROUND_NS = 1000 * 1000;
+
+std::string escape(const std::string &text)
+{
+    std::string escaped;
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+}
+
+BenchReport::BenchReport(const char *suite, int argc, char **argv) :
+    mSuite(suite),
+    mOut(std::string(suite) + ".json"),
+    mQuick(false)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--quick")) {
+            mQuick = true;
+        } else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+            mOut = argv[++i];
+        }
+    }
+}
+
+void BenchReport::measure(const std::string &name, int64_t batch, const std::function<void()> &op)
+{
+    const int64_t roundNs = mQuick ? QUICK_ROUND_NS : ROUND_NS;
+    const int rounds = mQuick ? 1 : ROUNDS;
+
+    // warm up and size the rounds
+    int64_t calls = 1;
+    for (;;) {
+        const int64_t start = nowNs();
+        for (int64_t i = 0; i < calls; ++i) {
+            op();
+        }
+        const int64_t elapsed = nowNs() - start;
+        if (elapsed >= roundNs / 4 || calls >= (int64_t(1) << 30)) {
+            calls = std::max<int64_t>(1, calls * roundNs / std::max<int64_t>(1, elapsed));
+            break;
+        }
+        calls *= 4;
+    }
+
+    std::vector<double> perOp;
+    for (int round = 0; round < rounds; ++round) {
+        const int64_t start = nowNs();
+        for (int64_t i = 0; i < calls; ++i) {
+            op();
+        }
+        perOp.push_back(double(nowNs() - start) / double(calls * batch));
+    }
+    add(name, *std::min_element(perOp.begin(), perOp.end()), "ns/op");
+}
+
+void BenchReport::add(const std::string &name, double value, const char *unit, Better better)
+{
+    printf("%-56s %14.3f %s\n", name.c_str(), value, unit);
+    fflush(stdout);
+    mResults.push_back({name, value, unit, better});
+}
+
+int BenchReport::finish() const
+{
+    FILE *file = fopen(mOut.c_str(), "w");
+    if (!file) {
+        perror(mOut.c_str());
+        return 1;
+    }
+    fprintf(file, "{\n  \"suite\": \"%s\",\n  \"quick\": %s,\n  \"results\": [", escape(mSuite).c_str(),
+            mQuick ? "true" : "false");
+    for (size_t i = 0; i < mResults.size(); ++i) {
+        const Result &result = mResults[i];
+        fprintf(file, "%s\n    {\"name\": \"%s\", \"value\": %.6g, \"unit\": \"%s\", \"better\": \"%s\"}",
+                i ? "," : "", escape(result.name).c_str(), result.value, escape(result.unit).c_str(),
+                result.better == Lower ? "lower" : "higher");
+    }
+    fprintf(file, "\n  ]\n}\n");
+    return fclose(file) == 0 ? 0 : 1;
+}
+
+int64_t BenchReport::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,58 @@
+#ifndef BENCHREPORT_H
+#define BENCHREPORT_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Results of one benchmark executable, written as JSON for the bench target:
+//
+//   {"suite": "core", "results": [
+//     {"name": "...", "value": 12.5, "unit": "ns/op", "better": "lower"}, ...]}
+//
+// bench_compare compares the file with baselines/<suite>.json and fails on
+// a metric that got worse than its tolerance allows.
+//
+// Executables take --out FILE (default <suite>.json in the working directory)
+// and --quick, which runs every case briefly so ctest can check the benches
+// still work without timing them.
+class BenchReport
+{
+public:
+    enum Better {
+        Lower,
+        Higher
+    };
+
+    BenchReport(const char *suite, int argc, char **argv);
+
+    bool quick() const { return mQuick; }
+
+    // Times op, which performs batch operations per call, over several rounds
+    // and records the fastest round's time per operation in ns.
+    void measure(const std::string &name, int64_t batch, const std::function<void()> &op);
+    void add(const std::string &name, double value, const char *unit, Better better = Lower);
+
+    // Writes the report, returns the process exit code.
+    int finish() const;
+
+    static int64_t nowNs();
+
+private:
+    struct Result
+    {
+        std::string name;
+        double value;
+        std::string unit;
+        Better better;
+    };
+
+    const std::string mSuite;
+    std::string mOut;
+    bool mQuick;
+    std::vector<Result> mResults;
+};
+
+#endif // BENCHREPORT_H
@@ -0,0 +1,429 @@
+// Hot paths of the Qt-free native code and of the JNI stand-in the desktop
+// benches run on.
+
+#include "AesCtr.h"
+#include "AesCtrDataSource.h"
+#include "AsyncReadEngine.h"
+#include "AtomicLatencyHistogram.h"
+#include "BandwidthEstimator.h"
+#include "BenchReport.h"
+#include "FakeJni.h"
+#include "FileDataSource.h"
+#include "IoScheduler.h"
+#include "LatencyHistogram.h"
+#include "VirtualTimeline.h"
+#include "com_vadim_android_NativeMediaDataSource.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+// keeps the optimizer from dropping a result
+volatile int64_t sink;
+
+void benchBandwidthEstimator(BenchReport &report)
+{
+    BandwidthEstimator estimator;
+    int64_t time = 0;
+    report.measure("BandwidthEstimator.addSample+timeToStall", 1, [&] {
+        time += 250;
+        estimator.addSample(time, time * 3 / 2);
+        sink = estimator.timeToStall(time, time, 600000, 1.0);
+    });
+}
+
+void benchLatencyHistogram(BenchReport &report)
+{
+    LatencyHistogram histogram;
+    int64_t value = 1;
+    report.measure("LatencyHistogram.record", 1, [&] {
+        value = (value * 1103515245 + 12345) & 0xfffff;
+        histogram.record(value);
+    });
+    report.measure("LatencyHistogram.percentile", 1, [&] {
+        sink = histogram.percentile(99);
+    });
+
+    // the record path of CallTiming, uncontended
+    AtomicLatencyHistogram atomicHistogram;
+    report.measure("AtomicLatencyHistogram.record", 1, [&] {
+        value = (value * 1103515245 + 12345) & 0xfffff;
+        atomicHistogram.record(value);
+    });
+    report.measure("AtomicLatencyHistogram.percentile", 1, [&] {
+        sink = atomicHistogram.percentile(99);
+    });
+}
+
+void benchVirtualTimeline(BenchReport &report)
+{
+    VirtualTimeline timeline;
+    const int parts = 100;
+    timeline.reset(parts);
+    for (int part = 0; part < parts; ++part) {
+        timeline.setPartDuration(part, 30000 + part);
+    }
+    int64_t position = 0;
+    report.measure("VirtualTimeline.locate(100 parts)", 1, [&] {
+        position = (position + 7919) % timeline.duration();
+        sink = timeline.locate(position).first;
+    });
+}
+
+void benchAesCtr(BenchReport &report)
+{
+    const quint8 key[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+    const quint8 iv[16] = {};
+    AesCtr cipher(key, sizeof(key), iv);
+    const int size = 64 * 1024;
+    std::vector<quint8> data(size);
+    int64_t position = 0;
+    report.measure(std::string("AesCtr.apply(64 KiB, ")
+                   + AesCtr::implementationName(cipher.implementation()) + ")", size, [&] {
+        cipher.apply(position, data.data(), size);
+        position += size;
+    });
+}
+
+void benchFileDataSource(BenchReport &report)
+{
+    char path[] = "/tmp/bench_coreXXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return;
+    }
+    const int64_t fileSize = 16 * 1024 * 1024;
+    std::vector<char> chunk(1024 * 1024, 'x');
+    for (int64_t written = 0; written < fileSize; written += int64_t(chunk.size())) {
+        if (write(fd, chunk.data(), chunk.size()) != ssize_t(chunk.size())) {
+            perror("write");
+            break;
+        }
+    }
+    close(fd);
+
+    // the page cache is warm, this is the cost of the read path itself
+    FileDataSource source(path, IoScheduler::instance().createClient("bench"));
+    std::vector<char> buffer(64 * 1024);
+    int64_t position = 0;
+    report.measure(std::string("FileDataSource.readAt(64 KiB, ") + IoScheduler::instance().engineName() + ")",
+                   1, [&] {
+        sink = source.readAt(position, buffer.data(), int64_t(buffer.size()));
+        position = (position + int64_t(buffer.size())) % fileSize;
+    });
+
+    // the engine underneath, one read in flight from submit to completion
+    std::mutex mutex;
+    std::condition_variable completed;
+    bool done = false;
+    const auto engine = AsyncReadEngine::create(1, [&](void *, qint64 result) {
+        sink = result;
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        completed.notify_one();
+    });
+    const int fd2 = open(path, O_RDONLY);
+    report.measure(std::string("AsyncReadEngine.submit+complete(4 KiB, ") + engine->name() + ")", 1, [&] {
+        done = false;
+        engine->submit({{fd2, position, buffer.data(), 4096, nullptr}});
+        position = (position + 4096) % fileSize;
+        std::unique_lock<std::mutex> lock(mutex);
+        completed.wait(lock, [&] { return done; });
+    });
+    close(fd2);
+    unlink(path);
+}
+
+struct ReadRate
+{
+    double bytesPerSecond;
+    // process CPU time per MiB read, whichever thread spent it
+    double cpuUsPerMiB;
+};
+
+double cpuSeconds()
+{
+    timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return double(time.tv_sec) + double(time.tv_nsec) / 1e9;
+}
+
+// 4 KiB reads spread over the file, queueDepth of them kept in flight on the
+// engine; without an engine the calling thread preads them one by one.
+ReadRate readRate(int fd, int64_t fileSize, AsyncReadEngine::Backend *backend, int queueDepth, bool quick)
+{
+    const int64_t blocks = fileSize / 4096;
+    const auto duration = std::chrono::milliseconds(quick ? 10 : 200);
+    std::atomic<int64_t> next(0);
+    std::atomic<int64_t> bytes(0);
+    const auto offset = [&] { return (next++ * 7919 % blocks) * 4096; };
+    std::vector<std::vector<char>> buffers(size_t(queueDepth), std::vector<char>(4096));
+
+    const double cpuStart = cpuSeconds();
+    const auto start = std::chrono::steady_clock::now();
+    if (!backend) {
+        AsyncReadEngine::Read read{fd, 0, buffers[0].data(), 4096, nullptr};
+        while (std::chrono::steady_clock::now() - start < duration) {
+            for (int i = 0; i < 64; ++i) {
+                read.offset = offset();
+                bytes += qMax<qint64>(0, AsyncReadEngine::readInline(read));
+            }
+        }
+    } else {
+        std::mutex mutex;
+        std::condition_variable drained;
+        std::atomic<bool> stopping(false);
+        int inFlight = queueDepth;
+        AsyncReadEngine *engine = nullptr;
+        const auto owned = AsyncReadEngine::create(queueDepth, [&](void *tag, qint64 result) {
+            bytes += qMax<qint64>(0, result);
+            if (!stopping) {
+                engine->submit({{fd, offset(), static_cast<char *>(tag), 4096, tag}});
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--inFlight == 0) {
+                drained.notify_one();
+            }
+        }, *backend);
+        engine = owned.get();
+        std::vector<AsyncReadEngine::Read> reads;
+        for (auto &buffer : buffers) {
+            reads.push_back({fd, offset(), buffer.data(), 4096, buffer.data()});
+        }
+        engine->submit(reads);
+        std::this_thread::sleep_for(duration);
+        stopping = true;
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [&] { return inFlight == 0; });
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const double mib = double(qMax<int64_t>(1, bytes.load())) / (1024 * 1024);
+    return {double(bytes.load()) / seconds, (cpuSeconds() - cpuStart) * 1e6 / mib};
+}
+
+// pread on the calling thread against the engines at several queue depths,
+// page cache warm: what the syscall, the hop and the batching cost.
+void benchReadEngines(BenchReport &report)
+{
+    char path[] = "/tmp/bench_coreXXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return;
+    }
+    const int64_t fileSize = 16 * 1024 * 1024;
+    std::vector<char> chunk(1024 * 1024, 'r');
+    for (int64_t written = 0; written < fileSize; written += int64_t(chunk.size())) {
+        if (write(fd, chunk.data(), chunk.size()) != ssize_t(chunk.size())) {
+            perror("write");
+            break;
+        }
+    }
+
+    const auto add = [&](const std::string &name, const ReadRate &rate) {
+        report.add(name + " throughput", rate.bytesPerSecond / (1024 * 1024), "MiB/s", BenchReport::Higher);
+        report.add(name + " CPU", rate.cpuUsPerMiB, "us/MiB");
+    };
+    add("pread(4 KiB, qd 1)", readRate(fd, fileSize, nullptr, 1, report.quick()));
+    for (AsyncReadEngine::Backend backend : {AsyncReadEngine::Backend::ThreadPool, AsyncReadEngine::Backend::Best}) {
+        const std::string engine = AsyncReadEngine::create(1, [](void *, qint64) {}, backend)->name();
+        if (backend == AsyncReadEngine::Backend::Best && engine == "threadpool") {
+            continue;
+        }
+        for (const int queueDepth : {1, 4, 16}) {
+            add("AsyncReadEngine(" + engine + ", 4 KiB, qd " + std::to_string(queueDepth) + ")",
+                readRate(fd, fileSize, &backend, queueDepth, report.quick()));
+        }
+    }
+    close(fd);
+    unlink(path);
+}
+
+// A clip held in memory, reads cost the copy only.
+class MemorySource : public MediaDataSource
+{
+public:
+    explicit MemorySource(int64_t size) : mData(size_t(size), 'm') {}
+
+    qint64 readAt(qint64 position, char *buffer, qint64 size) override
+    {
+        if (position >= qint64(mData.size())) {
+            return 0;
+        }
+        size = std::min<qint64>(size, qint64(mData.size()) - position);
+        memcpy(buffer, mData.data() + position, size_t(size));
+        return size;
+    }
+    qint64 size() const override { return qint64(mData.size()); }
+
+private:
+    std::vector<char> mData;
+};
+
+// Bytes per second MediaPlayer gets through NativeMediaDataSource.readAt()
+// with readers threads reading 64 KiB at a time, each into its own array.
+double jniReadThroughput(const std::shared_ptr<MediaDataSource> &source, int readers, bool quick)
+{
+    const int64_t size = source->size();
+    const jlong handle = MediaDataSource::createJniHandle(source);
+    const auto duration = std::chrono::milliseconds(quick ? 10 : 300);
+    std::atomic<int64_t> bytes(0);
+    std::vector<std::thread> threads;
+    const auto start = std::chrono::steady_clock::now();
+    for (int reader = 0; reader < readers; ++reader) {
+        threads.emplace_back([&, reader] {
+            const int chunk = 64 * 1024;
+            FakeJni::LocalRef array(FakeJni::newByteArray(chunk));
+            int64_t position = (size / readers * reader) / chunk * chunk;
+            int64_t read = 0;
+            while (std::chrono::steady_clock::now() - start < duration) {
+                for (int i = 0; i < 16; ++i) {
+                    const jint result = Java_com_vadim_android_NativeMediaDataSource_readAt(
+                        FakeJni::env(), nullptr, handle, position, array.as<jbyteArray>(), 0, chunk);
+                    read += result > 0 ? result : 0;
+                    position = result > 0 && position + chunk < size ? position + chunk : 0;
+                }
+            }
+            bytes += read;
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Java_com_vadim_android_NativeMediaDataSource_close(FakeJni::env(), nullptr, handle);
+    return double(bytes.load()) / seconds;
+}
+
+void benchJniReadAt(BenchReport &report)
+{
+    char path[] = "/tmp/bench_coreXXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return;
+    }
+    const int64_t fileSize = 16 * 1024 * 1024;
+    if (ftruncate(fd, fileSize) != 0) {
+        perror("ftruncate");
+    }
+    close(fd);
+
+    const auto memory = std::make_shared<MemorySource>(fileSize);
+    const auto file = std::make_shared<FileDataSource>(path, IoScheduler::instance().createClient("bench"));
+    for (const int readers : {1, 4, 8}) {
+        const std::string suffix = ", " + std::to_string(readers) + " reader" + (readers > 1 ? "s)" : ")");
+        report.add("NativeMediaDataSource.readAt(memory" + suffix,
+                   jniReadThroughput(memory, readers, report.quick()) / (1024 * 1024), "MiB/s",
+                   BenchReport::Higher);
+        report.add("NativeMediaDataSource.readAt(file" + suffix,
+                   jniReadThroughput(file, readers, report.quick()) / (1024 * 1024), "MiB/s",
+                   BenchReport::Higher);
+    }
+    unlink(path);
+}
+
+// Decryption with every core reading, and the latency MediaPlayer sees for a
+// read of encrypted media from JNI through the cipher, the IoScheduler and
+// the file.
+void benchEncryptedReads(BenchReport &report)
+{
+    char path[] = "/tmp/bench_coreXXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return;
+    }
+    const int64_t fileSize = 16 * 1024 * 1024;
+    std::vector<char> chunk(1024 * 1024, 'e');
+    for (int64_t written = 0; written < fileSize; written += int64_t(chunk.size())) {
+        if (write(fd, chunk.data(), chunk.size()) != ssize_t(chunk.size())) {
+            perror("write");
+            break;
+        }
+    }
+    close(fd);
+
+    const quint8 key[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+    const quint8 iv[16] = {};
+    const AesCtr cipher(key, sizeof(key), iv);
+    const std::string implementation = AesCtr::implementationName(cipher.implementation());
+
+    const int cores = int(std::max(1u, std::thread::hardware_concurrency()));
+    const auto memory = std::make_shared<AesCtrDataSource>(std::make_shared<MemorySource>(fileSize), cipher);
+    report.add("AesCtrDataSource.readAt(memory, " + implementation + ") per core",
+               jniReadThroughput(memory, cores, report.quick()) / cores / (1024 * 1024), "MiB/s",
+               BenchReport::Higher);
+
+    const auto file = std::make_shared<AesCtrDataSource>(
+        std::make_shared<FileDataSource>(path, IoScheduler::instance().createClient("bench")), cipher);
+    const jlong handle = MediaDataSource::createJniHandle(file);
+    const jint size = 64 * 1024;
+    FakeJni::LocalRef array(FakeJni::newByteArray(size_t(size)));
+    std::vector<int64_t> latencies(report.quick() ? 20 : 2000);
+    int64_t position = 0;
+    for (int64_t &latency : latencies) {
+        const int64_t start = BenchReport::nowNs();
+        sink = Java_com_vadim_android_NativeMediaDataSource_readAt(FakeJni::env(), nullptr, handle, position,
+                                                                  array.as<jbyteArray>(), 0, size);
+        latency = BenchReport::nowNs() - start;
+        position = (position + size) % fileSize;
+    }
+    Java_com_vadim_android_NativeMediaDataSource_close(FakeJni::env(), nullptr, handle);
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&](double percent) {
+        return double(latencies[size_t(percent / 100 * double(latencies.size() - 1))]) / 1000;
+    };
+    const std::string name = "NativeMediaDataSource.readAt(encrypted file, 64 KiB, " + implementation + ")";
+    report.add(name + " p50", percentile(50), "us");
+    report.add(name + " p99", percentile(99), "us");
+    unlink(path);
+}
+
+void benchFakeJni(BenchReport &report)
+{
+    FakeJni::registerClass("bench/Target");
+    FakeJni::registerMethod("bench/Target", "next", [](FakeJni::Object &, const FakeJni::Args &args) {
+        return FakeJni::Value(args.at(0).i + 1);
+    });
+    const auto target = std::make_shared<FakeJni::Object>("bench/Target");
+    JNIEnv *env = FakeJni::env();
+    const jobject ref = FakeJni::newGlobalRef(target);
+    const jmethodID method = env->GetMethodID(env->FindClass("bench/Target"), "next", "(J)V");
+    report.measure("FakeJni.CallVoidMethod", 1, [&] {
+        env->CallVoidMethod(ref, method, jlong(1));
+    });
+    FakeJni::deleteGlobalRef(ref);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    BenchReport report("core", argc, argv);
+    benchBandwidthEstimator(report);
+    benchLatencyHistogram(report);
+    benchVirtualTimeline(report);
+    benchAesCtr(report);
+    benchFileDataSource(report);
+    benchReadEngines(report);
+    benchJniReadAt(report);
+    benchEncryptedReads(report);
+    benchFakeJni(report);
+    return report.finish();
+}
@@ -0,0 +1,410 @@
+// GUI thread costs of AndroidMediaPlayer and the QML types on the simulated
+// backend: dispatching Java events, state transitions, position queries,
+// surface geometry, playlist switching and scene graph updates, and the
+// resume position journal. The render thread cost of grids of SurfaceTexture
+// items, with their draw calls and batches.
+
+#include "AndroidMediaPlayer.h"
+#include "AndroidSurfaceView.h"
+#include "BenchReport.h"
+#include "PlayerLog.h"
+#include "QSurfaceTexture.h"
+#include "QtWait.h"
+#include "QuickItemSurface.h"
+#include "RenderHarness.h"
+#include "ResumeStore.h"
+#include "SimulatedBackend.h"
+#include "com_vadim_android_NativeMediaPlayerEventListener.h"
+
+#include <QGuiApplication>
+#include <QProcess>
+#include <QQmlComponent>
+#include <QQmlEngine>
+#include <QQuickWindow>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace {
+
+volatile int64_t sink;
+
+// the batch counts come from a second run of the executable with this flag
+const char *const COUNT_BATCHES = "--count-batches";
+const int GRID_SIZES[] = {1, 4, 16, 64};
+const int INSTANTIATION_SIZES[] = {1, 5, 10, 20};
+
+// Brings a new player to Started on source.
+bool startPlayer(AndroidMediaPlayer &player, const QString &source)
+{
+    player.setDataSource(source);
+    if (!waitUntil([&] { return player.playbackState() == AndroidMediaPlayer::PlaybackState::Prepared; })) {
+        return false;
+    }
+    player.start();
+    return player.playbackState() == AndroidMediaPlayer::PlaybackState::Started;
+}
+
+void benchEventDispatch(BenchReport &report)
+{
+    AndroidMediaPlayer player;
+    if (!startPlayer(player, "sim:600000?download=1")) {
+        fprintf(stderr, "bench_player: player did not start\n");
+        return;
+    }
+    // from the Java listener through the queued invocation to the slot
+    const int batch = 100;
+    int percent = 0;
+    report.measure("AndroidMediaPlayer.dispatch(onBufferingUpdate)", batch, [&] {
+        for (int i = 0; i < batch; ++i) {
+            percent = (percent + 1) % 100;
+            Java_com_vadim_android_NativeMediaPlayerEventListener_onBufferingUpdate(nullptr, nullptr,
+                                                                                    jlong(&player), percent);
+        }
+        QCoreApplication::sendPostedEvents(&player);
+    });
+}
+
+void benchStateTransitions(BenchReport &report)
+{
+    AndroidMediaPlayer player;
+    if (!startPlayer(player, "sim:600000")) {
+        return;
+    }
+    report.measure("AndroidMediaPlayer.pause+resume", 1, [&] {
+        player.pause();
+        player.resume();
+        QCoreApplication::sendPostedEvents(&player);
+    });
+    report.measure("AndroidMediaPlayer.currentPosition", 1, [&] {
+        sink = player.currentPosition();
+    });
+    report.measure("AndroidMediaPlayer.duration", 1, [&] {
+        sink = player.duration();
+    });
+}
+
+void benchPlaylistSwitch(BenchReport &report)
+{
+    AndroidMediaPlayer player;
+    QStringList playlist;
+    for (int part = 0; part < 10; ++part) {
+        playlist.append(QString("sim:%1").arg(30000 + part));
+    }
+    player.setPlaylist(playlist);
+    if (!waitUntil([&] { return player.playbackState() == AndroidMediaPlayer::PlaybackState::Prepared; })) {
+        return;
+    }
+    // across a part boundary, the GUI thread side of stop, reset, open and
+    // prepare; the events of the previous switch are delivered in between
+    int part = 0;
+    report.measure("AndroidMediaPlayer.seekTo(other part)", 1, [&] {
+        part = (part + 3) % playlist.size();
+        player.seekTo(long(part) * 30000 + 1000);
+        QCoreApplication::sendPostedEvents(&player);
+    });
+    sink = player.currentPart();
+}
+
+// Position updates as the progress timer makes them, spread over keys
+// sources: the journal bytes written per byte of key and position, counting
+// compactions, and the cost of a lookup.
+void benchResumeStore(BenchReport &report)
+{
+    QTemporaryDir dir;
+    ResumeStore &store = ResumeStore::instance();
+    for (const int keys : {200, 10000}) {
+        if (!dir.isValid() || !store.open(dir.filePath(QString("resume%1.journal").arg(keys)))) {
+            fprintf(stderr, "bench_player: can't open a journal, skipping the resume store\n");
+            return;
+        }
+        QStringList sources;
+        for (int i = 0; i < keys; ++i) {
+            sources.append(QString("/sdcard/Movies/clip%1.mp4").arg(i));
+        }
+        const int updates = report.quick() ? keys : 20 * keys;
+        const ResumeStore::Stats before = store.stats();
+        quint64 logicalBytes = 0;
+        for (int i = 0; i < updates; ++i) {
+            const QString &source = sources.at(i % keys);
+            store.setPosition(source, qint64(i) * 1000);
+            logicalBytes += quint64(source.toUtf8().size()) + sizeof(qint64);
+        }
+        const ResumeStore::Stats after = store.stats();
+        const quint64 written = after.appendedBytes - before.appendedBytes
+                + after.compactedBytes - before.compactedBytes;
+        const std::string suffix = "(" + std::to_string(keys) + " keys)";
+        report.add("ResumeStore.setPosition write amplification" + suffix,
+                   double(written) / double(logicalBytes), "x");
+
+        int i = 0;
+        report.measure("ResumeStore.setPosition" + suffix, 1, [&] {
+            store.setPosition(sources.at(i), i);
+            i = (i + 1) % keys;
+        });
+        report.measure("ResumeStore.position" + suffix, 1, [&] {
+            sink = store.position(sources.at(i));
+            i = (i + 1) % keys;
+        });
+        store.close();
+    }
+}
+
+// What a debug statement on a hot path costs: nothing where the build
+// compiles it out (QT_NO_DEBUG, as in release), the formatting and the ring
+// write where it is enabled.
+void benchLogging(BenchReport &report)
+{
+    const int batch = 1000;
+    int64_t value = 0;
+    report.measure("hot loop without logging", batch, [&] {
+        for (int i = 0; i < batch; ++i) {
+            sink = ++value;
+        }
+    });
+    const bool enabled = PlayerLog::enabled(PlayerLog::Debug, PlayerLog::Player);
+    report.measure(std::string("hot loop with PLAYER_DEBUG(") + (enabled ? "enabled" : "compiled out") + ")",
+                   batch, [&] {
+        for (int i = 0; i < batch; ++i) {
+            sink = ++value;
+            PLAYER_DEBUG(Player) << "position:" << value;
+        }
+    });
+    report.measure("PlayerLog::Line(enabled)", 1, [&] {
+        PlayerLog::Line(PlayerLog::Debug, PlayerLog::Player, Q_FUNC_INFO) << "position:" << ++value;
+    });
+}
+
+// exposes the protected helper
+class GeometryProbe : public QuickItemPlayerSurface
+{
+public:
+    void setVideoSize(int, int) override {}
+    using QuickItemPlayerSurface::toPhycalGeometry;
+};
+
+void benchGeometry(BenchReport &report)
+{
+    qreal x = 0;
+    report.measure("QuickItemPlayerSurface.toPhycalGeometry", 1, [&] {
+        x += 0.5;
+        sink = GeometryProbe::toPhycalGeometry(x, 10.25, 320.5, 180.75).width();
+    });
+}
+
+void benchSceneGraph(BenchReport &report)
+{
+    RenderHarness harness(QSize(640, 360));
+    if (!harness.isValid()) {
+        fprintf(stderr, "bench_player: no OpenGL, skipping the scene graph\n");
+        return;
+    }
+    QSurfaceTexture texture(harness.contentItem());
+    texture.setSize(QSizeF(640, 360));
+    harness.renderFrame();
+    // a new frame every render: updateTexImage, the transform and the node
+    report.measure("QSurfaceTexture.frame(update+render)", 1, [&] {
+        texture.update();
+        harness.renderFrame();
+    });
+
+    AndroidMediaPlayer player;
+    player.setSurfaceView(&texture);
+    if (startPlayer(player, "testpattern:640x360@60")) {
+        report.measure("QSurfaceTexture.frame(playing testpattern)", 1, [&] {
+            harness.renderFrame();
+        });
+    }
+}
+
+std::string gridName(int items, bool blending, const char *metric)
+{
+    return "SurfaceTexture x" + std::to_string(items) + " (blending " + (blending ? "on" : "off") + ") "
+            + metric;
+}
+
+// Renders a grid of items SurfaceTexture items, each with a new 160x90 test
+// pattern frame every frame like a playing video, and calls frame with the
+// stats of every frame after the first.
+void renderGrid(RenderHarness &harness, int items, bool blending, int frames,
+                const std::function<void(const RenderHarness::FrameStats &)> &frame)
+{
+    const int columns = int(std::ceil(std::sqrt(double(items))));
+    const QSizeF cell(qreal(harness.size().width()) / columns, qreal(harness.size().height()) / columns);
+    std::vector<std::unique_ptr<QSurfaceTexture>> textures;
+    for (int i = 0; i < items; ++i) {
+        textures.emplace_back(new QSurfaceTexture(harness.contentItem()));
+        textures.back()->setPosition(QPointF((i % columns) * cell.width(), (i / columns) * cell.height()));
+        textures.back()->setSize(cell);
+        textures.back()->setBlending(blending);
+    }
+    // creates the nodes and the SurfaceTextures
+    harness.renderFrame();
+
+    TestPattern::Spec spec;
+    spec.width = 160;
+    spec.height = 90;
+    for (int index = 0; index < frames; ++index) {
+        for (const auto &texture : textures) {
+            SimulatedBackend::postFrame(texture->surfaceTexture(), spec, index);
+        }
+        harness.renderFrame();
+        frame(harness.lastFrame());
+    }
+}
+
+// The median render thread time per frame for 1 to 64 items with blending on
+// and off. Logging the batches would show in the times, they are counted by
+// countGridBatches() in a second run.
+void benchSurfaceGrid(BenchReport &report)
+{
+    RenderHarness harness(QSize(640, 360));
+    if (!harness.isValid()) {
+        return;
+    }
+    const int frames = report.quick() ? 3 : 200;
+    for (const bool blending : {true, false}) {
+        for (const int items : GRID_SIZES) {
+            std::vector<qint64> times;
+            renderGrid(harness, items, blending, frames, [&times](const RenderHarness::FrameStats &stats) {
+                times.push_back(stats.syncNs + stats.renderNs);
+            });
+            std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+            report.add(gridName(items, blending, "render thread"), double(times[times.size() / 2]) / 1000, "us");
+        }
+    }
+
+    QProcess counter;
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert("QSG_RENDERER_DEBUG", "render");
+    counter.setProcessEnvironment(environment);
+    counter.setStandardErrorFile(QProcess::nullDevice());
+    counter.start(QCoreApplication::applicationFilePath(), {COUNT_BATCHES});
+    if (!counter.waitForFinished(60000) || counter.exitCode() != 0) {
+        fprintf(stderr, "bench_player: counting the batches failed\n");
+        return;
+    }
+    // items blending batches drawCalls
+    for (const QByteArray &line : counter.readAllStandardOutput().split('\n')) {
+        const QList<QByteArray> fields = line.split(' ');
+        if (fields.size() == 4) {
+            const int items = fields[0].toInt();
+            const bool blending = fields[1] == "1";
+            report.add(gridName(items, blending, "batches"), fields[2].toDouble(), "batches");
+            report.add(gridName(items, blending, "draw calls"), fields[3].toDouble(), "calls");
+        }
+    }
+}
+
+// A page of QML delegates with a surface view each, like a wall of video
+// tiles: the GUI thread time of instantiating the page, until every view was
+// added to the layout on the Android UI thread, and of destroying the page,
+// the median over the runs.
+void benchSurfaceInstantiation(BenchReport &report)
+{
+    qmlRegisterType<AndroidSurfaceView>("com.vadim.android", 1, 0, "AndroidSurfaceView");
+    QQmlEngine engine;
+    QQmlComponent component(&engine);
+    component.setData("import QtQuick 2.12\n"
+                      "import com.vadim.android 1.0\n"
+                      "Grid {\n"
+                      "    id: page\n"
+                      "    property int count: 0\n"
+                      "    columns: 5\n"
+                      "    Repeater {\n"
+                      "        model: page.count\n"
+                      "        AndroidSurfaceView { width: 128; height: 72 }\n"
+                      "    }\n"
+                      "}\n", QUrl());
+    if (!component.isReady()) {
+        fprintf(stderr, "bench_player: %s\n", qPrintable(component.errorString()));
+        return;
+    }
+    const int runs = report.quick() ? 1 : 20;
+    for (const int count : INSTANTIATION_SIZES) {
+        std::vector<qint64> create;
+        std::vector<qint64> ready;
+        std::vector<qint64> destroy;
+        for (int run = 0; run < runs; ++run) {
+            const int views = SimulatedBackend::surfaceViewCount();
+            QElapsedTimer timer;
+            timer.start();
+            std::unique_ptr<QObject> page(component.beginCreate(engine.rootContext()));
+            page->setProperty("count", count);
+            component.completeCreate();
+            create.push_back(timer.nsecsElapsed());
+            if (!waitUntil([&] { return SimulatedBackend::surfaceViewCount() == views + count; })) {
+                fprintf(stderr, "bench_player: %d surface views not added\n", count);
+                return;
+            }
+            ready.push_back(timer.nsecsElapsed());
+
+            timer.restart();
+            page.reset();
+            destroy.push_back(timer.nsecsElapsed());
+            if (!waitUntil([&] { return SimulatedBackend::surfaceViewCount() == views; })) {
+                fprintf(stderr, "bench_player: %d surface views not removed\n", count);
+                return;
+            }
+        }
+        for (auto *times : {&create, &ready, &destroy}) {
+            std::nth_element(times->begin(), times->begin() + times->size() / 2, times->end());
+        }
+        const std::string name = "AndroidSurfaceView x" + std::to_string(count);
+        report.add(name + " instantiate", double(create[create.size() / 2]) / 1000, "us");
+        report.add(name + " until added", double(ready[ready.size() / 2]) / 1000, "us");
+        report.add(name + " destroy", double(destroy[destroy.size() / 2]) / 1000, "us");
+    }
+}
+
+// Runs with QSG_RENDERER_DEBUG=render, prints the batches and draw calls of
+// a frame of each grid.
+int countGridBatches()
+{
+    RenderHarness harness(QSize(640, 360));
+    if (!harness.isValid()) {
+        return 1;
+    }
+    for (const bool blending : {true, false}) {
+        for (const int items : GRID_SIZES) {
+            RenderHarness::FrameStats last;
+            renderGrid(harness, items, blending, 2, [&last](const RenderHarness::FrameStats &stats) {
+                last = stats;
+            });
+            if (last.batches < 0) {
+                return 1;
+            }
+            printf("%d %d %d %d\n", items, blending ? 1 : 0, last.batches, last.drawCalls);
+        }
+    }
+    return 0;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+    SimulatedBackend::install();
+    if (app.arguments().contains(COUNT_BATCHES)) {
+        return countGridBatches();
+    }
+    BenchReport report("player", argc, argv);
+    benchEventDispatch(report);
+    benchStateTransitions(report);
+    benchPlaylistSwitch(report);
+    benchGeometry(report);
+    benchLogging(report);
+    benchResumeStore(report);
+    benchSceneGraph(report);
+    benchSurfaceGrid(report);
+    benchSurfaceInstantiation(report);
+    return report.finish();
+}
@@ -0,0 +1,594 @@
+#include "FakeJni.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+
+namespace {
+
+struct Class {
+    FakeJni::Constructor constructor;
+    // keyed by "name" and "name(signature)"
+    std::map<std::string, FakeJni::Method> methods;
+    std::map<std::string, FakeJni::StaticMethod> staticMethods;
+};
+
+struct Reference {
+    FakeJni::ObjectPtr object;
+    int globalRefs = 0;
+    int localRefs = 0;
+};
+
+struct MethodId {
+    std::string name;
+    std::string signature;
+};
+
+struct Pending {
+    bool pending = false;
+    std::string className;
+    std::string message;
+};
+
+std::mutex classesMutex;
+std::map<std::string, std::shared_ptr<Class>> classes;
+
+std::mutex referencesMutex;
+std::unordered_map<jobject, Reference> references;
+
+std::mutex idsMutex;
+// node based, ids stay valid while new ones are added
+std::map<std::string, MethodId> methodIds;
+std::map<std::string, std::shared_ptr<FakeJni::Object>> classObjects;
+
+std::atomic<int64_t> liveObjects{0};
+std::atomic<int64_t> globalRefs{0};
+std::atomic<int64_t> localRefs{0};
+std::atomic<int64_t> calls{0};
+std::atomic<int64_t> unhandledCalls{0};
+std::atomic<int64_t> staleReferences{0};
+std::atomic<int64_t> exceptions{0};
+std::atomic<int> currentSdkVersion{28};
+
+thread_local Pending pendingException;
+thread_local _JNIEnv threadEnv;
+
+std::shared_ptr<Class> findClass(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(classesMutex);
+    const auto it = classes.find(name);
+    return it != classes.end() ? it->second : nullptr;
+}
+
+template<typename Map>
+typename Map::mapped_type findMethod(const Map &map, const char *name, const char *signature)
+{
+    if (signature) {
+        const auto it = map.find(std::string(name) + signature);
+        if (it != map.end()) {
+            return it->second;
+        }
+    }
+    const auto it = map.find(name);
+    return it != map.end() ? it->second : nullptr;
+}
+
+void unhandled(const std::string &className, const char *method)
+{
+    if (unhandledCalls.fetch_add(1, std::memory_order_relaxed) < 16 && getenv("FAKEJNI_VERBOSE")) {
+        fprintf(stderr, "FakeJni: unhandled call %s.%s\n", className.c_str(), method);
+    }
+}
+
+// Java semantics for the argument list of a method signature.
+FakeJni::Args readArgs(const char *signature, va_list args)
+{
+    FakeJni::Args values;
+    const char *p = signature ? strchr(signature, '(') : nullptr;
+    if (!p) {
+        return values;
+    }
+    for (++p; *p && *p != ')'; ++p) {
+        bool array = false;
+        while (*p == '[') {
+            array = true;
+            ++p;
+        }
+        if (*p == 'L') {
+            p = strchr(p, ';');
+            if (!p) {
+                break;
+            }
+            array = true;
+        }
+        if (array) {
+            values.push_back(FakeJni::resolve(va_arg(args, jobject)));
+            continue;
+        }
+        switch (*p) {
+        case 'Z':
+        case 'B':
+        case 'C':
+        case 'S':
+        case 'I':
+            values.push_back(jint(va_arg(args, int)));
+            break;
+        case 'J':
+            values.push_back(jlong(va_arg(args, jlong)));
+            break;
+        case 'F':
+            values.push_back(jfloat(va_arg(args, double)));
+            break;
+        case 'D':
+            values.push_back(jdouble(va_arg(args, double)));
+            break;
+        default:
+            break;
+        }
+    }
+    return values;
+}
+
+template<typename T>
+std::shared_ptr<FakeJni::Array<T>> array(jarray handle)
+{
+    return FakeJni::cast<FakeJni::Array<T>>(FakeJni::resolve(handle));
+}
+
+template<typename T>
+void getRegion(jarray handle, jsize start, jsize length, T *buffer)
+{
+    const auto values = array<T>(handle);
+    if (!values || start < 0 || length < 0 || start + length > values->length()) {
+        FakeJni::throwNew("java/lang/ArrayIndexOutOfBoundsException", "get region");
+        return;
+    }
+    memcpy(buffer, values->data.data() + start, size_t(length) * sizeof(T));
+}
+
+template<typename T>
+void setRegion(jarray handle, jsize start, jsize length, const T *buffer)
+{
+    const auto values = array<T>(handle);
+    if (!values || start < 0 || length < 0 || start + length > values->length()) {
+        FakeJni::throwNew("java/lang/ArrayIndexOutOfBoundsException", "set region");
+        return;
+    }
+    memcpy(values->data.data() + start, buffer, size_t(length) * sizeof(T));
+}
+
+}
+
+namespace FakeJni {
+
+Object::Object(std::string className) :
+    mClassName(std::move(className)),
+    mHandle(reinterpret_cast<jobject>(new char))
+{
+    liveObjects.fetch_add(1, std::memory_order_relaxed);
+}
+
+Object::~Object()
+{
+    delete reinterpret_cast<char *>(mHandle);
+    liveObjects.fetch_sub(1, std::memory_order_relaxed);
+}
+
+int64_t Object::liveCount()
+{
+    return liveObjects.load(std::memory_order_relaxed);
+}
+
+String::String(std::string value) :
+    Object("java/lang/String"),
+    value(std::move(value))
+{
+}
+
+std::shared_ptr<ByteArray> newByteArray(size_t length)
+{
+    return std::make_shared<ByteArray>("[B", length);
+}
+
+std::shared_ptr<IntArray> newIntArray(size_t length)
+{
+    return std::make_shared<IntArray>("[I", length);
+}
+
+std::shared_ptr<LongArray> newLongArray(const std::vector<jlong> &values)
+{
+    const auto array = std::make_shared<LongArray>("[J", values.size());
+    array->data = values;
+    return array;
+}
+
+std::shared_ptr<FloatArray> newFloatArray(size_t length)
+{
+    return std::make_shared<FloatArray>("[F", length);
+}
+
+std::shared_ptr<String> newString(const std::string &value)
+{
+    return std::make_shared<String>(value);
+}
+
+void registerClass(const std::string &className, Constructor constructor)
+{
+    auto entry = std::make_shared<Class>();
+    entry->constructor = std::move(constructor);
+    std::lock_guard<std::mutex> lock(classesMutex);
+    classes[className] = entry;
+}
+
+void registerMethod(const std::string &className, const std::string &method, Method implementation)
+{
+    std::lock_guard<std::mutex> lock(classesMutex);
+    auto &entry = classes[className];
+    if (!entry) {
+        entry = std::make_shared<Class>();
+    }
+    entry->methods[method] = std::move(implementation);
+}
+
+void registerStaticMethod(const std::string &className, const std::string &method,
+                          StaticMethod implementation)
+{
+    std::lock_guard<std::mutex> lock(classesMutex);
+    auto &entry = classes[className];
+    if (!entry) {
+        entry = std::make_shared<Class>();
+    }
+    entry->staticMethods[method] = std::move(implementation);
+}
+
+void unregisterClass(const std::string &className)
+{
+    std::lock_guard<std::mutex> lock(classesMutex);
+    classes.erase(className);
+}
+
+ObjectPtr construct(const char *className, const char *signature, const Args &args)
+{
+    calls.fetch_add(1, std::memory_order_relaxed);
+    const auto entry = findClass(className);
+    if (entry && entry->constructor) {
+        return entry->constructor(signature, args);
+    }
+    return std::make_shared<Object>(className);
+}
+
+Value call(Object &self, const char *method, const char *signature, const Args &args)
+{
+    calls.fetch_add(1, std::memory_order_relaxed);
+    const auto entry = findClass(self.className());
+    const Method implementation = entry ? findMethod(entry->methods, method, signature) : nullptr;
+    if (!implementation) {
+        unhandled(self.className(), method);
+        return {};
+    }
+    return implementation(self, args);
+}
+
+Value callStatic(const char *className, const char *method, const char *signature, const Args &args)
+{
+    calls.fetch_add(1, std::memory_order_relaxed);
+    const auto entry = findClass(className);
+    const StaticMethod implementation = entry ? findMethod(entry->staticMethods, method, signature) : nullptr;
+    if (!implementation) {
+        unhandled(className, method);
+        return {};
+    }
+    return implementation(args);
+}
+
+jobject newGlobalRef(const ObjectPtr &object)
+{
+    if (!object) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(referencesMutex);
+    Reference &reference = references[object->handle()];
+    reference.object = object;
+    ++reference.globalRefs;
+    globalRefs.fetch_add(1, std::memory_order_relaxed);
+    return object->handle();
+}
+
+void deleteGlobalRef(jobject handle)
+{
+    if (!handle) {
+        return;
+    }
+    ObjectPtr released;
+    std::lock_guard<std::mutex> lock(referencesMutex);
+    const auto it = references.find(handle);
+    if (it == references.end() || it->second.globalRefs == 0) {
+        staleReferences.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    --it->second.globalRefs;
+    globalRefs.fetch_sub(1, std::memory_order_relaxed);
+    if (it->second.globalRefs == 0 && it->second.localRefs == 0) {
+        // destroyed after the lock is released, destructors may call back
+        released = std::move(it->second.object);
+        references.erase(it);
+    }
+}
+
+jobject newLocalRef(const ObjectPtr &object)
+{
+    if (!object) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(referencesMutex);
+    Reference &reference = references[object->handle()];
+    reference.object = object;
+    ++reference.localRefs;
+    localRefs.fetch_add(1, std::memory_order_relaxed);
+    return object->handle();
+}
+
+void deleteLocalRef(jobject handle)
+{
+    if (!handle) {
+        return;
+    }
+    ObjectPtr released;
+    std::lock_guard<std::mutex> lock(referencesMutex);
+    const auto it = references.find(handle);
+    if (it == references.end() || it->second.localRefs == 0) {
+        staleReferences.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    --it->second.localRefs;
+    localRefs.fetch_sub(1, std::memory_order_relaxed);
+    if (it->second.globalRefs == 0 && it->second.localRefs == 0) {
+        released = std::move(it->second.object);
+        references.erase(it);
+    }
+}
+
+ObjectPtr resolve(jobject handle)
+{
+    if (!handle) {
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(referencesMutex);
+        const auto it = references.find(handle);
+        if (it != references.end()) {
+            return it->second.object;
+        }
+    }
+    {
+        // classes returned by FindClass live as long as the process
+        std::lock_guard<std::mutex> lock(idsMutex);
+        for (const auto &entry : classObjects) {
+            if (entry.second->handle() == handle) {
+                return entry.second;
+            }
+        }
+    }
+    staleReferences.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+void throwNew(const char *className, const std::string &message)
+{
+    exceptions.fetch_add(1, std::memory_order_relaxed);
+    pendingException.pending = true;
+    pendingException.className = className;
+    pendingException.message = message;
+}
+
+bool exceptionPending()
+{
+    return pendingException.pending;
+}
+
+void clearException()
+{
+    pendingException = Pending();
+}
+
+JNIEnv *env()
+{
+    return &threadEnv;
+}
+
+void setSdkVersion(int version)
+{
+    currentSdkVersion.store(version, std::memory_order_relaxed);
+}
+
+int sdkVersion()
+{
+    return currentSdkVersion.load(std::memory_order_relaxed);
+}
+
+Stats stats()
+{
+    Stats stats;
+    stats.globalRefs = globalRefs.load(std::memory_order_relaxed);
+    stats.localRefs = localRefs.load(std::memory_order_relaxed);
+    stats.liveObjects = liveObjects.load(std::memory_order_relaxed);
+    stats.calls = calls.load(std::memory_order_relaxed);
+    stats.unhandledCalls = unhandledCalls.load(std::memory_order_relaxed);
+    stats.staleReferences = staleReferences.load(std::memory_order_relaxed);
+    stats.exceptions = exceptions.load(std::memory_order_relaxed);
+    return stats;
+}
+
+}
+
+jboolean _JNIEnv::ExceptionCheck()
+{
+    return FakeJni::exceptionPending() ? JNI_TRUE : JNI_FALSE;
+}
+
+void _JNIEnv::ExceptionClear()
+{
+    FakeJni::clearException();
+}
+
+jclass _JNIEnv::FindClass(const char *name)
+{
+    std::lock_guard<std::mutex> lock(idsMutex);
+    auto &object = classObjects[name];
+    if (!object) {
+        object = std::make_shared<FakeJni::String>(name);
+    }
+    return static_cast<jclass>(object->handle());
+}
+
+jmethodID _JNIEnv::GetMethodID(jclass, const char *name, const char *signature)
+{
+    std::lock_guard<std::mutex> lock(idsMutex);
+    MethodId &id = methodIds[std::string(name) + signature];
+    id.name = name;
+    id.signature = signature;
+    return reinterpret_cast<jmethodID>(&id);
+}
+
+void _JNIEnv::CallVoidMethod(jobject object, jmethodID method, ...)
+{
+    const auto *id = reinterpret_cast<const MethodId *>(method);
+    const auto self = FakeJni::resolve(object);
+    if (!self || !id) {
+        FakeJni::throwNew("java/lang/NullPointerException", "CallVoidMethod");
+        return;
+    }
+    va_list args;
+    va_start(args, method);
+    const FakeJni::Args values = readArgs(id->signature.c_str(), args);
+    va_end(args);
+    FakeJni::call(*self, id->name.c_str(), id->signature.c_str(), values);
+}
+
+jobject _JNIEnv::NewGlobalRef(jobject object)
+{
+    return FakeJni::newGlobalRef(FakeJni::resolve(object));
+}
+
+void _JNIEnv::DeleteGlobalRef(jobject object)
+{
+    FakeJni::deleteGlobalRef(object);
+}
+
+void _JNIEnv::DeleteLocalRef(jobject object)
+{
+    FakeJni::deleteLocalRef(object);
+}
+
+jsize _JNIEnv::GetArrayLength(jarray handle)
+{
+    const auto object = FakeJni::resolve(handle);
+    if (const auto bytes = FakeJni::cast<FakeJni::ByteArray>(object)) {
+        return bytes->length();
+    }
+    if (const auto ints = FakeJni::cast<FakeJni::IntArray>(object)) {
+        return ints->length();
+    }
+    if (const auto longs = FakeJni::cast<FakeJni::LongArray>(object)) {
+        return longs->length();
+    }
+    if (const auto floats = FakeJni::cast<FakeJni::FloatArray>(object)) {
+        return floats->length();
+    }
+    return 0;
+}
+
+jbyteArray _JNIEnv::NewByteArray(jsize length)
+{
+    return static_cast<jbyteArray>(FakeJni::newLocalRef(FakeJni::newByteArray(size_t(length))));
+}
+
+jintArray _JNIEnv::NewIntArray(jsize length)
+{
+    return static_cast<jintArray>(FakeJni::newLocalRef(FakeJni::newIntArray(size_t(length))));
+}
+
+jlongArray _JNIEnv::NewLongArray(jsize length)
+{
+    return static_cast<jlongArray>(FakeJni::newLocalRef(
+                                       FakeJni::newLongArray(std::vector<jlong>(size_t(length)))));
+}
+
+jfloatArray _JNIEnv::NewFloatArray(jsize length)
+{
+    return static_cast<jfloatArray>(FakeJni::newLocalRef(FakeJni::newFloatArray(size_t(length))));
+}
+
+void _JNIEnv::GetByteArrayRegion(jbyteArray array, jsize start, jsize length, jbyte *buffer)
+{
+    getRegion(array, start, length, buffer);
+}
+
+void _JNIEnv::SetByteArrayRegion(jbyteArray array, jsize start, jsize length, const jbyte *buffer)
+{
+    setRegion(array, start, length, buffer);
+}
+
+void _JNIEnv::GetIntArrayRegion(jintArray array, jsize start, jsize length, jint *buffer)
+{
+    getRegion(array, start, length, buffer);
+}
+
+void _JNIEnv::GetLongArrayRegion(jlongArray array, jsize start, jsize length, jlong *buffer)
+{
+    getRegion(array, start, length, buffer);
+}
+
+void _JNIEnv::SetLongArrayRegion(jlongArray array, jsize start, jsize length, const jlong *buffer)
+{
+    setRegion(array, start, length, buffer);
+}
+
+void _JNIEnv::GetFloatArrayRegion(jfloatArray array, jsize start, jsize length, jfloat *buffer)
+{
+    getRegion(array, start, length, buffer);
+}
+
+void _JNIEnv::SetFloatArrayRegion(jfloatArray array, jsize start, jsize length, const jfloat *buffer)
+{
+    setRegion(array, start, length, buffer);
+}
+
+jfloat *_JNIEnv::GetFloatArrayElements(jfloatArray handle, jboolean *isCopy)
+{
+    const auto values = array<jfloat>(handle);
+    if (isCopy) {
+        *isCopy = JNI_FALSE;
+    }
+    return values ? values->data.data() : nullptr;
+}
+
+void _JNIEnv::ReleaseFloatArrayElements(jfloatArray, jfloat *, jint)
+{
+}
+
+void *_JNIEnv::GetPrimitiveArrayCritical(jarray handle, jboolean *isCopy)
+{
+    if (isCopy) {
+        *isCopy = JNI_FALSE;
+    }
+    if (const auto bytes = array<jbyte>(handle)) {
+        return bytes->data.data();
+    }
+    if (const auto ints = array<jint>(handle)) {
+        return ints->data.data();
+    }
+    if (const auto longs = array<jlong>(handle)) {
+        return longs->data.data();
+    }
+    if (const auto floats = array<jfloat>(handle)) {
+        return floats->data.data();
+    }
+    return nullptr;
+}
+
+void _JNIEnv::ReleasePrimitiveArrayCritical(jarray, void *, jint)
+{
+}
@@ -0,0 +1,194 @@
+#ifndef FAKEJNI_H
+#define FAKEJNI_H
+
+#include <jni.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// In-process stand-in for the Java VM the native player talks to on Android.
+//
+// Objects are C++ instances of FakeJni::Object. Native code only ever sees
+// their handle (the jobject), an opaque address like a JNI reference, which
+// is valid while the object holds JNI references. "Java" code, the simulated
+// backend, holds the objects through shared pointers like Java fields hold
+// references. Every global and local reference is counted so leaks of JNI
+// references show up in tests and soak runs, and a handle used after its
+// last reference was deleted is counted as a stale reference instead of
+// crashing.
+//
+// Classes are registered with their JNI name and dispatch methods by name,
+// optionally refined by signature ("prepare" or "prepare(J)V"). Objects of
+// unknown classes can be created and called; their methods return zero and
+// are counted as unhandled calls, so a new platform call does not need a
+// stand-in before the code calling it can run on the desktop.
+//
+// Exceptions are pending per thread as in JNI: a method throws with
+// throwNew(), the caller sees it through ExceptionCheck().
+namespace FakeJni {
+
+class Object;
+using ObjectPtr = std::shared_ptr<Object>;
+
+// A JNI argument or return value.
+struct Value
+{
+    Value() = default;
+    Value(bool value) : i(value) {}
+    Value(jbyte value) : i(value) {}
+    Value(jboolean value) : i(value) {}
+    Value(jint value) : i(value) {}
+    Value(jlong value) : i(value) {}
+    Value(long long value) : i(jlong(value)) {}
+    Value(unsigned value) : i(value) {}
+    Value(jfloat value) : f(value) {}
+    Value(jdouble value) : f(value) {}
+    Value(ObjectPtr value) : object(std::move(value)) {}
+    template<typename T>
+    Value(std::shared_ptr<T> value) : object(std::move(value)) {}
+    Value(std::nullptr_t) {}
+
+    jlong i = 0;
+    jdouble f = 0;
+    ObjectPtr object;
+};
+using Args = std::vector<Value>;
+
+class Object : public std::enable_shared_from_this<Object>
+{
+public:
+    explicit Object(std::string className);
+    virtual ~Object();
+
+    const std::string &className() const { return mClassName; }
+    jobject handle() const { return mHandle; }
+
+    // Objects alive in the process, referenced or not.
+    static int64_t liveCount();
+
+private:
+    Object(const Object &) = delete;
+    Object &operator=(const Object &) = delete;
+
+    const std::string mClassName;
+    const jobject mHandle;
+};
+
+class String : public Object
+{
+public:
+    explicit String(std::string value);
+
+    const std::string value;
+};
+
+template<typename T>
+class Array : public Object
+{
+public:
+    Array(const char *className, size_t length) :
+        Object(className),
+        data(length)
+    {
+    }
+
+    jsize length() const { return jsize(data.size()); }
+    // Java arrays are not synchronized either, the owner orders the accesses.
+    std::vector<T> data;
+};
+using ByteArray = Array<jbyte>;
+using IntArray = Array<jint>;
+using LongArray = Array<jlong>;
+using FloatArray = Array<jfloat>;
+
+std::shared_ptr<ByteArray> newByteArray(size_t length);
+std::shared_ptr<IntArray> newIntArray(size_t length);
+std::shared_ptr<LongArray> newLongArray(const std::vector<jlong> &values);
+std::shared_ptr<FloatArray> newFloatArray(size_t length);
+std::shared_ptr<String> newString(const std::string &value);
+
+template<typename T>
+std::shared_ptr<T> cast(const ObjectPtr &object)
+{
+    return std::dynamic_pointer_cast<T>(object);
+}
+
+// Classes
+
+using Constructor = std::function<ObjectPtr(const char *signature, const Args &args)>;
+using Method = std::function<Value(Object &self, const Args &args)>;
+using StaticMethod = std::function<Value(const Args &args)>;
+
+// Replaces any previous registration of the class. Without a constructor
+// instances are plain Objects.
+void registerClass(const std::string &className, Constructor constructor = nullptr);
+void registerMethod(const std::string &className, const std::string &method, Method implementation);
+void registerStaticMethod(const std::string &className, const std::string &method,
+                          StaticMethod implementation);
+void unregisterClass(const std::string &className);
+
+ObjectPtr construct(const char *className, const char *signature, const Args &args);
+Value call(Object &self, const char *method, const char *signature, const Args &args);
+Value callStatic(const char *className, const char *method, const char *signature, const Args &args);
+
+// References
+
+jobject newGlobalRef(const ObjectPtr &object);
+void deleteGlobalRef(jobject handle);
+jobject newLocalRef(const ObjectPtr &object);
+void deleteLocalRef(jobject handle);
+// Returns nullptr for a null handle or one without references left.
+ObjectPtr resolve(jobject handle);
+
+// A local reference for the duration of a call into native code, the way
+// the VM frees the references of a native method when it returns.
+class LocalRef
+{
+public:
+    explicit LocalRef(const ObjectPtr &object) : mHandle(object ? newLocalRef(object) : nullptr) {}
+    ~LocalRef() { if (mHandle) deleteLocalRef(mHandle); }
+
+    jobject get() const { return mHandle; }
+    template<typename T>
+    T as() const { return static_cast<T>(mHandle); }
+
+private:
+    LocalRef(const LocalRef &) = delete;
+    LocalRef &operator=(const LocalRef &) = delete;
+
+    const jobject mHandle;
+};
+
+// Exceptions of the calling thread
+
+void throwNew(const char *className, const std::string &message);
+bool exceptionPending();
+void clearException();
+
+// The JNIEnv of the calling thread.
+JNIEnv *env();
+
+// android.os.Build.VERSION.SDK_INT reported to the player.
+void setSdkVersion(int sdkVersion);
+int sdkVersion();
+
+struct Stats
+{
+    int64_t globalRefs = 0;
+    int64_t localRefs = 0;
+    int64_t liveObjects = 0;
+    int64_t calls = 0;
+    int64_t unhandledCalls = 0;
+    int64_t staleReferences = 0;
+    int64_t exceptions = 0;
+};
+Stats stats();
+
+}
+
+#endif // FAKEJNI_H
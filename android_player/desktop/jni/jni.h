@@ -0,0 +1,92 @@
+#ifndef FAKE_JNI_H
+#define FAKE_JNI_H
+
+// Desktop stand-in for the NDK jni.h. Types and names match the real header
+// so the native sources compile unchanged; references and calls are served
+// by FakeJni, see FakeJni.h. Only the JNIEnv functions the player uses exist.
+
+#include <cstdarg>
+#include <cstdint>
+
+typedef uint8_t jboolean;
+typedef int8_t jbyte;
+typedef uint16_t jchar;
+typedef int16_t jshort;
+typedef int32_t jint;
+typedef int64_t jlong;
+typedef float jfloat;
+typedef double jdouble;
+typedef jint jsize;
+
+class _jobject {};
+class _jclass : public _jobject {};
+class _jstring : public _jobject {};
+class _jthrowable : public _jobject {};
+class _jarray : public _jobject {};
+class _jbyteArray : public _jarray {};
+class _jintArray : public _jarray {};
+class _jlongArray : public _jarray {};
+class _jfloatArray : public _jarray {};
+class _jobjectArray : public _jarray {};
+
+typedef _jobject *jobject;
+typedef _jclass *jclass;
+typedef _jstring *jstring;
+typedef _jthrowable *jthrowable;
+typedef _jarray *jarray;
+typedef _jbyteArray *jbyteArray;
+typedef _jintArray *jintArray;
+typedef _jlongArray *jlongArray;
+typedef _jfloatArray *jfloatArray;
+typedef _jobjectArray *jobjectArray;
+
+struct _jmethodID;
+typedef struct _jmethodID *jmethodID;
+
+#define JNI_FALSE 0
+#define JNI_TRUE 1
+#define JNI_OK 0
+#define JNI_ERR (-1)
+#define JNI_COMMIT 1
+#define JNI_ABORT 2
+#define JNI_VERSION_1_6 0x00010006
+
+#define JNIEXPORT __attribute__((visibility("default")))
+#define JNICALL
+
+struct _JNIEnv
+{
+    jboolean ExceptionCheck();
+    void ExceptionClear();
+
+    jclass FindClass(const char *name);
+    jmethodID GetMethodID(jclass clazz, const char *name, const char *signature);
+    void CallVoidMethod(jobject object, jmethodID method, ...);
+
+    jobject NewGlobalRef(jobject object);
+    void DeleteGlobalRef(jobject object);
+    void DeleteLocalRef(jobject object);
+
+    jsize GetArrayLength(jarray array);
+    jbyteArray NewByteArray(jsize length);
+    jintArray NewIntArray(jsize length);
+    jlongArray NewLongArray(jsize length);
+    jfloatArray NewFloatArray(jsize length);
+    void GetByteArrayRegion(jbyteArray array, jsize start, jsize length, jbyte *buffer);
+    void SetByteArrayRegion(jbyteArray array, jsize start, jsize length, const jbyte *buffer);
+    void GetIntArrayRegion(jintArray array, jsize start, jsize length, jint *buffer);
+    void GetLongArrayRegion(jlongArray array, jsize start, jsize length, jlong *buffer);
+    void SetLongArrayRegion(jlongArray array, jsize start, jsize length, const jlong *buffer);
+    void GetFloatArrayRegion(jfloatArray array, jsize start, jsize length, jfloat *buffer);
+    void SetFloatArrayRegion(jfloatArray array, jsize start, jsize length, const jfloat *buffer);
+    jfloat *GetFloatArrayElements(jfloatArray array, jboolean *isCopy);
+    void ReleaseFloatArrayElements(jfloatArray array, jfloat *elements, jint mode);
+    void *GetPrimitiveArrayCritical(jarray array, jboolean *isCopy);
+    void ReleasePrimitiveArrayCritical(jarray array, void *elements, jint mode);
+};
+typedef _JNIEnv JNIEnv;
+
+struct _JavaVM;
+typedef _JavaVM JavaVM;
+
+#endif // FAKE_JNI_H
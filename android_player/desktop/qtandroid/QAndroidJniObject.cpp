@@ -0,0 +1,47 @@
+#include "QAndroidJniObject"
+
+QAndroidJniObject::Ref::Ref(const FakeJni::ObjectPtr &object) :
+    object(object),
+    handle(FakeJni::newGlobalRef(object))
+{
+}
+
+QAndroidJniObject::Ref::~Ref()
+{
+    FakeJni::deleteGlobalRef(handle);
+}
+
+QAndroidJniObject::QAndroidJniObject(const char *className) :
+    QAndroidJniObject(FakeJni::construct(className, "()V", {}))
+{
+}
+
+QAndroidJniObject::QAndroidJniObject(jobject object) :
+    QAndroidJniObject(FakeJni::resolve(object))
+{
+}
+
+QAndroidJniObject::QAndroidJniObject(const FakeJni::ObjectPtr &object) :
+    mRef(object ? std::make_shared<Ref>(object) : nullptr)
+{
+}
+
+QAndroidJniObject QAndroidJniObject::fromString(const QString &string)
+{
+    return QAndroidJniObject(FakeJni::newString(string.toStdString()));
+}
+
+QString QAndroidJniObject::toString() const
+{
+    const auto string = FakeJni::cast<FakeJni::String>(javaObject());
+    return string ? QString::fromStdString(string->value) : QString();
+}
+
+FakeJni::Value QAndroidJniObject::call(const char *method, const char *signature,
+                                       const FakeJni::Args &args) const
+{
+    if (!mRef) {
+        return {};
+    }
+    return FakeJni::call(*mRef->object, method, signature, args);
+}
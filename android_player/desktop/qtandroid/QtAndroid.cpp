@@ -0,0 +1,73 @@
+#include "QtAndroid"
+
+#include "Looper.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+const char *const ACTIVITY_CLASS = "org/qtproject/qt5/android/bindings/QtActivity";
+
+}
+
+namespace QtAndroid {
+
+QAndroidJniObject androidActivity()
+{
+    // never released, it outlives the players using it like the activity
+    static const auto activity = new QAndroidJniObject(ACTIVITY_CLASS);
+    return *activity;
+}
+
+QAndroidJniObject androidContext()
+{
+    return androidActivity();
+}
+
+int androidSdkVersion()
+{
+    return FakeJni::sdkVersion();
+}
+
+void runOnAndroidThread(const Runnable &runnable)
+{
+    androidThread().post(runnable);
+}
+
+void runOnAndroidThreadSync(const Runnable &runnable, int timeoutMs)
+{
+    Looper &looper = androidThread();
+    if (looper.isCurrentThread()) {
+        runnable();
+        return;
+    }
+    // shared, the runnable may still run after a timeout
+    struct Done
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool done = false;
+    };
+    const auto done = std::make_shared<Done>();
+    const bool posted = looper.post([runnable, done] {
+        runnable();
+        std::lock_guard<std::mutex> lock(done->mutex);
+        done->done = true;
+        done->condition.notify_all();
+    });
+    if (!posted) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(done->mutex);
+    done->condition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&done] { return done->done; });
+}
+
+Looper &androidThread()
+{
+    static Looper looper("android-main");
+    return looper;
+}
+
+}
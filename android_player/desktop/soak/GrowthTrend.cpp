@@ -0,0 +1,71 @@
+#include "GrowthTrend.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+
+template<typename Iterator>
+double median(Iterator begin, Iterator end)
+{
+    std::vector<double> values;
+    for (Iterator i = begin; i != end; ++i) {
+        values.push_back(i->y);
+    }
+    const size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    double value = values[middle];
+    if (values.size() % 2 == 0) {
+        value = (value + *std::max_element(values.begin(), values.begin() + middle)) / 2;
+    }
+    return value;
+}
+
+}
+
+GrowthTrend::GrowthTrend(std::string name, double absoluteAllowance, double relativeAllowance) :
+    mName(std::move(name)),
+    mAbsoluteAllowance(absoluteAllowance),
+    mRelativeAllowance(relativeAllowance)
+{
+}
+
+void GrowthTrend::add(double x, double y)
+{
+    mSamples.push_back({x, y});
+}
+
+GrowthTrend::Result GrowthTrend::result() const
+{
+    Result result;
+    const auto begin = mSamples.begin() + std::ptrdiff_t(double(mSamples.size()) * WARMUP_FRACTION);
+    const auto end = mSamples.end();
+    const std::ptrdiff_t count = end - begin;
+    if (count < MIN_SAMPLES) {
+        return result;
+    }
+
+    double meanX = 0;
+    double meanY = 0;
+    for (auto i = begin; i != end; ++i) {
+        meanX += i->x;
+        meanY += i->y;
+    }
+    meanX /= double(count);
+    meanY /= double(count);
+    double covariance = 0;
+    double variance = 0;
+    for (auto i = begin; i != end; ++i) {
+        covariance += (i->x - meanX) * (i->y - meanY);
+        variance += (i->x - meanX) * (i->x - meanX);
+    }
+    result.slope = variance > 0 ? covariance / variance : 0;
+
+    const std::ptrdiff_t third = count / 3;
+    result.firstMedian = median(begin, begin + third);
+    result.lastMedian = median(end - third, end);
+    const double allowance = mAbsoluteAllowance + mRelativeAllowance * std::fabs(result.firstMedian);
+    result.growing = result.lastMedian - result.firstMedian > allowance && result.slope > 0;
+    return result;
+}
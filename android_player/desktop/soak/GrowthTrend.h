@@ -0,0 +1,54 @@
+#ifndef GROWTHTREND_H
+#define GROWTHTREND_H
+
+#include <string>
+#include <vector>
+
+// Decides whether a quantity sampled over a soak run keeps growing: a leak
+// shows as a steady rise, a cache filling up as a step at the start and
+// noise as neither.
+//
+// The first WARMUP_FRACTION of the samples is left out, the rest is split in
+// thirds. The series grows when the median of the last third exceeds the
+// median of the first by more than the allowance, absolute plus relative to
+// the first median, and the least-squares slope over the samples agrees. The
+// medians keep single outliers (a GC-like pause, a page the allocator keeps)
+// from deciding, the slope a series that went up and back down.
+class GrowthTrend
+{
+public:
+    struct Result
+    {
+        // per unit of x, least squares
+        double slope = 0;
+        double firstMedian = 0;
+        double lastMedian = 0;
+        bool growing = false;
+    };
+
+    static constexpr double WARMUP_FRACTION = 0.1;
+    // fewer samples than this after the warmup never grow
+    static constexpr int MIN_SAMPLES = 9;
+
+    GrowthTrend(std::string name, double absoluteAllowance, double relativeAllowance);
+
+    void add(double x, double y);
+
+    const std::string &name() const { return mName; }
+    int size() const { return int(mSamples.size()); }
+    Result result() const;
+
+private:
+    struct Sample
+    {
+        double x;
+        double y;
+    };
+
+    std::string mName;
+    double mAbsoluteAllowance;
+    double mRelativeAllowance;
+    std::vector<Sample> mSamples;
+};
+
+#endif // GROWTHTREND_H
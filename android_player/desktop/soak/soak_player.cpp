@@ -0,0 +1,224 @@
+// Soak driver: runs the playlist loop of client/main.qml, which reinitializes
+// the backend on every completion like the kiosks do for weeks, for tens of
+// thousands of cycles on the simulated backend and watches what a leak or a
+// slowdown would show in:
+//
+//  - rss: resident set of the process in bytes;
+//  - globalRefs, javaObjects: JNI global references and live Java objects of
+//    FakeJni;
+//  - qtObjects: live QObjects, counted through the QHooks GammaRay uses;
+//  - switchMs: median time from a completion to the next media prepared over
+//    the cycles since the last sample.
+//
+// Every sample is taken at the same point of a cycle, the next media just
+// prepared, and printed as a CSV line. At the end each series goes through
+// GrowthTrend and the driver exits non-zero if one keeps growing or the loop
+// stalls.
+//
+//   soak_player [--cycles N] [--sample-every N] [--quick]
+//
+// --quick runs a few hundred cycles so ctest can check the driver still
+// works; the trends are printed but too short to fail on. The soak target
+// runs the full count.
+
+#include "AndroidMediaPlayer.h"
+#include "FakeJni.h"
+#include "GrowthTrend.h"
+#include "SimulatedBackend.h"
+
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QTimer>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <unistd.h>
+#include <vector>
+
+// QHooks, see private/qhooks_p.h
+extern Q_CORE_EXPORT quintptr qtHookData[];
+
+namespace {
+
+const int DEFAULT_CYCLES = 20000;
+const int QUICK_CYCLES = 300;
+const int DEFAULT_SAMPLE_EVERY = 100;
+const int QUICK_SAMPLE_EVERY = 10;
+// no completion for this long is a stall
+const int STALL_MS = 10000;
+// short media with the timings of local files, in playlist order
+const char *const PLAYLIST[] = {
+    "sim:40?prepare=5",
+    "sim:60?prepare=15&fps=25",
+    "sim:50?prepare=10&width=1920&height=1080",
+};
+
+// qtHookData indices
+const int ADD_QOBJECT_HOOK = 3;
+const int REMOVE_QOBJECT_HOOK = 4;
+
+using QObjectHook = void (*)(QObject *);
+
+std::atomic<qint64> liveQObjects{0};
+QObjectHook nextAddHook = nullptr;
+QObjectHook nextRemoveHook = nullptr;
+
+void addQObject(QObject *object)
+{
+    ++liveQObjects;
+    if (nextAddHook) {
+        nextAddHook(object);
+    }
+}
+
+void removeQObject(QObject *object)
+{
+    --liveQObjects;
+    if (nextRemoveHook) {
+        nextRemoveHook(object);
+    }
+}
+
+// Counts QObjects created from now on, before the application object.
+void installQObjectHooks()
+{
+    nextAddHook = reinterpret_cast<QObjectHook>(qtHookData[ADD_QOBJECT_HOOK]);
+    nextRemoveHook = reinterpret_cast<QObjectHook>(qtHookData[REMOVE_QOBJECT_HOOK]);
+    qtHookData[ADD_QOBJECT_HOOK] = reinterpret_cast<quintptr>(&addQObject);
+    qtHookData[REMOVE_QOBJECT_HOOK] = reinterpret_cast<quintptr>(&removeQObject);
+}
+
+qint64 residentBytes()
+{
+    long pages = 0;
+    long resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (!statm) {
+        return 0;
+    }
+    if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(statm);
+    return qint64(resident) * sysconf(_SC_PAGESIZE);
+}
+
+double median(std::vector<double> values)
+{
+    if (values.empty()) {
+        return 0;
+    }
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    int cycles = DEFAULT_CYCLES;
+    int sampleEvery = DEFAULT_SAMPLE_EVERY;
+    bool quick = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--quick")) {
+            quick = true;
+            cycles = QUICK_CYCLES;
+            sampleEvery = QUICK_SAMPLE_EVERY;
+        } else if (!strcmp(argv[i], "--cycles") && i + 1 < argc) {
+            cycles = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--sample-every") && i + 1 < argc) {
+            sampleEvery = std::max(1, atoi(argv[++i]));
+        }
+    }
+
+    installQObjectHooks();
+    QGuiApplication app(argc, argv);
+    SimulatedBackend::install();
+
+    // allowances: RSS moves with the allocator, the counts are exact and the
+    // latency is as noisy as the machine
+    GrowthTrend rss("rss", 4 << 20, 0.05);
+    GrowthTrend globalRefs("globalRefs", 0.5, 0);
+    GrowthTrend javaObjects("javaObjects", 0.5, 0);
+    GrowthTrend qtObjects("qtObjects", 0.5, 0);
+    GrowthTrend switchMs("switchMs", 2, 0.5);
+    GrowthTrend *const trends[] = {&rss, &globalRefs, &javaObjects, &qtObjects, &switchMs};
+
+    AndroidMediaPlayer player;
+    int cycle = 0;
+    int index = 0;
+    bool stalled = false;
+    QElapsedTimer sinceCompletion;
+    std::vector<double> switchTimes;
+    QTimer stall;
+    stall.setSingleShot(true);
+    stall.setInterval(STALL_MS);
+    QObject::connect(&stall, &QTimer::timeout, [&] {
+        fprintf(stderr, "soak_player: no completion for %d ms at cycle %d\n", STALL_MS, cycle);
+        stalled = true;
+        app.quit();
+    });
+
+    printf("cycle,rss,globalRefs,javaObjects,qtObjects,switchMs\n");
+    QObject::connect(&player, &AndroidMediaPlayer::playbackStateChanged, [&](AndroidMediaPlayer::PlaybackState state) {
+        switch (state) {
+        case AndroidMediaPlayer::PlaybackState::Prepared:
+            if (sinceCompletion.isValid()) {
+                switchTimes.push_back(double(sinceCompletion.nsecsElapsed()) / 1e6);
+            }
+            if (cycle % sampleEvery == 0) {
+                const FakeJni::Stats jni = FakeJni::stats();
+                const double values[] = {double(residentBytes()), double(jni.globalRefs), double(jni.liveObjects),
+                                         double(liveQObjects.load()), median(switchTimes)};
+                printf("%d", cycle);
+                for (size_t i = 0; i < std::size(trends); ++i) {
+                    trends[i]->add(cycle, values[i]);
+                    printf(",%.6g", values[i]);
+                }
+                printf("\n");
+                fflush(stdout);
+                switchTimes.clear();
+            }
+            player.start();
+            break;
+        case AndroidMediaPlayer::PlaybackState::PlaybackCompleted:
+            sinceCompletion.start();
+            stall.start();
+            if (++cycle == cycles) {
+                app.quit();
+                break;
+            }
+            index = (index + 1) % int(std::size(PLAYLIST));
+            player.stop();
+            player.reset();
+            player.setDataSource(PLAYLIST[index], true);
+            break;
+        case AndroidMediaPlayer::PlaybackState::Error:
+            fprintf(stderr, "soak_player: playback error at cycle %d\n", cycle);
+            stalled = true;
+            app.quit();
+            break;
+        default:
+            break;
+        }
+    });
+    player.setDataSource(PLAYLIST[index]);
+    stall.start();
+    app.exec();
+
+    bool growing = false;
+    fprintf(stderr, "soak_player: %d cycles\n", cycle);
+    for (const GrowthTrend *trend : trends) {
+        const GrowthTrend::Result result = trend->result();
+        fprintf(stderr, "  %-12s %14.6g -> %-14.6g %+.4g per 1000 cycles%s\n", trend->name().c_str(),
+                result.firstMedian, result.lastMedian, result.slope * 1000, result.growing ? "  GROWING" : "");
+        growing = growing || result.growing;
+    }
+    if (quick) {
+        return stalled ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    return stalled || growing ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+// Minimal assertions for the tests that run without Qt. A failed check is
+// reported and the test goes on, the process exits non-zero at the end.
+namespace Check {
+
+inline int &failures()
+{
+    static int count = 0;
+    return count;
+}
+
+inline void fail(const char *file, int line, const std::string &message)
+{
+    ++failures();
+    fprintf(stderr, "%s:%d: FAIL: %s\n", file, line, message.c_str());
+}
+
+template<typename A, typename B>
+void compare(const char *file, int line, const char *expression, const A &actual, const B &expected, bool equal)
+{
+    if (equal) {
+        return;
+    }
+    std::ostringstream message;
+    message << expression << " (actual " << actual << ", expected " << expected << ")";
+    fail(file, line, message.str());
+}
+
+inline int result(const char *name)
+{
+    if (failures()) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, failures());
+        return EXIT_FAILURE;
+    }
+    printf("%s: passed\n", name);
+    return EXIT_SUCCESS;
+}
+
+}
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) \
+            Check::fail(__FILE__, __LINE__, #condition); \
+    } while (false)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        const auto check_actual = (actual); \
+        const auto check_expected = (expected); \
+        Check::compare(__FILE__, __LINE__, #actual " == " #expected, check_actual, check_expected, \
+                       check_actual == check_expected); \
+    } while (false)
+
+// |actual - expected| <= tolerance
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { \
+        const double check_actual = double(actual); \
+        const double check_expected = double(expected); \
+        Check::compare(__FILE__, __LINE__, #actual " ~ " #expected, check_actual, check_expected, \
+                       check_actual - check_expected <= double(tolerance) \
+                       && check_expected - check_actual <= double(tolerance)); \
+    } while (false)
+
+#endif // CHECK_H
@@ -0,0 +1,153 @@
+#include "EventReplay.h"
+#include "AndroidMediaPlayer.h"
+#include "com_vadim_android_NativeMediaPlayerEventListener.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+
+#include <cstring>
+
+namespace {
+
+const char LOG_MAGIC[8] = {'P', 'L', 'E', 'V', 'L', 'O', 'G', '1'};
+const quint32 RECORD_SIZE = 24;
+// the event loop runs this often while waiting for the next event
+const qint64 POLL_US = 500;
+
+template<typename T>
+bool readValue(QFile &file, T *value)
+{
+    return file.read(reinterpret_cast<char *>(value), sizeof(T)) == qint64(sizeof(T));
+}
+
+void deliver(const EventLog::Record &record, AndroidMediaPlayer *target)
+{
+    const jlong handle = jlong(target);
+    switch (record.code) {
+    case EventRecorder::Started:
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onStarted(nullptr, nullptr, handle);
+        break;
+    case EventRecorder::Finished:
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onFinished(nullptr, nullptr, handle);
+        break;
+    case EventRecorder::Error:
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onError(nullptr, nullptr, handle,
+                                                                       jint(record.arg0), jint(record.arg1));
+        break;
+    case EventRecorder::Buffering:
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onBuffering(nullptr, nullptr, handle,
+                                                                           jboolean(record.arg0 != 0));
+        break;
+    case EventRecorder::BufferingUpdate:
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onBufferingUpdate(nullptr, nullptr, handle,
+                                                                                 jint(record.arg0));
+        break;
+    case EventRecorder::Pause:
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onPause(nullptr, nullptr, handle);
+        break;
+    case EventRecorder::Prepared:
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onPrepared(nullptr, nullptr, handle);
+        break;
+    case EventRecorder::SeekComplete:
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onSeekComplete(nullptr, nullptr, handle);
+        break;
+    case EventRecorder::NextPartStarted:
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onNextPartStarted(nullptr, nullptr, handle);
+        break;
+    case EventRecorder::Suspended:
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onSuspended(nullptr, nullptr, handle,
+                                                                           jboolean(record.arg0 != 0));
+        break;
+    case EventRecorder::VideoSizeChanged:
+        Java_com_vadim_android_NativeMediaPlayerEventListener_onVideoSizeChanged(nullptr, nullptr, handle,
+                                                                                  jint(record.arg0),
+                                                                                  jint(record.arg1));
+        break;
+    }
+}
+
+}
+
+bool EventLog::load(const QString &path)
+{
+    mRecords.clear();
+    mCommands.clear();
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    char magic[sizeof(LOG_MAGIC)];
+    quint32 recordSize = 0;
+    quint32 commandCount = 0;
+    if (file.read(magic, sizeof(magic)) != qint64(sizeof(magic)) || memcmp(magic, LOG_MAGIC, sizeof(magic)) != 0
+            || !readValue(file, &recordSize) || recordSize != RECORD_SIZE || !readValue(file, &commandCount)) {
+        return false;
+    }
+    for (quint32 i = 0; i < commandCount; ++i) {
+        QByteArray name;
+        char c = 0;
+        while (file.getChar(&c) && c) {
+            name += c;
+        }
+        if (c) {
+            return false;
+        }
+        mCommands.append(QString::fromLatin1(name));
+    }
+    Record record;
+    while (readValue(file, &record.timestampUs) && readValue(file, &record.arg0) && readValue(file, &record.arg1)
+           && readValue(file, &record.player) && readValue(file, &record.kind) && readValue(file, &record.code)) {
+        mRecords.append(record);
+    }
+    return true;
+}
+
+const QVector<EventLog::Record> &EventLog::records() const
+{
+    return mRecords;
+}
+
+const QStringList &EventLog::commands() const
+{
+    return mCommands;
+}
+
+QVector<EventLog::Record> EventLog::player(quint16 player) const
+{
+    QVector<Record> records;
+    for (const Record &record : mRecords) {
+        if (record.player == player) {
+            records.append(record);
+        }
+    }
+    return records;
+}
+
+QVector<qint64> replay(const QVector<EventLog::Record> &records, AndroidMediaPlayer *target, double speed)
+{
+    QVector<qint64> lateness;
+    qint64 firstUs = -1;
+    QElapsedTimer clock;
+    for (const EventLog::Record &record : records) {
+        if (record.kind != EventRecorder::Inbound || record.code == EventRecorder::SurfaceChanged) {
+            continue;
+        }
+        if (firstUs < 0) {
+            firstUs = record.timestampUs;
+            clock.start();
+        }
+        const qint64 dueUs = speed > 0 ? qint64(double(record.timestampUs - firstUs) / speed) : 0;
+        for (qint64 leftUs = dueUs - clock.nsecsElapsed() / 1000; leftUs > 0;
+             leftUs = dueUs - clock.nsecsElapsed() / 1000) {
+            // the player's timers run in the meantime
+            QCoreApplication::processEvents();
+            QThread::usleep(ulong(qMin(leftUs, POLL_US)));
+        }
+        deliver(record, target);
+        QCoreApplication::sendPostedEvents(target);
+        lateness.append(clock.nsecsElapsed() / 1000 - dueUs);
+    }
+    return lateness;
+}
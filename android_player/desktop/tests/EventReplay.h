@@ -0,0 +1,52 @@
+#ifndef EVENTREPLAY_H
+#define EVENTREPLAY_H
+
+#include "EventRecorder.h"
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class AndroidMediaPlayer;
+
+// A log written by EventRecorder, see there for the format.
+class EventLog
+{
+public:
+    struct Record
+    {
+        qint64 timestampUs;
+        qint64 arg0;
+        qint32 arg1;
+        quint16 player;
+        quint8 kind;
+        quint8 code;
+    };
+
+    // Returns false if the file can't be read or is not a log, a record cut
+    // short at the end is dropped.
+    bool load(const QString &path);
+
+    const QVector<Record> &records() const;
+    // The command names in code order.
+    const QStringList &commands() const;
+    // The records of one player.
+    QVector<Record> player(quint16 player) const;
+
+private:
+    QVector<Record> mRecords;
+    QStringList mCommands;
+};
+
+// Plays the MediaPlayer events of a recorded player back into target through
+// the NativeMediaPlayerEventListener entry points, like the Java listener
+// delivers them, and runs the event loop in between. Each event is delivered
+// at its recorded time from the first event divided by speed, or right away
+// with speed 0. SurfaceChanged comes from the surface view, not MediaPlayer,
+// and is skipped.
+//
+// Returns how late each event was dispatched to target in us, in the order
+// of the events.
+QVector<qint64> replay(const QVector<EventLog::Record> &records, AndroidMediaPlayer *target, double speed);
+
+#endif // EVENTREPLAY_H
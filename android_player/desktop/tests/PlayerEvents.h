@@ -0,0 +1,126 @@
+#ifndef PLAYEREVENTS_H
+#define PLAYEREVENTS_H
+
+#include "SimulatedMediaPlayer.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Records the callbacks of a SimulatedMediaPlayer as strings such as
+// "prepared" or "error(1,-1004)" and lets a test wait for them.
+class PlayerEvents : public SimulatedMediaPlayer::Listener
+{
+public:
+    void onVideoSizeChanged(int width, int height) override
+    {
+        add("videoSize(" + std::to_string(width) + "x" + std::to_string(height) + ")");
+    }
+    void onStarted() override { add("started"); }
+    void onFinished() override { add("finished"); }
+    void onError(int what, int extra) override
+    {
+        add("error(" + std::to_string(what) + "," + std::to_string(extra) + ")");
+    }
+    void onBuffering(bool state) override { add(state ? "buffering" : "buffered"); }
+    void onBufferingUpdate(int percent) override
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mLastPercent = percent;
+        ++mBufferingUpdates;
+    }
+    void onPause() override { add("pause"); }
+    void onPrepared() override { add("prepared"); }
+    void onSeekComplete() override { add("seekComplete"); }
+    void onNextPartStarted() override { add("nextPart"); }
+    void onSuspended(bool suspended) override { add(suspended ? "suspended" : "resumed"); }
+
+    // Waits until event occurred count times in total.
+    bool waitFor(const std::string &event, int count = 1, int timeoutMs = 5000)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        return mChanged.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] {
+            return countLocked(event) >= count;
+        });
+    }
+
+    int count(const std::string &event) const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return countLocked(event);
+    }
+
+    std::vector<std::string> events() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mEvents;
+    }
+
+    int lastPercent() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mLastPercent;
+    }
+
+    int bufferingUpdates() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mBufferingUpdates;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mEvents.clear();
+    }
+
+private:
+    void add(const std::string &event)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mEvents.push_back(event);
+        }
+        mChanged.notify_all();
+    }
+
+    int countLocked(const std::string &event) const
+    {
+        int count = 0;
+        for (const std::string &recorded : mEvents) {
+            count += recorded == event ? 1 : 0;
+        }
+        return count;
+    }
+
+    mutable std::mutex mMutex;
+    std::condition_variable mChanged;
+    std::vector<std::string> mEvents;
+    int mLastPercent = -1;
+    int mBufferingUpdates = 0;
+};
+
+// Collects the frames a player posts.
+class FrameLog : public SimulatedMediaPlayer::Surface
+{
+public:
+    void post(const SimulatedMediaPlayer::Frame &frame) override
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFrames.push_back(frame);
+    }
+
+    std::vector<SimulatedMediaPlayer::Frame> frames() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mFrames;
+    }
+
+private:
+    mutable std::mutex mMutex;
+    std::vector<SimulatedMediaPlayer::Frame> mFrames;
+};
+
+#endif // PLAYEREVENTS_H
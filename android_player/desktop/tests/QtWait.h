@@ -0,0 +1,33 @@
+#ifndef QTWAIT_H
+#define QTWAIT_H
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThread>
+
+#include <functional>
+
+// Runs the event loop of the calling thread until condition holds. Returns
+// false if it still doesn't after timeoutMs.
+inline bool waitUntil(const std::function<bool()> &condition, int timeoutMs = 5000)
+{
+    QElapsedTimer clock;
+    clock.start();
+    while (!condition()) {
+        if (clock.elapsed() > timeoutMs) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 5);
+        QCoreApplication::sendPostedEvents();
+        QThread::usleep(200);
+    }
+    return true;
+}
+
+// Runs the event loop for ms.
+inline void runEventsFor(int ms)
+{
+    waitUntil([] { return false; }, ms);
+}
+
+#endif // QTWAIT_H
@@ -0,0 +1,133 @@
+#include "RenderHarness.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions>
+#include <QQuickItem>
+#include <QQuickWindow>
+
+namespace {
+
+// the stats of the frame being rendered, the renderer logs on the calling
+// thread
+RenderHarness::FrameStats *countedFrame = nullptr;
+QtMessageHandler previousHandler = nullptr;
+
+// Counts the batch lines of QSG_RENDERER_DEBUG=render: one per batch, a
+// merged batch is one draw call, an unmerged one a draw call per node.
+void countBatches(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    const bool merged = message.contains(QLatin1String("[  merged]"));
+    if (!countedFrame || (!merged && !message.contains(QLatin1String("[unmerged]")))) {
+        previousHandler(type, context, message);
+        return;
+    }
+    ++countedFrame->batches;
+    if (merged) {
+        ++countedFrame->drawCalls;
+        return;
+    }
+    const int nodes = message.indexOf(QLatin1String("Nodes:"));
+    countedFrame->drawCalls += message.mid(nodes + 6).trimmed().section(QLatin1Char(' '), 0, 0).toInt();
+}
+
+bool countsBatches()
+{
+    static const bool counts = qgetenv("QSG_RENDERER_DEBUG").contains("render");
+    return counts;
+}
+
+}
+
+RenderHarness::RenderHarness(const QSize &size) :
+    mSize(size),
+    mValid(false)
+{
+    if (!mContext.create()) {
+        return;
+    }
+    mSurface.setFormat(mContext.format());
+    mSurface.create();
+    if (!mContext.makeCurrent(&mSurface)) {
+        return;
+    }
+    mWindow.reset(new QQuickWindow(&mControl));
+    mControl.initialize(&mContext);
+    mFbo.reset(new QOpenGLFramebufferObject(size, QOpenGLFramebufferObject::CombinedDepthStencil));
+    mWindow->setRenderTarget(mFbo.get());
+    mWindow->setGeometry(0, 0, size.width(), size.height());
+    mWindow->contentItem()->setSize(size);
+    mValid = true;
+}
+
+RenderHarness::~RenderHarness()
+{
+    if (mValid) {
+        // the scene graph is released with the context current
+        mContext.makeCurrent(&mSurface);
+        mControl.invalidate();
+        mWindow.reset();
+        mFbo.reset();
+        mContext.doneCurrent();
+    }
+}
+
+bool RenderHarness::isValid() const
+{
+    return mValid;
+}
+
+QQuickWindow *RenderHarness::window() const
+{
+    return mWindow.get();
+}
+
+QQuickItem *RenderHarness::contentItem() const
+{
+    return mWindow ? mWindow->contentItem() : nullptr;
+}
+
+QSize RenderHarness::size() const
+{
+    return mSize;
+}
+
+void RenderHarness::renderFrame()
+{
+    QCoreApplication::sendPostedEvents();
+    mContext.makeCurrent(&mSurface);
+    mControl.polishItems();
+
+    mLastFrame = FrameStats();
+    if (countsBatches()) {
+        mLastFrame.batches = 0;
+        mLastFrame.drawCalls = 0;
+        countedFrame = &mLastFrame;
+        previousHandler = qInstallMessageHandler(countBatches);
+    }
+    QElapsedTimer timer;
+    timer.start();
+    mControl.sync();
+    mLastFrame.syncNs = timer.nsecsElapsed();
+    mControl.render();
+    mContext.functions()->glFinish();
+    mLastFrame.renderNs = timer.nsecsElapsed() - mLastFrame.syncNs;
+    // there is no swap, the frame is done
+    emit mWindow->frameSwapped();
+    if (countedFrame) {
+        qInstallMessageHandler(previousHandler);
+        countedFrame = nullptr;
+    }
+}
+
+const RenderHarness::FrameStats &RenderHarness::lastFrame() const
+{
+    return mLastFrame;
+}
+
+QImage RenderHarness::grab()
+{
+    mContext.makeCurrent(&mSurface);
+    return mFbo->toImage();
+}
@@ -0,0 +1,68 @@
+#ifndef RENDERHARNESS_H
+#define RENDERHARNESS_H
+
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QQuickRenderControl>
+#include <QSize>
+
+#include <memory>
+
+class QOpenGLFramebufferObject;
+class QQuickItem;
+class QQuickWindow;
+
+// Renders a Qt Quick scene into a framebuffer object through
+// QQuickRenderControl on the calling thread, which is the GUI and the render
+// thread at once. Frames are rendered on request only, so benches time the
+// scene graph work of a frame without the vsync of a real window.
+//
+// With QSG_RENDERER_DEBUG=render in the environment before the first frame
+// of the process, the batch renderer logs every batch it draws; the harness
+// takes those lines out of the log and counts them in FrameStats.
+class RenderHarness
+{
+public:
+    struct FrameStats
+    {
+        // what the render thread does for the frame: sync, and render up to
+        // the GPU being done
+        qint64 syncNs = 0;
+        qint64 renderNs = 0;
+        // -1 without QSG_RENDERER_DEBUG=render
+        int batches = -1;
+        int drawCalls = -1;
+    };
+
+    explicit RenderHarness(const QSize &size);
+    ~RenderHarness();
+
+    // False without an OpenGL context, e.g. on a headless machine without Mesa.
+    bool isValid() const;
+    QQuickWindow *window() const;
+    QQuickItem *contentItem() const;
+    QSize size() const;
+
+    // Delivers the posted events (frameAvailable, update requests), then
+    // polishes, syncs and renders one frame and waits for the GPU. The window
+    // emits afterRendering and then frameSwapped like a render loop's does.
+    void renderFrame();
+    // The last frame rendered.
+    QImage grab();
+    const FrameStats &lastFrame() const;
+
+private:
+    Q_DISABLE_COPY(RenderHarness)
+
+    const QSize mSize;
+    QOpenGLContext mContext;
+    QOffscreenSurface mSurface;
+    QQuickRenderControl mControl;
+    std::unique_ptr<QQuickWindow> mWindow;
+    std::unique_ptr<QOpenGLFramebufferObject> mFbo;
+    bool mValid;
+    FrameStats mLastFrame;
+};
+
+#endif // RENDERHARNESS_H
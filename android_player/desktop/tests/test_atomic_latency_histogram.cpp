@@ -0,0 +1,89 @@
+// AtomicLatencyHistogram: every value lands in the bucket that covers it, the
+// buckets are at most 1/SubBuckets of their values wide and records from
+// several threads at once are all counted.
+
+#include "AtomicLatencyHistogram.h"
+#include "Check.h"
+
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const int THREADS = 8;
+const int RECORDS_PER_THREAD = 100000;
+
+void testBuckets()
+{
+    using Histogram = AtomicLatencyHistogram;
+    for (int i = 0; i < Histogram::BucketCount - 1; ++i) {
+        const qint64 lower = Histogram::bucketLowerBound(i);
+        const qint64 upper = Histogram::bucketUpperBound(i);
+        CHECK(lower < upper);
+        CHECK_EQ(Histogram::bucketIndex(lower), i);
+        CHECK_EQ(Histogram::bucketIndex(upper - 1), i);
+        CHECK((upper - lower) * Histogram::SubBuckets <= qMax<qint64>(lower, 2 * Histogram::SubBuckets));
+    }
+    CHECK_EQ(Histogram::bucketIndex(-5), 0);
+    CHECK_EQ(Histogram::bucketIndex(qint64(1) << Histogram::MaxExponent), Histogram::BucketCount - 1);
+    CHECK_EQ(Histogram::bucketIndex(std::numeric_limits<qint64>::max()), Histogram::BucketCount - 1);
+}
+
+void testPercentiles()
+{
+    AtomicLatencyHistogram histogram;
+    CHECK_EQ(histogram.percentile(50), qint64(0));
+    for (qint64 us = 1; us <= 10000; ++us) {
+        histogram.record(us);
+    }
+    CHECK_EQ(histogram.count(), quint64(10000));
+    CHECK_EQ(histogram.max(), qint64(10000));
+    CHECK_NEAR(histogram.mean(), 5000.5, 1e-9);
+    // within a sub-bucket of the exact value
+    CHECK_NEAR(double(histogram.percentile(50)), 5000.0, 5000.0 / AtomicLatencyHistogram::SubBuckets);
+    CHECK_NEAR(double(histogram.percentile(99)), 9900.0, 9900.0 / AtomicLatencyHistogram::SubBuckets);
+    CHECK_EQ(histogram.percentile(100), qint64(10000));
+    histogram.clear();
+    CHECK_EQ(histogram.count(), quint64(0));
+    CHECK_EQ(histogram.percentile(99), qint64(0));
+}
+
+void testConcurrentRecords()
+{
+    AtomicLatencyHistogram histogram;
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < THREADS; ++thread) {
+        threads.emplace_back([&histogram, thread] {
+            std::mt19937 random(thread);
+            for (int i = 0; i < RECORDS_PER_THREAD; ++i) {
+                histogram.record(qint64(random() % 100000));
+            }
+        });
+    }
+    // readers run next to the writers
+    for (int i = 0; i < 100; ++i) {
+        CHECK(histogram.percentile(50) <= histogram.percentile(99) || histogram.count() < quint64(THREADS));
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    quint64 total = 0;
+    for (int i = 0; i < AtomicLatencyHistogram::BucketCount; ++i) {
+        total += histogram.bucket(i);
+    }
+    CHECK_EQ(histogram.count(), quint64(THREADS * RECORDS_PER_THREAD));
+    CHECK_EQ(total, histogram.count());
+    CHECK(histogram.max() < 100000);
+}
+
+}
+
+int main()
+{
+    testBuckets();
+    testPercentiles();
+    testConcurrentRecords();
+    return Check::result("test_atomic_latency_histogram");
+}
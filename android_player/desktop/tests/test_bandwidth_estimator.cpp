@@ -0,0 +1,255 @@
+// Replays buffering traces through BandwidthEstimator and checks its stall
+// predictions against the stall the trace actually leads to.
+//
+// A trace in traces/ is the onBufferingUpdate sequence of one playback:
+//
+//   # comment
+//   duration <ms>          media duration
+//   rate <x>               playback rate
+//   expect stall|none      whether playback at that rate runs dry
+//   <ms> <percent>         ms since prepare, buffered percent of the duration
+//
+// Playback starts once START_BUFFER_MS are buffered and the position then
+// moves at the playback rate, so the stall time follows from the trace.
+//
+// The synthetic_*.trace files are hand-written, not recorded, shaped after
+// field behavior: steady downloads above and below the playback rate, a drop
+// to a weak link and on/off delivery. Recordings in the same format can be
+// dropped into traces/ next to them.
+//
+// Predictions are checked at every sample and halfway to the next one, where
+// the estimator has to account for the time since the last sample.
+
+#include "BandwidthEstimator.h"
+#include "Check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+
+namespace {
+
+const char *const TRACE_DIR = "traces";
+const int64_t START_BUFFER_MS = 10000;
+// predictions right after the start follow a single sample
+const int64_t WARMUP_MS = 5000;
+// a stall must be predicted this long before it happens, to within half the
+// time left and a second or two for the whole percents
+const int64_t WARNING_MS = 30000;
+const int64_t SLACK_MS = 2000;
+// a prediction of a stall that does not happen must be further out than this
+const int64_t FALSE_ALARM_MS = 10000;
+
+struct Sample
+{
+    int64_t timeMs;
+    int64_t bufferedMs;
+};
+
+struct Trace
+{
+    std::string name;
+    int64_t durationMs = 0;
+    double rate = 1.0;
+    bool stalls = false;
+    std::vector<Sample> samples;
+};
+
+bool load(const std::string &name, Trace *trace)
+{
+    std::ifstream file(std::string(TRACE_DIR) + "/" + name);
+    if (!file) {
+        return false;
+    }
+    trace->name = name;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+        if (key == "duration") {
+            fields >> trace->durationMs;
+        } else if (key == "rate") {
+            fields >> trace->rate;
+        } else if (key == "expect") {
+            std::string expect;
+            fields >> expect;
+            trace->stalls = expect == "stall";
+        } else {
+            int percent = 0;
+            fields >> percent;
+            trace->samples.push_back({std::stoll(key), trace->durationMs * percent / 100});
+        }
+    }
+    return trace->durationMs > 0 && !trace->samples.empty();
+}
+
+std::vector<std::string> traceNames()
+{
+    std::vector<std::string> names;
+    if (DIR *dir = opendir(TRACE_DIR)) {
+        while (const dirent *entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+            if (name.size() > 6 && name.compare(name.size() - 6, 6, ".trace") == 0) {
+                names.push_back(name);
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+// The time playback starts and the time it runs into the end of the buffered
+// range, -1 if it doesn't. Only whole percents are reported, in between the
+// buffered end moves linearly from one change to the next.
+void playback(const Trace &trace, int64_t *startMs, int64_t *stallMs)
+{
+    *startMs = -1;
+    *stallMs = -1;
+    std::vector<Sample> changes;
+    for (const Sample &sample : trace.samples) {
+        if (changes.empty() || sample.bufferedMs != changes.back().bufferedMs) {
+            changes.push_back(sample);
+        }
+        if (*startMs < 0 && sample.bufferedMs >= START_BUFFER_MS) {
+            *startMs = sample.timeMs;
+        }
+    }
+    if (*startMs < 0) {
+        return;
+    }
+    for (size_t i = 1; i < changes.size(); ++i) {
+        const Sample &from = changes[i - 1];
+        const Sample &to = changes[i];
+        if (from.bufferedMs >= trace.durationMs || to.timeMs <= *startMs) {
+            continue;
+        }
+        // the position and the buffered end meet within this segment
+        const double speed = double(to.bufferedMs - from.bufferedMs) / double(to.timeMs - from.timeMs);
+        const double gap = double(from.bufferedMs) - trace.rate * double(from.timeMs - *startMs);
+        if (trace.rate > speed && gap < (trace.rate - speed) * double(to.timeMs - from.timeMs)) {
+            *stallMs = from.timeMs + std::max<int64_t>(0, int64_t(gap / (trace.rate - speed)));
+            return;
+        }
+    }
+}
+
+void replay(const Trace &trace)
+{
+    int64_t startMs;
+    int64_t stallMs;
+    playback(trace, &startMs, &stallMs);
+    if (startMs < 0 || (stallMs >= 0) != trace.stalls) {
+        Check::fail(__FILE__, __LINE__, trace.name + ": the trace does not play out as it expects");
+        return;
+    }
+
+    BandwidthEstimator estimator;
+    bool warned = false;
+    for (size_t i = 0; i < trace.samples.size(); ++i) {
+        const Sample &sample = trace.samples[i];
+        if (stallMs >= 0 && sample.timeMs >= stallMs) {
+            break;
+        }
+        estimator.addSample(sample.timeMs, sample.bufferedMs);
+        std::vector<int64_t> times = {sample.timeMs};
+        if (i + 1 < trace.samples.size()) {
+            times.push_back((sample.timeMs + trace.samples[i + 1].timeMs) / 2);
+        }
+        for (const int64_t nowMs : times) {
+            if (nowMs < startMs + WARMUP_MS || (stallMs >= 0 && nowMs >= stallMs)) {
+                continue;
+            }
+            const int64_t positionMs = int64_t(double(nowMs - startMs) * trace.rate);
+            const int64_t predicted = estimator.timeToStall(nowMs, positionMs, trace.durationMs, trace.rate);
+            std::ostringstream at;
+            at << trace.name << " at " << nowMs << " ms: predicted " << predicted << " ms";
+            if (stallMs < 0) {
+                if (predicted >= 0 && predicted < FALSE_ALARM_MS) {
+                    Check::fail(__FILE__, __LINE__, at.str() + ", no stall follows");
+                }
+                continue;
+            }
+            const int64_t remaining = stallMs - nowMs;
+            if (remaining > WARNING_MS) {
+                continue;
+            }
+            warned = warned || predicted >= 0;
+            if (predicted < 0 || std::llabs(predicted - remaining) > remaining / 2 + SLACK_MS) {
+                std::ostringstream message;
+                message << at.str() << ", the stall comes in " << remaining << " ms";
+                Check::fail(__FILE__, __LINE__, message.str());
+            }
+        }
+    }
+    if (stallMs >= 0 && !warned) {
+        Check::fail(__FILE__, __LINE__, trace.name + ": the stall was not predicted");
+    }
+    printf("%s: %s\n", trace.name.c_str(), stallMs >= 0 ? "stall predicted" : "no false alarm");
+}
+
+void testTraces()
+{
+    const std::vector<std::string> names = traceNames();
+    CHECK(!names.empty());
+    for (const std::string &name : names) {
+        Trace trace;
+        if (!load(name, &trace)) {
+            Check::fail(__FILE__, __LINE__, name + ": can't read the trace");
+            continue;
+        }
+        replay(trace);
+    }
+}
+
+void testPlaybackRate()
+{
+    BandwidthEstimator estimator;
+    estimator.addSample(0, 10000);
+    estimator.addSample(1000, 11500);
+    CHECK_NEAR(estimator.bufferingRate(), 1.5, 1e-9);
+    // keeps up with real time, not with 2x, nothing is consumed while paused
+    // or rewinding
+    CHECK_EQ(estimator.timeToStall(1000, 4000, 60000, 1.0), -1);
+    CHECK_EQ(estimator.timeToStall(1000, 4000, 60000, 2.0), 15000);
+    CHECK_EQ(estimator.timeToStall(1000, 4000, 60000, 0.0), -1);
+    CHECK_EQ(estimator.timeToStall(1000, 4000, 60000, -4.0), -1);
+}
+
+// Between samples the estimate ages: the position moved on and the end is
+// taken to have moved at the estimated rate, up to one step.
+void testTimeSinceSample()
+{
+    BandwidthEstimator estimator;
+    estimator.addSample(0, 10000);
+    estimator.addSample(1000, 11500);
+    CHECK_EQ(estimator.timeToStall(1000, 4000, 60000, 2.0), 15000);
+    // a second later both moved on, 1000 ms of the 15000 have passed
+    CHECK_EQ(estimator.timeToStall(2000, 6000, 60000, 2.0), 14000);
+    // three seconds without a change: the end moved by a step at most, the
+    // rate is at most a step over those seconds
+    CHECK_EQ(estimator.timeToStall(4000, 10000, 60000, 2.0), 2000);
+    // a time before the last sample is taken as the last sample
+    CHECK_EQ(estimator.timeToStall(0, 4000, 60000, 2.0), 15000);
+}
+
+}
+
+int main()
+{
+    testPlaybackRate();
+    testTimeSinceSample();
+    testTraces();
+    return Check::result("test_bandwidth_estimator");
+}
@@ -0,0 +1,185 @@
+// A session recorded with EventRecorder and played back into a fresh player
+// at the recorded pace, faster and unpaced: the events have to arrive in
+// order and on time, the player has to go through the states the recorded
+// one went through on them and record the same events again.
+
+#include "AndroidMediaPlayer.h"
+#include "EventReplay.h"
+#include "PlayerDiagnostics.h"
+#include "QtWait.h"
+#include "SimulatedBackend.h"
+
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtTest>
+
+using PlaybackState = AndroidMediaPlayer::PlaybackState;
+
+namespace {
+
+// a busy machine may hold the GUI thread back this long
+const qint64 MAX_LATENESS_US = 30000;
+
+// The states the events drive, without repeats: Started comes from start()
+// and resume() themselves.
+QList<PlaybackState> eventStates(const QSignalSpy &spy)
+{
+    QList<PlaybackState> states;
+    for (const QList<QVariant> &arguments : spy) {
+        const auto state = arguments.at(0).value<PlaybackState>();
+        const bool driven = state == PlaybackState::Prepared || state == PlaybackState::Paused
+                || state == PlaybackState::PlaybackCompleted || state == PlaybackState::Error;
+        if (driven && (states.isEmpty() || states.last() != state)) {
+            states.append(state);
+        }
+    }
+    return states;
+}
+
+QVector<EventLog::Record> inbound(const QVector<EventLog::Record> &records)
+{
+    QVector<EventLog::Record> events;
+    for (const EventLog::Record &record : records) {
+        if (record.kind == EventRecorder::Inbound && record.code != EventRecorder::SurfaceChanged) {
+            events.append(record);
+        }
+    }
+    return events;
+}
+
+}
+
+class TestEventReplay : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        SimulatedBackend::install();
+        QVERIFY(mDir.isValid());
+
+        // prepare, play, pause, resume, seek and play to the end
+        AndroidMediaPlayer player;
+        QSignalSpy states(&player, &AndroidMediaPlayer::playbackStateChanged);
+        QVERIFY(PlayerDiagnostics::instance().startEventRecording(mDir.filePath("session.log")));
+        player.setDataSource("sim:1500");
+        QVERIFY(waitUntil([&] { return player.playbackState() == PlaybackState::Prepared; }));
+        player.start();
+        runEventsFor(300);
+        player.pause();
+        QVERIFY(waitUntil([&] { return player.playbackState() == PlaybackState::Paused; }));
+        runEventsFor(100);
+        player.resume();
+        player.seekTo(1000);
+        QVERIFY(waitUntil([&] { return player.playbackState() == PlaybackState::PlaybackCompleted; }));
+        PlayerDiagnostics::instance().stopEventRecording();
+
+        mRecordedStates = eventStates(states);
+        QVERIFY(mLog.load(mDir.filePath("session.log")));
+        mSession = mLog.player(0);
+        QVERIFY(inbound(mSession).size() >= 5);
+    }
+
+    // What the recorder wrote: in time order, and every event follows the
+    // command it answers.
+    void logIsConsistent()
+    {
+        QVERIFY(mLog.commands().contains("prepare"));
+        QCOMPARE(mLog.records().size(), mSession.size());
+
+        const auto command = [this](const char *name) {
+            return quint8(mLog.commands().indexOf(QString::fromLatin1(name)));
+        };
+        const QMap<quint8, QList<quint8>> answers{
+            {EventRecorder::Prepared, {command("prepare")}},
+            {EventRecorder::Pause, {command("pause")}},
+            {EventRecorder::SeekComplete, {command("seekTo")}},
+            // MediaPlayer reports the first frame after a seek again
+            {EventRecorder::Started, {command("start"), command("resume"), command("seekTo")}}
+        };
+        QSet<quint8> issued;
+        qint64 last = 0;
+        for (const EventLog::Record &record : mSession) {
+            QVERIFY(record.timestampUs >= last);
+            last = record.timestampUs;
+            if (record.kind == EventRecorder::Outbound) {
+                QVERIFY(record.code < mLog.commands().size());
+                issued.insert(record.code);
+                continue;
+            }
+            if (!answers.contains(record.code)) {
+                continue;
+            }
+            bool answered = false;
+            for (const quint8 code : answers.value(record.code)) {
+                answered = answered || issued.remove(code);
+            }
+            QVERIFY2(answered, qPrintable(QString("event %1 at %2 us").arg(record.code).arg(record.timestampUs)));
+        }
+        QCOMPARE(inbound(mSession).last().code, quint8(EventRecorder::Finished));
+    }
+
+    void replay_data()
+    {
+        QTest::addColumn<double>("speed");
+        QTest::newRow("recorded") << 1.0;
+        QTest::newRow("4x") << 4.0;
+        QTest::newRow("unpaced") << 0.0;
+    }
+
+    void replay()
+    {
+        QFETCH(double, speed);
+        AndroidMediaPlayer target;
+        QSignalSpy states(&target, &AndroidMediaPlayer::playbackStateChanged);
+        const QString path = mDir.filePath(QString("replay%1.log").arg(speed));
+        QVERIFY(PlayerDiagnostics::instance().startEventRecording(path));
+        QElapsedTimer clock;
+        clock.start();
+        const QVector<qint64> lateness = ::replay(mSession, &target, speed);
+        const qint64 elapsedUs = clock.nsecsElapsed() / 1000;
+        PlayerDiagnostics::instance().stopEventRecording();
+
+        const QVector<EventLog::Record> events = inbound(mSession);
+        QCOMPARE(lateness.size(), events.size());
+        if (speed > 0) {
+            // on time, never early, and the whole session takes its recorded
+            // time over speed
+            for (const qint64 late : lateness) {
+                QVERIFY(late >= 0);
+                QVERIFY2(late < MAX_LATENESS_US, qPrintable(QString("%1 us late").arg(late)));
+            }
+            const qint64 spanUs = qint64(double(events.last().timestampUs - events.first().timestampUs) / speed);
+            QVERIFY(elapsedUs >= spanUs);
+            QVERIFY(elapsedUs < spanUs + MAX_LATENESS_US);
+        }
+        QCOMPARE(eventStates(states), mRecordedStates);
+
+        // the target records what it was given, in order and at the pace
+        EventLog replayed;
+        QVERIFY(replayed.load(path));
+        const QVector<EventLog::Record> again = inbound(replayed.player(0));
+        QCOMPARE(again.size(), events.size());
+        for (int i = 0; i < events.size(); ++i) {
+            QCOMPARE(again[i].code, events[i].code);
+            QCOMPARE(again[i].arg0, events[i].arg0);
+            QCOMPARE(again[i].arg1, events[i].arg1);
+            if (speed > 0 && i > 0) {
+                const double recordedGap = double(events[i].timestampUs - events[i - 1].timestampUs) / speed;
+                const double gap = double(again[i].timestampUs - again[i - 1].timestampUs);
+                QVERIFY(qAbs(gap - recordedGap) < MAX_LATENESS_US);
+            }
+        }
+    }
+
+private:
+    QTemporaryDir mDir;
+    EventLog mLog;
+    QVector<EventLog::Record> mSession;
+    QList<PlaybackState> mRecordedStates;
+};
+
+QTEST_MAIN(TestEventReplay)
+#include "test_event_replay.moc"
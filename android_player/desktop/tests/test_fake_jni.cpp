@@ -0,0 +1,123 @@
+#include "Check.h"
+#include "FakeJni.h"
+
+#include <thread>
+
+namespace {
+
+void testReferences()
+{
+    const FakeJni::Stats before = FakeJni::stats();
+    jobject handle = nullptr;
+    {
+        auto object = std::make_shared<FakeJni::Object>("test/Object");
+        handle = FakeJni::newGlobalRef(object);
+        CHECK(handle == object->handle());
+        CHECK_EQ(FakeJni::stats().globalRefs, before.globalRefs + 1);
+    }
+    // the global reference keeps the object alive
+    CHECK(FakeJni::resolve(handle) != nullptr);
+    CHECK_EQ(FakeJni::stats().liveObjects, before.liveObjects + 1);
+
+    JNIEnv *env = FakeJni::env();
+    const jobject second = env->NewGlobalRef(handle);
+    CHECK(second == handle);
+    env->DeleteGlobalRef(handle);
+    CHECK(FakeJni::resolve(handle) != nullptr);
+    env->DeleteGlobalRef(second);
+    CHECK_EQ(FakeJni::stats().globalRefs, before.globalRefs);
+    CHECK_EQ(FakeJni::stats().liveObjects, before.liveObjects);
+
+    // using or deleting a released reference is counted, not a crash
+    const int64_t stale = FakeJni::stats().staleReferences;
+    env->DeleteGlobalRef(second);
+    CHECK_EQ(FakeJni::stats().staleReferences, stale + 1);
+}
+
+void testLocalRefs()
+{
+    const FakeJni::Stats before = FakeJni::stats();
+    JNIEnv *env = FakeJni::env();
+    const jfloatArray array = env->NewFloatArray(16);
+    CHECK_EQ(env->GetArrayLength(array), 16);
+    CHECK_EQ(FakeJni::stats().localRefs, before.localRefs + 1);
+    const jfloat values[2] = {1.5f, 2.5f};
+    env->SetFloatArrayRegion(array, 3, 2, values);
+    jfloat read[2] = {};
+    env->GetFloatArrayRegion(array, 3, 2, read);
+    CHECK_EQ(read[1], 2.5f);
+
+    // out of bounds throws
+    env->GetFloatArrayRegion(array, 15, 2, read);
+    CHECK(env->ExceptionCheck());
+    env->ExceptionClear();
+    CHECK(!env->ExceptionCheck());
+
+    env->DeleteLocalRef(array);
+    CHECK_EQ(FakeJni::stats().localRefs, before.localRefs);
+    CHECK_EQ(FakeJni::stats().liveObjects, before.liveObjects);
+}
+
+void testDispatch()
+{
+    struct Counter : FakeJni::Object
+    {
+        Counter() : FakeJni::Object("test/Counter") {}
+        int64_t total = 0;
+        float scale = 0;
+    };
+    FakeJni::registerClass("test/Counter", [](const char *, const FakeJni::Args &) {
+        return std::make_shared<Counter>();
+    });
+    FakeJni::registerMethod("test/Counter", "add", [](FakeJni::Object &self, const FakeJni::Args &args) {
+        static_cast<Counter &>(self).total += args.at(0).i;
+        return FakeJni::Value();
+    });
+    FakeJni::registerMethod("test/Counter", "add(JF)V", [](FakeJni::Object &self, const FakeJni::Args &args) {
+        auto &counter = static_cast<Counter &>(self);
+        counter.total += args.at(0).i;
+        counter.scale = float(args.at(1).f);
+        return FakeJni::Value();
+    });
+
+    const auto object = FakeJni::cast<Counter>(FakeJni::construct("test/Counter", "()V", {}));
+    CHECK(object != nullptr);
+    FakeJni::call(*object, "add", "(I)V", {jint(5)});
+    CHECK_EQ(object->total, 5);
+
+    // CallVoidMethod reads the arguments the signature describes
+    JNIEnv *env = FakeJni::env();
+    const jobject ref = FakeJni::newGlobalRef(object);
+    const jmethodID method = env->GetMethodID(env->FindClass("test/Counter"), "add", "(JF)V");
+    env->CallVoidMethod(ref, method, jlong(1) << 40, 0.5f);
+    CHECK_EQ(object->total, (int64_t(1) << 40) + 5);
+    CHECK_EQ(object->scale, 0.5f);
+    FakeJni::deleteGlobalRef(ref);
+
+    // unknown methods return zero and are counted
+    const int64_t unhandled = FakeJni::stats().unhandledCalls;
+    CHECK_EQ(FakeJni::call(*object, "missing", "()J", {}).i, 0);
+    CHECK_EQ(FakeJni::stats().unhandledCalls, unhandled + 1);
+    FakeJni::unregisterClass("test/Counter");
+}
+
+void testExceptionsPerThread()
+{
+    FakeJni::throwNew("java/lang/IllegalStateException", "test");
+    bool pendingElsewhere = true;
+    std::thread([&pendingElsewhere] { pendingElsewhere = FakeJni::exceptionPending(); }).join();
+    CHECK(!pendingElsewhere);
+    CHECK(FakeJni::exceptionPending());
+    FakeJni::clearException();
+}
+
+}
+
+int main()
+{
+    testReferences();
+    testLocalRefs();
+    testDispatch();
+    testExceptionsPerThread();
+    return Check::result("test_fake_jni");
+}
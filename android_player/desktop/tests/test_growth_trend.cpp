@@ -0,0 +1,64 @@
+// GrowthTrend on synthetic soak series: leaks of different slopes have to be
+// flagged, noise, a cache filling up at the start and a sawtooth not.
+
+#include "Check.h"
+#include "GrowthTrend.h"
+
+#include <functional>
+#include <random>
+
+namespace {
+
+const int SAMPLES = 200;
+
+GrowthTrend::Result trend(double absoluteAllowance, double relativeAllowance, const std::function<double(int)> &series,
+                          int samples = SAMPLES)
+{
+    GrowthTrend trend("series", absoluteAllowance, relativeAllowance);
+    for (int i = 0; i < samples; ++i) {
+        trend.add(i, series(i));
+    }
+    return trend.result();
+}
+
+}
+
+int main()
+{
+    std::mt19937 random(7);
+    std::normal_distribution<double> noise(0, 1);
+
+    // RSS like: 50 MB with a few hundred kB of allocator noise
+    const double BASE = 50e6;
+    const auto rss = [&](double leakPerSample) {
+        return [&, leakPerSample](int i) { return BASE + 300e3 * noise(random) + leakPerSample * i; };
+    };
+    CHECK(!trend(1e6, 0.02, rss(0)).growing);
+    // 20 kB a sample, 4 MB over the run
+    const GrowthTrend::Result leak = trend(1e6, 0.02, rss(20e3));
+    CHECK(leak.growing);
+    CHECK_NEAR(leak.slope, 20e3, 5e3);
+    // 2 kB a sample stays within the allowance
+    CHECK(!trend(1e6, 0.02, rss(2e3)).growing);
+
+    // a cache filling up during the warmup, then flat
+    CHECK(!trend(1e6, 0.02, [&](int i) { return BASE + (i < SAMPLES / 20 ? i * 1e6 : 10e6) + 300e3 * noise(random); })
+                   .growing);
+    // a sawtooth: memory released every 25 samples
+    CHECK(!trend(1e6, 0.02, [&](int i) { return BASE + (i % 25) * 200e3; }).growing);
+    // up and back down: the slope disagrees with nothing, the medians match
+    CHECK(!trend(1e6, 0.02, [&](int i) { return BASE + (i < SAMPLES / 2 ? i : SAMPLES - i) * 100e3; }).growing);
+
+    // exact counts like JNI references: one more every 50 samples
+    CHECK(!trend(0.5, 0, [](int) { return 12.0; }).growing);
+    CHECK(trend(0.5, 0, [](int i) { return 12.0 + i / 50; }).growing);
+    // a count that drops is no leak
+    CHECK(!trend(0.5, 0, [](int i) { return 12.0 - i / 50; }).growing);
+
+    // too few samples to tell
+    const GrowthTrend::Result few = trend(0.5, 0, [](int i) { return double(i); }, GrowthTrend::MIN_SAMPLES - 1);
+    CHECK(!few.growing);
+    CHECK_EQ(few.slope, 0.0);
+
+    return Check::result("test_growth_trend");
+}
@@ -0,0 +1,140 @@
+// NativeMediaDataSource.readAt() from several MediaPlayer worker threads at
+// once: every read lands at its offset in the caller's array, nothing around
+// it is touched and the end of the stream reads as -1.
+
+#include "AesCtr.h"
+#include "AesCtrDataSource.h"
+#include "Check.h"
+#include "FakeJni.h"
+#include "FileDataSource.h"
+#include "com_vadim_android_NativeMediaDataSource.h"
+
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+const int THREADS = 8;
+const int READS_PER_THREAD = 1000;
+const jint ARRAY_SIZE = 64 * 1024;
+const jbyte GUARD = jbyte(0xa5);
+const quint8 KEY[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+const quint8 IV[16] = {16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1};
+
+jbyte pattern(int64_t position)
+{
+    return jbyte((position * 131) >> 3);
+}
+
+// A file of the pattern, encrypted if cipher is given.
+std::string writeMedia(int64_t size, const AesCtr *cipher)
+{
+    char path[] = "/tmp/test_media_data_sourceXXXXXX";
+    const int fd = mkstemp(path);
+    std::vector<char> data(static_cast<size_t>(size));
+    for (int64_t i = 0; i < size; ++i) {
+        data[size_t(i)] = char(pattern(i));
+    }
+    if (cipher) {
+        cipher->apply(0, reinterpret_cast<quint8 *>(data.data()), size);
+    }
+    CHECK_EQ(write(fd, data.data(), data.size()), ssize_t(size));
+    close(fd);
+    return path;
+}
+
+// Reads at random positions, sizes and offsets from THREADS threads on one
+// handle and returns the number of bad reads.
+int stress(const std::shared_ptr<MediaDataSource> &source)
+{
+    const int64_t size = source->size();
+    const jlong handle = MediaDataSource::createJniHandle(source);
+    std::atomic<int> bad(0);
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < THREADS; ++thread) {
+        threads.emplace_back([&, thread] {
+            std::mt19937 random(thread);
+            const auto array = FakeJni::newByteArray(size_t(ARRAY_SIZE));
+            FakeJni::LocalRef ref(array);
+            for (int i = 0; i < READS_PER_THREAD; ++i) {
+                // a few reads at or past the end
+                const int64_t position = int64_t(random() % uint64_t(size + size / 64));
+                const jint length = jint(1 + random() % uint32_t(ARRAY_SIZE));
+                const jint offset = jint(random() % uint32_t(ARRAY_SIZE - length + 1));
+                std::fill(array->data.begin(), array->data.end(), GUARD);
+
+                const jint read = Java_com_vadim_android_NativeMediaDataSource_readAt(
+                    FakeJni::env(), nullptr, handle, position, ref.as<jbyteArray>(), offset, length);
+                const int64_t expected = std::min<int64_t>(length, size - position);
+                bool ok = expected > 0 ? read == expected : read == -1;
+                for (jint j = 0; ok && j < ARRAY_SIZE; ++j) {
+                    const bool inside = j >= offset && j < offset + std::max(read, 0);
+                    ok = array->data[size_t(j)] == (inside ? pattern(position + j - offset) : GUARD);
+                }
+                if (!ok) {
+                    ++bad;
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    Java_com_vadim_android_NativeMediaDataSource_close(FakeJni::env(), nullptr, handle);
+    return bad.load();
+}
+
+void testFileStress()
+{
+    const std::string path = writeMedia(8 * 1024 * 1024 + 123, nullptr);
+    const auto source = std::make_shared<FileDataSource>(path, IoScheduler::instance().createClient("test"));
+    CHECK(source->isOpen());
+    CHECK_EQ(stress(source), 0);
+    unlink(path.c_str());
+}
+
+void testDecryptingStress()
+{
+    const AesCtr cipher(KEY, 16, IV);
+    const std::string path = writeMedia(4 * 1024 * 1024 + 7, &cipher);
+    const auto file = std::make_shared<FileDataSource>(path, IoScheduler::instance().createClient("test"));
+    CHECK_EQ(stress(std::make_shared<AesCtrDataSource>(file, cipher)), 0);
+    unlink(path.c_str());
+}
+
+void testBadArguments()
+{
+    const std::string path = writeMedia(4096, nullptr);
+    const jlong handle = MediaDataSource::createJniHandle(
+        std::make_shared<FileDataSource>(path, IoScheduler::instance().createClient("test")));
+    const auto array = FakeJni::newByteArray(100);
+    FakeJni::LocalRef ref(array);
+    JNIEnv *env = FakeJni::env();
+    // out of the array, MediaPlayer sees an error instead of a corrupted heap
+    CHECK_EQ(Java_com_vadim_android_NativeMediaDataSource_readAt(env, nullptr, handle, 0, ref.as<jbyteArray>(), 50, 51), -1);
+    CHECK_EQ(Java_com_vadim_android_NativeMediaDataSource_readAt(env, nullptr, handle, 0, ref.as<jbyteArray>(), -1, 10), -1);
+    CHECK_EQ(Java_com_vadim_android_NativeMediaDataSource_readAt(env, nullptr, handle, 0, ref.as<jbyteArray>(), 0, 0), 0);
+    CHECK_EQ(Java_com_vadim_android_NativeMediaDataSource_readAt(env, nullptr, handle, 0, ref.as<jbyteArray>(), 50, 50), 50);
+    CHECK_EQ(array->data[49], jbyte(0));
+    CHECK_EQ(array->data[50], pattern(0));
+    CHECK_EQ(Java_com_vadim_android_NativeMediaDataSource_readAt(env, nullptr, handle, 0, nullptr, 0, 10), -1);
+    CHECK_EQ(Java_com_vadim_android_NativeMediaDataSource_readAt(env, nullptr, 0, 0, ref.as<jbyteArray>(), 0, 10), -1);
+    Java_com_vadim_android_NativeMediaDataSource_close(env, nullptr, handle);
+    unlink(path.c_str());
+}
+
+}
+
+int main()
+{
+    testBadArguments();
+    testFileStress();
+    testDecryptingStress();
+    CHECK_EQ(FakeJni::stats().localRefs, 0);
+    return Check::result("test_media_data_source");
+}
@@ -0,0 +1,147 @@
+// MemoryPressure on the simulated backend: trim levels arrive like the
+// platform sends them, here through the trim signal, and the bytes reported
+// have to be the ones actually given back.
+
+#include "AndroidMediaPlayer.h"
+#include "ClipCache.h"
+#include "IoScheduler.h"
+#include "MemoryPressure.h"
+#include "PlayerDiagnostics.h"
+#include "QtWait.h"
+#include "SimulatedBackend.h"
+
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <csignal>
+#include <unistd.h>
+
+namespace {
+
+const qint64 CLIP_BYTES = 256 * 1024;
+
+bool startPlayer(AndroidMediaPlayer &player, const QString &source)
+{
+    player.setDataSource(source);
+    if (!waitUntil([&] { return player.playbackState() == AndroidMediaPlayer::PlaybackState::Prepared; })) {
+        return false;
+    }
+    player.start();
+    return waitUntil([&] { return player.playbackState() == AndroidMediaPlayer::PlaybackState::Started; });
+}
+
+}
+
+class TestMemoryPressure : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        SimulatedBackend::install();
+        QVERIFY(SimulatedBackend::installTrimSignal(SIGUSR1));
+        QVERIFY(mDir.isValid());
+    }
+
+    // Only clips no player holds any more give their memory back, the others
+    // leave the cache but stay alive.
+    void clipTrimCountsReleasedClips()
+    {
+        ClipCache &cache = ClipCache::instance();
+        cache.trim(0);
+        const auto io = IoScheduler::instance().createClient("test");
+        std::vector<std::shared_ptr<ClipCache::Clip>> clips;
+        for (int i = 0; i < 4; ++i) {
+            QFile file(mDir.filePath(QString("clip%1.mp4").arg(i)));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            QVERIFY(file.write(QByteArray(int(CLIP_BYTES), char('a' + i))) == CLIP_BYTES);
+            file.close();
+            clips.push_back(cache.clip(file.fileName()));
+            QVERIFY(clips.back());
+        }
+        // three loaded, one never read
+        for (int i = 0; i < 3; ++i) {
+            QVERIFY(clips[i]->load(io));
+        }
+        const std::shared_ptr<ClipCache::Clip> held = clips[0];
+        clips.clear();
+        QCOMPARE(cache.stats().size, 4 * CLIP_BYTES);
+
+        QCOMPARE(cache.trim(0), 2 * CLIP_BYTES);
+        QCOMPARE(cache.stats().size, qint64(0));
+        QCOMPARE(cache.stats().clips, 0);
+        // the player keeps playing its copy
+        QVERIFY(held->isLoaded());
+        QCOMPARE(held->data(), QByteArray(int(CLIP_BYTES), 'a'));
+    }
+
+    // The signal sends the level given to sigqueue(), RUNNING_CRITICAL
+    // without one, and MemoryPressure reports the bytes per level.
+    void trimSignal()
+    {
+        MemoryPressure &pressure = MemoryPressure::instance();
+        QSignalSpy trimmed(&pressure, &MemoryPressure::trimmed);
+        QVERIFY(trimmed.isValid());
+        ClipCache &cache = ClipCache::instance();
+        const auto io = IoScheduler::instance().createClient("test");
+        QFile file(mDir.filePath("trimmed.mp4"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QVERIFY(file.write(QByteArray(int(CLIP_BYTES), 'z')) == CLIP_BYTES);
+        file.close();
+        QVERIFY(cache.clip(file.fileName())->load(io));
+
+        sigval value;
+        value.sival_int = MemoryPressure::Moderate;
+        QCOMPARE(sigqueue(getpid(), SIGUSR1, value), 0);
+        QVERIFY(waitUntil([&] { return trimmed.count() == 1; }));
+        QCOMPARE(trimmed.at(0).at(0).toInt(), int(MemoryPressure::Moderate));
+        // the clip nobody holds is given back
+        QCOMPARE(trimmed.at(0).at(1).toLongLong(), CLIP_BYTES);
+
+        QCOMPARE(raise(SIGUSR1), 0);
+        QVERIFY(waitUntil([&] { return trimmed.count() == 2; }));
+        QCOMPARE(trimmed.at(1).at(0).toInt(), int(MemoryPressure::RunningCritical));
+        QCOMPARE(trimmed.at(1).at(1).toLongLong(), qint64(0));
+
+        const QVariantMap levels = PlayerDiagnostics::instance().memoryPressureStats().value("levels").toMap();
+        const QVariantMap moderate = levels.value(QString::number(MemoryPressure::Moderate)).toMap();
+        QCOMPARE(moderate.value("events").toInt(), 1);
+        QCOMPARE(moderate.value("bytes").toLongLong(), CLIP_BYTES);
+    }
+
+    // Paused players give up their decoder and come back where they were,
+    // playing ones are left alone.
+    void idleDecodersAreReleased()
+    {
+        AndroidMediaPlayer playing;
+        AndroidMediaPlayer paused;
+        QVERIFY(startPlayer(playing, "sim:60000"));
+        QVERIFY(startPlayer(paused, "sim:60000"));
+        QVERIFY(waitUntil([&] { return paused.currentPosition() >= 500; }));
+        paused.pause();
+        QVERIFY(waitUntil([&] { return paused.playbackState() == AndroidMediaPlayer::PlaybackState::Paused; }));
+        const long position = paused.currentPosition();
+        const QVariantMap estimated = paused.memoryReport().value("estimated").toMap();
+        QVERIFY(estimated.value("outputBuffers").toLongLong() > 0);
+        QVERIFY(estimated.value("surfaceQueue").toLongLong() > 0);
+        // the buffer queue of the surface goes with the decoder
+        const qint64 decoderBytes = estimated.value("outputBuffers").toLongLong()
+                + estimated.value("surfaceQueue").toLongLong();
+
+        QCOMPARE(PlayerDiagnostics::instance().simulateTrimLevel(MemoryPressure::RunningLow), decoderBytes);
+        QCOMPARE(paused.playbackState(), AndroidMediaPlayer::PlaybackState::Idle);
+        QCOMPARE(playing.playbackState(), AndroidMediaPlayer::PlaybackState::Started);
+
+        paused.resume();
+        QVERIFY(waitUntil([&] { return paused.playbackState() == AndroidMediaPlayer::PlaybackState::Started; }));
+        QVERIFY(qAbs(paused.currentPosition() - position) < 1000);
+    }
+
+private:
+    QTemporaryDir mDir;
+};
+
+QTEST_MAIN(TestMemoryPressure)
+#include "test_memory_pressure.moc"
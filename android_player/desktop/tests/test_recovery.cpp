@@ -0,0 +1,128 @@
+// Recovery from a dead media server on the simulated backend: errors are
+// injected into the simulated MediaPlayer and AndroidMediaPlayer has to come
+// back at the position it was at, with the backoff and counters it reports.
+
+#include "AndroidMediaPlayer.h"
+#include "QtWait.h"
+#include "SimulatedBackend.h"
+
+#include <QSignalSpy>
+#include <QtTest>
+
+namespace {
+
+// android.media.MediaPlayer
+const int MEDIA_ERROR_UNKNOWN = 1;
+const int MEDIA_ERROR_SERVER_DIED = 100;
+const int MEDIA_ERROR_MALFORMED = -1007;
+// AndroidMediaPlayer saves the position this often
+const long PROGRESS_INTERVAL_MS = 500;
+
+bool startPlayer(AndroidMediaPlayer &player, const QString &source)
+{
+    player.setDataSource(source);
+    if (!waitUntil([&] { return player.playbackState() == AndroidMediaPlayer::PlaybackState::Prepared; })) {
+        return false;
+    }
+    player.start();
+    return waitUntil([&] { return player.playbackState() == AndroidMediaPlayer::PlaybackState::Started; });
+}
+
+}
+
+class TestRecovery : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        SimulatedBackend::install();
+    }
+
+    void serverDiedResumesAtPosition()
+    {
+        AndroidMediaPlayer player;
+        player.setRecoverFromErrors(true);
+        QSignalSpy recovering(&player, &AndroidMediaPlayer::recovering);
+        QSignalSpy recovered(&player, &AndroidMediaPlayer::recovered);
+        QSignalSpy error(&player, &AndroidMediaPlayer::error);
+        QVERIFY(startPlayer(player, "sim:60000"));
+        QVERIFY(waitUntil([&] { return player.currentPosition() >= 1200; }));
+        const long before = player.currentPosition();
+
+        SimulatedMediaPlayer *died = SimulatedBackend::player(&player);
+        QVERIFY(died);
+        died->injectError(MEDIA_ERROR_SERVER_DIED, 0);
+        QVERIFY(waitUntil([&] { return recovered.count() == 1; }));
+        QVERIFY(waitUntil([&] { return player.playbackState() == AndroidMediaPlayer::PlaybackState::Started; }));
+
+        QCOMPARE(recovering.count(), 1);
+        QCOMPARE(recovering.at(0).at(0).toInt(), 1);
+        QCOMPARE(recovering.at(0).at(1).toInt(), 250);
+        QCOMPARE(error.count(), 0);
+        // a new backend, prepared at the position of the last progress tick
+        // before the server died
+        QVERIFY(SimulatedBackend::player(&player) != died);
+        QVERIFY(player.currentPosition() >= before - PROGRESS_INTERVAL_MS);
+        QVERIFY(player.currentPosition() < before + 2000);
+
+        const QVariantMap stats = player.recoveryStats();
+        QCOMPARE(stats.value("attempts").toInt(), 1);
+        QCOMPARE(stats.value("recoveries").toInt(), 1);
+        QCOMPARE(stats.value("failures").toInt(), 0);
+        // the backoff delay is part of the recovery time
+        QVERIFY(stats.value("lastTime").toInt() >= 250);
+        QCOMPARE(stats.value("lastTime").toInt(), recovered.at(0).at(0).toInt());
+    }
+
+    void backoffUntilOutOfAttempts()
+    {
+        AndroidMediaPlayer player;
+        player.setRecoverFromErrors(true);
+        player.setMaxRecoveryAttempts(3);
+        QSignalSpy recovering(&player, &AndroidMediaPlayer::recovering);
+        QSignalSpy error(&player, &AndroidMediaPlayer::error);
+        // every new backend dies again as soon as it plays past 500 ms, it
+        // counts as a failure once the attempts run out
+        QVERIFY(startPlayer(player, QString("sim:60000?error=500&what=%1").arg(MEDIA_ERROR_SERVER_DIED)));
+        QVERIFY(waitUntil([&] { return error.count() == 1; }, 10000));
+
+        QCOMPARE(recovering.count(), 3);
+        for (int attempt = 0; attempt < recovering.count(); ++attempt) {
+            QCOMPARE(recovering.at(attempt).at(0).toInt(), attempt + 1);
+            QCOMPARE(recovering.at(attempt).at(1).toInt(), 250 << attempt);
+        }
+        QCOMPARE(player.playbackState(), AndroidMediaPlayer::PlaybackState::Error);
+        const QVariantMap stats = player.recoveryStats();
+        QCOMPARE(stats.value("attempts").toInt(), 3);
+        QCOMPARE(stats.value("failures").toInt(), 1);
+    }
+
+    void brokenMediaIsNotRetried()
+    {
+        AndroidMediaPlayer player;
+        player.setRecoverFromErrors(true);
+        QSignalSpy recovering(&player, &AndroidMediaPlayer::recovering);
+        QSignalSpy error(&player, &AndroidMediaPlayer::error);
+        QVERIFY(startPlayer(player, "sim:60000"));
+        SimulatedBackend::player(&player)->injectError(MEDIA_ERROR_UNKNOWN, MEDIA_ERROR_MALFORMED);
+        QVERIFY(waitUntil([&] { return error.count() == 1; }));
+        QCOMPARE(recovering.count(), 0);
+        QCOMPARE(player.playbackState(), AndroidMediaPlayer::PlaybackState::Error);
+    }
+
+    void offByDefault()
+    {
+        AndroidMediaPlayer player;
+        QSignalSpy recovering(&player, &AndroidMediaPlayer::recovering);
+        QSignalSpy error(&player, &AndroidMediaPlayer::error);
+        QVERIFY(startPlayer(player, "sim:60000"));
+        SimulatedBackend::player(&player)->injectError(MEDIA_ERROR_SERVER_DIED, 0);
+        QVERIFY(waitUntil([&] { return error.count() == 1; }));
+        QCOMPARE(recovering.count(), 0);
+    }
+};
+
+QTEST_MAIN(TestRecovery)
+#include "test_recovery.moc"
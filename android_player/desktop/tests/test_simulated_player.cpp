@@ -0,0 +1,408 @@
+// The simulated backend has to behave like the Java player it stands in for,
+// otherwise the tests and benches running on it measure something else.
+
+#include "Check.h"
+#include "FakeJni.h"
+#include "FileDataSource.h"
+#include "PlayerEvents.h"
+
+#include <thread>
+
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int64_t elapsedMs(Clock::time_point since)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - since).count();
+}
+
+void sleepMs(int64_t ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void testTestPattern()
+{
+    SimulatedMediaPlayer player;
+    const auto events = std::make_shared<PlayerEvents>();
+    const auto surface = std::make_shared<FrameLog>();
+    player.setEventListener(events);
+    player.setSurface(surface);
+    CHECK(player.setDataSource("testpattern:320x180@50/400"));
+    player.prepare(0);
+    CHECK(events->waitFor("prepared"));
+    CHECK_EQ(events->events().at(0), std::string("buffering"));
+    CHECK_EQ(events->events().at(1), std::string("videoSize(320x180)"));
+    CHECK_EQ(player.getDuration(), 400);
+
+    const auto started = Clock::now();
+    player.start();
+    CHECK(events->waitFor("started"));
+    CHECK(events->waitFor("finished"));
+    CHECK_NEAR(elapsedMs(started), 400, 150);
+    CHECK_EQ(events->count("started"), 1);
+
+    // 50 fps for 400 ms in order. Frames follow the wall clock, a thread
+    // woken late skips the frames it is late for like a decoder would, but
+    // never repeats or reorders one
+    const auto frames = surface->frames();
+    CHECK(!frames.empty());
+    CHECK_EQ(frames.front().index, 0);
+    int64_t skipped = 0;
+    for (size_t i = 1; i < frames.size(); ++i) {
+        CHECK(frames[i].index > frames[i - 1].index);
+        skipped += frames[i].index - frames[i - 1].index - 1;
+    }
+    CHECK(skipped <= 3);
+    CHECK_NEAR(double(frames.size() + skipped), 20, 2);
+    CHECK_EQ(player.stats().illegalStateCalls, 0);
+}
+
+// Latencies are scheduled in whole ms of uptime, checks allow for the rounding.
+void testLatencies()
+{
+    SimulatedMediaPlayer player;
+    const auto events = std::make_shared<PlayerEvents>();
+    player.setEventListener(events);
+    CHECK(player.setDataSource("sim:10000?prepare=80&seek=60&render=30"));
+
+    auto since = Clock::now();
+    player.prepare(0);
+    CHECK(events->waitFor("prepared"));
+    CHECK(elapsedMs(since) >= 78);
+
+    since = Clock::now();
+    player.start();
+    CHECK(events->waitFor("started"));
+    CHECK(elapsedMs(since) >= 28);
+
+    since = Clock::now();
+    player.seekTo(5000);
+    CHECK_EQ(player.getCurrentPosition(), 5000);
+    CHECK(events->waitFor("seekComplete"));
+    CHECK(elapsedMs(since) >= 58);
+    // MediaPlayer reports the first frame after a seek again
+    CHECK(events->waitFor("started", 2));
+    CHECK(elapsedMs(since) >= 88);
+
+    sleepMs(100);
+    const int64_t position = player.getCurrentPosition();
+    CHECK(position > 5000 && position < 5200);
+    player.pause();
+    CHECK_EQ(events->count("pause"), 1);
+    const int64_t paused = player.getCurrentPosition();
+    sleepMs(50);
+    CHECK_EQ(player.getCurrentPosition(), paused);
+}
+
+// The render start after a loop is what AndroidMediaPlayer measures the
+// visible loop gap from.
+void testLoopRenderStart()
+{
+    SimulatedMediaPlayer pattern;
+    auto events = std::make_shared<PlayerEvents>();
+    pattern.setEventListener(events);
+    pattern.setSurface(std::make_shared<FrameLog>());
+    pattern.setLooping(true);
+    CHECK(pattern.setDataSource("testpattern:320x180@50/300"));
+    pattern.prepare(0);
+    CHECK(events->waitFor("prepared"));
+    auto since = Clock::now();
+    pattern.start();
+    CHECK(events->waitFor("started"));
+    // TestPatternSource wraps around without a seek
+    CHECK(events->waitFor("started", 2));
+    CHECK_NEAR(elapsedMs(since), 300, 100);
+    since = Clock::now();
+    pattern.seekTo(100);
+    CHECK(events->waitFor("started", 3));
+    CHECK(elapsedMs(since) <= 2 * 20 + 30);
+    CHECK_EQ(events->count("finished"), 0);
+
+    // a range loop seeks back ahead of its end by the seek and render
+    // latency, the first frame of the loop start shows when the end would
+    SimulatedMediaPlayer player;
+    events = std::make_shared<PlayerEvents>();
+    player.setEventListener(events);
+    CHECK(player.setDataSource("sim:10000?seek=60&render=30"));
+    player.prepare(0);
+    CHECK(events->waitFor("prepared"));
+    player.start();
+    CHECK(events->waitFor("started"));
+    const int64_t loopEnd = 400;
+    while (player.getCurrentPosition() < loopEnd - 90) {
+        sleepMs(1);
+    }
+    since = Clock::now();
+    const int64_t lead = loopEnd - player.getCurrentPosition();
+    player.seekTo(0);
+    CHECK(events->waitFor("started", 2));
+    const int64_t gap = std::max<int64_t>(0, elapsedMs(since) - lead);
+    printf("simulated loop gap: %lld ms\n", static_cast<long long>(gap));
+    CHECK(gap <= 20);
+}
+
+// PlayerSurfaceView detaches the player before its surface goes, the next
+// surface resumes the same MediaPlayer with a new render start.
+void testSurfaceDetach()
+{
+    SimulatedMediaPlayer player;
+    const auto events = std::make_shared<PlayerEvents>();
+    player.setEventListener(events);
+    player.setSurface(std::make_shared<FrameLog>());
+    CHECK(player.setDataSource("sim:10000?prepare=40&render=30"));
+    player.prepare(0);
+    CHECK(events->waitFor("prepared"));
+    player.start();
+    CHECK(events->waitFor("started"));
+    sleepMs(100);
+
+    player.detachSurface();
+    CHECK_EQ(events->count("suspended"), 1);
+    CHECK(player.isSuspended());
+    CHECK(!player.isPlaying());
+    const int64_t position = player.getCurrentPosition();
+    sleepMs(50);
+    CHECK_EQ(player.getCurrentPosition(), position);
+
+    const auto surface = std::make_shared<FrameLog>();
+    const auto since = Clock::now();
+    player.attachSurface(surface);
+    CHECK_EQ(events->count("resumed"), 1);
+    CHECK(events->waitFor("started", 2));
+    CHECK(elapsedMs(since) >= 28);
+    CHECK(!surface->frames().empty());
+    CHECK(surface->frames().front().positionMs >= position);
+    CHECK_EQ(player.stats().prepares, 1);
+    CHECK_EQ(player.stats().illegalStateCalls, 0);
+}
+
+void testIllegalState()
+{
+    SimulatedMediaPlayer player;
+    player.start();
+    CHECK_EQ(player.stats().illegalStateCalls, 1);
+    CHECK(FakeJni::exceptionPending());
+    FakeJni::clearException();
+    CHECK(!player.setDataSource("/does/not/exist"));
+    CHECK(FakeJni::exceptionPending());
+    FakeJni::clearException();
+}
+
+void testNextPart()
+{
+    SimulatedMediaPlayer player;
+    const auto events = std::make_shared<PlayerEvents>();
+    player.setEventListener(events);
+    player.setLooping(false);
+    CHECK(player.setDataSource("sim:300"));
+    player.prepare(0);
+    CHECK(events->waitFor("prepared"));
+    player.setVideoScalingMode(2);
+    CHECK(player.setPlaybackSpeed(1.5f));
+    player.prepareNext("sim:200?prepare=20");
+    player.start();
+    CHECK(events->waitFor("nextPart"));
+    CHECK_EQ(player.dataSource(), std::string("sim:200?prepare=20"));
+    CHECK(player.isPlaying());
+    // the next part plays on with the settings of the previous one
+    CHECK_EQ(player.videoScalingMode(), 2);
+    CHECK_NEAR(player.playbackSpeed(), 1.5, 1e-6);
+    CHECK(!player.isLooping());
+    CHECK(events->waitFor("finished"));
+    CHECK_EQ(events->count("nextPart"), 1);
+}
+
+void testErrors()
+{
+    SimulatedMediaPlayer player;
+    const auto events = std::make_shared<PlayerEvents>();
+    player.setEventListener(events);
+    CHECK(player.setDataSource("sim:10000?error=100&what=100&extra=0"));
+    player.prepare(0);
+    CHECK(events->waitFor("prepared"));
+    player.start();
+    // an unhandled error is followed by onCompletion
+    CHECK(events->waitFor("error(100,0)"));
+    CHECK(events->waitFor("finished"));
+
+    player.reset();
+    CHECK(player.setDataSource("sim:10000"));
+    player.prepare(0);
+    CHECK(events->waitFor("prepared", 2));
+    player.start();
+    player.injectError(1, -19);
+    CHECK(events->waitFor("error(1,-19)"));
+    CHECK(events->waitFor("finished", 2));
+    // a lost surface resets the player
+    CHECK(player.dataSource().empty());
+    FakeJni::clearException();
+
+    player.reset();
+    CHECK(player.setDataSource("sim:10000?error=prepare"));
+    player.prepare(0);
+    CHECK(events->waitFor("error(1,-1004)"));
+}
+
+void testBuffering()
+{
+    SimulatedMediaPlayer player;
+    const auto events = std::make_shared<PlayerEvents>();
+    player.setEventListener(events);
+    // buffers 0.5 s of media a second, half of real time
+    CHECK(player.setDataSource("sim:60000?download=0.5"));
+    player.prepare(0);
+    CHECK(events->waitFor("prepared"));
+    player.start();
+    CHECK(events->waitFor("buffering", 2));
+    CHECK(events->bufferingUpdates() > 0);
+    CHECK(events->lastPercent() < 100);
+    player.setDownloadRate(100);
+    CHECK(events->waitFor("buffered"));
+}
+
+// A decoder clock running fast moves the position faster, the playback
+// speed on top of it.
+void testClockRate()
+{
+    SimulatedMediaPlayer player;
+    const auto events = std::make_shared<PlayerEvents>();
+    player.setEventListener(events);
+    CHECK(player.setDataSource("sim:60000?clock=1.1"));
+    player.prepare(0);
+    CHECK(events->waitFor("prepared"));
+    player.start();
+    CHECK(events->waitFor("started"));
+
+    const auto rate = [&player] {
+        const auto since = Clock::now();
+        const int64_t from = player.getCurrentPosition();
+        sleepMs(500);
+        const int64_t to = player.getCurrentPosition();
+        return double(to - from) / double(elapsedMs(since));
+    };
+    CHECK_NEAR(rate(), 1.1, 0.06);
+    CHECK(player.setPlaybackSpeed(2));
+    CHECK_NEAR(rate(), 2.2, 0.1);
+}
+
+void testSeekToSync()
+{
+    SimulatedMediaPlayer player;
+    const auto events = std::make_shared<PlayerEvents>();
+    player.setEventListener(events);
+    CHECK(player.setDataSource("sim:10000?keyframes=2000"));
+    player.prepare(0);
+    CHECK(events->waitFor("prepared"));
+    player.seekToSync(2900);
+    CHECK_EQ(player.getCurrentPosition(), 2000);
+    player.seekToSync(3100);
+    CHECK_EQ(player.getCurrentPosition(), 4000);
+    const auto keyframes = SimulatedMediaPlayer::keyframes("sim:10000?keyframes=2000");
+    CHECK_EQ(keyframes.size(), size_t(6));
+    CHECK_EQ(SimulatedMediaPlayer::keyframes("testpattern:64x64@30/3000").size(), size_t(4));
+}
+
+// Counts the reads and the close of the handle.
+class CountingSource : public MediaDataSource
+{
+public:
+    explicit CountingSource(std::shared_ptr<MediaDataSource> source, std::atomic<int> *closed) :
+        mSource(std::move(source)),
+        mClosed(closed)
+    {
+    }
+    ~CountingSource() override { ++*mClosed; }
+
+    qint64 readAt(qint64 position, char *buffer, qint64 size) override
+    {
+        ++reads;
+        return mSource->readAt(position, buffer, size);
+    }
+    qint64 size() const override { return mSource->size(); }
+
+    std::atomic<int> reads{0};
+
+private:
+    std::shared_ptr<MediaDataSource> mSource;
+    std::atomic<int> *mClosed;
+};
+
+void testNativeDataSource()
+{
+    char path[] = "/tmp/test_simulated_playerXXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    const std::vector<char> data(512 * 1024, 'v');
+    CHECK_EQ(write(fd, data.data(), data.size()), ssize_t(data.size()));
+    close(fd);
+
+    std::atomic<int> closed{0};
+    auto file = std::make_shared<FileDataSource>(path, IoScheduler::instance().createClient("test"));
+    auto source = std::make_shared<CountingSource>(file, &closed);
+    {
+        SimulatedMediaPlayer player;
+        const auto events = std::make_shared<PlayerEvents>();
+        player.setEventListener(events);
+        // 1 Mbit/s, the file holds about 4 s
+        SimulatedMediaPlayer::setDefaultMedia("sim:0?bitrate=1000000&fps=25");
+        CHECK(player.setNativeDataSource(MediaDataSource::createJniHandle(source)));
+        player.prepare(0);
+        CHECK(events->waitFor("prepared"));
+        CHECK_NEAR(player.getDuration(), 4194, 1);
+        player.start();
+        sleepMs(200);
+        CHECK(source->reads > 1);
+        CHECK(player.stats().bytesRead > 64 * 1024);
+        player.release();
+    }
+    SimulatedMediaPlayer::setDefaultMedia("sim:60000");
+    source.reset();
+    // MediaPlayer closed the data source
+    CHECK_EQ(closed.load(), 1);
+
+    // a playlist part prepared ahead reads through its own data source
+    source = std::make_shared<CountingSource>(file, &closed);
+    {
+        SimulatedMediaPlayer player;
+        const auto events = std::make_shared<PlayerEvents>();
+        player.setEventListener(events);
+        CHECK(player.setDataSource("sim:300"));
+        player.prepare(0);
+        CHECK(events->waitFor("prepared"));
+        SimulatedMediaPlayer::setDefaultMedia("sim:0?bitrate=1000000&fps=25");
+        player.prepareNextNative(MediaDataSource::createJniHandle(source));
+        SimulatedMediaPlayer::setDefaultMedia("sim:60000");
+        player.start();
+        CHECK(events->waitFor("nextPart"));
+        CHECK_EQ(player.dataSource().compare(0, 7, "native:"), 0);
+        sleepMs(200);
+        CHECK(source->reads > 1);
+        player.release();
+    }
+    source.reset();
+    CHECK_EQ(closed.load(), 2);
+    unlink(path);
+}
+
+}
+
+int main()
+{
+    testTestPattern();
+    testLatencies();
+    testLoopRenderStart();
+    testSurfaceDetach();
+    testIllegalState();
+    testNextPart();
+    testErrors();
+    testBuffering();
+    testClockRate();
+    testSeekToSync();
+    testNativeDataSource();
+    CHECK_EQ(SimulatedMediaPlayer::liveCount(), 0);
+    return Check::result("test_simulated_player");
+}
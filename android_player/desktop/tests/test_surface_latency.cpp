@@ -0,0 +1,114 @@
+// Glass-to-glass latency of "testpattern:" sources on a SurfaceTexture item
+// with measureLatency on: the simulated player draws the frame index and the
+// uptime into every frame, QSurfaceTexture reads them back from the rendered
+// frame. The measurement has to account for every frame and stay within what
+// the render cadence allows.
+
+#include "AndroidMediaPlayer.h"
+#include "QSurfaceTexture.h"
+#include "QtWait.h"
+#include "RenderHarness.h"
+#include "SimulatedBackend.h"
+
+#include <QElapsedTimer>
+#include <QtTest>
+
+namespace {
+
+const QSize WINDOW_SIZE(640, 360);
+const int RUN_MS = 2000;
+// the marker carries whole milliseconds of uptime
+const qint64 CLOCK_US = 1000;
+
+}
+
+class TestSurfaceLatency : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        SimulatedBackend::install();
+    }
+
+    void latency_data()
+    {
+        QTest::addColumn<QString>("source");
+        QTest::addColumn<int>("fps");
+        QTest::addColumn<int>("renderIntervalMs");
+        QTest::newRow("320x180@30, 60 Hz") << "testpattern:320x180@30" << 30 << 16;
+        QTest::newRow("1280x720@60, 60 Hz") << "testpattern:1280x720@60" << 60 << 16;
+        // a consumer slower than the video drops frames, but shows the newest
+        QTest::newRow("1280x720@60, 10 Hz") << "testpattern:1280x720@60" << 60 << 100;
+    }
+
+    void latency()
+    {
+        QFETCH(QString, source);
+        QFETCH(int, fps);
+        QFETCH(int, renderIntervalMs);
+        RenderHarness harness(WINDOW_SIZE);
+        if (!harness.isValid()) {
+            QSKIP("no OpenGL");
+        }
+        QSurfaceTexture texture(harness.contentItem());
+        texture.setSize(WINDOW_SIZE);
+        texture.setMeasureLatency(true);
+        harness.renderFrame();
+
+        AndroidMediaPlayer player;
+        player.setSurfaceView(&texture);
+        player.setDataSource(source);
+        QVERIFY(waitUntil([&] { return player.playbackState() == AndroidMediaPlayer::PlaybackState::Prepared; }));
+        player.start();
+        // the first frames arrive before the item knows the video size
+        QVERIFY(waitUntil([&] {
+            harness.renderFrame();
+            return texture.latencyStats().value("frames").toLongLong() > 0;
+        }));
+        texture.resetLatencyStats();
+
+        QElapsedTimer clock;
+        clock.start();
+        int renders = 0;
+        while (clock.elapsed() < RUN_MS) {
+            harness.renderFrame();
+            ++renders;
+            runEventsFor(renderIntervalMs);
+        }
+        const qint64 elapsedMs = clock.elapsed();
+        const QVariantMap stats = texture.latencyStats();
+        QCOMPARE(player.latencyStats().value("frames"), stats.value("frames"));
+        qInfo("%s: %lld frames, p50 %lld us, p99 %lld us, max %lld us, %lld dropped, %lld repeated", qPrintable(source),
+              stats.value("frames").toLongLong(), stats.value("p50Us").toLongLong(), stats.value("p99Us").toLongLong(),
+              stats.value("maxUs").toLongLong(), stats.value("droppedFrames").toLongLong(),
+              stats.value("repeatedFrames").toLongLong());
+
+        // every render reads a marker, each frame index is either shown,
+        // repeated or dropped
+        const qint64 frames = stats.value("frames").toLongLong();
+        const qint64 shown = frames + stats.value("repeatedFrames").toLongLong();
+        const qint64 dropped = stats.value("droppedFrames").toLongLong();
+        QCOMPARE(stats.value("decodeErrors").toLongLong(), qlonglong(0));
+        QVERIFY(frames > 0);
+        QVERIFY(shown <= renders);
+        QVERIFY(shown >= renders - renders / 10);
+        const qint64 produced = elapsedMs * fps / 1000;
+        QVERIFY2(qAbs(frames + dropped - produced) <= produced / 5,
+                 qPrintable(QString("%1 shown + %2 dropped of %3").arg(frames).arg(dropped).arg(produced)));
+
+        // the frame on screen is at most a frame interval plus a render old,
+        // more when the machine is busy but not at the median
+        const qint64 frameUs = 1000000 / fps;
+        const qint64 renderUs = (elapsedMs * 1000 - qint64(renders) * renderIntervalMs * 1000) / renders;
+        QVERIFY(stats.value("p50Us").toLongLong() <= frameUs + renderUs + CLOCK_US);
+        if (renderIntervalMs * 1000 + renderUs < frameUs) {
+            QVERIFY(dropped <= produced / 10);
+        }
+        QVERIFY(stats.value("maxUs").toLongLong() < 20 * frameUs);
+    }
+};
+
+QTEST_MAIN(TestSurfaceLatency)
+#include "test_surface_latency.moc"
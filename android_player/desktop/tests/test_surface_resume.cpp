@@ -0,0 +1,200 @@
+// Surface loss on the simulated backend: a player detached from its surface
+// before the surface goes keeps its prepared decoder, attaching the next
+// surface resumes it. The time from the new surface to its first frame is
+// compared with the re-prepare path the -ENODEV error used to force on every
+// surface loss: reset, setDataSource, prepare, seek back and start.
+
+#include "AndroidMediaPlayer.h"
+#include "PlayerEvents.h"
+#include "QSurfaceTexture.h"
+#include "QtWait.h"
+#include "RenderHarness.h"
+#include "SimulatedBackend.h"
+
+#include <QSignalSpy>
+#include <QtTest>
+
+namespace {
+
+// prepare and seek are what a re-prepare pays on top of the render latency
+const QString SOURCE = "sim:60000?prepare=400&seek=150&render=50";
+const qint64 PREPARE_MS = 400;
+const qint64 RENDER_MS = 50;
+// android.media.MediaPlayer
+const int MEDIA_ERROR_UNKNOWN = 1;
+const int ERROR_SURFACE_LOST = -19;
+const QSize WINDOW_SIZE(320, 180);
+
+bool startPlayer(AndroidMediaPlayer &player, const QString &source)
+{
+    player.setDataSource(source);
+    if (!waitUntil([&] { return player.playbackState() == AndroidMediaPlayer::PlaybackState::Prepared; })) {
+        return false;
+    }
+    player.start();
+    return waitUntil([&] { return player.currentPosition() >= 1000; });
+}
+
+// Uptime of the first frame drawn on surface, -1 if none came.
+qint64 firstFrameMs(const FrameLog &surface)
+{
+    qint64 uptime = -1;
+    waitUntil([&] {
+        const auto frames = surface.frames();
+        uptime = frames.empty() ? -1 : frames.front().uptimeMs;
+        return uptime >= 0;
+    });
+    return uptime;
+}
+
+}
+
+class TestSurfaceResume : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        SimulatedBackend::install();
+    }
+
+    // What PlayerSurfaceView does in surfaceDestroyed() and surfaceCreated().
+    void detachAttachKeepsDecoder()
+    {
+        const qint64 latency = resumeByDetach();
+        QVERIFY(latency >= 0);
+        // the render latency, but no prepare
+        QVERIFY(latency >= RENDER_MS - 2);
+        QVERIFY(latency < PREPARE_MS);
+    }
+
+    void resumeFasterThanReprepare()
+    {
+        const qint64 detach = resumeByDetach();
+        const qint64 reprepare = resumeByReprepare();
+        QVERIFY(detach >= 0);
+        QVERIFY(reprepare >= 0);
+        qDebug() << "first frame on the new surface: detach/attach" << detach
+                 << "ms, re-prepare" << reprepare << "ms";
+        // the re-prepare pays for prepare and seek on top of the render latency
+        QVERIFY(reprepare >= PREPARE_MS);
+        QVERIFY(detach + PREPARE_MS / 2 < reprepare);
+    }
+
+    // The native player detaches from a QSurfaceTexture before the texture
+    // goes and attaches to the next one.
+    void surfaceTextureReplaced()
+    {
+        RenderHarness harness(WINDOW_SIZE);
+        if (!harness.isValid()) {
+            QSKIP("no OpenGL");
+        }
+        auto *first = new QSurfaceTexture(harness.contentItem());
+        first->setSize(WINDOW_SIZE);
+        harness.renderFrame();
+
+        AndroidMediaPlayer player;
+        QSignalSpy resumed(&player, &AndroidMediaPlayer::surfaceResumeLatencyChanged);
+        player.setSurfaceView(first);
+        QVERIFY(startPlayer(player, SOURCE));
+        SimulatedMediaPlayer *simulated = SimulatedBackend::player(&player);
+        QVERIFY(simulated);
+
+        delete first;
+        QVERIFY(waitUntil([&] { return player.playbackState() == AndroidMediaPlayer::PlaybackState::Paused; }));
+        QVERIFY(simulated->isSuspended());
+        const long position = player.currentPosition();
+
+        QSurfaceTexture second(harness.contentItem());
+        second.setSize(WINDOW_SIZE);
+        player.setSurfaceView(&second);
+        harness.renderFrame();
+        QVERIFY(waitUntil([&] { return resumed.count() == 1; }));
+        QCOMPARE(player.playbackState(), AndroidMediaPlayer::PlaybackState::Started);
+        QVERIFY(!simulated->isSuspended());
+        QCOMPARE(SimulatedBackend::player(&player), simulated);
+        QCOMPARE(simulated->stats().prepares, int64_t(1));
+        QCOMPARE(simulated->stats().errors, int64_t(0));
+        QVERIFY(player.surfaceResumeLatency() < PREPARE_MS);
+        QVERIFY(player.currentPosition() >= position);
+    }
+
+private:
+    // Returns the ms from attaching the new surface to its first frame, -1
+    // on failure.
+    qint64 resumeByDetach()
+    {
+        AndroidMediaPlayer player;
+        QSignalSpy resumed(&player, &AndroidMediaPlayer::surfaceResumeLatencyChanged);
+        SimulatedMediaPlayer *simulated = SimulatedBackend::player(&player);
+        if (!simulated) {
+            return -1;
+        }
+        simulated->setSurface(std::make_shared<FrameLog>());
+        if (!startPlayer(player, SOURCE)) {
+            return -1;
+        }
+
+        simulated->detachSurface();
+        if (!waitUntil([&] { return player.playbackState() == AndroidMediaPlayer::PlaybackState::Paused; })) {
+            return -1;
+        }
+        const long position = player.currentPosition();
+        const auto surface = std::make_shared<FrameLog>();
+        const qint64 attached = Looper::uptimeMs();
+        simulated->attachSurface(surface);
+        const qint64 firstFrame = firstFrameMs(*surface);
+        if (firstFrame < 0 || !waitUntil([&] { return resumed.count() == 1; })) {
+            return -1;
+        }
+
+        // the decoder was kept, playback goes on where it stopped
+        const bool kept = simulated->stats().prepares == 1
+                && simulated->stats().errors == 0
+                && player.playbackState() == AndroidMediaPlayer::PlaybackState::Started
+                && surface->frames().front().positionMs >= position
+                && player.surfaceResumeLatency() <= firstFrame - attached + 100;
+        return kept ? firstFrame - attached : -1;
+    }
+
+    qint64 resumeByReprepare()
+    {
+        AndroidMediaPlayer player;
+        QSignalSpy error(&player, &AndroidMediaPlayer::error);
+        SimulatedMediaPlayer *simulated = SimulatedBackend::player(&player);
+        if (!simulated) {
+            return -1;
+        }
+        simulated->setSurface(std::make_shared<FrameLog>());
+        if (!startPlayer(player, SOURCE)) {
+            return -1;
+        }
+
+        // the surface went without a detach, AndroidMediaPlayer.onError()
+        // stops and resets
+        const long position = player.currentPosition();
+        simulated->injectError(MEDIA_ERROR_UNKNOWN, ERROR_SURFACE_LOST);
+        if (!waitUntil([&] { return error.count() == 1; })) {
+            return -1;
+        }
+        const auto surface = std::make_shared<FrameLog>();
+        const qint64 attached = Looper::uptimeMs();
+        simulated->setSurface(surface);
+        player.reset();
+        player.setDataSource(SOURCE);
+        if (!waitUntil([&] { return player.playbackState() == AndroidMediaPlayer::PlaybackState::Prepared; })) {
+            return -1;
+        }
+        player.seekTo(position);
+        player.start();
+        const qint64 firstFrame = firstFrameMs(*surface);
+        if (firstFrame < 0 || surface->frames().front().positionMs < position) {
+            return -1;
+        }
+        return firstFrame - attached;
+    }
+};
+
+QTEST_MAIN(TestSurfaceResume)
+#include "test_surface_resume.moc"
@@ -0,0 +1,227 @@
+// The test-pattern backend feeding SurfaceTexture-like consumers: a render
+// thread latches the newest frame, paints it at its own buffer size and reads
+// the marker back like QSurfaceTexture does. Every frame shown has to decode,
+// come in order and be recent, a slow consumer drops frames instead of
+// falling behind.
+
+#include "Check.h"
+#include "PlayerEvents.h"
+
+#include <condition_variable>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Stands in for QSurfaceTexture on android.graphics.SurfaceTexture: post()
+// keeps the newest frame and signals frameAvailable, the render thread paints
+// it in updateTexImage() and decodes the marker from the buffer like
+// QSurfaceTexture::readMarker().
+class TextureConsumer : public SimulatedMediaPlayer::Surface
+{
+public:
+    struct Stats
+    {
+        std::vector<int64_t> shown;
+        int64_t maxLatencyMs = 0;
+        int decodeErrors = 0;
+        int64_t dropped = 0;
+    };
+
+    TextureConsumer(int width, int height, int64_t renderMs) :
+        mWidth(width),
+        mHeight(height),
+        mRenderMs(renderMs),
+        mPixels(size_t(width) * size_t(height)),
+        mThread(&TextureConsumer::run, this)
+    {
+    }
+
+    ~TextureConsumer() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mAvailable.notify_all();
+        mThread.join();
+    }
+
+    void post(const SimulatedMediaPlayer::Frame &frame) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mPending = true;
+            mFrame = frame;
+            mSpec = *frame.spec;
+        }
+        mAvailable.notify_all();
+    }
+
+    Stats stats() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mStats;
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        for (;;) {
+            mAvailable.wait(lock, [this] { return mPending || mStop; });
+            if (mStop) {
+                return;
+            }
+            mPending = false;
+            const SimulatedMediaPlayer::Frame frame = mFrame;
+            const TestPattern::Spec spec = mSpec;
+            lock.unlock();
+
+            // updateTexImage(), then the frame is drawn and read back
+            TestPattern::paint(mPixels.data(), mWidth, mHeight, mWidth, spec, frame.index, frame.uptimeMs);
+            std::this_thread::sleep_for(std::chrono::milliseconds(mRenderMs));
+            uint64_t marker = 0;
+            const bool decoded = TestPattern::decode(mPixels.data() + TestPattern::markerRow(mWidth, 0) * mWidth,
+                                                     mPixels.data() + TestPattern::markerRow(mWidth, 1) * mWidth,
+                                                     mWidth, &marker);
+            const int64_t latencyMs = int64_t(uint32_t(uint32_t(Looper::uptimeMs()) - uint32_t(marker)));
+
+            lock.lock();
+            if (!decoded) {
+                ++mStats.decodeErrors;
+                continue;
+            }
+            const int64_t index = int64_t(marker >> 32);
+            if (!mStats.shown.empty() && index > mStats.shown.back() + 1) {
+                mStats.dropped += index - mStats.shown.back() - 1;
+            }
+            mStats.shown.push_back(index);
+            mStats.maxLatencyMs = std::max(mStats.maxLatencyMs, latencyMs);
+        }
+    }
+
+    const int mWidth;
+    const int mHeight;
+    const int64_t mRenderMs;
+    mutable std::mutex mMutex;
+    std::condition_variable mAvailable;
+    bool mPending = false;
+    bool mStop = false;
+    SimulatedMediaPlayer::Frame mFrame{};
+    TestPattern::Spec mSpec;
+    Stats mStats;
+    // render thread
+    std::vector<uint32_t> mPixels;
+    std::thread mThread;
+};
+
+// Plays source to the end onto consumer.
+bool play(SimulatedMediaPlayer &player, const std::string &source, const std::shared_ptr<TextureConsumer> &consumer,
+          const std::shared_ptr<PlayerEvents> &events)
+{
+    player.setEventListener(events);
+    player.setSurface(consumer);
+    if (!player.setDataSource(source)) {
+        return false;
+    }
+    player.prepare(0);
+    if (!events->waitFor("prepared")) {
+        return false;
+    }
+    player.start();
+    return events->waitFor("finished");
+}
+
+bool inOrder(const std::vector<int64_t> &shown)
+{
+    for (size_t i = 1; i < shown.size(); ++i) {
+        if (shown[i] <= shown[i - 1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void testConsumer(int width, int height)
+{
+    SimulatedMediaPlayer player;
+    const auto consumer = std::make_shared<TextureConsumer>(width, height, 0);
+    CHECK(play(player, "testpattern:320x180@50/400", consumer, std::make_shared<PlayerEvents>()));
+    // let the render thread catch up with the last frame
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const TextureConsumer::Stats stats = consumer->stats();
+    CHECK_EQ(stats.decodeErrors, 0);
+    CHECK_NEAR(double(stats.shown.size()), 20, 3);
+    CHECK(inOrder(stats.shown));
+    // a busy machine may hold the render thread back a frame or two
+    CHECK(stats.dropped <= 2);
+    CHECK(stats.maxLatencyMs < 100);
+}
+
+void testSeveralConsumers()
+{
+    const int fps[] = {25, 30, 50, 60};
+    std::vector<std::unique_ptr<SimulatedMediaPlayer>> players;
+    std::vector<std::shared_ptr<TextureConsumer>> consumers;
+    std::vector<std::shared_ptr<PlayerEvents>> events;
+    for (const int rate : fps) {
+        players.emplace_back(new SimulatedMediaPlayer);
+        consumers.push_back(std::make_shared<TextureConsumer>(640, 360, 0));
+        events.push_back(std::make_shared<PlayerEvents>());
+        players.back()->setEventListener(events.back());
+        players.back()->setSurface(consumers.back());
+        CHECK(players.back()->setDataSource("testpattern:320x180@" + std::to_string(rate) + "/500"));
+        players.back()->prepare(0);
+    }
+    for (size_t i = 0; i < players.size(); ++i) {
+        CHECK(events[i]->waitFor("prepared"));
+        players[i]->start();
+    }
+    for (size_t i = 0; i < players.size(); ++i) {
+        CHECK(events[i]->waitFor("finished"));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    for (size_t i = 0; i < players.size(); ++i) {
+        const TextureConsumer::Stats stats = consumers[i]->stats();
+        CHECK_EQ(stats.decodeErrors, 0);
+        CHECK(inOrder(stats.shown));
+        // each consumer sees its own stream, at most a few frames lost to
+        // the other render threads
+        const double frames = fps[i] / 2.0;
+        CHECK_NEAR(double(stats.shown.size() + size_t(stats.dropped)), frames, 3);
+        CHECK(stats.dropped <= 4);
+    }
+}
+
+// A SurfaceTexture keeps the newest frame only: a consumer slower than the
+// video shows fewer frames, all of them recent.
+void testSlowConsumer()
+{
+    const int64_t renderMs = 50;
+    SimulatedMediaPlayer player;
+    const auto consumer = std::make_shared<TextureConsumer>(640, 360, renderMs);
+    CHECK(play(player, "testpattern:320x180@60/600", consumer, std::make_shared<PlayerEvents>()));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * renderMs));
+    const TextureConsumer::Stats stats = consumer->stats();
+    CHECK_EQ(stats.decodeErrors, 0);
+    CHECK(inOrder(stats.shown));
+    CHECK_NEAR(double(stats.shown.size()), 600.0 / renderMs, 4);
+    CHECK(stats.dropped >= 20);
+    // the frame a slow render started with plus one frame interval
+    CHECK(stats.maxLatencyMs < renderMs + 17 + 50);
+}
+
+}
+
+int main()
+{
+    // the video size, then scaled up like a SurfaceTexture with a default
+    // buffer size or a window bigger than the video
+    testConsumer(320, 180);
+    testConsumer(1280, 720);
+    testSeveralConsumers();
+    testSlowConsumer();
+    return Check::result("test_test_pattern");
+}
@@ -0,0 +1,95 @@
+// Keyframe-only trick play on the simulated backend: the speed achieved has
+// to follow the requested rate whatever the seeks cost, only the frames shown
+// per second drop when a seek takes longer than the budget.
+
+#include "AndroidMediaPlayer.h"
+#include "QtWait.h"
+#include "SimulatedBackend.h"
+
+#include <QtTest>
+
+namespace {
+
+const int RUN_MS = 3000;
+// the timer and the looper add to the seek time of every frame
+const int OVERHEAD_MS = 30;
+
+}
+
+class TestTrickPlay : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        SimulatedBackend::install();
+    }
+
+    void speed_data()
+    {
+        QTest::addColumn<QString>("source");
+        QTest::addColumn<qint64>("from");
+        QTest::addColumn<qreal>("rate");
+        QTest::addColumn<int>("budget");
+        QTest::addColumn<int>("seekMs");
+        QTest::newRow("8x, fast seeks") << "sim:600000?keyframes=500&seek=20" << qint64(0) << 8.0 << 100 << 20;
+        QTest::newRow("8x, seeks over budget") << "sim:600000?keyframes=500&seek=250" << qint64(0) << 8.0 << 100 << 250;
+        QTest::newRow("32x, sparse keyframes") << "sim:600000?keyframes=2000&seek=20" << qint64(0) << 32.0 << 100 << 20;
+        QTest::newRow("-8x") << "sim:600000?keyframes=500&seek=20" << qint64(300000) << -8.0 << 100 << 20;
+    }
+
+    void speed()
+    {
+        QFETCH(QString, source);
+        QFETCH(qint64, from);
+        QFETCH(qreal, rate);
+        QFETCH(int, budget);
+        QFETCH(int, seekMs);
+        AndroidMediaPlayer player;
+        player.setDataSource(source);
+        QVERIFY(waitUntil([&] { return player.playbackState() == AndroidMediaPlayer::PlaybackState::Prepared; }));
+        player.start();
+        QVERIFY(waitUntil([&] { return player.playbackState() == AndroidMediaPlayer::PlaybackState::Started; }));
+        if (from > 0) {
+            player.seekTo(long(from));
+            QVERIFY(waitUntil([&] { return player.currentPosition() >= from; }));
+        }
+
+        player.setTrickPlayBudget(budget);
+        player.setTrickPlayRate(rate);
+        runEventsFor(RUN_MS);
+        const QVariantMap stats = player.trickPlayStats();
+        qInfo("%s at %gx: %.2fx achieved, %.1f frames/s, %d frames, %lld skipped, %lld over budget, seek %.1f ms",
+              qPrintable(source), rate, stats.value("achievedSpeed").toDouble(), stats.value("framesPerSecond").toDouble(),
+              stats.value("frames").toInt(), stats.value("skippedKeyframes").toLongLong(),
+              stats.value("overBudget").toLongLong(), stats.value("meanSeekMs").toDouble());
+
+        // the rate holds to within the last frame step, a shown frame may be
+        // up to a budget and a seek behind the target
+        const qreal lag = qAbs(rate) * (qMax(budget, seekMs) + OVERHEAD_MS) / RUN_MS;
+        QVERIFY(qAbs(stats.value("achievedSpeed").toDouble() - rate) <= lag + qAbs(rate) * 0.1);
+
+        // a frame per budget, or per seek when seeks take longer
+        const qreal fps = stats.value("framesPerSecond").toDouble();
+        QVERIFY(fps <= 1000.0 / budget * 1.1);
+        QVERIFY(fps >= 1000.0 / (qMax(budget, seekMs) + OVERHEAD_MS) * 0.7);
+        if (seekMs > budget) {
+            QVERIFY(stats.value("overBudget").toLongLong() >= stats.value("frames").toLongLong() - 1);
+            // the frames in between are skipped, not shown late
+            QVERIFY(stats.value("skippedKeyframes").toLongLong() > 0);
+        } else {
+            QCOMPARE(stats.value("overBudget").toLongLong(), qlonglong(0));
+        }
+
+        // back to normal playback from the frame shown
+        player.setTrickPlayRate(0);
+        QCOMPARE(player.trickPlayRate(), qreal(0));
+        QVERIFY(waitUntil([&] { return player.playbackState() == AndroidMediaPlayer::PlaybackState::Started; }));
+        const qint64 reached = from + qint64(rate * RUN_MS);
+        QVERIFY(qAbs(player.currentPosition() - reached) <= qAbs(rate) * (qMax(budget, seekMs) + OVERHEAD_MS) + 1000);
+    }
+};
+
+QTEST_MAIN(TestTrickPlay)
+#include "test_trick_play.moc"
@@ -0,0 +1,354 @@
+#include "AesCtr.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PLAYER_HAS_AESNI 1
+#include <wmmintrin.h>
+#endif
+
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+#define PLAYER_HAS_ARM_CRYPTO 1
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_AES
+#define HWCAP_AES (1 << 3)
+#endif
+#endif
+
+namespace {
+
+struct Tables {
+    quint8 sbox[256];
+    quint32 te[4][256];
+
+    Tables()
+    {
+        // build the S-box from the multiplicative inverse in GF(2^8)
+        quint8 p = 1;
+        quint8 q = 1;
+        do {
+            p = quint8(p ^ (p << 1) ^ ((p & 0x80) ? 0x1b : 0));
+            q ^= q << 1;
+            q ^= q << 2;
+            q ^= q << 4;
+            if (q & 0x80) {
+                q ^= 0x09;
+            }
+            const quint8 x = q ^ rotl(q, 1) ^ rotl(q, 2) ^ rotl(q, 3) ^ rotl(q, 4);
+            sbox[p] = x ^ 0x63;
+        } while (p != 1);
+        sbox[0] = 0x63;
+
+        for (int i = 0; i < 256; ++i) {
+            const quint32 s = sbox[i];
+            const quint32 s2 = xtime(quint8(s));
+            const quint32 s3 = s2 ^ s;
+            te[0][i] = (s2 << 24) | (s << 16) | (s << 8) | s3;
+            for (int t = 1; t < 4; ++t) {
+                te[t][i] = (te[t - 1][i] >> 8) | (te[t - 1][i] << 24);
+            }
+        }
+    }
+
+    static quint8 rotl(quint8 x, int shift)
+    {
+        return quint8((x << shift) | (x >> (8 - shift)));
+    }
+
+    static quint8 xtime(quint8 x)
+    {
+        return quint8((x << 1) ^ ((x & 0x80) ? 0x1b : 0));
+    }
+};
+
+const Tables &tables()
+{
+    static const Tables tables;
+    return tables;
+}
+
+inline quint32 load32(const quint8 *p)
+{
+    return (quint32(p[0]) << 24) | (quint32(p[1]) << 16) | (quint32(p[2]) << 8) | quint32(p[3]);
+}
+
+inline void store32(quint8 *p, quint32 v)
+{
+    p[0] = quint8(v >> 24);
+    p[1] = quint8(v >> 16);
+    p[2] = quint8(v >> 8);
+    p[3] = quint8(v);
+}
+
+using Block = std::array<quint8, 16>;
+
+void encryptBlocksScalar(const quint8 *roundKeys, int rounds, const Block *in, Block *out, int count)
+{
+    const Tables &t = tables();
+    quint32 rk[15 * 4];
+    for (int i = 0; i < (rounds + 1) * 4; ++i) {
+        rk[i] = load32(roundKeys + 4 * i);
+    }
+
+    for (int b = 0; b < count; ++b) {
+        quint32 s0 = load32(in[b].data()) ^ rk[0];
+        quint32 s1 = load32(in[b].data() + 4) ^ rk[1];
+        quint32 s2 = load32(in[b].data() + 8) ^ rk[2];
+        quint32 s3 = load32(in[b].data() + 12) ^ rk[3];
+
+        for (int r = 1; r < rounds; ++r) {
+            const quint32 *k = rk + 4 * r;
+            const quint32 t0 = t.te[0][s0 >> 24] ^ t.te[1][(s1 >> 16) & 0xff] ^ t.te[2][(s2 >> 8) & 0xff] ^ t.te[3][s3 & 0xff] ^ k[0];
+            const quint32 t1 = t.te[0][s1 >> 24] ^ t.te[1][(s2 >> 16) & 0xff] ^ t.te[2][(s3 >> 8) & 0xff] ^ t.te[3][s0 & 0xff] ^ k[1];
+            const quint32 t2 = t.te[0][s2 >> 24] ^ t.te[1][(s3 >> 16) & 0xff] ^ t.te[2][(s0 >> 8) & 0xff] ^ t.te[3][s1 & 0xff] ^ k[2];
+            const quint32 t3 = t.te[0][s3 >> 24] ^ t.te[1][(s0 >> 16) & 0xff] ^ t.te[2][(s1 >> 8) & 0xff] ^ t.te[3][s2 & 0xff] ^ k[3];
+            s0 = t0;
+            s1 = t1;
+            s2 = t2;
+            s3 = t3;
+        }
+
+        // the last round has no MixColumns
+        const quint32 *k = rk + 4 * rounds;
+        const quint8 *sb = t.sbox;
+        store32(out[b].data(), ((quint32(sb[s0 >> 24]) << 24) | (quint32(sb[(s1 >> 16) & 0xff]) << 16)
+                                | (quint32(sb[(s2 >> 8) & 0xff]) << 8) | sb[s3 & 0xff]) ^ k[0]);
+        store32(out[b].data() + 4, ((quint32(sb[s1 >> 24]) << 24) | (quint32(sb[(s2 >> 16) & 0xff]) << 16)
+                                    | (quint32(sb[(s3 >> 8) & 0xff]) << 8) | sb[s0 & 0xff]) ^ k[1]);
+        store32(out[b].data() + 8, ((quint32(sb[s2 >> 24]) << 24) | (quint32(sb[(s3 >> 16) & 0xff]) << 16)
+                                    | (quint32(sb[(s0 >> 8) & 0xff]) << 8) | sb[s1 & 0xff]) ^ k[2]);
+        store32(out[b].data() + 12, ((quint32(sb[s3 >> 24]) << 24) | (quint32(sb[(s0 >> 16) & 0xff]) << 16)
+                                     | (quint32(sb[(s1 >> 8) & 0xff]) << 8) | sb[s2 & 0xff]) ^ k[3]);
+    }
+}
+
+#ifdef PLAYER_HAS_AESNI
+__attribute__((target("aes,sse2")))
+void encryptBlocksAesNi(const quint8 *roundKeys, int rounds, const Block *in, Block *out, int count)
+{
+    __m128i rk[15];
+    for (int r = 0; r <= rounds; ++r) {
+        rk[r] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(roundKeys + 16 * r));
+    }
+
+    int b = 0;
+    // four independent blocks keep the AES unit busy
+    for (; b + 4 <= count; b += 4) {
+        __m128i x0 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in[b].data())), rk[0]);
+        __m128i x1 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in[b + 1].data())), rk[0]);
+        __m128i x2 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in[b + 2].data())), rk[0]);
+        __m128i x3 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in[b + 3].data())), rk[0]);
+        for (int r = 1; r < rounds; ++r) {
+            x0 = _mm_aesenc_si128(x0, rk[r]);
+            x1 = _mm_aesenc_si128(x1, rk[r]);
+            x2 = _mm_aesenc_si128(x2, rk[r]);
+            x3 = _mm_aesenc_si128(x3, rk[r]);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out[b].data()), _mm_aesenclast_si128(x0, rk[rounds]));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out[b + 1].data()), _mm_aesenclast_si128(x1, rk[rounds]));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out[b + 2].data()), _mm_aesenclast_si128(x2, rk[rounds]));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out[b + 3].data()), _mm_aesenclast_si128(x3, rk[rounds]));
+    }
+    for (; b < count; ++b) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in[b].data())), rk[0]);
+        for (int r = 1; r < rounds; ++r) {
+            x = _mm_aesenc_si128(x, rk[r]);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out[b].data()), _mm_aesenclast_si128(x, rk[rounds]));
+    }
+}
+#endif
+
+#ifdef PLAYER_HAS_ARM_CRYPTO
+void encryptBlocksArmCrypto(const quint8 *roundKeys, int rounds, const Block *in, Block *out, int count)
+{
+    uint8x16_t rk[15];
+    for (int r = 0; r <= rounds; ++r) {
+        rk[r] = vld1q_u8(roundKeys + 16 * r);
+    }
+
+    int b = 0;
+    for (; b + 4 <= count; b += 4) {
+        uint8x16_t x0 = vld1q_u8(in[b].data());
+        uint8x16_t x1 = vld1q_u8(in[b + 1].data());
+        uint8x16_t x2 = vld1q_u8(in[b + 2].data());
+        uint8x16_t x3 = vld1q_u8(in[b + 3].data());
+        // AESE is AddRoundKey + SubBytes + ShiftRows, AESMC is MixColumns
+        for (int r = 0; r < rounds - 1; ++r) {
+            x0 = vaesmcq_u8(vaeseq_u8(x0, rk[r]));
+            x1 = vaesmcq_u8(vaeseq_u8(x1, rk[r]));
+            x2 = vaesmcq_u8(vaeseq_u8(x2, rk[r]));
+            x3 = vaesmcq_u8(vaeseq_u8(x3, rk[r]));
+        }
+        vst1q_u8(out[b].data(), veorq_u8(vaeseq_u8(x0, rk[rounds - 1]), rk[rounds]));
+        vst1q_u8(out[b + 1].data(), veorq_u8(vaeseq_u8(x1, rk[rounds - 1]), rk[rounds]));
+        vst1q_u8(out[b + 2].data(), veorq_u8(vaeseq_u8(x2, rk[rounds - 1]), rk[rounds]));
+        vst1q_u8(out[b + 3].data(), veorq_u8(vaeseq_u8(x3, rk[rounds - 1]), rk[rounds]));
+    }
+    for (; b < count; ++b) {
+        uint8x16_t x = vld1q_u8(in[b].data());
+        for (int r = 0; r < rounds - 1; ++r) {
+            x = vaesmcq_u8(vaeseq_u8(x, rk[r]));
+        }
+        vst1q_u8(out[b].data(), veorq_u8(vaeseq_u8(x, rk[rounds - 1]), rk[rounds]));
+    }
+}
+#endif
+
+}
+
+AesCtr::AesCtr(const quint8 *key, int keySize, const quint8 *iv) :
+    mRounds(0)
+{
+    memset(mRoundKeys, 0, sizeof(mRoundKeys));
+    memcpy(mIv.data(), iv, mIv.size());
+    setImplementation(detectImplementation());
+
+    if (keySize != 16 && keySize != 24 && keySize != 32) {
+        return;
+    }
+
+    // FIPS-197 key expansion
+    const quint8 *sbox = tables().sbox;
+    const int nk = keySize / 4;
+    mRounds = nk + 6;
+    memcpy(mRoundKeys, key, size_t(keySize));
+    quint8 rcon = 1;
+    for (int i = nk; i < 4 * (mRounds + 1); ++i) {
+        quint8 temp[4];
+        memcpy(temp, mRoundKeys + 4 * (i - 1), 4);
+        if (i % nk == 0) {
+            const quint8 first = temp[0];
+            temp[0] = sbox[temp[1]] ^ rcon;
+            temp[1] = sbox[temp[2]];
+            temp[2] = sbox[temp[3]];
+            temp[3] = sbox[first];
+            rcon = quint8((rcon << 1) ^ ((rcon & 0x80) ? 0x1b : 0));
+        } else if (nk > 6 && i % nk == 4) {
+            for (quint8 &byte : temp) {
+                byte = sbox[byte];
+            }
+        }
+        for (int j = 0; j < 4; ++j) {
+            mRoundKeys[4 * i + j] = mRoundKeys[4 * (i - nk) + j] ^ temp[j];
+        }
+    }
+}
+
+bool AesCtr::isValid() const
+{
+    return mRounds > 0;
+}
+
+AesCtr::Implementation AesCtr::implementation() const
+{
+    return mImplementation;
+}
+
+const char *AesCtr::implementationName(Implementation implementation)
+{
+    switch (implementation) {
+    case Implementation::AesNi:
+        return "aes-ni";
+    case Implementation::ArmCrypto:
+        return "armv8-crypto";
+    case Implementation::Scalar:
+        break;
+    }
+    return "scalar";
+}
+
+void AesCtr::apply(qint64 position, quint8 *data, qint64 size) const
+{
+    if (!isValid() || position < 0) {
+        return;
+    }
+
+    const int BATCH_BLOCKS = 32;
+    Block counters[BATCH_BLOCKS];
+    Block keystream[BATCH_BLOCKS];
+
+    quint64 blockIndex = quint64(position) / 16;
+    int skip = int(position % 16);
+    while (size > 0) {
+        const int count = int(qMin<qint64>(BATCH_BLOCKS, (skip + size + 15) / 16));
+        for (int i = 0; i < count; ++i) {
+            counterBlock(blockIndex + quint64(i), counters[i]);
+        }
+        mEncryptBlocks(mRoundKeys, mRounds, counters, keystream, count);
+
+        const quint8 *stream = keystream[0].data() + skip;
+        const qint64 bytes = qMin<qint64>(size, qint64(count) * 16 - skip);
+        qint64 i = 0;
+        for (; i + 8 <= bytes; i += 8) {
+            quint64 d;
+            quint64 k;
+            memcpy(&d, data + i, 8);
+            memcpy(&k, stream + i, 8);
+            d ^= k;
+            memcpy(data + i, &d, 8);
+        }
+        for (; i < bytes; ++i) {
+            data[i] ^= stream[i];
+        }
+
+        data += bytes;
+        size -= bytes;
+        blockIndex += quint64(count);
+        skip = 0;
+    }
+}
+
+AesCtr::Implementation AesCtr::detectImplementation()
+{
+#ifdef PLAYER_HAS_AESNI
+    if (__builtin_cpu_supports("aes")) {
+        return Implementation::AesNi;
+    }
+#endif
+#ifdef PLAYER_HAS_ARM_CRYPTO
+    if (getauxval(AT_HWCAP) & HWCAP_AES) {
+        return Implementation::ArmCrypto;
+    }
+#endif
+    return Implementation::Scalar;
+}
+
+void AesCtr::setImplementation(Implementation implementation)
+{
+    mImplementation = Implementation::Scalar;
+    mEncryptBlocks = encryptBlocksScalar;
+    switch (implementation) {
+    case Implementation::AesNi:
+#ifdef PLAYER_HAS_AESNI
+        mImplementation = implementation;
+        mEncryptBlocks = encryptBlocksAesNi;
+#endif
+        break;
+    case Implementation::ArmCrypto:
+#ifdef PLAYER_HAS_ARM_CRYPTO
+        mImplementation = implementation;
+        mEncryptBlocks = encryptBlocksArmCrypto;
+#endif
+        break;
+    case Implementation::Scalar:
+        break;
+    }
+}
+
+void AesCtr::counterBlock(quint64 blockIndex, Block &block) const
+{
+    // 128-bit big-endian addition of the block index to the IV
+    block = mIv;
+    unsigned carry = 0;
+    for (int i = 15; i >= 0; --i) {
+        const unsigned sum = unsigned(block[size_t(i)]) + unsigned(blockIndex & 0xff) + carry;
+        block[size_t(i)] = quint8(sum);
+        carry = sum >> 8;
+        blockIndex >>= 8;
+        if (!blockIndex && !carry) {
+            break;
+        }
+    }
+}
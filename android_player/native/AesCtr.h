@@ -0,0 +1,53 @@
+#ifndef AESCTR_H
+#define AESCTR_H
+
+#include <QtGlobal>
+
+#include <array>
+
+// AES in counter mode with random access: the keystream for any byte offset
+// can be produced without touching the bytes before it, so a data source can
+// decrypt exactly the range that MediaPlayer asks for.
+//
+// The counter is the 128-bit big-endian IV plus the block index. Blocks are
+// encrypted with AES-NI on x86, the ARMv8 crypto extension on aarch64, or a
+// table-based implementation when neither is available.
+class AesCtr
+{
+public:
+    enum class Implementation {
+        Scalar,
+        AesNi,
+        ArmCrypto
+    };
+
+    // key must be 16, 24 or 32 bytes, iv 16 bytes.
+    AesCtr(const quint8 *key, int keySize, const quint8 *iv);
+
+    bool isValid() const;
+    Implementation implementation() const;
+    static const char *implementationName(Implementation implementation);
+
+    // XORs the keystream for [position, position + size) into data.
+    void apply(qint64 position, quint8 *data, qint64 size) const;
+
+    // Picks the fastest implementation supported by the CPU.
+    static Implementation detectImplementation();
+    // Forces an implementation, the CPU must support it.
+    void setImplementation(Implementation implementation);
+
+private:
+    using Block = std::array<quint8, 16>;
+    using EncryptBlocks = void (*)(const quint8 *roundKeys, int rounds, const Block *in, Block *out, int count);
+
+    void counterBlock(quint64 blockIndex, Block &block) const;
+
+    // 15 round keys are enough for AES-256
+    alignas(16) quint8 mRoundKeys[15 * 16];
+    int mRounds;
+    Block mIv;
+    Implementation mImplementation;
+    EncryptBlocks mEncryptBlocks;
+};
+
+#endif // AESCTR_H
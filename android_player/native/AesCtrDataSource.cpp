@@ -0,0 +1,26 @@
+#include "AesCtrDataSource.h"
+
+AesCtrDataSource::AesCtrDataSource(std::shared_ptr<MediaDataSource> source, const AesCtr &cipher) :
+    mSource(std::move(source)),
+    mCipher(cipher)
+{
+}
+
+qint64 AesCtrDataSource::readAt(qint64 position, char *buffer, qint64 size)
+{
+    const qint64 result = mSource->readAt(position, buffer, size);
+    if (result > 0) {
+        mCipher.apply(position, reinterpret_cast<quint8 *>(buffer), result);
+    }
+    return result;
+}
+
+qint64 AesCtrDataSource::size() const
+{
+    return mSource->size();
+}
+
+qint64 AesCtrDataSource::memoryUsage() const
+{
+    return mSource->memoryUsage();
+}
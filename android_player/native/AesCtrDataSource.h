@@ -0,0 +1,23 @@
+#ifndef AESCTRDATASOURCE_H
+#define AESCTRDATASOURCE_H
+
+#include "AesCtr.h"
+#include "MediaDataSource.h"
+
+// Decrypts an AES-CTR encrypted source on the fly. Reads land in MediaPlayer's
+// buffer and are decrypted in place, so no plaintext copy of the media is kept.
+class AesCtrDataSource : public MediaDataSource
+{
+public:
+    AesCtrDataSource(std::shared_ptr<MediaDataSource> source, const AesCtr &cipher);
+
+    qint64 readAt(qint64 position, char *buffer, qint64 size) override;
+    qint64 size() const override;
+    qint64 memoryUsage() const override;
+
+private:
+    std::shared_ptr<MediaDataSource> mSource;
+    const AesCtr mCipher;
+};
+
+#endif // AESCTRDATASOURCE_H
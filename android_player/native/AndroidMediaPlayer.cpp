@@ -1,10 +1,22 @@
 #include "AndroidMediaPlayer.h"
+#include "AesCtrDataSource.h"
 #include "AndroidSurfaceView.h"
+#include "FileDataSource.h"
+#include "MemoryDataSource.h"
+#include "MemoryPressure.h"
+#include "PlayerLog.h"
 #include "QSurfaceTexture.h"
+#include "ResumeStore.h"
+#include "Trace.h"
 #include "com_vadim_android_NativeMediaPlayerEventListener.h"
 
 #include <QtAndroid>
 #include <QAndroidJniEnvironment>
+#include <QCoreApplication>
+#include <QUrl>
+#include <QtConcurrent>
+
+#include <algorithm>
 
 const static auto EVENT_LISTENER = std::make_tuple("setEventListener",
                                                    "(Lcom/vadim/android/MediaPlayerEventListener;)V");
@@ -17,22 +29,113 @@ enum MediaError {
     MEDIA_ERROR_UNSUPPORTED = -1010,
     MEDIA_ERROR_TIMED_OUT = -110
 };
+// android.media.MediaDataSource is available since API 23
+const static int MEDIA_DATA_SOURCE_MIN_SDK = 23;
+const static int PROGRESS_INTERVAL_MS = 500;
+// initial guess of how long a seek takes, refined by every completed seek
+const static qint64 INITIAL_SEEK_LATENCY_MS = 100;
+// how long before the end of a playlist part the next one is prepared
+const static qint64 PREPARE_NEXT_PART_AHEAD_MS = 5000;
+// how often the position of a playing source is saved for resumePlayback
+const static qint64 RESUME_SAVE_INTERVAL_MS = 5000;
+// delay before the first recovery attempt, doubled for every further attempt
+const static int RECOVERY_BASE_DELAY_MS = 250;
+const static int RECOVERY_MAX_DELAY_MS = 8000;
+const static int DEFAULT_MAX_RECOVERY_ATTEMPTS = 5;
+// playback that lasts this long after a recovery resets the backoff
+const static qint64 RECOVERY_STABLE_MS = 30000;
+// decoders render into the buffer queue of the surface, a SurfaceView sized
+// with setFixedSize or a SurfaceTexture: about two buffers the decoder keeps
+// dequeued and the three of the queue, freed when the decoder disconnects
+const static int ESTIMATED_DECODER_BUFFERS = 2;
+const static int ESTIMATED_QUEUE_BUFFERS = 3;
+// MediaPlayer reports a destroyed surface as MEDIA_ERROR_UNKNOWN with -ENODEV
+const static int ERROR_SURFACE_LOST = -19;
+// ten sync frames a second, about what a phone decoder sustains for 1080p
+// seeks while the display stays readable
+const static int DEFAULT_TRICK_PLAY_BUDGET_MS = 100;
+
+// every player alive, only touched on the GUI thread
+static QList<AndroidMediaPlayer *> &livePlayers()
+{
+    static QList<AndroidMediaPlayer *> players;
+    return players;
+}
 
 AndroidMediaPlayer::AndroidMediaPlayer(QObject *parent) :
     QObject(parent),
     mPlaybackState(PlaybackState::Idle),
     mUseRTPlayer(false),
-    mAutoStart(false)
+    mAutoStart(false),
+    mDuration(0),
+    mTimeToStall(-1),
+    mUseNativeDataSource(false),
+    mCacheClips(false),
+    mIoClient(IoScheduler::instance().createClient(
+                  QString::asprintf("AndroidMediaPlayer(%p)", static_cast<void *>(this)).toStdString())),
+    mLoops(false),
+    mLoopStart(-1),
+    mLoopEnd(-1),
+    mLoopSeekPending(false),
+    mLoopLead(0),
+    mLoopGap(0),
+    mSeekLatency(INITIAL_SEEK_LATENCY_MS),
+    mCurrentPart(0),
+    mPlaylistGeneration(0),
+    mPendingStartPosition(0),
+    mPlayAfterPrepare(false),
+    mNextPartRequested(false),
+    mBoundaryLatency(0),
+    mResumePlayback(false),
+    mLastPosition(0),
+    mRecoverFromErrors(false),
+    mMaxRecoveryAttempts(DEFAULT_MAX_RECOVERY_ATTEMPTS),
+    mRecoveryAttempt(0),
+    mSurfaceResumeLatency(0),
+    mSuspended(false),
+    mDecoderReleased(false),
+    mRestoreWithSurface(false),
+    mPlaybackRate(1),
+    mTrickPlayRate(0),
+    mTrickPlayBudget(DEFAULT_TRICK_PLAY_BUDGET_MS),
+    mTrickPlayOrigin(0),
+    mTrickPlayFrame(0),
+    mTrickPlaySeekPending(false),
+    mPlayAfterTrickPlay(false)
 {
+    mBufferingClock.start();
+    mProgressTimer.setInterval(PROGRESS_INTERVAL_MS);
+    connect(&mProgressTimer, &QTimer::timeout, this, &AndroidMediaPlayer::onProgressTimer);
+    mLoopTimer.setSingleShot(true);
+    mLoopTimer.setTimerType(Qt::PreciseTimer);
+    connect(&mLoopTimer, &QTimer::timeout, this, &AndroidMediaPlayer::onLoopTimer);
+    mRecoveryTimer.setSingleShot(true);
+    connect(&mRecoveryTimer, &QTimer::timeout, this, &AndroidMediaPlayer::onRecoveryTimer);
+    mTrickPlayTimer.setSingleShot(true);
+    mTrickPlayTimer.setTimerType(Qt::PreciseTimer);
+    connect(&mTrickPlayTimer, &QTimer::timeout, this, &AndroidMediaPlayer::onTrickPlayTimer);
     initAndroidPlayer();
     //    setUseRTPlayer(mUseRTPlayer);
+    livePlayers().append(this);
+    // starts listening for trim events
+    MemoryPressure::instance();
 }
 
 AndroidMediaPlayer::~AndroidMediaPlayer()
 {
-    mAndroidPlayer.callMethod<void>(std::get<0>(EVENT_LISTENER),
-                                    std::get<1>(EVENT_LISTENER),
-                                    nullptr);
+    livePlayers().removeOne(this);
+    if (const auto asv = dynamic_cast<AndroidSurfaceView *>(mSurfaceView.data())) {
+        // the Java player tolerates calls from the view after it was released
+        asv->postToView([](const QAndroidJniObject &view) {
+            TIME_CALL("async:setMediaPlayer");
+            view.callMethod<void>("setMediaPlayer",
+                                  "(Lcom/vadim/android/AndroidMediaPlayer;)V",
+                                  nullptr);
+        });
+    }
+    callPlayer<void>(std::get<0>(EVENT_LISTENER),
+                     std::get<1>(EVENT_LISTENER),
+                     nullptr);
     if (mPlaybackState != PlaybackState::Idle) {
         stop();
         reset();
@@ -52,25 +155,68 @@ AndroidMediaPlayer::PlaybackState AndroidMediaPlayer::playbackState() const
 
 void AndroidMediaPlayer::setDataSource(const QString &source, bool reinitBackend)
 {
-    qDebug() << Q_FUNC_INFO << "source:" << source;
+    cancelRecovery();
+    mLastPosition = 0;
+    if (!mPlaylist.isEmpty()) {
+        mPlaylist.clear();
+        mTimeline.reset(0);
+        ++mPlaylistGeneration;
+        emit playlistChanged(mPlaylist);
+    }
+    openDataSource(source, reinitBackend);
+}
 
+void AndroidMediaPlayer::openDataSource(const QString &source, bool reinitBackend)
+{
+    PLAYER_DEBUG(Player) << "source:" << source;
+    TRACE_SPAN("player", "setDataSource");
+
+    stopTrickPlay(false);
     mDataSource = source;
+    mDecoderReleased = false;
+    mPlaybackRate = 1;
+    mDuration = 0;
+    mTimeToStall = -1;
+    mBandwidthEstimator.reset();
     switch (mPlaybackState) {
     case PlaybackState::Idle:
         if (reinitBackend) {
             initAndroidPlayer();
         }
+        mNativeDataSource = createNativeDataSource(source);
+        if (!mNativeDataSource && !mContentKey.isEmpty()) {
+            // MediaPlayer would be handed the ciphertext
+            qWarning() << Q_FUNC_INFO << "encrypted media needs a local file and API"
+                       << MEDIA_DATA_SOURCE_MIN_SDK << source;
+            emit error("encrypted media can't be decrypted");
+            break;
+        }
         setPlaybackState(PlaybackState::Initialized);
-        mAndroidPlayer.callMethod<void>("setDataSource",
-                                        "(Ljava/lang/String;)V",
-                                        QAndroidJniObject::fromString(source).object());
+        if (mNativeDataSource) {
+            callPlayer<void>("setNativeDataSource",
+                             "(J)V",
+                             MediaDataSource::createJniHandle(mNativeDataSource));
+        } else {
+            callPlayer<void>("setDataSource",
+                             "(Ljava/lang/String;)V",
+                             QAndroidJniObject::fromString(source).object());
+        }
         {
             QAndroidJniEnvironment env;
             if (env->ExceptionCheck()) {
                 env->ExceptionClear();
                 emit error("setDataSource failed");
             } else {
-                mAndroidPlayer.callMethod<void>("prepare");
+                applyLooping();
+                // the start position is sought by the Java side as soon as the
+                // player is prepared, without a round trip through this thread
+                qint64 startPosition = mPendingStartPosition;
+                mPendingStartPosition = 0;
+                if (startPosition <= 0 && mResumePlayback && mPlaylist.isEmpty()) {
+                    startPosition = ResumeStore::instance().position(source);
+                }
+                Trace::asyncBegin("player", "prepare", this);
+                callPlayer<void>("prepare", "(J)V", jlong(startPosition));
             }
         }
         break;
@@ -82,12 +228,18 @@ void AndroidMediaPlayer::setDataSource(const QString &source, bool reinitBackend
 
 void AndroidMediaPlayer::pause()
 {
+    stopTrickPlay(false);
+    mSuspended = false;
+    mRestoreWithSurface = false;
     switch (mPlaybackState) {
     case PlaybackState::Started:
     case PlaybackState::Paused:
     case PlaybackState::PlaybackCompleted:
+        mLastPosition = currentPosition();
+        savePosition();
+        mLoopClock.invalidate();
         setPlaybackState(PlaybackState::Paused);
-        mAndroidPlayer.callMethod<void>("pause");
+        callPlayer<void>("pause");
         break;
     default:
         qWarning() << Q_FUNC_INFO << "player is in an invalid state: " << mPlaybackState;
@@ -97,20 +249,28 @@ void AndroidMediaPlayer::pause()
 
 void AndroidMediaPlayer::resume()
 {
+    stopTrickPlay(false);
+    if (mDecoderReleased) {
+        restoreDecoder(true);
+        return;
+    }
     setPlaybackState(PlaybackState::Started);
-    mAndroidPlayer.callMethod<void>("resume");
+    callPlayer<void>("resume");
 }
 
 void AndroidMediaPlayer::stop()
 {
+    stopTrickPlay(false);
     switch (mPlaybackState) {
     case PlaybackState::Prepared:
     case PlaybackState::Started:
     case PlaybackState::Stopped:
     case PlaybackState::Paused:
     case PlaybackState::PlaybackCompleted:
+        savePosition();
+        mLoopClock.invalidate();
         setPlaybackState(PlaybackState::Stopped);
-        mAndroidPlayer.callMethod<void>("stop");
+        callPlayer<void>("stop");
         break;
     default:
         qWarning() << Q_FUNC_INFO << "player is in an invalid state: " << mPlaybackState;
@@ -120,6 +280,10 @@ void AndroidMediaPlayer::stop()
 
 void AndroidMediaPlayer::reset()
 {
+    cancelRecovery();
+    stopTrickPlay(false);
+    mSuspended = false;
+    mDecoderReleased = false;
     switch (mPlaybackState) {
     case PlaybackState::Idle:
     case PlaybackState::Initialized:
@@ -130,7 +294,8 @@ void AndroidMediaPlayer::reset()
     case PlaybackState::PlaybackCompleted:
     case PlaybackState::Error:
         setPlaybackState(PlaybackState::Idle);
-        mAndroidPlayer.callMethod<void>("reset");
+        callPlayer<void>("reset");
+        mNextNativeDataSource.reset();
         break;
     default:
         qWarning() << Q_FUNC_INFO << "player is in an invalid state: " << mPlaybackState;
@@ -140,6 +305,15 @@ void AndroidMediaPlayer::reset()
 }
 
 long AndroidMediaPlayer::currentPosition()
+{
+    const long position = partPosition();
+    if (mPlaylist.isEmpty()) {
+        return position;
+    }
+    return long(mTimeline.partOffset(mCurrentPart) + position);
+}
+
+long AndroidMediaPlayer::partPosition()
 {
     switch (mPlaybackState) {
     case PlaybackState::Idle:
@@ -149,7 +323,7 @@ long AndroidMediaPlayer::currentPosition()
     case PlaybackState::Paused:
     case PlaybackState::Stopped:
     case PlaybackState::PlaybackCompleted:
-        return mAndroidPlayer.callMethod<jlong>("getCurrentPosition");
+        return callPlayer<jlong>("getCurrentPosition");
     default:
         qWarning() << Q_FUNC_INFO << "player is in an invalid state: " << mPlaybackState;
         break;
@@ -165,7 +339,10 @@ long long AndroidMediaPlayer::duration()
     case PlaybackState::Paused:
     case PlaybackState::Stopped:
     case PlaybackState::PlaybackCompleted:
-        return mAndroidPlayer.callMethod<jlong>("getDuration");
+        if (!mPlaylist.isEmpty()) {
+            return mTimeline.duration();
+        }
+        return callPlayer<jlong>("getDuration");
     default:
         qWarning() << Q_FUNC_INFO << "player is in an invalid state: " << mPlaybackState;
         break;
@@ -175,14 +352,31 @@ long long AndroidMediaPlayer::duration()
 
 void AndroidMediaPlayer::seekTo(long position)
 {
-    qDebug() << Q_FUNC_INFO;
+    PLAYER_DEBUG(Player);
+    mLastPosition = position;
+    stopTrickPlay(false);
+
+    if (mDecoderReleased) {
+        restoreDecoder(false);
+        return;
+    }
+    if (!mPlaylist.isEmpty()) {
+        const auto &&location = mTimeline.locate(position);
+        if (location.first != mCurrentPart) {
+            switchToPart(location.first, location.second, mPlaybackState == PlaybackState::Started);
+            return;
+        }
+        position = long(location.second);
+    }
 
     switch (mPlaybackState) {
     case PlaybackState::Prepared:
     case PlaybackState::Started:
     case PlaybackState::Paused:
     case PlaybackState::PlaybackCompleted:
-        mAndroidPlayer.callMethod<void>("seekTo", "(J)V", jlong(position));
+        mSeekClock.start();
+        Trace::asyncBegin("player", "seek", this);
+        callPlayer<void>("seekTo", "(J)V", jlong(position));
         break;
     default:
         qWarning() << Q_FUNC_INFO << "player is in an invalid state: " << mPlaybackState;
@@ -192,7 +386,13 @@ void AndroidMediaPlayer::seekTo(long position)
 
 void AndroidMediaPlayer::start()
 {
-    qDebug() << Q_FUNC_INFO;
+    PLAYER_DEBUG(Player);
+    mSuspended = false;
+    stopTrickPlay(false);
+    if (mDecoderReleased) {
+        restoreDecoder(true);
+        return;
+    }
 
     switch (mPlaybackState) {
     case PlaybackState::Prepared:
@@ -200,7 +400,8 @@ void AndroidMediaPlayer::start()
     case PlaybackState::Paused:
     case PlaybackState::PlaybackCompleted:
         setPlaybackState(PlaybackState::Started);
-        mAndroidPlayer.callMethod<void>("start", "()V");
+        callPlayer<void>("start", "()V");
+        scheduleLoop();
         break;
     default:
         qWarning() << Q_FUNC_INFO << "player is in an invalid state: " << mPlaybackState;
@@ -217,9 +418,9 @@ void AndroidMediaPlayer::setFillMode(AndroidMediaPlayer::VideoScalingMode mode)
     case PlaybackState::Paused:
     case PlaybackState::Stopped:
     case PlaybackState::PlaybackCompleted:
-        mAndroidPlayer.callMethod<void>("setVideoScalingMode",
-                                        "(I)V",
-                                        jint(mode));
+        callPlayer<void>("setVideoScalingMode",
+                         "(I)V",
+                         jint(mode));
         break;
     default:
         qWarning() << Q_FUNC_INFO << "player is in an invalid state: " << mPlaybackState;
@@ -237,6 +438,339 @@ bool AndroidMediaPlayer::autoStart() const
     return mAutoStart;
 }
 
+QVariantList AndroidMediaPlayer::bufferedRanges() const
+{
+    // MediaPlayer reports a single range growing from the beginning of the media
+    if (mBandwidthEstimator.bufferedMs() <= 0) {
+        return {};
+    }
+    return {QVariantMap{{"start", 0}, {"end", mBandwidthEstimator.bufferedMs()}}};
+}
+
+qreal AndroidMediaPlayer::bufferingRate() const
+{
+    return mBandwidthEstimator.bufferingRate();
+}
+
+qint64 AndroidMediaPlayer::timeToStall() const
+{
+    return mTimeToStall;
+}
+
+bool AndroidMediaPlayer::useNativeDataSource() const
+{
+    return mUseNativeDataSource;
+}
+
+int AndroidMediaPlayer::ioPriority() const
+{
+    return mIoClient->priority();
+}
+
+QVariantMap AndroidMediaPlayer::ioStats() const
+{
+    for (const auto &stats : IoScheduler::instance().stats()) {
+        if (stats.name != mIoClient->name()) {
+            continue;
+        }
+        QVariantList buckets;
+        for (int i = 0; i < LatencyHistogram::BucketCount; ++i) {
+            buckets.append(stats.queueWait.bucket(i));
+        }
+        return {
+            {"requests", stats.requests},
+            {"bytes", stats.bytes},
+            {"queueWaitMeanUs", stats.queueWait.mean()},
+            {"queueWaitP50Us", stats.queueWait.percentile(50)},
+            {"queueWaitP99Us", stats.queueWait.percentile(99)},
+            {"queueWaitMaxUs", stats.queueWait.max()},
+            {"queueWaitBuckets", buckets}
+        };
+    }
+    return {};
+}
+
+bool AndroidMediaPlayer::cacheClips() const
+{
+    return mCacheClips;
+}
+
+bool AndroidMediaPlayer::recoverFromErrors() const
+{
+    return mRecoverFromErrors;
+}
+
+QList<AndroidMediaPlayer *> AndroidMediaPlayer::players()
+{
+    return livePlayers();
+}
+
+QVariantMap AndroidMediaPlayer::memoryReport() const
+{
+    const qint64 outputBuffers = estimatedOutputBuffers();
+    const qint64 surfaceQueue = estimatedQueueBuffers();
+    const auto qst = dynamic_cast<const QSurfaceTexture *>(mSurfaceView.data());
+    const qint64 texture = qst ? qst->textureBytes() : 0;
+    const qint64 nativeObject = sizeof(*this);
+    const qint64 dataSource = mNativeDataSource ? mNativeDataSource->memoryUsage() : 0;
+
+    return {
+        {"estimated", QVariantMap{
+             {"outputBuffers", outputBuffers},
+             {"surfaceQueue", surfaceQueue},
+             {"texture", texture},
+             {"nativeObject", nativeObject}
+         }},
+        {"measured", QVariantMap{
+             {"dataSource", dataSource}
+         }},
+        {"videoWidth", mVideoSize.width()},
+        {"videoHeight", mVideoSize.height()},
+        {"total", outputBuffers + surfaceQueue + texture + nativeObject + dataSource}
+    };
+}
+
+qint64 AndroidMediaPlayer::releaseDecoder()
+{
+    if (mTrickPlayRate != 0) {
+        // paused, but the decoder is busy with sync frames
+        return 0;
+    }
+    switch (mPlaybackState) {
+    case PlaybackState::Prepared:
+    case PlaybackState::Paused:
+        mLastPosition = currentPosition();
+        break;
+    case PlaybackState::PlaybackCompleted:
+        // started again from the beginning, like MediaPlayer does
+        mLastPosition = 0;
+        break;
+    default:
+        return 0;
+    }
+    const qint64 bytes = estimatedOutputBuffers() + estimatedQueueBuffers();
+    const bool suspended = mSuspended;
+    PLAYER_LOG(Info, Player) << "releasing the decoder of" << mDataSource << "at" << mLastPosition;
+
+    stop();
+    reset();
+    mNativeDataSource.reset();
+    mDecoderReleased = true;
+    mRestoreWithSurface = suspended;
+    return bytes;
+}
+
+bool AndroidMediaPlayer::setPlaybackRate(qreal rate)
+{
+    if (rate <= 0) {
+        return false;
+    }
+    if (mPlaybackState != PlaybackState::Started) {
+        qWarning() << Q_FUNC_INFO << "player is in an invalid state: " << mPlaybackState;
+        return false;
+    }
+    if (qFuzzyCompare(rate, mPlaybackRate)) {
+        return true;
+    }
+    if (!callPlayer<jboolean>("setPlaybackSpeed", "(F)Z", jfloat(rate))) {
+        return false;
+    }
+    mPlaybackRate = rate;
+    return true;
+}
+
+qreal AndroidMediaPlayer::playbackRate() const
+{
+    return mPlaybackRate;
+}
+
+qreal AndroidMediaPlayer::trickPlayRate() const
+{
+    return mTrickPlayRate;
+}
+
+int AndroidMediaPlayer::trickPlayBudget() const
+{
+    return mTrickPlayBudget;
+}
+
+QVariantMap AndroidMediaPlayer::trickPlayStats() const
+{
+    const qint64 time = mTrickPlayStats.time;
+    return {
+        {"rate", mTrickPlayRate},
+        {"keyframes", int(mKeyframes.size())},
+        {"indexTimeMs", mTrickPlayStats.indexTime},
+        {"frames", mTrickPlayStats.frames},
+        {"skippedKeyframes", mTrickPlayStats.skippedKeyframes},
+        {"overBudget", mTrickPlayStats.overBudget},
+        {"meanSeekMs", mTrickPlayStats.frames ? qreal(mTrickPlayStats.seekTime) / mTrickPlayStats.frames : 0},
+        {"framesPerSecond", time > 0 ? mTrickPlayStats.frames * 1000.0 / time : 0},
+        // media time covered by the frames shown per wall clock time
+        {"achievedSpeed", time > 0 ? qreal(mTrickPlayFrame - mTrickPlayStats.startPosition) / time : 0}
+    };
+}
+
+void AndroidMediaPlayer::setTrickPlayRate(qreal trickPlayRate)
+{
+    if (qFuzzyCompare(trickPlayRate, 1.0)) {
+        trickPlayRate = 0;
+    }
+    if (mTrickPlayRate == trickPlayRate)
+        return;
+    if (trickPlayRate == 0) {
+        stopTrickPlay(mPlayAfterTrickPlay);
+        return;
+    }
+    if (!mPlaylist.isEmpty() || mDecoderReleased) {
+        qWarning() << Q_FUNC_INFO << "trick play is not available";
+        return;
+    }
+
+    switch (mPlaybackState) {
+    case PlaybackState::Prepared:
+    case PlaybackState::Started:
+    case PlaybackState::Paused:
+    case PlaybackState::PlaybackCompleted:
+        break;
+    default:
+        qWarning() << Q_FUNC_INFO << "player is in an invalid state: " << mPlaybackState;
+        return;
+    }
+
+    if (mTrickPlayRate == 0) {
+        PLAYER_DEBUG(Player) << "trick play at" << trickPlayRate;
+        mPlayAfterTrickPlay = mPlaybackState == PlaybackState::Started;
+        if (mPlayAfterTrickPlay) {
+            pause();
+        }
+        mTrickPlayFrame = currentPosition();
+        mTrickPlayOrigin = mTrickPlayFrame;
+        const qint64 indexTime = mTrickPlayStats.indexTime;
+        mTrickPlayStats = {};
+        mTrickPlayStats.startPosition = mTrickPlayFrame;
+        mTrickPlayStats.indexTime = indexTime;
+        mTrickPlaySessionClock.start();
+        Trace::asyncBegin("player", "trickPlay", this);
+        if (mKeyframesSource != mDataSource) {
+            buildKeyframeIndex();
+        }
+    } else {
+        // a new rate continues from where the old one got to
+        mTrickPlayOrigin = trickPlayPosition();
+    }
+    mTrickPlayClock.start();
+    mTrickPlayRate = trickPlayRate;
+    emit trickPlayRateChanged(mTrickPlayRate);
+
+    if (!mTrickPlaySeekPending) {
+        mTrickPlayTimer.stop();
+        onTrickPlayTimer();
+    }
+}
+
+void AndroidMediaPlayer::setTrickPlayBudget(int trickPlayBudget)
+{
+    trickPlayBudget = qMax(1, trickPlayBudget);
+    if (mTrickPlayBudget == trickPlayBudget)
+        return;
+    mTrickPlayBudget = trickPlayBudget;
+    emit trickPlayBudgetChanged(mTrickPlayBudget);
+}
+
+QVariantMap AndroidMediaPlayer::latencyStats() const
+{
+    if (const auto qst = dynamic_cast<QSurfaceTexture *>(mSurfaceView.data())) {
+        return qst->latencyStats();
+    }
+    return {};
+}
+
+int AndroidMediaPlayer::surfaceResumeLatency() const
+{
+    return mSurfaceResumeLatency;
+}
+
+int AndroidMediaPlayer::maxRecoveryAttempts() const
+{
+    return mMaxRecoveryAttempts;
+}
+
+QVariantMap AndroidMediaPlayer::recoveryStats() const
+{
+    return {
+        {"attempts", mRecoveryStats.attempts},
+        {"recoveries", mRecoveryStats.recoveries},
+        {"failures", mRecoveryStats.failures},
+        {"lastTime", mRecoveryStats.lastTime},
+        {"maxTime", mRecoveryStats.maxTime},
+        {"meanTime", mRecoveryStats.recoveries
+         ? double(mRecoveryStats.totalTime) / mRecoveryStats.recoveries : 0.0}
+    };
+}
+
+void AndroidMediaPlayer::simulateError(int what, int extra)
+{
+    onError(what, extra);
+}
+
+bool AndroidMediaPlayer::resumePlayback() const
+{
+    return mResumePlayback;
+}
+
+bool AndroidMediaPlayer::setContentKey(const QString &keyHex, const QString &ivHex)
+{
+    if (keyHex.isEmpty() && ivHex.isEmpty()) {
+        mContentKey.clear();
+        mContentIv.clear();
+        return true;
+    }
+
+    const QByteArray &&key = QByteArray::fromHex(keyHex.toLatin1());
+    const QByteArray &&iv = QByteArray::fromHex(ivHex.toLatin1());
+    if ((key.size() != 16 && key.size() != 24 && key.size() != 32) || iv.size() != 16) {
+        qWarning() << Q_FUNC_INFO << "invalid key or iv size:" << key.size() << iv.size();
+        return false;
+    }
+    mContentKey = key;
+    mContentIv = iv;
+    return true;
+}
+
+bool AndroidMediaPlayer::loops() const
+{
+    return mLoops;
+}
+
+QVariantList AndroidMediaPlayer::loopRange() const
+{
+    if (!hasLoopRange()) {
+        return {};
+    }
+    return {mLoopStart, mLoopEnd};
+}
+
+int AndroidMediaPlayer::loopGap() const
+{
+    return mLoopGap;
+}
+
+QStringList AndroidMediaPlayer::playlist() const
+{
+    return mPlaylist;
+}
+
+int AndroidMediaPlayer::currentPart() const
+{
+    return mCurrentPart;
+}
+
+int AndroidMediaPlayer::boundaryLatency() const
+{
+    return mBoundaryLatency;
+}
+
 bool AndroidMediaPlayer::visible()
 {
     if( mSurfaceView )
@@ -251,7 +785,7 @@ QString AndroidMediaPlayer::getDataSource()
 
 void AndroidMediaPlayer::setSurfaceView(QQuickItem *surfaceView)
 {
-    qDebug() << Q_FUNC_INFO << surfaceView;
+    PLAYER_DEBUG(Player) << surfaceView;
 
     if (mSurfaceView == surfaceView)
         return;
@@ -261,42 +795,62 @@ void AndroidMediaPlayer::setSurfaceView(QQuickItem *surfaceView)
     disconnect(surfaceView, nullptr, this, nullptr);
     disconnect(this, nullptr, surfaceView, nullptr);
 
+    if (const auto asv = dynamic_cast<AndroidSurfaceView *>(mSurfaceView.data())) {
+        asv->postToView([](const QAndroidJniObject &view) {
+            TIME_CALL("async:setMediaPlayer");
+            view.callMethod<void>("setMediaPlayer",
+                                  "(Lcom/vadim/android/AndroidMediaPlayer;)V",
+                                  nullptr);
+        });
+    } else if (dynamic_cast<QSurfaceTexture *>(mSurfaceView.data())) {
+        detachSurface();
+    }
     mSurfaceView = surfaceView;
-    QtAndroid::runOnAndroidThreadSync([this, surfaceView] {
-        if (dynamic_cast<AndroidSurfaceView *>(surfaceView) != nullptr) {
-            const auto asv = dynamic_cast<AndroidSurfaceView *>(surfaceView);
-            connect(this, &AndroidMediaPlayer::videoSizeChanged,
-                    asv, &AndroidSurfaceView::setVideoSize);
-            connect(asv, &AndroidSurfaceView::surfaceChanged,
-                    this, &AndroidMediaPlayer::setSurface);
-            if (asv->surface().isValid()) {
-                setSurface(asv->surface());
-            }
-        } else if (dynamic_cast<QSurfaceTexture *>(surfaceView)) {
-            const auto qst = dynamic_cast<QSurfaceTexture *>(surfaceView);
-            const auto onSurfaceTextureChanged = [this](QSurfaceTexture *surfaceTexture) {
-                const auto &&surface = QAndroidJniObject("android/view/Surface",
-                                                         "(Landroid/graphics/SurfaceTexture;)V",
-                                                         surfaceTexture->surfaceTexture().object());
-                setSurface(surface);
-            };
-            connect(qst, &QSurfaceTexture::surfaceTextureChanged,
-                    this, onSurfaceTextureChanged);
-            if (qst->surfaceTexture().isValid()) {
-                onSurfaceTextureChanged(qst);
-            }
+    if (const auto asv = dynamic_cast<AndroidSurfaceView *>(surfaceView)) {
+        // lets the view detach the player before its surface goes away
+        const QAndroidJniObject player = mAndroidPlayer;
+        asv->postToView([player](const QAndroidJniObject &view) {
+            TIME_CALL("async:setMediaPlayer");
+            view.callMethod<void>("setMediaPlayer",
+                                  "(Lcom/vadim/android/AndroidMediaPlayer;)V",
+                                  player.object());
+        });
+        connect(this, &AndroidMediaPlayer::videoSizeChanged,
+                asv, &AndroidSurfaceView::setVideoSize);
+        connect(asv, &AndroidSurfaceView::surfaceChanged,
+                this, &AndroidMediaPlayer::setSurface);
+        if (asv->surface().isValid()) {
+            setSurface(asv->surface());
         }
-    });
+    } else if (const auto qst = dynamic_cast<QSurfaceTexture *>(surfaceView)) {
+        const auto onSurfaceTextureChanged = [this](QSurfaceTexture *surfaceTexture) {
+            const auto &&surface = TIMED_CALL("new Surface",
+                QAndroidJniObject("android/view/Surface",
+                                  "(Landroid/graphics/SurfaceTexture;)V",
+                                  surfaceTexture->surfaceTexture().object()));
+            setSurface(surface);
+        };
+        connect(qst, &QSurfaceTexture::surfaceTextureChanged,
+                this, onSurfaceTextureChanged);
+        // the texture keeps its SurfaceTexture until the garbage collector
+        // finalizes it, detaching now keeps the decoder from seeing -ENODEV
+        connect(qst, &QObject::destroyed, this, &AndroidMediaPlayer::detachSurface);
+        connect(this, &AndroidMediaPlayer::videoSizeChanged,
+                qst, &QSurfaceTexture::setVideoSize);
+        if (qst->surfaceTexture().isValid()) {
+            onSurfaceTextureChanged(qst);
+        }
+    }
     emit surfaceViewChanged(mSurfaceView.data());
 }
 
 void AndroidMediaPlayer::setUseRTPlayer(bool useRTPlayer)
 {
-    qDebug() << Q_FUNC_INFO << "callMethod useRTPlayer:" << useRTPlayer;
+    PLAYER_DEBUG(Player) << "callMethod useRTPlayer:" << useRTPlayer;
     mUseRTPlayer = useRTPlayer;
-    mAndroidPlayer.callMethod<void>("useRTPlayer",
-                                    "(Z)V",
-                                    jboolean(useRTPlayer));
+    callPlayer<void>("useRTPlayer",
+                     "(Z)V",
+                     jboolean(useRTPlayer));
 }
 
 void AndroidMediaPlayer::setAutoStart(bool autoStart)
@@ -304,28 +858,196 @@ void AndroidMediaPlayer::setAutoStart(bool autoStart)
     mAutoStart = autoStart;
 }
 
+void AndroidMediaPlayer::setUseNativeDataSource(bool useNativeDataSource)
+{
+    if (mUseNativeDataSource == useNativeDataSource)
+        return;
+    mUseNativeDataSource = useNativeDataSource;
+    emit useNativeDataSourceChanged(mUseNativeDataSource);
+}
+
+void AndroidMediaPlayer::setCacheClips(bool cacheClips)
+{
+    if (mCacheClips == cacheClips)
+        return;
+    mCacheClips = cacheClips;
+    emit cacheClipsChanged(mCacheClips);
+}
+
+void AndroidMediaPlayer::setResumePlayback(bool resumePlayback)
+{
+    if (mResumePlayback == resumePlayback)
+        return;
+    mResumePlayback = resumePlayback;
+    emit resumePlaybackChanged(mResumePlayback);
+}
+
+void AndroidMediaPlayer::setRecoverFromErrors(bool recoverFromErrors)
+{
+    if (mRecoverFromErrors == recoverFromErrors)
+        return;
+    mRecoverFromErrors = recoverFromErrors;
+    if (!mRecoverFromErrors) {
+        cancelRecovery();
+    }
+    emit recoverFromErrorsChanged(mRecoverFromErrors);
+}
+
+void AndroidMediaPlayer::setMaxRecoveryAttempts(int maxRecoveryAttempts)
+{
+    maxRecoveryAttempts = qMax(0, maxRecoveryAttempts);
+    if (mMaxRecoveryAttempts == maxRecoveryAttempts)
+        return;
+    mMaxRecoveryAttempts = maxRecoveryAttempts;
+    emit maxRecoveryAttemptsChanged(mMaxRecoveryAttempts);
+}
+
+void AndroidMediaPlayer::setLoops(bool loops)
+{
+    if (mLoops == loops)
+        return;
+    mLoops = loops;
+    applyLooping();
+    scheduleLoop();
+    emit loopsChanged(mLoops);
+}
+
+void AndroidMediaPlayer::setLoopRange(const QVariantList &loopRange)
+{
+    qint64 start = -1;
+    qint64 end = -1;
+    if (loopRange.size() == 2) {
+        start = loopRange.at(0).toLongLong();
+        end = loopRange.at(1).toLongLong();
+        if (start < 0 || end <= start) {
+            qWarning() << Q_FUNC_INFO << "invalid loop range" << loopRange;
+            start = end = -1;
+        }
+    } else if (!loopRange.isEmpty()) {
+        qWarning() << Q_FUNC_INFO << "loop range must be [start, end]" << loopRange;
+    }
+
+    if (mLoopStart == start && mLoopEnd == end)
+        return;
+    mLoopStart = start;
+    mLoopEnd = end;
+    applyLooping();
+    scheduleLoop();
+    emit loopRangeChanged(this->loopRange());
+}
+
+void AndroidMediaPlayer::setPlaylist(const QStringList &playlist)
+{
+    PLAYER_DEBUG(Player) << playlist;
+
+    if (mPlaylist == playlist)
+        return;
+    cancelRecovery();
+    mLastPosition = 0;
+    mPlaylist = playlist;
+    mTimeline.reset(mPlaylist.size());
+    ++mPlaylistGeneration;
+    emit playlistChanged(mPlaylist);
+
+    if (!mPlaylist.isEmpty()) {
+        prefetchPartDurations();
+        switchToPart(0, 0, false);
+    }
+}
+
+void AndroidMediaPlayer::setIoPriority(int ioPriority)
+{
+    if (mIoClient->priority() == ioPriority)
+        return;
+    mIoClient->setPriority(ioPriority);
+    emit ioPriorityChanged(mIoClient->priority());
+}
+
 void AndroidMediaPlayer::onStarted()
 {
-    qDebug() << Q_FUNC_INFO;
+    PLAYER_DEBUG(Player);
+    EventRecorder::instance().event(this, EventRecorder::Started);
+    Trace::instant("player", "started");
+    if (mSurfaceResumeClock.isValid()) {
+        mSurfaceResumeLatency = int(mSurfaceResumeClock.elapsed());
+        mSurfaceResumeClock.invalidate();
+        PLAYER_DEBUG(Player) << "surface resume latency:" << mSurfaceResumeLatency << "ms";
+        emit surfaceResumeLatencyChanged(mSurfaceResumeLatency);
+    }
+    if (mBoundaryClock.isValid()) {
+        mBoundaryLatency = int(mBoundaryClock.elapsed());
+        mBoundaryClock.invalidate();
+        PLAYER_DEBUG(Player) << "part boundary latency:" << mBoundaryLatency << "ms";
+        emit boundaryLatencyChanged(mBoundaryLatency);
+    }
+    if (mLoopClock.isValid()) {
+        // MediaPlayer reports the first frame rendered after the loop seek
+        mLoopGap = int(qMax<qint64>(0, mLoopClock.elapsed() - mLoopLead));
+        mLoopClock.invalidate();
+        PLAYER_DEBUG(Player) << "loop gap:" << mLoopGap << "ms";
+        emit looped();
+    }
     keepScreenOn(true);
 }
 
 void AndroidMediaPlayer::onFinished()
 {
-    qDebug() << Q_FUNC_INFO;
+    PLAYER_DEBUG(Player);
+    EventRecorder::instance().event(this, EventRecorder::Finished);
+    if (mRecoveryTimer.isActive()) {
+        // MediaPlayer reports completion after an unhandled error
+        return;
+    }
+    if (mLoops && hasLoopRange() && mPlaybackState == PlaybackState::Started) {
+        // the media ended before the end of the loop range
+        mLoopSeekPending = true;
+        mLoopClock.start();
+        mLoopLead = 0;
+        seekTo(mLoopStart);
+        callPlayer<void>("start", "()V");
+        return;
+    }
+    if (!mPlaylist.isEmpty() && mCurrentPart + 1 < mPlaylist.size()) {
+        // the next part was not prepared in time, open it the regular way
+        mBoundaryClock.start();
+        switchToPart(mCurrentPart + 1, 0, true);
+        return;
+    }
+    if (mResumePlayback && mPlaylist.isEmpty()) {
+        // watched to the end, start over next time
+        ResumeStore::instance().remove(mDataSource);
+    }
     setPlaybackState(PlaybackState::PlaybackCompleted);
     keepScreenOn(false);
 }
 
 void AndroidMediaPlayer::onBuffering(bool state)
 {
-    qDebug() << Q_FUNC_INFO << state;
+    PLAYER_DEBUG(Player) << state;
+    EventRecorder::instance().event(this, EventRecorder::Buffering, state);
+    if (state) {
+        Trace::asyncBegin("player", "buffering", this);
+    } else {
+        Trace::asyncEnd("player", "buffering", this);
+    }
     emit buffering(state);
 }
 
+void AndroidMediaPlayer::onBufferingUpdate(int percent)
+{
+    EventRecorder::instance().event(this, EventRecorder::BufferingUpdate, percent);
+    if (mDuration <= 0) {
+        return;
+    }
+    mBandwidthEstimator.addSample(mBufferingClock.elapsed(), mDuration * percent / 100);
+    updateTimeToStall();
+    emit bufferingProgressChanged();
+}
+
 void AndroidMediaPlayer::onError(int what, int extra)
 {
-    qDebug() << Q_FUNC_INFO << what << extra;
+    PLAYER_DEBUG(Player) << what << extra;
+    EventRecorder::instance().event(this, EventRecorder::Error, what, extra);
 
     QString msg;
 
@@ -361,40 +1083,239 @@ void AndroidMediaPlayer::onError(int what, int extra)
         msg = "Other case of media playback error.";
         break;
     }
+
+    if (startRecovery(what, extra)) {
+        return;
+    }
+    if (mRecoveryClock.isValid() || mRecoveryAttempt > 0) {
+        // out of attempts, also when the last attempt got as far as playing
+        ++mRecoveryStats.failures;
+        mRecoveryClock.invalidate();
+        mPlayAfterPrepare = false;
+    }
     setPlaybackState(PlaybackState::Error);
     emit error(msg);
 }
 
+void AndroidMediaPlayer::onRecoveryTimer()
+{
+    ++mRecoveryAttempt;
+    ++mRecoveryStats.attempts;
+    PLAYER_DEBUG(Player) << "attempt" << mRecoveryAttempt << "position" << mLastPosition;
+
+    initAndroidPlayer();
+    if (!mPlaylist.isEmpty()) {
+        const auto &&location = mTimeline.locate(mLastPosition);
+        switchToPart(location.first, location.second, mPlayAfterPrepare);
+    } else {
+        mPendingStartPosition = mLastPosition;
+        openDataSource(mDataSource);
+    }
+}
+
 void AndroidMediaPlayer::onPause()
 {
-    qDebug() << Q_FUNC_INFO;
+    PLAYER_DEBUG(Player);
+    EventRecorder::instance().event(this, EventRecorder::Pause);
     keepScreenOn(false);
     setPlaybackState(PlaybackState::Paused);
 }
 
+void AndroidMediaPlayer::onSuspended(bool suspended)
+{
+    PLAYER_DEBUG(Player) << suspended;
+    EventRecorder::instance().event(this, EventRecorder::Suspended, suspended);
+    // the Java side has already paused or restarted MediaPlayer
+    mSuspended = suspended;
+    if (suspended) {
+        if (mPlaybackState == PlaybackState::Started) {
+            mLastPosition = currentPosition();
+            savePosition();
+            keepScreenOn(false);
+            setPlaybackState(PlaybackState::Paused);
+        }
+    } else if (mPlaybackState == PlaybackState::Paused) {
+        mSurfaceResumeClock.start();
+        keepScreenOn(true);
+        setPlaybackState(PlaybackState::Started);
+    }
+}
+
 void AndroidMediaPlayer::onPrepared()
 {
-    qDebug() << Q_FUNC_INFO;
+    PLAYER_DEBUG(Player);
+    EventRecorder::instance().event(this, EventRecorder::Prepared);
+    Trace::asyncEnd("player", "prepare", this);
+    mDuration = callPlayer<jlong>("getDuration");
     setPlaybackState(PlaybackState::Prepared);
+
+    if (mRecoveryClock.isValid()) {
+        const int recoveryTime = int(mRecoveryClock.elapsed());
+        mRecoveryClock.invalidate();
+        mRecoveredClock.start();
+        ++mRecoveryStats.recoveries;
+        mRecoveryStats.lastTime = recoveryTime;
+        mRecoveryStats.maxTime = qMax(mRecoveryStats.maxTime, recoveryTime);
+        mRecoveryStats.totalTime += recoveryTime;
+        PLAYER_DEBUG(Player) << "recovered in" << recoveryTime << "ms";
+        emit recovered(recoveryTime);
+    }
+
+    if (!mPlaylist.isEmpty()) {
+        mTimeline.setPartDuration(mCurrentPart, mDuration);
+    }
+    if (mPlayAfterPrepare) {
+        mPlayAfterPrepare = false;
+        start();
+    }
 }
 
 void AndroidMediaPlayer::onVideoSizeChanged(int width, int height)
 {
-    qDebug() << Q_FUNC_INFO;
+    PLAYER_DEBUG(Player);
+    EventRecorder::instance().event(this, EventRecorder::VideoSizeChanged, width, height);
+    mVideoSize = QSize(width, height);
     emit videoSizeChanged(width, height);
 }
 
 void AndroidMediaPlayer::setSurface(QAndroidJniObject surface) {
-    qDebug() << Q_FUNC_INFO << mPlaybackState << "surface: " << surface.isValid();
+    PLAYER_DEBUG(Player) << mPlaybackState << "surface: " << surface.isValid();
+    EventRecorder::instance().event(this, EventRecorder::SurfaceChanged, surface.isValid());
     if (surface.isValid() && mPlaybackState != PlaybackState::Error) {
-        mAndroidPlayer.callMethod<void>("setSurface",
-                                        "(Landroid/view/Surface;)V",
-                                        surface.object());
+        TRACE_SPAN("player", "setSurface");
+        // a PlayerSurfaceView attaches the player itself, a SurfaceTexture
+        // surface resumes the player detachSurface() paused
+        if (dynamic_cast<QSurfaceTexture *>(mSurfaceView.data())) {
+            callPlayer<void>("attachSurface",
+                             "(Landroid/view/Surface;)V",
+                             surface.object());
+        } else {
+            callPlayer<void>("setSurface",
+                             "(Landroid/view/Surface;)V",
+                             surface.object());
+        }
+        if (mDecoderReleased && mRestoreWithSurface) {
+            // released while suspended, resume the way the Java side would have
+            restoreDecoder(true);
+        }
+    }
+}
+
+void AndroidMediaPlayer::detachSurface()
+{
+    PLAYER_DEBUG(Player) << mPlaybackState;
+    switch (mPlaybackState) {
+    case PlaybackState::Prepared:
+    case PlaybackState::Started:
+    case PlaybackState::Paused:
+    case PlaybackState::PlaybackCompleted:
+        // like PlayerSurfaceView.surfaceDestroyed(), the Java side pauses a
+        // playing player and reports it through onSuspended()
+        callPlayer<void>("detachSurface");
+        break;
+    default:
+        break;
+    }
+}
+
+void AndroidMediaPlayer::onProgressTimer()
+{
+    scheduleLoop();
+    mLastPosition = currentPosition();
+
+    // the position moved on since the last buffering update
+    if (mDuration > 0 && updateTimeToStall()) {
+        emit bufferingProgressChanged();
+    }
+
+    if (mRecoveredClock.isValid() && mRecoveredClock.elapsed() >= RECOVERY_STABLE_MS) {
+        mRecoveryAttempt = 0;
+        mRecoveredClock.invalidate();
+    }
+
+    if (!mResumeClock.isValid() || mResumeClock.elapsed() >= RESUME_SAVE_INTERVAL_MS) {
+        savePosition();
+    }
+
+    if (!mPlaylist.isEmpty() && !mNextPartRequested && mCurrentPart + 1 < mPlaylist.size()
+            && mDuration > 0 && mDuration - partPosition() < PREPARE_NEXT_PART_AHEAD_MS) {
+        mNextPartRequested = true;
+        // the next part is read the same way as the current one, encrypted
+        // media that can't be is refused at the boundary
+        const QString &next = mPlaylist.at(mCurrentPart + 1);
+        mNextNativeDataSource = createNativeDataSource(next);
+        if (mNextNativeDataSource) {
+            callPlayer<void>("prepareNextNative",
+                             "(J)V",
+                             MediaDataSource::createJniHandle(mNextNativeDataSource));
+        } else if (mContentKey.isEmpty()) {
+            callPlayer<void>("prepareNext",
+                             "(Ljava/lang/String;)V",
+                             QAndroidJniObject::fromString(next).object());
+        }
+    }
+
+    if (mNativeDataSource && mNativeDataSource->size() > 0 && mDuration > 0) {
+        // map the read offset of the data source to media time
+        const qint64 readMs = mIoClient->readPosition() * mDuration / mNativeDataSource->size();
+        mIoClient->setBufferLevel(readMs - partPosition());
+    }
+}
+
+void AndroidMediaPlayer::onSeekComplete()
+{
+    EventRecorder::instance().event(this, EventRecorder::SeekComplete);
+    // seeks issued by the Java side on prepare are not timed
+    const qint64 latency = mSeekClock.isValid() ? mSeekClock.elapsed() : 0;
+    if (mSeekClock.isValid()) {
+        Trace::asyncEnd("player", "seek", this);
+        // sync frame seeks don't tell how long an exact seek for a loop takes
+        if (!mTrickPlaySeekPending) {
+            mSeekLatency = (3 * mSeekLatency + latency) / 4;
+        }
+        mSeekClock.invalidate();
+    }
+    if (mTrickPlaySeekPending) {
+        onTrickPlayFrame(latency);
+        return;
+    }
+
+    if (mLoopSeekPending) {
+        // the gap is known once the first frame is rendered
+        mLoopSeekPending = false;
+        scheduleLoop();
+    }
+}
+
+void AndroidMediaPlayer::onNextPartStarted()
+{
+    PLAYER_DEBUG(Player);
+    EventRecorder::instance().event(this, EventRecorder::NextPartStarted);
+    // the Java side has already switched to the prepared next part
+    mBoundaryClock.start();
+    ++mCurrentPart;
+    mNextPartRequested = false;
+    mNativeDataSource = std::move(mNextNativeDataSource);
+    mBandwidthEstimator.reset();
+    mDuration = callPlayer<jlong>("getDuration");
+    mTimeline.setPartDuration(mCurrentPart, mDuration);
+    emit currentPartChanged(mCurrentPart);
+}
+
+void AndroidMediaPlayer::onLoopTimer()
+{
+    if (mLoopSeekPending || !mLoops || !hasLoopRange() || mPlaybackState != PlaybackState::Started) {
+        return;
     }
+    mLoopSeekPending = true;
+    mLoopClock.start();
+    mLoopLead = qMax<qint64>(0, qint64((mLoopEnd - partPosition()) / qMax(mPlaybackRate, qreal(0.01))));
+    seekTo(mLoopStart);
 }
 
 void AndroidMediaPlayer::keepScreenOn(bool on) {
     QtAndroid::runOnAndroidThread([on]{
+        TIME_CALL("async:keepScreenOn");
         const QAndroidJniObject &&activity = QtAndroid::androidActivity();
         if (activity.isValid()) {
             QAndroidJniObject &&window =
@@ -418,26 +1339,32 @@ void AndroidMediaPlayer::keepScreenOn(bool on) {
 
 void AndroidMediaPlayer::setPlaybackState(PlaybackState newPlaybackState)
 {
-    qDebug() << Q_FUNC_INFO << "newPlaybackState:" << newPlaybackState;
+    PLAYER_DEBUG(Player) << "newPlaybackState:" << newPlaybackState;
     if (newPlaybackState != mPlaybackState) {
         mPlaybackState = newPlaybackState;
+        if (mPlaybackState == PlaybackState::Started) {
+            mProgressTimer.start();
+        } else {
+            mProgressTimer.stop();
+        }
         emit playbackStateChanged(newPlaybackState);
     }
 }
 
 void AndroidMediaPlayer::initAndroidPlayer()
 {
-    qDebug() << Q_FUNC_INFO;
+    PLAYER_DEBUG(Player);
     if (mAndroidPlayer.isValid()) {
         release();
     }
-    mAndroidPlayer = QAndroidJniObject("com/vadim/android/AndroidMediaPlayer");
+    mAndroidPlayer = TIMED_CALL("new AndroidMediaPlayer",
+                                QAndroidJniObject("com/vadim/android/AndroidMediaPlayer"));
     mPlaybackState = PlaybackState::Idle;
-    mAndroidPlayer.callMethod<void>(std::get<0>(EVENT_LISTENER),
-                                    std::get<1>(EVENT_LISTENER),
-                                    QAndroidJniObject("com/vadim/android/NativeMediaPlayerEventListener",
-                                                      "(J)V",
-                                                      jlong(this)).object());
+    callPlayer<void>(std::get<0>(EVENT_LISTENER),
+                     std::get<1>(EVENT_LISTENER),
+                     QAndroidJniObject("com/vadim/android/NativeMediaPlayerEventListener",
+                                       "(J)V",
+                                       jlong(this)).object());
     const auto surfaceView = mSurfaceView;
     mSurfaceView = nullptr;
     setSurfaceView(surfaceView);
@@ -446,7 +1373,384 @@ void AndroidMediaPlayer::initAndroidPlayer()
 void AndroidMediaPlayer::release()
 {
     setPlaybackState(PlaybackState::End);
-    mAndroidPlayer.callMethod<void>("release");
+    callPlayer<void>("release");
+}
+
+void AndroidMediaPlayer::switchToPart(int part, qint64 position, bool play)
+{
+    PLAYER_DEBUG(Player) << part << position << play;
+
+    mCurrentPart = part;
+    mPendingStartPosition = position;
+    mPlayAfterPrepare = play;
+    mNextPartRequested = false;
+    mNextNativeDataSource.reset();
+
+    switch (mPlaybackState) {
+    case PlaybackState::Prepared:
+    case PlaybackState::Started:
+    case PlaybackState::Paused:
+    case PlaybackState::PlaybackCompleted:
+        stop();
+        reset();
+        break;
+    case PlaybackState::Idle:
+        break;
+    default:
+        reset();
+        break;
+    }
+    openDataSource(mPlaylist.at(part));
+    emit currentPartChanged(mCurrentPart);
+}
+
+void AndroidMediaPlayer::restoreDecoder(bool play)
+{
+    PLAYER_DEBUG(Player) << "position" << mLastPosition << "play" << play;
+    mRestoreWithSurface = false;
+    if (!mPlaylist.isEmpty()) {
+        const auto &&location = mTimeline.locate(mLastPosition);
+        switchToPart(location.first, location.second, play);
+    } else {
+        mPendingStartPosition = mLastPosition;
+        mPlayAfterPrepare = play;
+        openDataSource(mDataSource);
+    }
+}
+
+qint64 AndroidMediaPlayer::estimatedFrameBytes() const
+{
+    switch (mPlaybackState) {
+    case PlaybackState::Prepared:
+    case PlaybackState::Started:
+    case PlaybackState::Paused:
+    case PlaybackState::Stopped:
+    case PlaybackState::PlaybackCompleted:
+        // YUV 4:2:0
+        return qint64(mVideoSize.width()) * mVideoSize.height() * 3 / 2;
+    default:
+        return 0;
+    }
+}
+
+qint64 AndroidMediaPlayer::estimatedOutputBuffers() const
+{
+    // the next part of a playlist has a decoder of its own
+    return ESTIMATED_DECODER_BUFFERS * estimatedFrameBytes() * (mNextPartRequested ? 2 : 1);
+}
+
+qint64 AndroidMediaPlayer::estimatedQueueBuffers() const
+{
+    return ESTIMATED_QUEUE_BUFFERS * estimatedFrameBytes();
+}
+
+void AndroidMediaPlayer::buildKeyframeIndex()
+{
+    // MediaExtractor reads the sample tables of the container, for long
+    // files over the network that takes a while and is not done on this thread
+    mKeyframes.clear();
+    mKeyframesSource = mDataSource;
+    const QPointer<AndroidMediaPlayer> self(this);
+    const QString source = mDataSource;
+    QtConcurrent::run([self, source] {
+        TRACE_SPAN("player", "keyframeIndex");
+        QElapsedTimer clock;
+        clock.start();
+        std::vector<qint64> keyframes;
+        QAndroidJniEnvironment env;
+        const QAndroidJniObject &&times = TIMED_CALL("KeyframeIndex.build",
+            QAndroidJniObject::callStaticObjectMethod("com/vadim/android/KeyframeIndex",
+                                                      "build",
+                                                      "(Ljava/lang/String;)[J",
+                                                      QAndroidJniObject::fromString(source).object()));
+        if (env->ExceptionCheck()) {
+            env->ExceptionClear();
+        } else if (times.isValid()) {
+            const jlongArray array = times.object<jlongArray>();
+            keyframes.resize(size_t(env->GetArrayLength(array)));
+            env->GetLongArrayRegion(array, 0, jsize(keyframes.size()),
+                                    reinterpret_cast<jlong *>(keyframes.data()));
+        }
+        const qint64 indexTime = clock.elapsed();
+        QMetaObject::invokeMethod(qApp, [self, source, keyframes, indexTime] {
+            if (self && self->mKeyframesSource == source) {
+                PLAYER_DEBUG(Player) << keyframes.size() << "sync frames indexed in" << indexTime << "ms";
+                self->mKeyframes = keyframes;
+                self->mTrickPlayStats.indexTime = indexTime;
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+qreal AndroidMediaPlayer::effectiveRate() const
+{
+    if (mTrickPlayRate != 0) {
+        return mTrickPlayRate;
+    }
+    return mPlaybackState == PlaybackState::Started ? mPlaybackRate : 0;
+}
+
+bool AndroidMediaPlayer::updateTimeToStall()
+{
+    const qint64 timeToStall = mBandwidthEstimator.timeToStall(mBufferingClock.elapsed(), partPosition(),
+                                                                mDuration, effectiveRate());
+    if (timeToStall == mTimeToStall) {
+        return false;
+    }
+    mTimeToStall = timeToStall;
+    return true;
+}
+
+qint64 AndroidMediaPlayer::trickPlayPosition() const
+{
+    const qint64 position = mTrickPlayOrigin + qint64(mTrickPlayRate * mTrickPlayClock.elapsed());
+    return qBound<qint64>(0, position, mDuration);
+}
+
+void AndroidMediaPlayer::onTrickPlayTimer()
+{
+    if (mTrickPlayRate == 0 || mTrickPlaySeekPending) {
+        return;
+    }
+    const bool forward = mTrickPlayRate > 0;
+    const qint64 target = trickPlayPosition();
+    const qint64 boundary = forward ? mDuration : 0;
+
+    // the last sync frame passed in the direction of play and not shown yet
+    qint64 frame = -1;
+    if (!mKeyframes.empty()) {
+        if (forward) {
+            auto it = std::upper_bound(mKeyframes.begin(), mKeyframes.end(), target);
+            if (it != mKeyframes.begin() && *(--it) > mTrickPlayFrame) {
+                frame = *it;
+                mTrickPlayStats.skippedKeyframes += quint64(std::distance(
+                    std::upper_bound(mKeyframes.begin(), mKeyframes.end(), mTrickPlayFrame), it));
+            }
+        } else {
+            auto it = std::lower_bound(mKeyframes.begin(), mKeyframes.end(), target);
+            if (it != mKeyframes.end() && *it < mTrickPlayFrame) {
+                frame = *it;
+                mTrickPlayStats.skippedKeyframes += quint64(std::distance(
+                    it, std::lower_bound(mKeyframes.begin(), mKeyframes.end(), mTrickPlayFrame)) - 1);
+            }
+        }
+    } else if (qAbs(target - mTrickPlayFrame) >= qAbs(mTrickPlayRate) * mTrickPlayBudget
+               || target == boundary) {
+        // no index yet or none available, MediaPlayer snaps to a sync frame
+        frame = target != mTrickPlayFrame ? target : -1;
+    }
+
+    if (frame < 0) {
+        if (target == boundary) {
+            // rewound to the start plays from there, the end pauses on the
+            // last sync frame
+            PLAYER_DEBUG(Player) << "trick play reached" << boundary;
+            stopTrickPlay(!forward);
+            return;
+        }
+        mTrickPlayTimer.start(mTrickPlayBudget);
+        return;
+    }
+
+    mTrickPlayFrame = frame;
+    mTrickPlaySeekPending = true;
+    mSeekClock.start();
+    Trace::asyncBegin("player", "seek", this);
+    callPlayer<void>("seekToSync", "(J)V", jlong(frame));
+}
+
+void AndroidMediaPlayer::onTrickPlayFrame(qint64 latency)
+{
+    mTrickPlaySeekPending = false;
+    if (mTrickPlayRate == 0) {
+        return;
+    }
+    ++mTrickPlayStats.frames;
+    mTrickPlayStats.seekTime += latency;
+    mTrickPlayStats.time = mTrickPlaySessionClock.elapsed();
+    if (latency > mTrickPlayBudget) {
+        ++mTrickPlayStats.overBudget;
+    }
+    mTrickPlayTimer.start(int(qMax<qint64>(0, mTrickPlayBudget - latency)));
+}
+
+void AndroidMediaPlayer::stopTrickPlay(bool resume)
+{
+    if (mTrickPlayRate == 0) {
+        return;
+    }
+    PLAYER_DEBUG(Player) << "trick play stopped at" << mTrickPlayFrame;
+    Trace::asyncEnd("player", "trickPlay", this);
+    mTrickPlayTimer.stop();
+    mTrickPlayRate = 0;
+    mPlayAfterTrickPlay = false;
+    mLastPosition = mTrickPlayFrame;
+    emit trickPlayRateChanged(mTrickPlayRate);
+    // the player is paused on the sync frame shown, a pending seek still
+    // completes before playback starts
+    if (resume) {
+        start();
+    }
+}
+
+void AndroidMediaPlayer::prefetchPartDurations()
+{
+    // read the durations from the file headers so the whole timeline is
+    // known before the parts are played
+    const QPointer<AndroidMediaPlayer> self(this);
+    const int generation = mPlaylistGeneration;
+    const QStringList playlist = mPlaylist;
+    QtConcurrent::run([self, generation, playlist] {
+        for (int part = 0; part < playlist.size(); ++part) {
+            const qint64 duration = TIMED_CALL("getMediaDuration",
+                QAndroidJniObject::callStaticMethod<jlong>("com/vadim/android/AndroidMediaPlayer",
+                                                           "getMediaDuration",
+                                                           "(Ljava/lang/String;)J",
+                                                           QAndroidJniObject::fromString(playlist.at(part)).object()));
+            QMetaObject::invokeMethod(qApp, [self, generation, part, duration] {
+                if (self && self->mPlaylistGeneration == generation && duration >= 0
+                        && self->mTimeline.partDuration(part) < 0) {
+                    self->mTimeline.setPartDuration(part, duration);
+                }
+            }, Qt::QueuedConnection);
+        }
+    });
+}
+
+bool AndroidMediaPlayer::hasLoopRange() const
+{
+    return mLoopStart >= 0 && mLoopEnd > mLoopStart;
+}
+
+void AndroidMediaPlayer::applyLooping()
+{
+    // whole-file loops are left to MediaPlayer, ranges are handled by scheduleLoop()
+    switch (mPlaybackState) {
+    case PlaybackState::Initialized:
+    case PlaybackState::Preparing:
+    case PlaybackState::Prepared:
+    case PlaybackState::Started:
+    case PlaybackState::Paused:
+    case PlaybackState::Stopped:
+    case PlaybackState::PlaybackCompleted:
+        callPlayer<void>("setLooping", "(Z)V", jboolean(mLoops && !hasLoopRange()));
+        break;
+    default:
+        break;
+    }
+}
+
+void AndroidMediaPlayer::scheduleLoop()
+{
+    if (!mLoops || !hasLoopRange() || mPlaybackState != PlaybackState::Started) {
+        mLoopTimer.stop();
+        return;
+    }
+    if (mLoopSeekPending) {
+        return;
+    }
+
+    // seek ahead of the loop end by the expected seek latency so that the
+    // first frame of the loop start is ready when the end is reached
+    const qint64 remaining = mLoopEnd - mSeekLatency - partPosition();
+    if (remaining <= 0) {
+        onLoopTimer();
+    } else if (remaining <= 2 * PROGRESS_INTERVAL_MS) {
+        mLoopTimer.start(int(remaining));
+    }
+}
+
+bool AndroidMediaPlayer::startRecovery(int what, int extra)
+{
+    if (!mRecoverFromErrors || mRecoveryAttempt >= mMaxRecoveryAttempts
+            || (mDataSource.isEmpty() && mPlaylist.isEmpty())) {
+        return false;
+    }
+    // broken media fails again, a lost surface is handled by its owner
+    if (what != MEDIA_ERROR_SERVER_DIED
+            && (what != MEDIA_ERROR_UNKNOWN || extra == MEDIA_ERROR_MALFORMED
+                || extra == MEDIA_ERROR_UNSUPPORTED || extra == ERROR_SURFACE_LOST)) {
+        return false;
+    }
+
+    if (!mRecoveryClock.isValid()) {
+        mRecoveryClock.start();
+        mPlayAfterPrepare = mPlaybackState == PlaybackState::Started
+                || (mPlayAfterPrepare && mPlaybackState != PlaybackState::Paused);
+    }
+    mRecoveredClock.invalidate();
+    const int delay = qMin(RECOVERY_MAX_DELAY_MS, RECOVERY_BASE_DELAY_MS << qMin(mRecoveryAttempt, 16));
+    qWarning() << Q_FUNC_INFO << "error" << what << extra << "recovering in" << delay << "ms";
+    setPlaybackState(PlaybackState::Error);
+    mRecoveryTimer.start(delay);
+    emit recovering(mRecoveryAttempt + 1, delay);
+    return true;
+}
+
+void AndroidMediaPlayer::cancelRecovery()
+{
+    mRecoveryTimer.stop();
+    if (mRecoveryClock.isValid()) {
+        mRecoveryClock.invalidate();
+        mPlayAfterPrepare = false;
+    }
+    mRecoveredClock.invalidate();
+    mRecoveryAttempt = 0;
+}
+
+void AndroidMediaPlayer::savePosition()
+{
+    if (!mResumePlayback || !mPlaylist.isEmpty() || mDataSource.isEmpty()) {
+        return;
+    }
+    switch (mPlaybackState) {
+    case PlaybackState::Started:
+    case PlaybackState::Paused:
+        ResumeStore::instance().setPosition(mDataSource, partPosition());
+        mResumeClock.start();
+        break;
+    default:
+        break;
+    }
+}
+
+std::shared_ptr<MediaDataSource> AndroidMediaPlayer::createNativeDataSource(const QString &source) const
+{
+    const bool encrypted = !mContentKey.isEmpty();
+    if ((!mUseNativeDataSource && !mCacheClips && !encrypted)
+            || QtAndroid::androidSdkVersion() < MEDIA_DATA_SOURCE_MIN_SDK) {
+        return nullptr;
+    }
+
+    const QUrl url(source);
+    const QString &&path = url.isLocalFile() ? url.toLocalFile() : source;
+    if (!path.startsWith('/')) {
+        // not a local file, let MediaPlayer handle it
+        return nullptr;
+    }
+
+    std::shared_ptr<MediaDataSource> dataSource;
+    if (mCacheClips) {
+        // the cache keeps the ciphertext, clips are decrypted per read
+        if (const auto clip = ClipCache::instance().clip(path)) {
+            dataSource = std::make_shared<MemoryDataSource>(clip, mIoClient);
+        }
+    }
+    if (!dataSource) {
+        const auto file = std::make_shared<FileDataSource>(path.toStdString(), mIoClient);
+        if (!file->isOpen()) {
+            qWarning() << Q_FUNC_INFO << "can't open" << path;
+            return nullptr;
+        }
+        dataSource = file;
+    }
+
+    if (encrypted) {
+        const AesCtr cipher(reinterpret_cast<const quint8 *>(mContentKey.constData()), mContentKey.size(),
+                            reinterpret_cast<const quint8 *>(mContentIv.constData()));
+        dataSource = std::make_shared<AesCtrDataSource>(dataSource, cipher);
+    }
+    return dataSource;
 }
 
 void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onFinished
@@ -475,6 +1779,13 @@ void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onBuffering
                               Qt::QueuedConnection, Q_ARG(bool, state));
 }
 
+void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onBufferingUpdate
+    (JNIEnv *, jclass, jlong listener, jint percent) {
+    QMetaObject::invokeMethod(reinterpret_cast<AndroidMediaPlayer*>(listener),
+                              "onBufferingUpdate",
+                              Qt::QueuedConnection, Q_ARG(int, percent));
+}
+
 void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onPause
     (JNIEnv *, jclass, jlong listener) {
     QMetaObject::invokeMethod(reinterpret_cast<AndroidMediaPlayer*>(listener),
@@ -487,6 +1798,25 @@ void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onPrepared
                               "onPrepared", Qt::QueuedConnection);
 }
 
+void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onSeekComplete
+    (JNIEnv *, jclass, jlong listener) {
+    QMetaObject::invokeMethod(reinterpret_cast<AndroidMediaPlayer*>(listener),
+                              "onSeekComplete", Qt::QueuedConnection);
+}
+
+void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onNextPartStarted
+    (JNIEnv *, jclass, jlong listener) {
+    QMetaObject::invokeMethod(reinterpret_cast<AndroidMediaPlayer*>(listener),
+                              "onNextPartStarted", Qt::QueuedConnection);
+}
+
+void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onSuspended
+    (JNIEnv *, jclass, jlong listener, jboolean suspended) {
+    QMetaObject::invokeMethod(reinterpret_cast<AndroidMediaPlayer*>(listener),
+                              "onSuspended",
+                              Qt::QueuedConnection, Q_ARG(bool, suspended));
+}
+
 void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onVideoSizeChanged(JNIEnv *,
                                                                                       jclass,
                                                                                       jlong listener,
@@ -1,13 +1,27 @@
 #ifndef PLAYER_H
 #define PLAYER_H
 
+#include "BandwidthEstimator.h"
+#include "CallTiming.h"
+#include "EventRecorder.h"
+#include "IoScheduler.h"
+#include "VirtualTimeline.h"
+
 #include <QAndroidJniObject>
+#include <QElapsedTimer>
 #include <QObject>
 #include <QPointer>
 #include <QQuickItem>
 #include <QMetaType>
+#include <QStringList>
+#include <QTimer>
+#include <QVariant>
+
+#include <memory>
+#include <vector>
 
 class AndroidSurfaceView;
+class MediaDataSource;
 class QQuickItem;
 
 class AndroidMediaPlayer : public QObject
@@ -17,6 +31,24 @@ class AndroidMediaPlayer : public QObject
     Q_PROPERTY(PlaybackState playbackState READ playbackState NOTIFY playbackStateChanged)
     Q_PROPERTY(bool useRTPlayer READ useRTPlayer WRITE setUseRTPlayer NOTIFY useRTPlayerChanged)
     Q_PROPERTY(bool autoStart READ autoStart WRITE setAutoStart)
+    Q_PROPERTY(QVariantList bufferedRanges READ bufferedRanges NOTIFY bufferingProgressChanged)
+    Q_PROPERTY(qreal bufferingRate READ bufferingRate NOTIFY bufferingProgressChanged)
+    Q_PROPERTY(qint64 timeToStall READ timeToStall NOTIFY bufferingProgressChanged)
+    Q_PROPERTY(bool useNativeDataSource READ useNativeDataSource WRITE setUseNativeDataSource NOTIFY useNativeDataSourceChanged)
+    Q_PROPERTY(int ioPriority READ ioPriority WRITE setIoPriority NOTIFY ioPriorityChanged)
+    Q_PROPERTY(bool cacheClips READ cacheClips WRITE setCacheClips NOTIFY cacheClipsChanged)
+    Q_PROPERTY(bool loops READ loops WRITE setLoops NOTIFY loopsChanged)
+    Q_PROPERTY(QVariantList loopRange READ loopRange WRITE setLoopRange NOTIFY loopRangeChanged)
+    Q_PROPERTY(int loopGap READ loopGap NOTIFY looped)
+    Q_PROPERTY(QStringList playlist READ playlist WRITE setPlaylist NOTIFY playlistChanged)
+    Q_PROPERTY(int currentPart READ currentPart NOTIFY currentPartChanged)
+    Q_PROPERTY(int boundaryLatency READ boundaryLatency NOTIFY boundaryLatencyChanged)
+    Q_PROPERTY(bool resumePlayback READ resumePlayback WRITE setResumePlayback NOTIFY resumePlaybackChanged)
+    Q_PROPERTY(bool recoverFromErrors READ recoverFromErrors WRITE setRecoverFromErrors NOTIFY recoverFromErrorsChanged)
+    Q_PROPERTY(int maxRecoveryAttempts READ maxRecoveryAttempts WRITE setMaxRecoveryAttempts NOTIFY maxRecoveryAttemptsChanged)
+    Q_PROPERTY(int surfaceResumeLatency READ surfaceResumeLatency NOTIFY surfaceResumeLatencyChanged)
+    Q_PROPERTY(qreal trickPlayRate READ trickPlayRate WRITE setTrickPlayRate NOTIFY trickPlayRateChanged)
+    Q_PROPERTY(int trickPlayBudget READ trickPlayBudget WRITE setTrickPlayBudget NOTIFY trickPlayBudgetChanged)
 
 public:
     AndroidMediaPlayer(QObject *parent = nullptr);
@@ -58,35 +90,185 @@ public:
     bool useRTPlayer() const;
     bool autoStart() const;
     bool visible();
+    QVariantList bufferedRanges() const;
+    // Media ms buffered per wall-clock ms, 1.0 keeps up with normal playback.
+    // The slope of the buffered position, MediaPlayer reports no bytes
+    // downloaded, see BandwidthEstimator.
+    qreal bufferingRate() const;
+    qint64 timeToStall() const;
+    bool useNativeDataSource() const;
+    int ioPriority() const;
+    Q_INVOKABLE QVariantMap ioStats() const;
+    bool cacheClips() const;
+    // Media set after this call is treated as AES-CTR encrypted with the given
+    // hex encoded key (128, 192 or 256 bit) and 128-bit initial counter.
+    // Empty strings clear the key. Takes effect on the next setDataSource,
+    // which fails with error() unless the media is a local file and the
+    // device has MediaDataSource (API 23).
+    Q_INVOKABLE bool setContentKey(const QString &keyHex, const QString &ivHex);
+    bool loops() const;
+    QVariantList loopRange() const;
+    int loopGap() const;
+    QStringList playlist() const;
+    int currentPart() const;
+    int boundaryLatency() const;
+    bool resumePlayback() const;
+    bool recoverFromErrors() const;
+    int maxRecoveryAttempts() const;
+    Q_INVOKABLE QVariantMap recoveryStats() const;
+    // Feeds an error through the same path as one reported by MediaPlayer.
+    Q_INVOKABLE void simulateError(int what, int extra);
+    int surfaceResumeLatency() const;
+    // Latency of "testpattern:" frames on a SurfaceTexture surface view with
+    // measureLatency on, empty for other surface views.
+    Q_INVOKABLE QVariantMap latencyStats() const;
+    // Memory used for this player by category, split into measured values and
+    // estimates for what lives in the decoder, the surface buffer queue, the
+    // QSurfaceTexture texture and this object.
+    Q_INVOKABLE QVariantMap memoryReport() const;
+    // Players alive in the process, for the GUI thread only.
+    static QList<AndroidMediaPlayer *> players();
+    // Releases MediaPlayer and its decoder if the player is prepared, paused
+    // or completed. The player goes to Idle and prepares again at the same
+    // position on the next start(), resume() or seekTo(), or when the surface
+    // comes back if it was suspended with it. Returns the estimated bytes
+    // released.
+    qint64 releaseDecoder();
+    // Playback speed of a started player, 1 is normal speed. Returns false if
+    // the backend can't change it. Reset to 1 with every data source.
+    Q_INVOKABLE bool setPlaybackRate(qreal rate);
+    qreal playbackRate() const;
+    // Fast forward (> 1) or rewind (< 0) by showing sync frames only, 0 or 1
+    // returns to normal playback from the frame shown. Sync frames are looked
+    // up in an index built from the container when trick play first starts;
+    // without one the player seeks to the closest sync frame of the position
+    // it should be at. Not available for playlists.
+    qreal trickPlayRate() const;
+    // Time in ms a shown frame may take, seeks are not issued more often.
+    // Seeks that take longer skip the sync frames passed in the meantime, so
+    // the rate holds and only the frames shown per second drop.
+    int trickPlayBudget() const;
+    // Frames shown, skipped sync frames, seeks over budget and the achieved
+    // speed of the last trick play session.
+    Q_INVOKABLE QVariantMap trickPlayStats() const;
 
 signals:
     void playbackStateChanged(PlaybackState playbackState);
     void error(QString error);
     void buffering(bool state);
+    void bufferingProgressChanged();
     void surfaceViewChanged(QQuickItem * surfaceView);
     void videoSizeChanged(int width, int height);
     void useRTPlayerChanged(bool useRTPlayer);
+    void useNativeDataSourceChanged(bool useNativeDataSource);
+    void ioPriorityChanged(int ioPriority);
+    void cacheClipsChanged(bool cacheClips);
+    void loopsChanged(bool loops);
+    void loopRangeChanged(const QVariantList &loopRange);
+    void looped();
+    void playlistChanged(const QStringList &playlist);
+    void currentPartChanged(int currentPart);
+    void boundaryLatencyChanged(int boundaryLatency);
+    void resumePlaybackChanged(bool resumePlayback);
+    void recoverFromErrorsChanged(bool recoverFromErrors);
+    void maxRecoveryAttemptsChanged(int maxRecoveryAttempts);
+    // the backend died and is re-created after delay ms
+    void recovering(int attempt, int delay);
+    void recovered(int recoveryTime);
+    void surfaceResumeLatencyChanged(int surfaceResumeLatency);
+    void trickPlayRateChanged(qreal trickPlayRate);
+    void trickPlayBudgetChanged(int trickPlayBudget);
 
 public slots:
     void setSurfaceView(QQuickItem *surfaceView);
     void setUseRTPlayer(bool useRTPlayer);
     void setAutoStart(bool autoStart);
+    void setUseNativeDataSource(bool useNativeDataSource);
+    void setIoPriority(int ioPriority);
+    void setCacheClips(bool cacheClips);
+    void setLoops(bool loops);
+    void setLoopRange(const QVariantList &loopRange);
+    void setPlaylist(const QStringList &playlist);
+    void setResumePlayback(bool resumePlayback);
+    void setRecoverFromErrors(bool recoverFromErrors);
+    void setMaxRecoveryAttempts(int maxRecoveryAttempts);
+    void setTrickPlayRate(qreal trickPlayRate);
+    void setTrickPlayBudget(int trickPlayBudget);
 
 private slots:
     void onStarted();
     void onFinished();
     void onBuffering(bool state);
+    void onBufferingUpdate(int percent);
     void onError(int what, int extra);
     void onPause();
     void onPrepared();
     void onVideoSizeChanged(int width, int height);
     void setSurface(QAndroidJniObject surfaceView);
+    // Lets go of a SurfaceTexture surface before it is released, the decoder
+    // is kept and attaching the next surface resumes.
+    void detachSurface();
+    void onProgressTimer();
+    void onSeekComplete();
+    void onLoopTimer();
+    void onNextPartStarted();
+    void onRecoveryTimer();
+    void onSuspended(bool suspended);
+    void onTrickPlayTimer();
 
 private:
     void keepScreenOn(bool on);
     void setPlaybackState(PlaybackState newPlaybackState);
     void initAndroidPlayer();
     void release();
+    void openDataSource(const QString &source, bool reinitBackend = false);
+    long partPosition();
+    void switchToPart(int part, qint64 position, bool play);
+    void prefetchPartDurations();
+    bool hasLoopRange() const;
+    void applyLooping();
+    void scheduleLoop();
+    void savePosition();
+    // Returns false if the error is not recoverable or out of attempts.
+    bool startRecovery(int what, int extra);
+    void cancelRecovery();
+    void restoreDecoder(bool play);
+    // Bytes of a decoded frame while MediaPlayer holds a decoder, else 0.
+    qint64 estimatedFrameBytes() const;
+    qint64 estimatedOutputBuffers() const;
+    qint64 estimatedQueueBuffers() const;
+    void buildKeyframeIndex();
+    qint64 trickPlayPosition() const;
+    // Media ms played per wall-clock ms, 0 while nothing is consumed.
+    qreal effectiveRate() const;
+    // Returns true if the estimate changed.
+    bool updateTimeToStall();
+    void onTrickPlayFrame(qint64 latency);
+    // Leaves trick play, playback resumes if it was playing before.
+    void stopTrickPlay(bool resume);
+    std::shared_ptr<MediaDataSource> createNativeDataSource(const QString &source) const;
+
+    // Calls a method of the Java player, timed under the method name and
+    // recorded while an event recording runs.
+    template<typename T, typename... Args>
+    T callPlayer(const char *method, const char *signature, Args... args) const
+    {
+        if (EventRecorder::instance().isRecording()) {
+            EventRecorder::instance().command(this, method, args...);
+        }
+        const CallTiming::Scope timing(method);
+        return mAndroidPlayer.callMethod<T>(method, signature, args...);
+    }
+
+    template<typename T>
+    T callPlayer(const char *method) const
+    {
+        if (EventRecorder::instance().isRecording()) {
+            EventRecorder::instance().command(this, method);
+        }
+        const CallTiming::Scope timing(method);
+        return mAndroidPlayer.callMethod<T>(method);
+    }
 
     QPointer<QQuickItem> mSurfaceView;
     PlaybackState mPlaybackState;
@@ -94,6 +276,90 @@ private:
     bool mUseRTPlayer;
     bool mAutoStart;
     QString mDataSource;
+    qint64 mDuration;
+    qint64 mTimeToStall;
+    QElapsedTimer mBufferingClock;
+    BandwidthEstimator mBandwidthEstimator;
+    bool mUseNativeDataSource;
+    bool mCacheClips;
+    QByteArray mContentKey;
+    QByteArray mContentIv;
+    std::shared_ptr<IoScheduler::Client> mIoClient;
+    std::shared_ptr<MediaDataSource> mNativeDataSource;
+    // of the next part, once it is prepared ahead
+    std::shared_ptr<MediaDataSource> mNextNativeDataSource;
+    QTimer mProgressTimer;
+    bool mLoops;
+    qint64 mLoopStart;
+    qint64 mLoopEnd;
+    QTimer mLoopTimer;
+    bool mLoopSeekPending;
+    // from the loop seek to the first frame of the loop start on screen,
+    // less the time the loop end was still ahead when the seek was issued
+    QElapsedTimer mLoopClock;
+    qint64 mLoopLead;
+    int mLoopGap;
+    QElapsedTimer mSeekClock;
+    qint64 mSeekLatency;
+    QStringList mPlaylist;
+    VirtualTimeline mTimeline;
+    int mCurrentPart;
+    int mPlaylistGeneration;
+    qint64 mPendingStartPosition;
+    bool mPlayAfterPrepare;
+    bool mNextPartRequested;
+    QElapsedTimer mBoundaryClock;
+    int mBoundaryLatency;
+    bool mResumePlayback;
+    QElapsedTimer mResumeClock;
+    // last position known to be good, restored after a recovery
+    qint64 mLastPosition;
+    bool mRecoverFromErrors;
+    int mMaxRecoveryAttempts;
+    int mRecoveryAttempt;
+    QTimer mRecoveryTimer;
+    QElapsedTimer mRecoveryClock;
+    QElapsedTimer mRecoveredClock;
+    struct {
+        quint64 attempts = 0;
+        quint64 recoveries = 0;
+        quint64 failures = 0;
+        int lastTime = 0;
+        int maxTime = 0;
+        qint64 totalTime = 0;
+    } mRecoveryStats;
+    QElapsedTimer mSurfaceResumeClock;
+    int mSurfaceResumeLatency;
+    QSize mVideoSize;
+    // paused by the Java side because the surface went away
+    bool mSuspended;
+    bool mDecoderReleased;
+    bool mRestoreWithSurface;
+    qreal mPlaybackRate;
+    qreal mTrickPlayRate;
+    int mTrickPlayBudget;
+    QTimer mTrickPlayTimer;
+    // the trick play position is mTrickPlayOrigin + rate * mTrickPlayClock
+    QElapsedTimer mTrickPlayClock;
+    qint64 mTrickPlayOrigin;
+    // the sync frame shown or being sought to
+    qint64 mTrickPlayFrame;
+    bool mTrickPlaySeekPending;
+    bool mPlayAfterTrickPlay;
+    QElapsedTimer mTrickPlaySessionClock;
+    // sync frame times in ms of mKeyframesSource, ascending
+    std::vector<qint64> mKeyframes;
+    QString mKeyframesSource;
+    struct {
+        qint64 startPosition = 0;
+        quint64 frames = 0;
+        quint64 skippedKeyframes = 0;
+        quint64 overBudget = 0;
+        qint64 seekTime = 0;
+        // from the start of the session to the last frame shown
+        qint64 time = 0;
+        qint64 indexTime = 0;
+    } mTrickPlayStats;
 };
 
 Q_DECLARE_METATYPE(AndroidMediaPlayer::PlaybackState)
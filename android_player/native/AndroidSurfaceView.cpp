@@ -1,4 +1,6 @@
 #include "AndroidSurfaceView.h"
+#include "CallTiming.h"
+#include "PlayerLog.h"
 
 #include "com_vadim_android_NativeSurfaceChangeListener.h"
 
@@ -8,42 +10,45 @@
 #include <QScreen>
 
 AndroidSurfaceView::AndroidSurfaceView(QQuickItem *parent) :
-    QuickItemPlayerSurface(parent)
+    QuickItemPlayerSurface(parent),
+    mListener(new QPointer<AndroidSurfaceView>(this))
 {
-    qDebug() << Q_FUNC_INFO;
+    PLAYER_DEBUG(Surface);
 
-    QtAndroid::runOnAndroidThreadSync([this] {
-        mSurfaceView = QAndroidJniObject("com/vadim/android/PlayerSurfaceView",
-                                     "(Landroid/content/Context;)V",
-                                     QtAndroid::androidContext().object());
-        qDebug() << Q_FUNC_INFO << "AndroidSurfaceView" << mSurfaceView.isValid();
-        mSurfaceView.callMethod<void>("setFocusable", "(Z)V", jboolean(false));
-        mSurfaceView.callMethod<void>("setFocusableInTouchMode", "(Z)V", jboolean(false));
-        mSurfaceView.callMethod<void>("setZOrderMediaOverlay", "(Z)V", jboolean(false));
-        mSurfaceView.callMethod<void>("setZOrderOnTop", "(Z)V", jboolean(false));
-        mSurfaceView.callMethod<void>("setSurfaceChangeListener",
-                                      "(Lcom/vadim/android/SurfaceChangeListener;)V",
-                                      QAndroidJniObject("com/vadim/android/NativeSurfaceChangeListener",
-                                                        "(J)V",
-                                                        jlong(this)).object());
+    const auto listener = mListener;
+    createView([listener] {
+        TIME_CALL("async:createPlayerSurfaceView");
+        QAndroidJniObject view("com/vadim/android/PlayerSurfaceView",
+                               "(Landroid/content/Context;)V",
+                               QtAndroid::androidContext().object());
+        PLAYER_DEBUG(Surface) << "AndroidSurfaceView" << view.isValid();
+        view.callMethod<void>("setFocusable", "(Z)V", jboolean(false));
+        view.callMethod<void>("setFocusableInTouchMode", "(Z)V", jboolean(false));
+        view.callMethod<void>("setZOrderMediaOverlay", "(Z)V", jboolean(false));
+        view.callMethod<void>("setZOrderOnTop", "(Z)V", jboolean(false));
+        view.callMethod<void>("setSurfaceChangeListener",
+                              "(Lcom/vadim/android/SurfaceChangeListener;)V",
+                              QAndroidJniObject("com/vadim/android/NativeSurfaceChangeListener",
+                                                "(J)V",
+                                                jlong(listener)).object());
+        return view;
     });
 }
 
 AndroidSurfaceView::~AndroidSurfaceView()
 {
-    qDebug() << Q_FUNC_INFO;
-    QtAndroid::runOnAndroidThreadSync([this] {
-        mSurfaceView.callMethod<void>("setSurfaceChangeListener",
-                                      "(Lcom/vadim/android/SurfaceChangeListener;)V",
-                                      nullptr);
+    PLAYER_DEBUG(Surface);
+    // surface changes until then find the handle cleared and are dropped
+    const auto listener = mListener;
+    postToView([listener](const QAndroidJniObject &view) {
+        TIME_CALL("async:setSurfaceChangeListener");
+        view.callMethod<void>("setSurfaceChangeListener",
+                              "(Lcom/vadim/android/SurfaceChangeListener;)V",
+                              nullptr);
+        delete listener;
     });
 }
 
-QAndroidJniObject AndroidSurfaceView::view() const
-{
-    return mSurfaceView;
-}
-
 QAndroidJniObject AndroidSurfaceView::surface() const
 {
     return mSurface;
@@ -56,17 +61,18 @@ AndroidSurfaceView::ScalingMode AndroidSurfaceView::scalingMode() const
 
 void AndroidSurfaceView::setVideoSize(int width, int height)
 {
-    qDebug() << Q_FUNC_INFO << width << height;
-    QtAndroid::runOnAndroidThread([this, width, height] {
-        mSurfaceView.callMethod<void>("setVideoSize",
-                                      "(II)V",
-                                      jint(width), jint(height));
+    PLAYER_DEBUG(Surface) << width << height;
+    postToView([width, height](const QAndroidJniObject &view) {
+        TIME_CALL("async:setVideoSize");
+        view.callMethod<void>("setVideoSize",
+                              "(II)V",
+                              jint(width), jint(height));
     });
 }
 
 void AndroidSurfaceView::onSurfaceChanged(QAndroidJniObject surface)
 {
-    qDebug() << Q_FUNC_INFO;
+    PLAYER_DEBUG(Surface);
     if (mSurface != surface) {
         mSurface = surface;
         emit surfaceChanged(surface);
@@ -75,24 +81,30 @@ void AndroidSurfaceView::onSurfaceChanged(QAndroidJniObject surface)
 
 void AndroidSurfaceView::setScalingMode(AndroidSurfaceView::ScalingMode scalingMode)
 {
-    qDebug() << Q_FUNC_INFO << "scalingMode:" << scalingMode;
+    PLAYER_DEBUG(Surface) << "scalingMode:" << scalingMode;
 
     if (mScalingMode == scalingMode)
         return;
     mScalingMode = scalingMode;
-    QtAndroid::runOnAndroidThread([this, scalingMode] {
-        mSurfaceView.callMethod<void>("setScalingMode",
-                                      "(I)V",
-                                      jint(scalingMode));
+    postToView([scalingMode](const QAndroidJniObject &view) {
+        TIME_CALL("async:setScalingMode");
+        view.callMethod<void>("setScalingMode",
+                              "(I)V",
+                              jint(scalingMode));
     });
     emit scalingModeChanged(mScalingMode);
 }
 
 JNIEXPORT void JNICALL Java_com_vadim_android_NativeSurfaceChangeListener_onSurfaceChanged
 (JNIEnv *, jclass, jlong listener, jobject surface) {
-    qDebug() << Q_FUNC_INFO << "listener:" << reinterpret_cast<AndroidSurfaceView *>(listener)
+    PLAYER_DEBUG(Surface) << "listener:" << reinterpret_cast<void *>(listener)
              << "surface:" << surface;
-    QMetaObject::invokeMethod(reinterpret_cast<AndroidSurfaceView *>(listener),
-                              "onSurfaceChanged", Qt::QueuedConnection,
-                              Q_ARG(QAndroidJniObject, QAndroidJniObject(surface)));
+    // the item may be gone by the time this is delivered
+    const QPointer<AndroidSurfaceView> view = *reinterpret_cast<QPointer<AndroidSurfaceView> *>(listener);
+    const QAndroidJniObject surfaceObject(surface);
+    QMetaObject::invokeMethod(qApp, [view, surfaceObject] {
+        if (view) {
+            view->onSurfaceChanged(surfaceObject);
+        }
+    }, Qt::QueuedConnection);
 }
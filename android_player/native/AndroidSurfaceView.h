@@ -4,6 +4,7 @@
 #include "QuickItemSurface.h"
 
 #include <QAndroidJniObject>
+#include <QPointer>
 
 class AndroidSurfaceView : public QuickItemPlayerSurface
 {
@@ -20,7 +21,6 @@ public:
     };
     Q_ENUM(ScalingMode)
 
-    QAndroidJniObject view() const override;
     QAndroidJniObject surface() const;
     ScalingMode scalingMode() const;
 
@@ -34,7 +34,9 @@ public slots:
     void setScalingMode(ScalingMode scalingMode);
 
 private:
-    QAndroidJniObject mSurfaceView;
+    // handle of the Java listener, deleted on the Android UI thread once the
+    // listener is removed
+    QPointer<AndroidSurfaceView> *mListener;
     QAndroidJniObject mSurface;
     ScalingMode mScalingMode;
 };
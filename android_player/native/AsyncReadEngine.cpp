@@ -0,0 +1,451 @@
+#include "AsyncReadEngine.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define PLAYER_HAS_IO_URING 1
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#ifdef __ANDROID__
+#include <cstdlib>
+#include <sys/system_properties.h>
+#endif
+#endif
+
+namespace {
+
+const int MAX_POOL_THREADS = 4;
+#ifdef __ANDROID__
+// Android 12, the first release whose app seccomp filter passes io_uring
+const int MIN_URING_SDK = 31;
+#endif
+
+class ThreadPoolReadEngine : public AsyncReadEngine
+{
+public:
+    ThreadPoolReadEngine(int queueDepth, Completion completion) :
+        AsyncReadEngine(queueDepth, std::move(completion))
+    {
+        for (int i = 0; i < qMin(queueDepth, MAX_POOL_THREADS); ++i) {
+            mThreads.emplace_back(&ThreadPoolReadEngine::run, this);
+        }
+    }
+
+    ~ThreadPoolReadEngine() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopped = true;
+        }
+        mPending.notify_all();
+        for (auto &thread : mThreads) {
+            thread.join();
+        }
+    }
+
+    void submit(const std::vector<Read> &reads) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQueue.insert(mQueue.end(), reads.begin(), reads.end());
+        }
+        if (reads.size() == 1) {
+            mPending.notify_one();
+        } else {
+            mPending.notify_all();
+        }
+    }
+
+    const char *name() const override
+    {
+        return "threadpool";
+    }
+
+private:
+    void run()
+    {
+        for (;;) {
+            Read read;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mPending.wait(lock, [this] { return mStopped || !mQueue.empty(); });
+                if (mQueue.empty()) {
+                    return;
+                }
+                read = mQueue.front();
+                mQueue.pop_front();
+            }
+            mCompletion(read.tag, readInline(read));
+        }
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mPending;
+    std::deque<Read> mQueue;
+    std::vector<std::thread> mThreads;
+    bool mStopped = false;
+};
+
+#ifdef PLAYER_HAS_IO_URING
+
+const __u64 WAKEUP_USER_DATA = ~__u64(0);
+const __u64 CANCEL_USER_DATA = ~__u64(0) - 1;
+
+class UringReadEngine : public AsyncReadEngine
+{
+public:
+    UringReadEngine(int queueDepth, Completion completion) :
+        AsyncReadEngine(queueDepth, std::move(completion))
+    {
+    }
+
+    ~UringReadEngine() override
+    {
+        if (mReaper.joinable()) {
+            mStopped = true;
+            if (!mReaperExited) {
+                // wake the reaper with a no-op
+                std::lock_guard<std::mutex> lock(mSubmitMutex);
+                io_uring_sqe *sqe = nextSqe();
+                sqe->opcode = IORING_OP_NOP;
+                sqe->user_data = WAKEUP_USER_DATA;
+                commit();
+            }
+            mReaper.join();
+        }
+        // the pool's reads are still running
+        mFallback.reset();
+        if (mSqes) {
+            munmap(mSqes, mSqesSize);
+        }
+        if (mCqRing) {
+            munmap(mCqRing, mCqRingSize);
+        }
+        if (mSqRing) {
+            munmap(mSqRing, mSqRingSize);
+        }
+        if (mRingFd >= 0) {
+            ::close(mRingFd);
+        }
+    }
+
+    bool init()
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        // one extra entry for the shutdown wakeup
+        mRingFd = int(syscall(__NR_io_uring_setup, unsigned(mQueueDepth + 1), &params));
+        if (mRingFd < 0) {
+            return false;
+        }
+
+        mSqRingSize = params.sq_off.array + params.sq_entries * sizeof(__u32);
+        mCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        mSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        mSqRing = map(mSqRingSize, IORING_OFF_SQ_RING);
+        mCqRing = map(mCqRingSize, IORING_OFF_CQ_RING);
+        mSqes = static_cast<io_uring_sqe *>(map(mSqesSize, IORING_OFF_SQES));
+        if (!mSqRing || !mCqRing || !mSqes) {
+            return false;
+        }
+
+        auto *sq = static_cast<char *>(mSqRing);
+        mSqTail = reinterpret_cast<std::atomic<__u32> *>(sq + params.sq_off.tail);
+        mSqMask = *reinterpret_cast<__u32 *>(sq + params.sq_off.ring_mask);
+        mSqArray = reinterpret_cast<__u32 *>(sq + params.sq_off.array);
+        auto *cq = static_cast<char *>(mCqRing);
+        mCqHead = reinterpret_cast<std::atomic<__u32> *>(cq + params.cq_off.head);
+        mCqTail = reinterpret_cast<std::atomic<__u32> *>(cq + params.cq_off.tail);
+        mCqMask = *reinterpret_cast<__u32 *>(cq + params.cq_off.ring_mask);
+        mCqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+        mIovecs.resize(size_t(mQueueDepth));
+        mTags.resize(size_t(mQueueDepth));
+        mBusy.resize(size_t(mQueueDepth));
+        for (int i = 0; i < mQueueDepth; ++i) {
+            mFreeSlots.push_back(i);
+        }
+
+        mReaper = std::thread(&UringReadEngine::reap, this);
+        return true;
+    }
+
+    void submit(const std::vector<Read> &reads) override
+    {
+        std::lock_guard<std::mutex> lock(mSubmitMutex);
+        if (mFallback) {
+            mFallback->submit(reads);
+            return;
+        }
+        std::vector<int> slots;
+        for (const Read &read : reads) {
+            const int slot = mFreeSlots.back();
+            mFreeSlots.pop_back();
+            slots.push_back(slot);
+            mIovecs[size_t(slot)] = {read.buffer, size_t(read.size)};
+            mTags[size_t(slot)] = read.tag;
+            mBusy[size_t(slot)] = true;
+            ++mInFlight;
+
+            io_uring_sqe *sqe = nextSqe();
+            sqe->opcode = IORING_OP_READV;
+            sqe->fd = read.fd;
+            sqe->off = __u64(read.offset);
+            sqe->addr = reinterpret_cast<__u64>(&mIovecs[size_t(slot)]);
+            sqe->len = 1;
+            sqe->user_data = __u64(slot);
+        }
+        const size_t submitted = commit();
+        if (submitted < reads.size()) {
+            // the kernel failed the submission: the reads it took complete on
+            // the ring, the pool reads the others and every later batch
+            for (size_t i = submitted; i < slots.size(); ++i) {
+                release(slots[i]);
+            }
+            mFallback.reset(new ThreadPoolReadEngine(mQueueDepth, mCompletion));
+            mFallback->submit(std::vector<Read>(reads.begin() + std::ptrdiff_t(submitted), reads.end()));
+        }
+    }
+
+    const char *name() const override
+    {
+        return "io_uring";
+    }
+
+private:
+    void *map(size_t size, off_t offset)
+    {
+        void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRingFd, offset);
+        return ptr == MAP_FAILED ? nullptr : ptr;
+    }
+
+    // mSubmitMutex must be held
+    io_uring_sqe *nextSqe()
+    {
+        const __u32 index = (mSqTail->load(std::memory_order_relaxed) + mPendingSqes) & mSqMask;
+        ++mPendingSqes;
+        mSqArray[index] = index;
+        io_uring_sqe *sqe = &mSqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    // mSubmitMutex must be held
+    void release(int slot)
+    {
+        mBusy[size_t(slot)] = false;
+        mFreeSlots.push_back(slot);
+        --mInFlight;
+    }
+
+    // mSubmitMutex must be held. Submits the entries queued with nextSqe(),
+    // the rest of a short submit again, and returns how many the kernel
+    // took. Without SQPOLL the kernel only reads the ring in
+    // io_uring_enter() and takes entries in order: the ones it did not take
+    // are the last ones and come off the ring again, so no later
+    // io_uring_enter() submits them.
+    unsigned commit()
+    {
+        const unsigned count = mPendingSqes;
+        mPendingSqes = 0;
+        const __u32 tail = mSqTail->load(std::memory_order_relaxed) + count;
+        mSqTail->store(tail, std::memory_order_release);
+        unsigned submitted = 0;
+        while (submitted < count) {
+            const long result = syscall(__NR_io_uring_enter, mRingFd, count - submitted, 0, 0, nullptr, 0);
+            if (result > 0) {
+                submitted += unsigned(result);
+            } else if (result == 0 || errno != EINTR) {
+                break;
+            }
+        }
+        if (submitted < count) {
+            mSqTail->store(tail - (count - submitted), std::memory_order_release);
+        }
+        return submitted;
+    }
+
+    // Hands the completions in the queue to the handler. Reads cancelled by
+    // retire() fail with cancelError. Returns true if the destructor's
+    // wakeup was among them.
+    bool complete(int cancelError = 0)
+    {
+        bool woken = false;
+        __u32 head = mCqHead->load(std::memory_order_relaxed);
+        while (head != mCqTail->load(std::memory_order_acquire)) {
+            const io_uring_cqe &cqe = mCqes[head & mCqMask];
+            const __u64 userData = cqe.user_data;
+            qint64 result = cqe.res;
+            mCqHead->store(++head, std::memory_order_release);
+
+            if (userData == WAKEUP_USER_DATA) {
+                woken = true;
+                continue;
+            }
+            if (userData == CANCEL_USER_DATA) {
+                continue;
+            }
+            if (cancelError && (result == -ECANCELED || result == -EINTR)) {
+                result = -cancelError;
+            }
+            void *tag;
+            {
+                std::lock_guard<std::mutex> lock(mSubmitMutex);
+                tag = mTags[size_t(userData)];
+                release(int(userData));
+            }
+            mCompletion(tag, result);
+        }
+        return woken;
+    }
+
+    int inFlight()
+    {
+        std::lock_guard<std::mutex> lock(mSubmitMutex);
+        return mInFlight;
+    }
+
+    // The ring can't be waited on any more: hands the later reads to the
+    // pool and fails the reads in flight on the ring. The kernel may still
+    // write into their buffers, so they are cancelled and their completions,
+    // which the kernel posts without io_uring_enter(), awaited first.
+    void retire(int error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mSubmitMutex);
+            if (!mFallback) {
+                mFallback.reset(new ThreadPoolReadEngine(mQueueDepth, mCompletion));
+            }
+            for (size_t slot = 0; slot < mBusy.size(); ++slot) {
+                if (mBusy[slot]) {
+                    io_uring_sqe *sqe = nextSqe();
+                    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                    sqe->addr = __u64(slot);
+                    sqe->user_data = CANCEL_USER_DATA;
+                }
+            }
+            // reads that can't be cancelled finish on their own
+            commit();
+        }
+        while (inFlight() > 0) {
+            complete(error);
+            if (inFlight() > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        mReaperExited = true;
+    }
+
+    void reap()
+    {
+        for (;;) {
+            if (syscall(__NR_io_uring_enter, mRingFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                retire(errno);
+                return;
+            }
+            // reads still in flight at the wakeup write into their buffers
+            // until they complete
+            if (complete() && mStopped) {
+                mStopping = true;
+            }
+            if (mStopping && inFlight() == 0) {
+                return;
+            }
+        }
+    }
+
+    int mRingFd = -1;
+    void *mSqRing = nullptr;
+    void *mCqRing = nullptr;
+    io_uring_sqe *mSqes = nullptr;
+    size_t mSqRingSize = 0;
+    size_t mCqRingSize = 0;
+    size_t mSqesSize = 0;
+
+    std::atomic<__u32> *mSqTail = nullptr;
+    __u32 mSqMask = 0;
+    __u32 *mSqArray = nullptr;
+    std::atomic<__u32> *mCqHead = nullptr;
+    std::atomic<__u32> *mCqTail = nullptr;
+    __u32 mCqMask = 0;
+    io_uring_cqe *mCqes = nullptr;
+
+    std::mutex mSubmitMutex;
+    unsigned mPendingSqes = 0;
+    std::vector<iovec> mIovecs;
+    std::vector<void *> mTags;
+    std::vector<char> mBusy;
+    std::vector<int> mFreeSlots;
+    int mInFlight = 0;
+    // takes the reads once the ring failed
+    std::unique_ptr<AsyncReadEngine> mFallback;
+    std::thread mReaper;
+    std::atomic<bool> mStopped{false};
+    std::atomic<bool> mReaperExited{false};
+    // reaper thread
+    bool mStopping = false;
+};
+
+bool uringAllowed()
+{
+#ifdef __ANDROID__
+    char sdk[PROP_VALUE_MAX] = {};
+    __system_property_get("ro.build.version.sdk", sdk);
+    return atoi(sdk) >= MIN_URING_SDK;
+#else
+    return true;
+#endif
+}
+
+#endif // PLAYER_HAS_IO_URING
+
+}
+
+std::unique_ptr<AsyncReadEngine> AsyncReadEngine::create(int queueDepth, Completion completion, Backend backend)
+{
+    queueDepth = qMax(1, queueDepth);
+#ifdef PLAYER_HAS_IO_URING
+    if (backend == Backend::Best && uringAllowed()) {
+        std::unique_ptr<UringReadEngine> uring(new UringReadEngine(queueDepth, completion));
+        if (uring->init()) {
+            return uring;
+        }
+    }
+#else
+    Q_UNUSED(backend)
+#endif
+    return std::unique_ptr<AsyncReadEngine>(new ThreadPoolReadEngine(queueDepth, std::move(completion)));
+}
+
+qint64 AsyncReadEngine::readInline(const Read &read)
+{
+    ssize_t result;
+    do {
+        result = ::pread(read.fd, read.buffer, size_t(read.size), off_t(read.offset));
+    } while (result < 0 && errno == EINTR);
+    return result < 0 ? -errno : result;
+}
+
+int AsyncReadEngine::queueDepth() const
+{
+    return mQueueDepth;
+}
+
+AsyncReadEngine::AsyncReadEngine(int queueDepth, Completion completion) :
+    mQueueDepth(queueDepth),
+    mCompletion(std::move(completion))
+{
+}
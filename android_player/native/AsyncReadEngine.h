@@ -0,0 +1,61 @@
+#ifndef ASYNCREADENGINE_H
+#define ASYNCREADENGINE_H
+
+#include <QtGlobal>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Executes positional reads without parking a thread per reader. Reads are
+// submitted in batches and land directly in the caller's buffer; the
+// completion handler runs on an engine thread with the read's tag and the
+// pread-style result (bytes read or -errno).
+//
+// create() prefers io_uring and falls back to a small thread pool when the
+// kernel or the sandbox does not allow it. On Android io_uring is only tried
+// from Android 12 on: earlier app seccomp filters do not list its syscalls and
+// a call is fatal (SIGSYS). Later releases let SELinux decide, a denial fails
+// io_uring_setup() and the pool is used. A ring that fails at runtime is
+// retired and the pool takes over: the reads the kernel did not take go to
+// the pool, the ones in flight on the ring are cancelled and fail once the
+// kernel is done with their buffers.
+class AsyncReadEngine
+{
+public:
+    struct Read {
+        int fd;
+        qint64 offset;
+        char *buffer;
+        qint64 size;
+        void *tag;
+    };
+    using Completion = std::function<void(void *tag, qint64 result)>;
+    enum class Backend {
+        Best,
+        ThreadPool
+    };
+
+    static std::unique_ptr<AsyncReadEngine> create(int queueDepth, Completion completion,
+                                                   Backend backend = Backend::Best);
+
+    // A read on the calling thread, with the result convention of the
+    // completion handler.
+    static qint64 readInline(const Read &read);
+
+    virtual ~AsyncReadEngine() = default;
+
+    // The caller must not have more than queueDepth() reads in flight.
+    virtual void submit(const std::vector<Read> &reads) = 0;
+    virtual const char *name() const = 0;
+
+    int queueDepth() const;
+
+protected:
+    AsyncReadEngine(int queueDepth, Completion completion);
+
+    const int mQueueDepth;
+    const Completion mCompletion;
+};
+
+#endif // ASYNCREADENGINE_H
@@ -0,0 +1,117 @@
+#include "AtomicLatencyHistogram.h"
+
+#include <limits>
+
+namespace {
+
+// log2 of SubBuckets
+const int SUB_BUCKET_BITS = 4;
+static_assert(1 << SUB_BUCKET_BITS == AtomicLatencyHistogram::SubBuckets, "SubBuckets is a power of two");
+
+int highestBit(quint64 value)
+{
+    return 63 - __builtin_clzll(value);
+}
+
+}
+
+void AtomicLatencyHistogram::record(qint64 us)
+{
+    const qint64 value = qMax<qint64>(0, us);
+    mBuckets[size_t(bucketIndex(value))].fetch_add(1, std::memory_order_relaxed);
+    mCount.fetch_add(1, std::memory_order_relaxed);
+    mSum.fetch_add(value, std::memory_order_relaxed);
+    qint64 max = mMax.load(std::memory_order_relaxed);
+    while (value > max && !mMax.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+void AtomicLatencyHistogram::clear()
+{
+    for (std::atomic<quint64> &bucket : mBuckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    mCount.store(0, std::memory_order_relaxed);
+    mSum.store(0, std::memory_order_relaxed);
+    mMax.store(0, std::memory_order_relaxed);
+}
+
+quint64 AtomicLatencyHistogram::count() const
+{
+    return mCount.load(std::memory_order_relaxed);
+}
+
+qint64 AtomicLatencyHistogram::max() const
+{
+    return mMax.load(std::memory_order_relaxed);
+}
+
+double AtomicLatencyHistogram::mean() const
+{
+    const quint64 count = this->count();
+    return count ? double(mSum.load(std::memory_order_relaxed)) / double(count) : 0.0;
+}
+
+qint64 AtomicLatencyHistogram::percentile(double percent) const
+{
+    // the total of the buckets, count() may not match them yet
+    std::array<quint64, BucketCount> buckets;
+    quint64 total = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        buckets[i] = mBuckets[i].load(std::memory_order_relaxed);
+        total += buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    const quint64 rank = quint64(double(total) * qBound(0.0, percent, 100.0) / 100.0);
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += buckets[size_t(i)];
+        if (seen > rank || seen == total) {
+            return qMin(bucketUpperBound(i), max());
+        }
+    }
+    return max();
+}
+
+quint64 AtomicLatencyHistogram::bucket(int index) const
+{
+    return mBuckets[size_t(index)].load(std::memory_order_relaxed);
+}
+
+int AtomicLatencyHistogram::bucketIndex(qint64 us)
+{
+    if (us < 2 * SubBuckets) {
+        return int(qMax<qint64>(0, us));
+    }
+    const int exponent = highestBit(quint64(us));
+    if (exponent >= MaxExponent) {
+        return BucketCount - 1;
+    }
+    // exponent >= 5, the top SUB_BUCKET_BITS + 1 bits pick the sub-bucket
+    const int shift = exponent - SUB_BUCKET_BITS;
+    const int sub = int(us >> shift) - SubBuckets;
+    return 2 * SubBuckets + (exponent - 5) * SubBuckets + sub;
+}
+
+qint64 AtomicLatencyHistogram::bucketLowerBound(int index)
+{
+    if (index < 2 * SubBuckets) {
+        return index;
+    }
+    if (index == BucketCount - 1) {
+        return qint64(1) << MaxExponent;
+    }
+    const int exponent = 5 + (index - 2 * SubBuckets) / SubBuckets;
+    const int sub = (index - 2 * SubBuckets) % SubBuckets;
+    return qint64(SubBuckets + sub) << (exponent - SUB_BUCKET_BITS);
+}
+
+qint64 AtomicLatencyHistogram::bucketUpperBound(int index)
+{
+    if (index == BucketCount - 1) {
+        return std::numeric_limits<qint64>::max();
+    }
+    return bucketLowerBound(index + 1);
+}
@@ -0,0 +1,51 @@
+#ifndef ATOMICLATENCYHISTOGRAM_H
+#define ATOMICLATENCYHISTOGRAM_H
+
+#include <QtGlobal>
+
+#include <array>
+#include <atomic>
+
+// Histogram of durations in microseconds that any number of threads record
+// into without a lock. Buckets are HDR-style: values below 2 * SubBuckets are
+// counted exactly, above that every power of two is split into SubBuckets
+// linear sub-buckets, so a bucket is at most 1/SubBuckets of its values wide.
+// Values from 2^MaxExponent us (about 12 days) on share the last bucket.
+//
+// Readers see every record, but not atomically: count() may be ahead of or
+// behind the buckets while records are in flight.
+class AtomicLatencyHistogram
+{
+public:
+    static constexpr int SubBuckets = 16;
+    static constexpr int MaxExponent = 40;
+    static constexpr int BucketCount = 2 * SubBuckets + (MaxExponent - 5) * SubBuckets + 1;
+
+    AtomicLatencyHistogram() = default;
+
+    void record(qint64 us);
+    void clear();
+
+    quint64 count() const;
+    qint64 max() const;
+    double mean() const;
+    // Upper bound of the bucket that holds the given percentile (0..100),
+    // capped by max().
+    qint64 percentile(double percent) const;
+
+    quint64 bucket(int index) const;
+    static int bucketIndex(qint64 us);
+    // Values in bucket index are in [bucketLowerBound(index), bucketUpperBound(index)).
+    static qint64 bucketLowerBound(int index);
+    static qint64 bucketUpperBound(int index);
+
+private:
+    Q_DISABLE_COPY(AtomicLatencyHistogram)
+
+    std::array<std::atomic<quint64>, BucketCount> mBuckets{};
+    std::atomic<quint64> mCount{0};
+    std::atomic<qint64> mSum{0};
+    std::atomic<qint64> mMax{0};
+};
+
+#endif // ATOMICLATENCYHISTOGRAM_H
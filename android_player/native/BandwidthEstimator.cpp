@@ -0,0 +1,114 @@
+#include "BandwidthEstimator.h"
+
+#include <cmath>
+
+BandwidthEstimator::BandwidthEstimator(qint64 halfLifeMs) :
+    mHalfLifeMs(qMax<qint64>(1, halfLifeMs))
+{
+    reset();
+}
+
+void BandwidthEstimator::reset()
+{
+    mOldestChange = 0;
+    mChangeCount = 0;
+    mLastSampleMs = -1;
+    mStepMs = 0;
+    mRate = 0.0;
+    mHasEstimate = false;
+}
+
+void BandwidthEstimator::addSample(qint64 timestampMs, qint64 bufferedMs)
+{
+    if (mChangeCount == 0 || bufferedMs < this->bufferedMs()) {
+        // first sample or the buffer was dropped (seek, new source)
+        mChanges[0] = {timestampMs, bufferedMs};
+        mOldestChange = 0;
+        mChangeCount = 1;
+        mLastSampleMs = timestampMs;
+        return;
+    }
+
+    const Change &last = change(mChangeCount - 1);
+    const qint64 elapsed = timestampMs - last.timestampMs;
+    if (elapsed <= 0) {
+        return;
+    }
+    mLastSampleMs = qMax(mLastSampleMs, timestampMs);
+
+    const qint64 added = bufferedMs - last.bufferedMs;
+    if (added == 0) {
+        // less than a step was buffered since the last change
+        if (mHasEstimate && mStepMs > 0) {
+            mRate = qMin(mRate, double(mStepMs) / double(elapsed));
+        }
+        return;
+    }
+    mStepMs = mStepMs > 0 ? qMin(mStepMs, added) : added;
+
+    // the changes before the window are out of it for good, the previous
+    // change is kept
+    while (mChangeCount > 1 && timestampMs - change(0).timestampMs > WINDOW_MS) {
+        mOldestChange = (mOldestChange + 1) % MAX_CHANGES;
+        --mChangeCount;
+    }
+    const Change &from = change(0);
+    const double rate = double(bufferedMs - from.bufferedMs) / double(timestampMs - from.timestampMs);
+    if (mChangeCount == MAX_CHANGES) {
+        mOldestChange = (mOldestChange + 1) % MAX_CHANGES;
+        --mChangeCount;
+    }
+    mChanges[(mOldestChange + mChangeCount++) % MAX_CHANGES] = {timestampMs, bufferedMs};
+
+    if (mHasEstimate) {
+        // weight of the new sample grows with the time it covers
+        const double alpha = 1.0 - std::exp2(-double(elapsed) / double(mHalfLifeMs));
+        mRate += alpha * (rate - mRate);
+    } else {
+        mRate = rate;
+        mHasEstimate = true;
+    }
+}
+
+bool BandwidthEstimator::hasEstimate() const
+{
+    return mHasEstimate;
+}
+
+qint64 BandwidthEstimator::bufferedMs() const
+{
+    return mChangeCount > 0 ? change(mChangeCount - 1).bufferedMs : 0;
+}
+
+double BandwidthEstimator::bufferingRate() const
+{
+    return mRate;
+}
+
+qint64 BandwidthEstimator::timeToStall(qint64 nowMs, qint64 positionMs, qint64 durationMs, double playbackRate) const
+{
+    const qint64 buffered = bufferedMs();
+    if (durationMs > 0 && buffered >= durationMs) {
+        // everything is buffered
+        return -1;
+    }
+    if (playbackRate <= 0) {
+        return -1;
+    }
+    if (!mHasEstimate) {
+        return buffered > positionMs ? -1 : 0;
+    }
+    const qint64 since = qMax(nowMs, mLastSampleMs) - change(mChangeCount - 1).timestampMs;
+    double rate = mRate;
+    if (mStepMs > 0 && since > 0) {
+        rate = qMin(rate, double(mStepMs) / double(since));
+    }
+    const qint64 ahead = buffered + qMin(mStepMs, qint64(rate * double(since))) - positionMs;
+    if (ahead <= 0) {
+        return 0;
+    }
+    if (rate >= playbackRate) {
+        return -1;
+    }
+    return qint64(double(ahead) / (playbackRate - rate));
+}
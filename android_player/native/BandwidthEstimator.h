@@ -0,0 +1,72 @@
+#ifndef BANDWIDTHESTIMATOR_H
+#define BANDWIDTHESTIMATOR_H
+
+#include <QtGlobal>
+
+// Estimates how fast media is being buffered from the samples reported by
+// MediaPlayer.onBufferingUpdate. The rate is kept in media milliseconds per
+// wall-clock millisecond (1.0 means the download keeps up with real-time
+// playback) and smoothed with a time-based exponentially weighted average.
+//
+// The buffered position stands in for the download throughput: MediaPlayer
+// fetches http sources itself and reports no byte counts, and the native data
+// sources read local files. Its slope is the throughput over the bitrate of
+// the media, which is what decides whether playback stalls.
+//
+// MediaPlayer reports whole percents about once a second, so on a slow
+// download most samples repeat the last one. A rate sample is the slope
+// across the changes of the buffered end within the last WINDOW_MS, which
+// evens out the rounding to whole percents and seconds. While the end stays
+// put the rate can't be more than one reporting step over the time since the
+// last change, and the end is taken to have moved on at the estimated rate,
+// up to one step.
+class BandwidthEstimator
+{
+public:
+    explicit BandwidthEstimator(qint64 halfLifeMs = 2000);
+
+    void reset();
+
+    // bufferedMs is the end of the buffered range in media time.
+    void addSample(qint64 timestampMs, qint64 bufferedMs);
+
+    bool hasEstimate() const;
+    qint64 bufferedMs() const;
+    // Media ms buffered per wall-clock ms, comparable to the playback rate.
+    double bufferingRate() const;
+
+    // Returns the wall-clock time in ms from nowMs until the playback
+    // position, at positionMs then and moving at playbackRate, catches up
+    // with the buffered range, or -1 if no stall is expected. Nothing is
+    // consumed at a rate of 0 or below (paused, rewind). The time since the
+    // last sample counts like a sample that repeats the buffered end.
+    qint64 timeToStall(qint64 nowMs, qint64 positionMs, qint64 durationMs, double playbackRate = 1.0) const;
+
+private:
+    struct Change
+    {
+        qint64 timestampMs;
+        qint64 bufferedMs;
+    };
+    static const int MAX_CHANGES = 16;
+    static const qint64 WINDOW_MS = 8000;
+
+    const Change &change(int index) const
+    {
+        return mChanges[(mOldestChange + index) % MAX_CHANGES];
+    }
+
+    qint64 mHalfLifeMs;
+    // ring of the changes of the buffered end within the window, the newest
+    // is the current end
+    Change mChanges[MAX_CHANGES];
+    int mOldestChange;
+    int mChangeCount;
+    qint64 mLastSampleMs;
+    // the smallest change seen, one percent of the duration
+    qint64 mStepMs;
+    double mRate;
+    bool mHasEstimate;
+};
+
+#endif // BANDWIDTHESTIMATOR_H
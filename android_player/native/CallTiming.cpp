@@ -0,0 +1,345 @@
+#include "CallTiming.h"
+#include "AtomicLatencyHistogram.h"
+#include "PlayerLog.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+const qint64 DEFAULT_STALL_BUDGET_US = 16000;
+const int MAX_RECENT_STALLS = 64;
+// sites in the table, the last slot is "other"
+const int MAX_SITES = 128;
+// the GUI thread call in flight is the start time in us above the site bits
+const int SITE_BITS = 8;
+static_assert(MAX_SITES < (1 << SITE_BITS), "a site index and 0 for none fit the site bits");
+const qint64 MIN_WATCHDOG_PERIOD_US = 1000;
+
+struct Stall {
+    const char *site;
+    qint64 durationUs;
+    qint64 time;
+};
+
+}
+
+namespace CallTiming {
+
+struct Site {
+    Site(const char *name, int index) :
+        name(name),
+        index(index)
+    {
+    }
+
+    const char *const name;
+    const int index;
+    AtomicLatencyHistogram latency;
+    std::atomic<quint64> stalls{0};
+    std::atomic<quint64> blocked{0};
+};
+
+}
+
+namespace {
+
+using CallTiming::Site;
+
+// Open addressing by the hash of the name. A slot is set once and never
+// cleared, sites live as long as the process.
+std::atomic<Site *> siteTable[MAX_SITES];
+
+// The rare path of a stall only.
+QMutex stallMutex;
+QVector<Stall> recentStalls;
+int nextStall = 0;
+std::atomic<quint64> stalls{0};
+std::atomic<quint64> blocked{0};
+std::atomic<qint64> budgetUs{DEFAULT_STALL_BUDGET_US};
+// (start us << SITE_BITS) | (site index + 1) of the GUI thread call in
+// flight, 0 if there is none
+std::atomic<quint64> guiCall{0};
+
+qint64 nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool onGuiThread()
+{
+    const auto app = QCoreApplication::instance();
+    return app && QThread::currentThread() == app->thread();
+}
+
+quint64 hashName(const char *name)
+{
+    // FNV-1a
+    quint64 hash = 14695981039346656037ull;
+    for (; *name; ++name) {
+        hash = (hash ^ quint8(*name)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Samples guiCall and reports a call once when it has been in flight for
+// longer than the stall budget.
+class Watchdog
+{
+public:
+    ~Watchdog()
+    {
+        setEnabled(false);
+    }
+
+    void setEnabled(bool enabled)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (enabled == mThread.joinable()) {
+            return;
+        }
+        if (enabled) {
+            mStop = false;
+            mThread = std::thread(&Watchdog::run, this);
+            return;
+        }
+        mStop = true;
+        std::thread thread = std::move(mThread);
+        lock.unlock();
+        mWake.notify_all();
+        thread.join();
+    }
+
+    bool enabled()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mThread.joinable();
+    }
+
+private:
+    void run()
+    {
+        quint64 reported = 0;
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mStop) {
+            const qint64 budget = budgetUs.load(std::memory_order_relaxed);
+            mWake.wait_for(lock, std::chrono::microseconds(qMax(budget / 2, MIN_WATCHDOG_PERIOD_US)));
+            const quint64 call = guiCall.load(std::memory_order_relaxed);
+            if (call == 0 || call == reported) {
+                continue;
+            }
+            const qint64 elapsedUs = nowUs() - qint64(call >> SITE_BITS);
+            if (elapsedUs <= budget) {
+                continue;
+            }
+            reported = call;
+            Site *site = siteTable[(call & ((1 << SITE_BITS) - 1)) - 1].load(std::memory_order_acquire);
+            site->blocked.fetch_add(1, std::memory_order_relaxed);
+            blocked.fetch_add(1, std::memory_order_relaxed);
+            if (Trace::enabled()) {
+                Trace::instant("jni", "guiThreadBlocked");
+            }
+            PLAYER_LOG(Warning, Player) << "GUI thread blocked for" << elapsedUs << "us so far in" << site->name;
+        }
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::thread mThread;
+    bool mStop = false;
+};
+
+Watchdog watchdog;
+
+void addStall(Site &site, qint64 us)
+{
+    site.stalls.fetch_add(1, std::memory_order_relaxed);
+    stalls.fetch_add(1, std::memory_order_relaxed);
+    const Stall stall{site.name, us, QDateTime::currentMSecsSinceEpoch()};
+    {
+        QMutexLocker lock(&stallMutex);
+        if (recentStalls.size() < MAX_RECENT_STALLS) {
+            recentStalls.append(stall);
+        } else {
+            recentStalls[nextStall] = stall;
+        }
+        nextStall = (nextStall + 1) % MAX_RECENT_STALLS;
+    }
+    PLAYER_LOG(Info, Player) << "GUI thread stalled for" << us << "us in" << site.name;
+}
+
+void recordCall(Site &site, qint64 us, bool onGuiThread)
+{
+    site.latency.record(us);
+    if (onGuiThread && us > budgetUs.load(std::memory_order_relaxed)) {
+        addStall(site, us);
+    }
+}
+
+}
+
+namespace CallTiming {
+
+Site &site(const char *name)
+{
+    const int other = MAX_SITES - 1;
+    int index = int(hashName(name) % quint64(other));
+    for (int probe = 0; probe < other; ++probe, index = (index + 1) % other) {
+        Site *entry = siteTable[index].load(std::memory_order_acquire);
+        if (!entry) {
+            Site *added = new Site(name, index);
+            if (siteTable[index].compare_exchange_strong(entry, added, std::memory_order_acq_rel)) {
+                return *added;
+            }
+            // another thread took the slot, entry is its site
+            delete added;
+        }
+        if (entry->name == name || std::strcmp(entry->name, name) == 0) {
+            return *entry;
+        }
+    }
+    Site *entry = siteTable[other].load(std::memory_order_acquire);
+    if (!entry) {
+        Site *added = new Site("other", other);
+        if (siteTable[other].compare_exchange_strong(entry, added, std::memory_order_acq_rel)) {
+            return *added;
+        }
+        delete added;
+    }
+    return *entry;
+}
+
+Scope::Scope(Site &site) :
+    mSite(site),
+    mStartUs(nowUs()),
+    mTraced(Trace::enabled()),
+    mOnGuiThread(onGuiThread()),
+    mOuterCall(0)
+{
+    if (mOnGuiThread) {
+        mOuterCall = guiCall.exchange((quint64(mStartUs) << SITE_BITS) | quint64(mSite.index + 1),
+                                      std::memory_order_relaxed);
+    }
+    if (mTraced) {
+        Trace::record('B', "jni", mSite.name);
+    }
+}
+
+Scope::Scope(const char *site) :
+    Scope(CallTiming::site(site))
+{
+}
+
+Scope::~Scope()
+{
+    if (mTraced) {
+        Trace::record('E', "jni", mSite.name);
+    }
+    if (mOnGuiThread) {
+        guiCall.store(mOuterCall, std::memory_order_relaxed);
+    }
+    recordCall(mSite, nowUs() - mStartUs, mOnGuiThread);
+}
+
+void record(const char *site, qint64 us)
+{
+    recordCall(CallTiming::site(site), us, onGuiThread());
+}
+
+void setStallBudget(qint64 us)
+{
+    budgetUs.store(us, std::memory_order_relaxed);
+}
+
+qint64 stallBudget()
+{
+    return budgetUs.load(std::memory_order_relaxed);
+}
+
+void setWatchdogEnabled(bool enabled)
+{
+    watchdog.setEnabled(enabled);
+}
+
+bool watchdogEnabled()
+{
+    return watchdog.enabled();
+}
+
+QVariantMap stats()
+{
+    QVariantMap sitesStats;
+    for (const std::atomic<Site *> &slot : siteTable) {
+        const Site *site = slot.load(std::memory_order_acquire);
+        if (!site || site->latency.count() == 0) {
+            continue;
+        }
+        const AtomicLatencyHistogram &latency = site->latency;
+        QVariantList buckets;
+        for (int i = 0; i < AtomicLatencyHistogram::BucketCount; ++i) {
+            if (const quint64 count = latency.bucket(i)) {
+                buckets.append(QVariant(QVariantList{AtomicLatencyHistogram::bucketLowerBound(i), count}));
+            }
+        }
+        sitesStats.insert(QString::fromLatin1(site->name), QVariantMap{
+            {"count", latency.count()},
+            {"meanUs", latency.mean()},
+            {"p50Us", latency.percentile(50)},
+            {"p99Us", latency.percentile(99)},
+            {"maxUs", latency.max()},
+            {"stalls", site->stalls.load(std::memory_order_relaxed)},
+            {"blocked", site->blocked.load(std::memory_order_relaxed)},
+            {"buckets", buckets}
+        });
+    }
+
+    // oldest first
+    QVariantList stallList;
+    {
+        QMutexLocker lock(&stallMutex);
+        for (int i = 0; i < recentStalls.size(); ++i) {
+            const Stall &stall = recentStalls.at((nextStall + i) % recentStalls.size());
+            stallList.append(QVariantMap{
+                {"site", QString::fromLatin1(stall.site)},
+                {"durationUs", stall.durationUs},
+                {"time", stall.time}
+            });
+        }
+    }
+
+    return {
+        {"stallBudgetUs", stallBudget()},
+        {"stalls", stalls.load(std::memory_order_relaxed)},
+        {"blocked", blocked.load(std::memory_order_relaxed)},
+        {"recentStalls", stallList},
+        {"sites", sitesStats}
+    };
+}
+
+void reset()
+{
+    for (std::atomic<Site *> &slot : siteTable) {
+        if (Site *site = slot.load(std::memory_order_acquire)) {
+            site->latency.clear();
+            site->stalls.store(0, std::memory_order_relaxed);
+            site->blocked.store(0, std::memory_order_relaxed);
+        }
+    }
+    QMutexLocker lock(&stallMutex);
+    recentStalls.clear();
+    nextStall = 0;
+    stalls.store(0, std::memory_order_relaxed);
+    blocked.store(0, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,80 @@
+#ifndef CALLTIMING_H
+#define CALLTIMING_H
+
+#include "Trace.h"
+
+#include <QVariantMap>
+
+// Latency of calls into Java, one histogram per call site. Calls made on the
+// GUI thread that take longer than the stall budget (a 60 Hz frame by default)
+// are also kept in a list of recent stalls together with their site, so a
+// janky frame can be pinned on a specific call. With the watchdog on, a call
+// that holds the GUI thread past the budget is reported while it still runs,
+// so a call that hangs shows up too.
+//
+// Recording takes no lock: sites live in a lock-free table and their
+// histograms have atomic buckets. TIME_CALL looks its site up once per
+// expansion, a Scope made from a name looks it up by content every time.
+//
+// Sites must be string literals, only the pointers are stored. Calls made
+// on the Android thread are named "async:...". TIME_CALL times the rest of
+// the scope, TIMED_CALL a single call and gives back its result.
+//
+//     TIME_CALL("async:addPlayerSurface");
+//     QtAndroid::androidActivity().callMethod<void>("addPlayerSurface", ...);
+//
+//     const jint width = TIMED_CALL("getWidth", bitmap.callMethod<jint>("getWidth"));
+namespace CallTiming {
+
+struct Site;
+
+// The site of the name, added on first use. Past the capacity of the table
+// calls are counted under "other".
+Site &site(const char *name);
+
+// Times the enclosing scope and shows it in traces under the "jni" category.
+class Scope
+{
+public:
+    explicit Scope(Site &site);
+    explicit Scope(const char *site);
+    ~Scope();
+
+private:
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+    Site &mSite;
+    const qint64 mStartUs;
+    const bool mTraced;
+    const bool mOnGuiThread;
+    // the GUI thread call this one is nested in
+    quint64 mOuterCall;
+};
+
+// Thread safe.
+void record(const char *site, qint64 us);
+void setStallBudget(qint64 us);
+qint64 stallBudget();
+// Starts or stops the thread that samples the GUI thread call in flight
+// every half stall budget. Off by default.
+void setWatchdogEnabled(bool enabled);
+bool watchdogEnabled();
+// Returns {"stallBudgetUs", "stalls", "blocked", "recentStalls": [{site,
+// durationUs, time}], "sites": {site: {count, meanUs, p50Us, p99Us, maxUs,
+// stalls, blocked, buckets: [[lowerUs, count]...]}}}. blocked counts the
+// calls the watchdog caught in flight past the budget, buckets lists the
+// non-empty buckets.
+QVariantMap stats();
+void reset();
+
+}
+
+#define TIME_CALL(name) \
+    static CallTiming::Site &TRACE_CONCAT(callSite, __LINE__) = CallTiming::site(name); \
+    const CallTiming::Scope TRACE_CONCAT(callTiming, __LINE__)(TRACE_CONCAT(callSite, __LINE__))
+
+#define TIMED_CALL(name, ...) \
+    ([&]() -> decltype(__VA_ARGS__) { TIME_CALL(name); return __VA_ARGS__; }())
+
+#endif // CALLTIMING_H
@@ -0,0 +1,191 @@
+#include "ClipCache.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+const qint64 DEFAULT_CAPACITY = 32 * 1024 * 1024;
+const qint64 DEFAULT_MAX_CLIP_SIZE = 8 * 1024 * 1024;
+}
+
+ClipCache::Clip::Clip(ClipCache *cache, const QString &key, const std::string &path, qint64 size) :
+    mCache(cache),
+    mKey(key),
+    mPath(path),
+    mSize(size),
+    mLoaded(false)
+{
+}
+
+bool ClipCache::Clip::load(const std::shared_ptr<IoScheduler::Client> &ioClient)
+{
+    if (isLoaded()) {
+        return true;
+    }
+    QMutexLocker locker(&mMutex);
+    if (isLoaded()) {
+        return true;
+    }
+
+    const int fd = ::open(mPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        mCache->onLoadFailed(mKey, this);
+        return false;
+    }
+    QByteArray data(int(mSize), Qt::Uninitialized);
+    qint64 offset = 0;
+    while (offset < mSize) {
+        const qint64 read = IoScheduler::instance().read(ioClient, fd, offset,
+                                                         data.data() + offset, mSize - offset);
+        if (read <= 0) {
+            break;
+        }
+        offset += read;
+    }
+    ::close(fd);
+
+    if (offset != mSize) {
+        qWarning() << Q_FUNC_INFO << "short read" << mPath.c_str() << offset << mSize;
+        mCache->onLoadFailed(mKey, this);
+        return false;
+    }
+    mData = data;
+    mLoaded.store(true, std::memory_order_release);
+    mCache->onLoaded(this);
+    return true;
+}
+
+bool ClipCache::Clip::isLoaded() const
+{
+    return mLoaded.load(std::memory_order_acquire);
+}
+
+const QByteArray &ClipCache::Clip::data() const
+{
+    return mData;
+}
+
+qint64 ClipCache::Clip::size() const
+{
+    return mSize;
+}
+
+ClipCache &ClipCache::instance()
+{
+    static ClipCache cache;
+    return cache;
+}
+
+ClipCache::ClipCache() :
+    mCapacity(DEFAULT_CAPACITY),
+    mMaxClipSize(DEFAULT_MAX_CLIP_SIZE)
+{
+}
+
+std::shared_ptr<ClipCache::Clip> ClipCache::clip(const QString &path)
+{
+    const QFileInfo info(path);
+    if (!info.isFile() || info.size() <= 0) {
+        return nullptr;
+    }
+
+    QMutexLocker locker(&mMutex);
+    if (info.size() > mMaxClipSize || info.size() > mCapacity) {
+        return nullptr;
+    }
+
+    // a rewritten file gets a new entry, the stale one ages out
+    const QString &&key = QString("%1:%2:%3").arg(info.absoluteFilePath())
+            .arg(info.size())
+            .arg(info.lastModified().toMSecsSinceEpoch());
+    const auto it = mIndex.find(key);
+    if (it != mIndex.end()) {
+        mLru.splice(mLru.begin(), mLru, it.value());
+        ++mStats.hits;
+        mStats.bytesSaved += info.size();
+        return mLru.front().clip;
+    }
+
+    ++mStats.misses;
+    const auto clip = std::make_shared<Clip>(this, key, info.absoluteFilePath().toStdString(), info.size());
+    mLru.push_front({key, clip});
+    mIndex.insert(key, mLru.begin());
+    mStats.size += clip->size();
+    evict(mCapacity);
+    return clip;
+}
+
+void ClipCache::setCapacity(qint64 bytes)
+{
+    QMutexLocker locker(&mMutex);
+    mCapacity = qMax<qint64>(0, bytes);
+    evict(mCapacity);
+}
+
+void ClipCache::setMaxClipSize(qint64 bytes)
+{
+    QMutexLocker locker(&mMutex);
+    mMaxClipSize = bytes;
+}
+
+qint64 ClipCache::maxClipSize() const
+{
+    QMutexLocker locker(&mMutex);
+    return mMaxClipSize;
+}
+
+qint64 ClipCache::trim(qint64 bytes)
+{
+    QMutexLocker locker(&mMutex);
+    return evict(qMax<qint64>(0, bytes));
+}
+
+ClipCache::Stats ClipCache::stats() const
+{
+    QMutexLocker locker(&mMutex);
+    Stats stats = mStats;
+    stats.capacity = mCapacity;
+    stats.clips = mIndex.size();
+    return stats;
+}
+
+void ClipCache::onLoaded(const Clip *clip)
+{
+    QMutexLocker locker(&mMutex);
+    mStats.bytesLoaded += clip->size();
+}
+
+void ClipCache::onLoadFailed(const QString &key, const Clip *clip)
+{
+    QMutexLocker locker(&mMutex);
+    ++mStats.loadFailures;
+    const auto it = mIndex.find(key);
+    // it may have been evicted, and the key reused, in the meantime
+    if (it != mIndex.end() && it.value()->clip.get() == clip) {
+        mStats.size -= clip->size();
+        mLru.erase(it.value());
+        mIndex.erase(it);
+    }
+}
+
+qint64 ClipCache::evict(qint64 targetSize)
+{
+    qint64 released = 0;
+    while (mStats.size > targetSize && !mLru.empty()) {
+        const Entry &entry = mLru.back();
+        mStats.size -= entry.clip->size();
+        // a clip players still hold is freed when the last of them lets go,
+        // one that never loaded holds nothing
+        if (entry.clip.use_count() == 1 && entry.clip->isLoaded()) {
+            released += entry.clip->size();
+        }
+        ++mStats.evictions;
+        mIndex.remove(entry.key);
+        mLru.pop_back();
+    }
+    return released;
+}
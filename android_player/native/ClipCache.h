@@ -0,0 +1,96 @@
+#ifndef CLIPCACHE_H
+#define CLIPCACHE_H
+
+#include "IoScheduler.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+#include <atomic>
+#include <list>
+#include <memory>
+
+// Process-wide in-memory cache of small media files, meant for short clips
+// that are looped over and over. Clips are loaded once through the
+// IoScheduler and shared by every player that plays them; the least recently
+// used clips are dropped when the cache grows over its capacity. Players that
+// still hold an evicted clip keep using it until they are done. A clip that
+// fails to load leaves the cache, the next lookup tries again.
+class ClipCache
+{
+public:
+    class Clip
+    {
+    public:
+        Clip(ClipCache *cache, const QString &key, const std::string &path, qint64 size);
+
+        // Loads the file on first use, concurrent callers wait for the same load.
+        bool load(const std::shared_ptr<IoScheduler::Client> &ioClient);
+        // Lock-free, once true data() never changes.
+        bool isLoaded() const;
+        // Valid after load() succeeded.
+        const QByteArray &data() const;
+        qint64 size() const;
+
+    private:
+        Q_DISABLE_COPY(Clip)
+
+        ClipCache *const mCache;
+        const QString mKey;
+        const std::string mPath;
+        const qint64 mSize;
+        QMutex mMutex;
+        std::atomic<bool> mLoaded;
+        QByteArray mData;
+    };
+
+    struct Stats {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        quint64 evictions = 0;
+        quint64 loadFailures = 0;
+        qint64 bytesLoaded = 0;
+        qint64 bytesSaved = 0;
+        qint64 size = 0;
+        qint64 capacity = 0;
+        int clips = 0;
+    };
+
+    static ClipCache &instance();
+
+    // Returns nullptr if the file is missing or too large to be cached.
+    std::shared_ptr<Clip> clip(const QString &path);
+
+    void setCapacity(qint64 bytes);
+    void setMaxClipSize(qint64 bytes);
+    qint64 maxClipSize() const;
+    // Drops clips until the cache holds at most the given number of bytes.
+    // Returns the number of bytes released: dropped clips that players still
+    // hold are not counted.
+    qint64 trim(qint64 bytes);
+    Stats stats() const;
+
+private:
+    ClipCache();
+
+    struct Entry {
+        QString key;
+        std::shared_ptr<Clip> clip;
+    };
+
+    void onLoaded(const Clip *clip);
+    void onLoadFailed(const QString &key, const Clip *clip);
+    // mMutex must be held
+    qint64 evict(qint64 targetSize);
+
+    mutable QMutex mMutex;
+    std::list<Entry> mLru;
+    QHash<QString, std::list<Entry>::iterator> mIndex;
+    qint64 mCapacity;
+    qint64 mMaxClipSize;
+    Stats mStats;
+};
+
+#endif // CLIPCACHE_H
@@ -0,0 +1,157 @@
+#include "EventRecorder.h"
+
+#include <QDebug>
+
+#include <chrono>
+#include <cstring>
+
+namespace {
+const char LOG_MAGIC[8] = {'P', 'L', 'E', 'V', 'L', 'O', 'G', '1'};
+
+struct Record {
+    qint64 timestampUs;
+    qint64 arg0;
+    qint32 arg1;
+    quint16 player;
+    quint8 kind;
+    quint8 code;
+};
+static_assert(sizeof(Record) == 24, "records are written as they are laid out");
+
+// calls that change the state of the Java player, in code order; append only
+// so that older logs keep their meaning
+const char *const COMMANDS[] = {
+    "setEventListener",
+    "setDataSource",
+    "setNativeDataSource",
+    "prepare",
+    "prepareNext",
+    "start",
+    "pause",
+    "resume",
+    "seekTo",
+    "stop",
+    "reset",
+    "release",
+    "setSurface",
+    "setLooping",
+    "setVideoScalingMode",
+    "useRTPlayer",
+    "setPlaybackSpeed",
+    "seekToSync"
+};
+const int COMMAND_COUNT = int(sizeof(COMMANDS) / sizeof(COMMANDS[0]));
+
+int commandCode(const char *method)
+{
+    for (int code = 0; code < COMMAND_COUNT; ++code) {
+        if (strcmp(COMMANDS[code], method) == 0) {
+            return code;
+        }
+    }
+    return -1;
+}
+
+qint64 nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+EventRecorder &EventRecorder::instance()
+{
+    static EventRecorder recorder;
+    return recorder;
+}
+
+EventRecorder::EventRecorder() :
+    mRecording(false),
+    mStartUs(0)
+{
+}
+
+EventRecorder::~EventRecorder()
+{
+    stop();
+}
+
+bool EventRecorder::start(const QString &path)
+{
+    QMutexLocker lock(&mMutex);
+    mRecording.store(false, std::memory_order_relaxed);
+    mFile.close();
+    mPlayers.clear();
+
+    mFile.setFileName(path);
+    if (!mFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << Q_FUNC_INFO << "can't open" << path << mFile.errorString();
+        return false;
+    }
+    const quint32 recordSize = sizeof(Record);
+    const quint32 commandCount = COMMAND_COUNT;
+    mFile.write(LOG_MAGIC, sizeof(LOG_MAGIC));
+    mFile.write(reinterpret_cast<const char *>(&recordSize), sizeof(recordSize));
+    mFile.write(reinterpret_cast<const char *>(&commandCount), sizeof(commandCount));
+    for (const char *name : COMMANDS) {
+        mFile.write(name, qint64(strlen(name)) + 1);
+    }
+    mStartUs = nowUs();
+    mRecording.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void EventRecorder::stop()
+{
+    QMutexLocker lock(&mMutex);
+    mRecording.store(false, std::memory_order_relaxed);
+    mFile.close();
+}
+
+void EventRecorder::event(const void *player, Event event, qint64 arg0, qint32 arg1)
+{
+    if (!isRecording()) {
+        return;
+    }
+    QMutexLocker lock(&mMutex);
+    write(player, Inbound, event, arg0, arg1);
+    if (event == Error) {
+        // the events leading up to an error are the interesting ones
+        mFile.flush();
+    }
+}
+
+void EventRecorder::recordCommand(const void *player, const char *method, qint64 arg0, qint32 arg1)
+{
+    if (!isRecording()) {
+        return;
+    }
+    const int code = commandCode(method);
+    if (code < 0) {
+        return;
+    }
+    QMutexLocker lock(&mMutex);
+    write(player, Outbound, quint8(code), arg0, arg1);
+}
+
+void EventRecorder::write(const void *player, Kind kind, quint8 code, qint64 arg0, qint32 arg1)
+{
+    if (!mFile.isOpen()) {
+        return;
+    }
+    // players are numbered in the order they first show up in the log
+    auto it = mPlayers.find(player);
+    if (it == mPlayers.end()) {
+        it = mPlayers.insert(player, quint16(mPlayers.size()));
+    }
+
+    Record record;
+    record.timestampUs = nowUs() - mStartUs;
+    record.arg0 = arg0;
+    record.arg1 = arg1;
+    record.player = it.value();
+    record.kind = kind;
+    record.code = code;
+    // QFile buffers the writes, the file is written in larger chunks
+    mFile.write(reinterpret_cast<const char *>(&record), sizeof(record));
+}
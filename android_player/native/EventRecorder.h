@@ -0,0 +1,97 @@
+#ifndef EVENTRECORDER_H
+#define EVENTRECORDER_H
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+// Process-wide recorder of the events players receive from MediaPlayer and
+// the commands they send to it, for reproducing the exact interleaving of a
+// field issue. Nothing is recorded unless a recording was started.
+//
+// The log is written in host byte order (little endian on every Android ABI):
+//
+//   header  "PLEVLOG1", quint32 record size, quint32 command count, then the
+//           command names as NUL-terminated strings in code order
+//   record  qint64 microseconds since the recording started, qint64 and
+//           qint32 arguments, quint16 player, quint8 kind, quint8 code
+//
+// For events the code is an Event value, for commands the index of the
+// command name in the header.
+class EventRecorder
+{
+public:
+    enum Kind : quint8 {
+        Inbound,
+        Outbound
+    };
+
+    enum Event : quint8 {
+        Started,
+        Finished,
+        Error,
+        Buffering,
+        BufferingUpdate,
+        Pause,
+        Prepared,
+        SeekComplete,
+        NextPartStarted,
+        Suspended,
+        VideoSizeChanged,
+        SurfaceChanged
+    };
+
+    static EventRecorder &instance();
+
+    ~EventRecorder();
+
+    // Truncates the file. Returns false if it can't be opened.
+    bool start(const QString &path);
+    void stop();
+
+    bool isRecording() const
+    {
+        return mRecording.load(std::memory_order_relaxed);
+    }
+
+    // Thread safe.
+    void event(const void *player, Event event, qint64 arg0 = 0, qint32 arg1 = 0);
+
+    // Records a call into the Java player with its first two JNI arguments,
+    // objects are recorded as 0 and floats in thousandths. Getters and other
+    // methods missing from the command table are not recorded.
+    template<typename... Args>
+    void command(const void *player, const char *method, Args... args)
+    {
+        const qint64 values[] = {argument(args)..., 0, 0};
+        recordCommand(player, method, values[0], qint32(values[1]));
+    }
+
+private:
+    EventRecorder();
+    Q_DISABLE_COPY(EventRecorder)
+
+    static qint64 argument(qint64 value) { return value; }
+    template<typename T, typename = std::enable_if_t<std::is_floating_point<T>::value>>
+    static qint64 argument(T value) { return qRound64(value * 1000); }
+    static qint64 argument(std::nullptr_t) { return 0; }
+    template<typename T>
+    static qint64 argument(T *) { return 0; }
+
+    void recordCommand(const void *player, const char *method, qint64 arg0, qint32 arg1);
+    // mMutex must be held
+    void write(const void *player, Kind kind, quint8 code, qint64 arg0, qint32 arg1);
+
+    std::atomic<bool> mRecording;
+    QMutex mMutex;
+    QFile mFile;
+    qint64 mStartUs;
+    QHash<const void *, quint16> mPlayers;
+};
+
+#endif // EVENTRECORDER_H
@@ -0,0 +1,47 @@
+#include "FileDataSource.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FileDataSource::FileDataSource(const std::string &path, std::shared_ptr<IoScheduler::Client> ioClient) :
+    mFd(::open(path.c_str(), O_RDONLY | O_CLOEXEC)),
+    mSize(-1),
+    mIoClient(std::move(ioClient))
+{
+    struct stat st;
+    if (mFd >= 0 && ::fstat(mFd, &st) == 0) {
+        mSize = st.st_size;
+    }
+}
+
+FileDataSource::~FileDataSource()
+{
+    if (mFd >= 0) {
+        ::close(mFd);
+    }
+}
+
+bool FileDataSource::isOpen() const
+{
+    return mFd >= 0;
+}
+
+qint64 FileDataSource::readAt(qint64 position, char *buffer, qint64 size)
+{
+    if (mFd < 0 || position < 0) {
+        return -1;
+    }
+    if (mSize >= 0) {
+        if (position >= mSize) {
+            return 0;
+        }
+        size = qMin(size, mSize - position);
+    }
+    return IoScheduler::instance().read(mIoClient, mFd, position, buffer, size);
+}
+
+qint64 FileDataSource::size() const
+{
+    return mSize;
+}
@@ -0,0 +1,29 @@
+#ifndef FILEDATASOURCE_H
+#define FILEDATASOURCE_H
+
+#include "IoScheduler.h"
+#include "MediaDataSource.h"
+
+#include <string>
+
+// Local file read through the shared IoScheduler.
+class FileDataSource : public MediaDataSource
+{
+public:
+    FileDataSource(const std::string &path, std::shared_ptr<IoScheduler::Client> ioClient);
+    ~FileDataSource() override;
+
+    bool isOpen() const;
+
+    qint64 readAt(qint64 position, char *buffer, qint64 size) override;
+    qint64 size() const override;
+
+private:
+    Q_DISABLE_COPY(FileDataSource)
+
+    int mFd;
+    qint64 mSize;
+    std::shared_ptr<IoScheduler::Client> mIoClient;
+};
+
+#endif // FILEDATASOURCE_H
@@ -0,0 +1,217 @@
+#include "IoScheduler.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+// Reads are never given less slack than this, even with an empty buffer.
+constexpr qint64 MIN_SLACK_MS = 20;
+// Clients may run this far ahead of their bandwidth share before being held back.
+constexpr double SHARE_SLACK_BYTES = 2 * 1024 * 1024;
+constexpr int MAX_PRIORITY = 8;
+}
+
+void IoScheduler::Client::setPriority(int priority)
+{
+    mPriority = qBound(0, priority, MAX_PRIORITY);
+}
+
+int IoScheduler::Client::priority() const
+{
+    return mPriority;
+}
+
+void IoScheduler::Client::setShare(double share)
+{
+    mShare = qMax(0.01, share);
+}
+
+double IoScheduler::Client::share() const
+{
+    return mShare;
+}
+
+void IoScheduler::Client::setBufferLevel(qint64 ms)
+{
+    mBufferLevelMs = qMax<qint64>(0, ms);
+}
+
+qint64 IoScheduler::Client::bufferLevel() const
+{
+    return mBufferLevelMs;
+}
+
+qint64 IoScheduler::Client::readPosition() const
+{
+    return mReadPosition;
+}
+
+const std::string &IoScheduler::Client::name() const
+{
+    return mName;
+}
+
+IoScheduler::Client::Client(const std::string &name) :
+    mName(name)
+{
+}
+
+IoScheduler &IoScheduler::instance()
+{
+    static IoScheduler scheduler;
+    return scheduler;
+}
+
+IoScheduler::IoScheduler(int queueDepth) :
+    mEngine(AsyncReadEngine::create(queueDepth, [this](void *tag, qint64 result) {
+        onReadCompleted(tag, result);
+    }))
+{
+}
+
+IoScheduler::~IoScheduler() = default;
+
+std::shared_ptr<IoScheduler::Client> IoScheduler::createClient(const std::string &name)
+{
+    std::shared_ptr<Client> client(new Client(name));
+    std::lock_guard<std::mutex> lock(mMutex);
+    mClients.erase(std::remove_if(mClients.begin(), mClients.end(),
+                                  [](const std::weak_ptr<Client> &c) { return c.expired(); }),
+                   mClients.end());
+    mClients.push_back(client);
+    return client;
+}
+
+qint64 IoScheduler::read(const std::shared_ptr<Client> &client, int fd, qint64 offset, char *buffer, qint64 size)
+{
+    Request request;
+    request.client = client.get();
+    request.fd = fd;
+    request.offset = offset;
+    request.buffer = buffer;
+    request.size = size;
+    request.enqueued = Clock::now();
+    request.deadline = deadlineFor(*client, request.enqueued);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    // a client that was idle does not get credit for the time it did not read
+    double minServed = std::numeric_limits<double>::max();
+    for (const Request *pending : mQueue) {
+        minServed = std::min(minServed, pending->client->mServedBytes / pending->client->mShare);
+    }
+    if (minServed != std::numeric_limits<double>::max()) {
+        client->mServedBytes = std::max(client->mServedBytes, minServed * client->mShare);
+    }
+
+    if (mQueue.empty() && mInFlight < mEngine->queueDepth()) {
+        // nothing to order, the caller blocks either way and reads itself
+        // rather than waiting for an engine thread to wake up
+        ++mInFlight;
+        client->mQueueWait.record(0);
+        client->mServedBytes += double(size);
+        lock.unlock();
+        const qint64 result = AsyncReadEngine::readInline({fd, offset, buffer, size, &request});
+        lock.lock();
+        complete(&request, result);
+        return request.result;
+    }
+
+    mQueue.push_back(&request);
+    dispatch();
+    mCompleted.wait(lock, [&request] { return request.done; });
+    return request.result;
+}
+
+std::vector<IoScheduler::ClientStats> IoScheduler::stats() const
+{
+    std::vector<ClientStats> result;
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto &weak : mClients) {
+        if (const auto client = weak.lock()) {
+            result.push_back({client->mName, client->priority(), client->share(),
+                              client->mRequests, client->mBytes, client->mQueueWait});
+        }
+    }
+    return result;
+}
+
+const char *IoScheduler::engineName() const
+{
+    return mEngine->name();
+}
+
+void IoScheduler::dispatch()
+{
+    std::vector<AsyncReadEngine::Read> batch;
+    const auto now = Clock::now();
+    while (mInFlight < mEngine->queueDepth() && !mQueue.empty()) {
+        const auto it = nextRequest();
+        Request *request = *it;
+        mQueue.erase(it);
+        ++mInFlight;
+
+        Client *client = request->client;
+        client->mQueueWait.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                                      now - request->enqueued).count());
+        // charge the client up front so the next pick sees the new share
+        client->mServedBytes += double(request->size);
+        batch.push_back({request->fd, request->offset, request->buffer, request->size, request});
+    }
+    if (!batch.empty()) {
+        mEngine->submit(batch);
+    }
+}
+
+void IoScheduler::onReadCompleted(void *tag, qint64 result)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    complete(static_cast<Request *>(tag), result);
+}
+
+void IoScheduler::complete(Request *request, qint64 result)
+{
+    --mInFlight;
+
+    Client *client = request->client;
+    ++client->mRequests;
+    if (result > 0) {
+        client->mBytes += quint64(result);
+        client->mReadPosition = request->offset + result;
+    }
+    client->mServedBytes -= double(request->size - qMax<qint64>(0, result));
+    request->result = result < 0 ? -1 : result;
+    request->done = true;
+    mCompleted.notify_all();
+    dispatch();
+}
+
+std::vector<IoScheduler::Request *>::iterator IoScheduler::nextRequest()
+{
+    const auto now = Clock::now();
+
+    double minServed = std::numeric_limits<double>::max();
+    for (const Request *request : mQueue) {
+        minServed = std::min(minServed, request->client->mServedBytes / request->client->mShare);
+    }
+
+    auto best = mQueue.end();
+    for (auto it = mQueue.begin(); it != mQueue.end(); ++it) {
+        const Request *request = *it;
+        const double ahead = request->client->mServedBytes / request->client->mShare - minServed;
+        // overdue reads are always eligible, the rest must stay within their share
+        if (request->deadline > now && ahead > SHARE_SLACK_BYTES) {
+            continue;
+        }
+        if (best == mQueue.end() || request->deadline < (*best)->deadline) {
+            best = it;
+        }
+    }
+    // the client with the least service is always eligible, so best is set
+    return best;
+}
+
+IoScheduler::Clock::time_point IoScheduler::deadlineFor(const Client &client, Clock::time_point now) const
+{
+    const qint64 slack = qMax(MIN_SLACK_MS, client.bufferLevel()) << client.priority();
+    return now + std::chrono::milliseconds(slack);
+}
@@ -0,0 +1,117 @@
+#ifndef IOSCHEDULER_H
+#define IOSCHEDULER_H
+
+#include "AsyncReadEngine.h"
+#include "LatencyHistogram.h"
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Process-wide scheduler for the reads of all native data sources.
+//
+// Every player owns a Client. Each read gets a deadline derived from the
+// client's buffer level and priority and pending reads are served
+// earliest-deadline-first. Under contention a client that has consumed more
+// than its bandwidth share is held back until the others catch up, so a
+// background preview cannot starve the foreground player. At most
+// queueDepth reads are handed to the AsyncReadEngine at a time, so the
+// ordering decision is made as late as possible. A read that finds nothing
+// queued and a free slot is done on the calling thread.
+class IoScheduler
+{
+public:
+    class Client
+    {
+    public:
+        // Lower values are more urgent; every step doubles the read slack.
+        void setPriority(int priority);
+        int priority() const;
+        // Relative weight of the client in the bandwidth split.
+        void setShare(double share);
+        double share() const;
+        // How much media is buffered ahead of the playback position.
+        void setBufferLevel(qint64 ms);
+        qint64 bufferLevel() const;
+        // End offset of the most recent completed read.
+        qint64 readPosition() const;
+
+        const std::string &name() const;
+
+    private:
+        friend class IoScheduler;
+        explicit Client(const std::string &name);
+
+        std::string mName;
+        std::atomic<int> mPriority{0};
+        std::atomic<double> mShare{1.0};
+        std::atomic<qint64> mBufferLevelMs{0};
+        std::atomic<qint64> mReadPosition{0};
+
+        // guarded by IoScheduler::mMutex
+        double mServedBytes = 0;
+        quint64 mRequests = 0;
+        quint64 mBytes = 0;
+        LatencyHistogram mQueueWait;
+    };
+
+    struct ClientStats {
+        std::string name;
+        int priority;
+        double share;
+        quint64 requests;
+        quint64 bytes;
+        LatencyHistogram queueWait;
+    };
+
+    static IoScheduler &instance();
+
+    explicit IoScheduler(int queueDepth = 4);
+    ~IoScheduler();
+
+    std::shared_ptr<Client> createClient(const std::string &name);
+
+    // Blocks until the read is served. Returns the number of bytes read or -1.
+    qint64 read(const std::shared_ptr<Client> &client, int fd, qint64 offset, char *buffer, qint64 size);
+
+    std::vector<ClientStats> stats() const;
+    const char *engineName() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Request {
+        Client *client;
+        int fd;
+        qint64 offset;
+        char *buffer;
+        qint64 size;
+        Clock::time_point enqueued;
+        Clock::time_point deadline;
+        qint64 result = 0;
+        bool done = false;
+    };
+
+    // mMutex must be held
+    void dispatch();
+    void onReadCompleted(void *tag, qint64 result);
+    void complete(Request *request, qint64 result);
+    std::vector<Request *>::iterator nextRequest();
+    Clock::time_point deadlineFor(const Client &client, Clock::time_point now) const;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCompleted;
+    std::vector<Request *> mQueue;
+    std::vector<std::weak_ptr<Client>> mClients;
+    int mInFlight = 0;
+    // declared last so it is destroyed, and its threads joined, first
+    std::unique_ptr<AsyncReadEngine> mEngine;
+};
+
+#endif // IOSCHEDULER_H
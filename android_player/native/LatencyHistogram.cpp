@@ -0,0 +1,72 @@
+#include "LatencyHistogram.h"
+
+void LatencyHistogram::record(qint64 us)
+{
+    int index = 0;
+    if (us > 0) {
+        index = 1;
+        while (index < BucketCount - 1 && (qint64(1) << index) <= us) {
+            ++index;
+        }
+    }
+    ++mBuckets[size_t(index)];
+    ++mCount;
+    mSum += qMax<qint64>(0, us);
+    mMax = qMax(mMax, us);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for (size_t i = 0; i < mBuckets.size(); ++i) {
+        mBuckets[i] += other.mBuckets[i];
+    }
+    mCount += other.mCount;
+    mSum += other.mSum;
+    mMax = qMax(mMax, other.mMax);
+}
+
+void LatencyHistogram::clear()
+{
+    *this = LatencyHistogram();
+}
+
+quint64 LatencyHistogram::count() const
+{
+    return mCount;
+}
+
+qint64 LatencyHistogram::max() const
+{
+    return mMax;
+}
+
+double LatencyHistogram::mean() const
+{
+    return mCount ? double(mSum) / double(mCount) : 0.0;
+}
+
+qint64 LatencyHistogram::percentile(double percent) const
+{
+    if (mCount == 0) {
+        return 0;
+    }
+    const quint64 rank = quint64(double(mCount) * qBound(0.0, percent, 100.0) / 100.0);
+    quint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += mBuckets[size_t(i)];
+        if (seen > rank || seen == mCount) {
+            return qMin(bucketUpperBound(i), mMax);
+        }
+    }
+    return mMax;
+}
+
+quint64 LatencyHistogram::bucket(int index) const
+{
+    return mBuckets[size_t(index)];
+}
+
+qint64 LatencyHistogram::bucketUpperBound(int index)
+{
+    return index == 0 ? 1 : (qint64(1) << index);
+}
@@ -0,0 +1,36 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QtGlobal>
+
+#include <array>
+
+// Fixed-size histogram of durations in microseconds with power-of-two buckets:
+// bucket 0 holds values below 1 us, bucket i holds [2^(i-1), 2^i) us and the
+// last bucket collects everything above.
+class LatencyHistogram
+{
+public:
+    static constexpr int BucketCount = 32;
+
+    void record(qint64 us);
+    void merge(const LatencyHistogram &other);
+    void clear();
+
+    quint64 count() const;
+    qint64 max() const;
+    double mean() const;
+    // Upper bound of the bucket that holds the given percentile (0..100).
+    qint64 percentile(double percent) const;
+
+    quint64 bucket(int index) const;
+    static qint64 bucketUpperBound(int index);
+
+private:
+    std::array<quint64, BucketCount> mBuckets{};
+    quint64 mCount = 0;
+    qint64 mSum = 0;
+    qint64 mMax = 0;
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,50 @@
+#include "MediaDataSource.h"
+#include "com_vadim_android_NativeMediaDataSource.h"
+
+jlong MediaDataSource::createJniHandle(const std::shared_ptr<MediaDataSource> &source)
+{
+    return jlong(new std::shared_ptr<MediaDataSource>(source));
+}
+
+static MediaDataSource *fromHandle(jlong handle)
+{
+    return handle ? reinterpret_cast<std::shared_ptr<MediaDataSource> *>(handle)->get() : nullptr;
+}
+
+JNIEXPORT jint JNICALL Java_com_vadim_android_NativeMediaDataSource_readAt
+    (JNIEnv *env, jclass, jlong handle, jlong position, jbyteArray buffer, jint offset, jint size) {
+    MediaDataSource *source = fromHandle(handle);
+    if (!source) {
+        return -1;
+    }
+    if (size <= 0) {
+        return 0;
+    }
+
+    if (offset < 0 || offset > env->GetArrayLength(buffer) - size) {
+        return -1;
+    }
+
+    // Straight into the Java array. MediaPlayer reads into a 64 KiB array,
+    // which ART allocates in the non-moving large object space, so holding it
+    // across the read neither copies it nor holds off the garbage collector.
+    jbyte *elements = static_cast<jbyte *>(env->GetPrimitiveArrayCritical(buffer, nullptr));
+    if (!elements) {
+        return -1;
+    }
+    const qint64 read = source->readAt(position, reinterpret_cast<char *>(elements + offset), size);
+    env->ReleasePrimitiveArrayCritical(buffer, elements, read > 0 ? 0 : JNI_ABORT);
+    // MediaDataSource signals the end of the stream with -1
+    return read == 0 ? -1 : jint(read);
+}
+
+JNIEXPORT jlong JNICALL Java_com_vadim_android_NativeMediaDataSource_getSize
+    (JNIEnv *, jclass, jlong handle) {
+    MediaDataSource *source = fromHandle(handle);
+    return source ? jlong(source->size()) : -1;
+}
+
+JNIEXPORT void JNICALL Java_com_vadim_android_NativeMediaDataSource_close
+    (JNIEnv *, jclass, jlong handle) {
+    delete reinterpret_cast<std::shared_ptr<MediaDataSource> *>(handle);
+}
@@ -0,0 +1,30 @@
+#ifndef MEDIADATASOURCE_H
+#define MEDIADATASOURCE_H
+
+#include <QtGlobal>
+
+#include <jni.h>
+#include <memory>
+
+// Native counterpart of android.media.MediaDataSource. Instances are handed to
+// the Java NativeMediaDataSource, which forwards MediaPlayer reads to readAt().
+// readAt() is called from MediaPlayer worker threads.
+class MediaDataSource
+{
+public:
+    virtual ~MediaDataSource() = default;
+
+    // Reads up to size bytes at position. Returns the number of bytes read,
+    // 0 at the end of the stream and -1 on error.
+    virtual qint64 readAt(qint64 position, char *buffer, qint64 size) = 0;
+    // Returns the size of the media in bytes or -1 if it is unknown.
+    virtual qint64 size() const = 0;
+    // Returns the bytes of memory the source holds on to, e.g. cached media.
+    virtual qint64 memoryUsage() const { return 0; }
+
+    // Wraps the source into a handle for NativeMediaDataSource(long).
+    // The handle is released when MediaPlayer closes the data source.
+    static jlong createJniHandle(const std::shared_ptr<MediaDataSource> &source);
+};
+
+#endif // MEDIADATASOURCE_H
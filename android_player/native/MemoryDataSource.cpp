@@ -0,0 +1,34 @@
+#include "MemoryDataSource.h"
+
+#include <cstring>
+
+MemoryDataSource::MemoryDataSource(std::shared_ptr<ClipCache::Clip> clip,
+                                   std::shared_ptr<IoScheduler::Client> ioClient) :
+    mClip(std::move(clip)),
+    mIoClient(std::move(ioClient))
+{
+}
+
+qint64 MemoryDataSource::readAt(qint64 position, char *buffer, qint64 size)
+{
+    // only the first reads of a clip take its mutex
+    if (position < 0 || (!mClip->isLoaded() && !mClip->load(mIoClient))) {
+        return -1;
+    }
+    if (position >= mClip->size()) {
+        return 0;
+    }
+    size = qMin(size, mClip->size() - position);
+    memcpy(buffer, mClip->data().constData() + position, size_t(size));
+    return size;
+}
+
+qint64 MemoryDataSource::size() const
+{
+    return mClip->size();
+}
+
+qint64 MemoryDataSource::memoryUsage() const
+{
+    return mClip->size();
+}
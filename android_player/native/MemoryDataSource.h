@@ -0,0 +1,24 @@
+#ifndef MEMORYDATASOURCE_H
+#define MEMORYDATASOURCE_H
+
+#include "ClipCache.h"
+#include "MediaDataSource.h"
+
+// Serves a clip from the ClipCache. The clip is loaded on the first read,
+// which happens on a MediaPlayer thread rather than the GUI thread.
+class MemoryDataSource : public MediaDataSource
+{
+public:
+    MemoryDataSource(std::shared_ptr<ClipCache::Clip> clip, std::shared_ptr<IoScheduler::Client> ioClient);
+
+    qint64 readAt(qint64 position, char *buffer, qint64 size) override;
+    qint64 size() const override;
+    // The clip, which is shared with other players of the same clip.
+    qint64 memoryUsage() const override;
+
+private:
+    std::shared_ptr<ClipCache::Clip> mClip;
+    std::shared_ptr<IoScheduler::Client> mIoClient;
+};
+
+#endif // MEMORYDATASOURCE_H
@@ -0,0 +1,148 @@
+#include "MemoryPressure.h"
+#include "AndroidMediaPlayer.h"
+#include "CallTiming.h"
+#include "ClipCache.h"
+#include "PlayerLog.h"
+#include "Trace.h"
+#include "com_vadim_android_NativeMemoryPressureListener.h"
+
+#include <QtAndroid>
+
+#include <algorithm>
+
+namespace {
+// cheapest to restore first
+const int PRIORITY_SHRINK_CLIP_CACHE = 0;
+const int PRIORITY_IDLE_DECODERS = 10;
+const int PRIORITY_DROP_CLIP_CACHE = 20;
+}
+
+MemoryPressure &MemoryPressure::instance()
+{
+    static MemoryPressure memoryPressure;
+    return memoryPressure;
+}
+
+MemoryPressure::MemoryPressure() :
+    mNextId(0),
+    mLastLevel(0)
+{
+    addBuiltInReclaimers();
+
+    TIME_CALL("registerComponentCallbacks");
+    mListener = QAndroidJniObject("com/vadim/android/NativeMemoryPressureListener");
+    QtAndroid::androidContext().callMethod<void>("registerComponentCallbacks",
+                                                 "(Landroid/content/ComponentCallbacks;)V",
+                                                 mListener.object());
+}
+
+int MemoryPressure::addReclaimer(const QString &name, int minLevel, int priority, const Reclaimer &reclaimer)
+{
+    const Entry entry{mNextId++, name, minLevel, priority, reclaimer, 0};
+    // after the ones of the same priority
+    const auto it = std::upper_bound(mReclaimers.begin(), mReclaimers.end(), entry,
+                                     [](const Entry &left, const Entry &right) {
+        return left.priority < right.priority;
+    });
+    mReclaimers.insert(it, entry);
+    return entry.id;
+}
+
+void MemoryPressure::removeReclaimer(int id)
+{
+    for (int i = 0; i < mReclaimers.size(); ++i) {
+        if (mReclaimers.at(i).id == id) {
+            mReclaimers.remove(i);
+            return;
+        }
+    }
+}
+
+qint64 MemoryPressure::trim(int level)
+{
+    TRACE_SPAN("memory", "trim");
+    mLastLevel = level;
+
+    // reclaimers may add or remove reclaimers, run them by id
+    QVector<int> ids;
+    for (const Entry &entry : mReclaimers) {
+        if (level >= entry.minLevel) {
+            ids.append(entry.id);
+        }
+    }
+
+    const auto find = [this](int id) {
+        return std::find_if(mReclaimers.begin(), mReclaimers.end(), [id](const Entry &entry) {
+            return entry.id == id;
+        });
+    };
+    qint64 total = 0;
+    for (const int id : ids) {
+        auto it = find(id);
+        if (it == mReclaimers.end()) {
+            continue;
+        }
+        const Reclaimer reclaimer = it->reclaimer;
+        const qint64 bytes = qMax<qint64>(0, reclaimer(level));
+        total += bytes;
+        it = find(id);
+        if (it != mReclaimers.end()) {
+            it->reclaimed += bytes;
+        }
+    }
+
+    LevelStats &stats = mLevels[level];
+    ++stats.events;
+    stats.reclaimed += total;
+    PLAYER_LOG(Info, Player) << "trim level" << level << "reclaimed" << total << "bytes";
+    emit trimmed(level, total);
+    return total;
+}
+
+QVariantMap MemoryPressure::stats() const
+{
+    QVariantMap levels;
+    for (auto it = mLevels.cbegin(); it != mLevels.cend(); ++it) {
+        levels.insert(QString::number(it.key()), QVariantMap{
+            {"events", it.value().events},
+            {"bytes", it.value().reclaimed}
+        });
+    }
+    QVariantMap reclaimers;
+    for (const Entry &entry : mReclaimers) {
+        reclaimers.insert(entry.name, reclaimers.value(entry.name).toLongLong() + entry.reclaimed);
+    }
+    return {
+        {"lastLevel", mLastLevel},
+        {"levels", levels},
+        {"reclaimers", reclaimers}
+    };
+}
+
+void MemoryPressure::addBuiltInReclaimers()
+{
+    addReclaimer("shrinkClipCache", RunningModerate, PRIORITY_SHRINK_CLIP_CACHE, [](int) {
+        ClipCache &cache = ClipCache::instance();
+        return cache.trim(cache.stats().size / 2);
+    });
+    // players that are not playing give up their decoder and buffers and
+    // prepare again at the same position when they are needed
+    addReclaimer("idleDecoders", RunningLow, PRIORITY_IDLE_DECODERS, [](int) {
+        qint64 bytes = 0;
+        for (AndroidMediaPlayer *player : AndroidMediaPlayer::players()) {
+            if (player->playbackState() != AndroidMediaPlayer::PlaybackState::Started) {
+                bytes += player->releaseDecoder();
+            }
+        }
+        return bytes;
+    });
+    addReclaimer("dropClipCache", RunningCritical, PRIORITY_DROP_CLIP_CACHE, [](int) {
+        return ClipCache::instance().trim(0);
+    });
+}
+
+JNIEXPORT void JNICALL Java_com_vadim_android_NativeMemoryPressureListener_onMemoryTrimmed
+    (JNIEnv *, jclass, jint level) {
+    QMetaObject::invokeMethod(&MemoryPressure::instance(), "trim",
+                              Qt::QueuedConnection, Q_ARG(int, level));
+}
@@ -0,0 +1,92 @@
+#ifndef MEMORYPRESSURE_H
+#define MEMORYPRESSURE_H
+
+#include <QAndroidJniObject>
+#include <QMap>
+#include <QObject>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+#include <functional>
+
+// Process-wide coordinator that gives memory back when the platform asks for
+// it through ComponentCallbacks2.onTrimMemory().
+//
+// Reclaimers register with the lowest trim level they act on and a priority;
+// on a trim event the eligible ones run in priority order, cheapest to
+// restore first, and report how many bytes they released. The built-in
+// reclaimers shrink the clip cache, release the decoders of players that are
+// not playing and finally drop the clip cache altogether.
+//
+// Java delivers trim events on the UI thread, they are handled on the GUI
+// thread. On a device "adb shell am send-trim-memory <package> RUNNING_LOW"
+// sends a real one; elsewhere trim() can be called directly to simulate a
+// trim level.
+class MemoryPressure : public QObject
+{
+    Q_OBJECT
+
+public:
+    // the values of the ComponentCallbacks2.TRIM_MEMORY_* constants
+    enum Level {
+        RunningModerate = 5,
+        RunningLow = 10,
+        RunningCritical = 15,
+        UiHidden = 20,
+        Background = 40,
+        Moderate = 60,
+        Complete = 80
+    };
+    Q_ENUM(Level)
+
+    // Called with the trim level, returns the number of bytes released.
+    using Reclaimer = std::function<qint64(int level)>;
+
+    // Registers for the platform callbacks on first use.
+    static MemoryPressure &instance();
+
+    // Lower priorities run first. Returns an id for removeReclaimer().
+    int addReclaimer(const QString &name, int minLevel, int priority, const Reclaimer &reclaimer);
+    void removeReclaimer(int id);
+
+    // Per trim level the number of events and the bytes reclaimed, and the
+    // bytes released by every reclaimer.
+    QVariantMap stats() const;
+
+signals:
+    void trimmed(int level, qint64 bytes);
+
+public slots:
+    // Runs the reclaimers for the level. Returns the number of bytes released.
+    qint64 trim(int level);
+
+private:
+    MemoryPressure();
+    Q_DISABLE_COPY(MemoryPressure)
+
+    void addBuiltInReclaimers();
+
+    struct Entry {
+        int id;
+        QString name;
+        int minLevel;
+        int priority;
+        Reclaimer reclaimer;
+        qint64 reclaimed;
+    };
+
+    struct LevelStats {
+        quint64 events = 0;
+        qint64 reclaimed = 0;
+    };
+
+    QAndroidJniObject mListener;
+    // sorted by priority
+    QVector<Entry> mReclaimers;
+    int mNextId;
+    QMap<int, LevelStats> mLevels;
+    int mLastLevel;
+};
+
+#endif // MEMORYPRESSURE_H
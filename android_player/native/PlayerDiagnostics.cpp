@@ -0,0 +1,188 @@
+#include "PlayerDiagnostics.h"
+#include "AndroidMediaPlayer.h"
+#include "CallTiming.h"
+#include "ClipCache.h"
+#include "EventRecorder.h"
+#include "MemoryPressure.h"
+#include "PlayerLog.h"
+#include "ResumeStore.h"
+#include "Trace.h"
+
+#include <QAndroidJniEnvironment>
+#include <QAndroidJniObject>
+#include <QFile>
+
+#include <unistd.h>
+
+PlayerDiagnostics &PlayerDiagnostics::instance()
+{
+    static PlayerDiagnostics diagnostics;
+    return diagnostics;
+}
+
+QStringList PlayerDiagnostics::dumpLog() const
+{
+    return PlayerLog::dump();
+}
+
+void PlayerDiagnostics::startTrace()
+{
+    Trace::start();
+}
+
+void PlayerDiagnostics::stopTrace()
+{
+    Trace::stop();
+}
+
+bool PlayerDiagnostics::saveTrace(const QString &path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << Q_FUNC_INFO << "can't write" << path << file.errorString();
+        return false;
+    }
+    return file.write(Trace::exportJson()) >= 0;
+}
+
+QVariantMap PlayerDiagnostics::callStats() const
+{
+    return CallTiming::stats();
+}
+
+void PlayerDiagnostics::resetCallStats()
+{
+    CallTiming::reset();
+}
+
+void PlayerDiagnostics::setStallBudget(qint64 us)
+{
+    CallTiming::setStallBudget(us);
+}
+
+void PlayerDiagnostics::setCallWatchdogEnabled(bool enabled)
+{
+    CallTiming::setWatchdogEnabled(enabled);
+}
+
+bool PlayerDiagnostics::startEventRecording(const QString &path)
+{
+    return EventRecorder::instance().start(path);
+}
+
+void PlayerDiagnostics::stopEventRecording()
+{
+    EventRecorder::instance().stop();
+}
+
+QVariantMap PlayerDiagnostics::processMemoryReport() const
+{
+    const QList<AndroidMediaPlayer *> &&players = AndroidMediaPlayer::players();
+    QVariantMap categories;
+    qint64 playersTotal = 0;
+    for (const AndroidMediaPlayer *player : players) {
+        const QVariantMap &&report = player->memoryReport();
+        for (const char *group : {"estimated", "measured"}) {
+            const QVariantMap &&values = report.value(group).toMap();
+            for (auto it = values.cbegin(); it != values.cend(); ++it) {
+                categories[it.key()] = categories.value(it.key()).toLongLong() + it.value().toLongLong();
+            }
+        }
+        playersTotal += report.value("total").toLongLong();
+    }
+
+    qint64 rss = -1;
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> &&fields = statm.readAll().split(' ');
+        if (fields.size() > 1) {
+            rss = fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+
+    QAndroidJniEnvironment env;
+    TIME_CALL("heapSizes");
+    qint64 javaHeap = -1;
+    const QAndroidJniObject &&runtime = QAndroidJniObject::callStaticObjectMethod("java/lang/Runtime",
+                                                                                  "getRuntime",
+                                                                                  "()Ljava/lang/Runtime;");
+    if (!env->ExceptionCheck() && runtime.isValid()) {
+        const qint64 total = runtime.callMethod<jlong>("totalMemory");
+        const qint64 free = runtime.callMethod<jlong>("freeMemory");
+        if (!env->ExceptionCheck()) {
+            javaHeap = total - free;
+        }
+    }
+    if (env->ExceptionCheck()) {
+        env->ExceptionClear();
+    }
+    qint64 nativeHeap = QAndroidJniObject::callStaticMethod<jlong>("android/os/Debug",
+                                                                   "getNativeHeapAllocatedSize");
+    if (env->ExceptionCheck()) {
+        env->ExceptionClear();
+        nativeHeap = -1;
+    }
+
+    return {
+        {"players", players.size()},
+        {"playersTotal", playersTotal},
+        {"playerCategories", categories},
+        {"rss", rss},
+        {"javaHeap", javaHeap},
+        {"nativeHeap", nativeHeap},
+        {"clipCache", ClipCache::instance().stats().size}
+    };
+}
+
+qint64 PlayerDiagnostics::simulateTrimLevel(int level)
+{
+    return MemoryPressure::instance().trim(level);
+}
+
+QVariantMap PlayerDiagnostics::memoryPressureStats() const
+{
+    return MemoryPressure::instance().stats();
+}
+
+QVariantMap PlayerDiagnostics::clipCacheStats() const
+{
+    const ClipCache::Stats &&stats = ClipCache::instance().stats();
+    const quint64 lookups = stats.hits + stats.misses;
+    return {
+        {"hits", stats.hits},
+        {"misses", stats.misses},
+        {"hitRate", lookups ? double(stats.hits) / double(lookups) : 0.0},
+        {"evictions", stats.evictions},
+        {"loadFailures", stats.loadFailures},
+        {"bytesLoaded", stats.bytesLoaded},
+        {"bytesSaved", stats.bytesSaved},
+        {"size", stats.size},
+        {"capacity", stats.capacity},
+        {"clips", stats.clips}
+    };
+}
+
+void PlayerDiagnostics::setClipCacheCapacity(qint64 bytes)
+{
+    ClipCache::instance().setCapacity(bytes);
+}
+
+qint64 PlayerDiagnostics::savedPosition(const QString &source) const
+{
+    return ResumeStore::instance().position(source);
+}
+
+QVariantMap PlayerDiagnostics::resumeStoreStats() const
+{
+    const ResumeStore::Stats &&stats = ResumeStore::instance().stats();
+    return {
+        {"entries", stats.entries},
+        {"journalSize", stats.journalSize},
+        {"liveSize", stats.liveSize},
+        {"appendedBytes", stats.appendedBytes},
+        {"compactedBytes", stats.compactedBytes},
+        {"compactions", stats.compactions},
+        {"writeAmplification", stats.appendedBytes
+         ? double(stats.appendedBytes + stats.compactedBytes) / double(stats.appendedBytes) : 0.0}
+    };
+}
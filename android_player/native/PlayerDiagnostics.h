@@ -0,0 +1,59 @@
+#ifndef PLAYERDIAGNOSTICS_H
+#define PLAYERDIAGNOSTICS_H
+
+#include <QObject>
+#include <QStringList>
+#include <QVariantMap>
+
+// The process-wide state behind all players and surfaces. A QML singleton,
+// the per-player numbers stay on AndroidMediaPlayer.
+class PlayerDiagnostics : public QObject
+{
+    Q_OBJECT
+
+public:
+    static PlayerDiagnostics &instance();
+
+    // Returns the lines retained by the in-memory debug log.
+    Q_INVOKABLE QStringList dumpLog() const;
+
+    // Trace events of all players and surfaces, saved in the Chrome
+    // trace-event format for chrome://tracing or ui.perfetto.dev.
+    Q_INVOKABLE void startTrace();
+    Q_INVOKABLE void stopTrace();
+    Q_INVOKABLE bool saveTrace(const QString &path) const;
+
+    // Latency of the calls into Java of all players and surfaces, and the
+    // calls that held the GUI thread longer than the stall budget.
+    Q_INVOKABLE QVariantMap callStats() const;
+    Q_INVOKABLE void resetCallStats();
+    Q_INVOKABLE void setStallBudget(qint64 us);
+    // Reports GUI thread calls into Java that run past the stall budget
+    // while they still run, see CallTiming.
+    Q_INVOKABLE void setCallWatchdogEnabled(bool enabled);
+
+    // Records the events and commands of all players into a binary log, see
+    // EventRecorder for the format.
+    Q_INVOKABLE bool startEventRecording(const QString &path);
+    Q_INVOKABLE void stopEventRecording();
+
+    // Sum of the memory reports of all players next to the measured heaps and
+    // resident size of the process, -1 for what can't be measured.
+    Q_INVOKABLE QVariantMap processMemoryReport() const;
+    // Runs the MemoryPressure reclaimers as if the platform had sent the
+    // ComponentCallbacks2 trim level. Returns the bytes reclaimed.
+    Q_INVOKABLE qint64 simulateTrimLevel(int level);
+    Q_INVOKABLE QVariantMap memoryPressureStats() const;
+
+    Q_INVOKABLE QVariantMap clipCacheStats() const;
+    Q_INVOKABLE void setClipCacheCapacity(qint64 bytes);
+
+    // Returns the position saved for the source or -1.
+    Q_INVOKABLE qint64 savedPosition(const QString &source) const;
+    Q_INVOKABLE QVariantMap resumeStoreStats() const;
+
+private:
+    PlayerDiagnostics() = default;
+};
+
+#endif // PLAYERDIAGNOSTICS_H
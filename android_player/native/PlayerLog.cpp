@@ -0,0 +1,124 @@
+#include "PlayerLog.h"
+
+#include <QtAlgorithms>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+const quint64 RING_SLOTS = 1024;
+const int MAX_TEXT_SIZE = 232;
+
+// A slot is a small seqlock: the sequence is odd while a writer fills it and
+// 2 * (index + 1) once line number index is committed. Readers skip slots
+// whose sequence changes while they copy them.
+struct Slot {
+    std::atomic<quint64> sequence{0};
+    qint64 timestampUs;
+    quint8 level;
+    quint8 category;
+    quint16 size;
+    char text[MAX_TEXT_SIZE];
+};
+
+Slot ring[RING_SLOTS];
+std::atomic<quint64> nextIndex{0};
+std::atomic<bool> echo{false};
+const auto startTime = std::chrono::steady_clock::now();
+
+const char *levelName(int level)
+{
+    static const char *const names[] = {"E", "W", "I", "D", "T"};
+    return level >= 0 && level <= PlayerLog::Trace ? names[level] : "?";
+}
+
+const char *categoryName(int bit)
+{
+    static const char *const names[] = {"player", "surface", "io", "cache"};
+    return bit >= 0 && bit < 4 ? names[bit] : "?";
+}
+
+}
+
+namespace PlayerLog {
+
+Line::Line(Level level, Category category, const char *function) :
+    mLevel(level),
+    mCategory(category),
+    mDebug(&mText)
+{
+    mDebug.noquote() << function;
+    mDebug.quote();
+}
+
+Line::~Line()
+{
+    const QByteArray &&text = mText.toUtf8();
+    write(mLevel, mCategory, text.constData(), text.size());
+
+    if (mLevel == Error) {
+        qCritical().noquote() << mText;
+    } else if (mLevel == Warning) {
+        qWarning().noquote() << mText;
+    } else if (echo.load(std::memory_order_relaxed)) {
+        qDebug().noquote() << mText;
+    }
+}
+
+void write(Level level, Category category, const char *text, int size)
+{
+    const quint64 index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = ring[index % RING_SLOTS];
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - startTime).count();
+    slot.level = quint8(level);
+    slot.category = quint8(qCountTrailingZeroBits(unsigned(category)));
+    slot.size = quint16(qBound(0, size, MAX_TEXT_SIZE));
+    memcpy(slot.text, text, slot.size);
+
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+QStringList dump()
+{
+    const quint64 end = nextIndex.load(std::memory_order_acquire);
+    const quint64 begin = end > RING_SLOTS ? end - RING_SLOTS : 0;
+
+    QStringList lines;
+    for (quint64 index = begin; index < end; ++index) {
+        const Slot &slot = ring[index % RING_SLOTS];
+        const quint64 sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2) {
+            // still being written or already overwritten
+            continue;
+        }
+        const qint64 timestampUs = slot.timestampUs;
+        const int level = slot.level;
+        const int category = slot.category;
+        char text[MAX_TEXT_SIZE];
+        const int size = qMin<int>(slot.size, MAX_TEXT_SIZE);
+        memcpy(text, slot.text, size_t(size));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+
+        lines.append(QString::asprintf("%lld.%06lld %s %s ",
+                                       timestampUs / 1000000, timestampUs % 1000000,
+                                       levelName(level), categoryName(category))
+                     + QString::fromUtf8(text, size));
+    }
+    return lines;
+}
+
+void setEcho(bool on)
+{
+    echo.store(on, std::memory_order_relaxed);
+}
+
+}
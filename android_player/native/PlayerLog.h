@@ -0,0 +1,93 @@
+#ifndef PLAYERLOG_H
+#define PLAYERLOG_H
+
+#include <QDebug>
+#include <QString>
+#include <QStringList>
+
+// Logging for paths that run many times a second. Every statement carries a
+// level and a category that are known at compile time; statements above
+// PLAYER_LOG_LEVEL or outside PLAYER_LOG_CATEGORIES are discarded by the
+// compiler together with their arguments, so a release build does not format,
+// allocate or even evaluate them.
+//
+// Enabled statements are written to a fixed-size in-memory ring that can be
+// read back with dump(). Warnings and errors also go to the Qt message
+// handler, everything else only when echo is on.
+//
+//     PLAYER_DEBUG(Player) << "source:" << source;
+
+#ifndef PLAYER_LOG_LEVEL
+#ifdef QT_NO_DEBUG
+#define PLAYER_LOG_LEVEL 1 // Warning
+#else
+#define PLAYER_LOG_LEVEL 3 // Debug
+#endif
+#endif
+
+#ifndef PLAYER_LOG_CATEGORIES
+#define PLAYER_LOG_CATEGORIES 0xffffffffu
+#endif
+
+namespace PlayerLog {
+
+enum Level {
+    Error,
+    Warning,
+    Info,
+    Debug,
+    Trace
+};
+
+enum Category : unsigned {
+    Player = 1u << 0,
+    Surface = 1u << 1,
+    Io = 1u << 2,
+    Cache = 1u << 3
+};
+
+constexpr bool enabled(Level level, Category category)
+{
+    return level <= PLAYER_LOG_LEVEL && (category & PLAYER_LOG_CATEGORIES) != 0;
+}
+
+// Collects one statement and commits it when destroyed.
+class Line
+{
+public:
+    Line(Level level, Category category, const char *function);
+    ~Line();
+
+    template<typename T>
+    Line &operator<<(const T &value)
+    {
+        mDebug << value;
+        return *this;
+    }
+
+private:
+    Q_DISABLE_COPY(Line)
+
+    const Level mLevel;
+    const Category mCategory;
+    QString mText;
+    QDebug mDebug;
+};
+
+// Lock-free, safe to call from any thread.
+void write(Level level, Category category, const char *text, int size);
+// Returns the retained lines, oldest first.
+QStringList dump();
+// Forwards every line to the Qt message handler as well.
+void setEcho(bool echo);
+
+}
+
+#define PLAYER_LOG(level, category) \
+    if (!PlayerLog::enabled(PlayerLog::level, PlayerLog::category)) {} \
+    else PlayerLog::Line(PlayerLog::level, PlayerLog::category, Q_FUNC_INFO)
+
+#define PLAYER_DEBUG(category) PLAYER_LOG(Debug, category)
+#define PLAYER_TRACE(category) PLAYER_LOG(Trace, category)
+
+#endif // PLAYERLOG_H
@@ -0,0 +1,379 @@
+#include "PlayerSyncGroup.h"
+#include "AndroidMediaPlayer.h"
+#include "PlayerLog.h"
+#include "Trace.h"
+
+namespace {
+// about a frame at 25 to 30 fps, positions are not reported finer than that
+const int DEFAULT_TOLERANCE_MS = 40;
+const int DEFAULT_SEEK_THRESHOLD_MS = 250;
+const int DEFAULT_CORRECTION_INTERVAL_MS = 250;
+const int DEFAULT_CORRECTION_WINDOW_MS = 2000;
+// a 5 % speed change is not noticeable on video and barely on speech
+const qreal DEFAULT_MAX_RATE_DEVIATION = 0.05;
+// rate changes smaller than this are not sent to the backend
+const qreal RATE_STEP = 0.005;
+
+bool isReady(AndroidMediaPlayer::PlaybackState state)
+{
+    switch (state) {
+    case AndroidMediaPlayer::PlaybackState::Prepared:
+    case AndroidMediaPlayer::PlaybackState::Started:
+    case AndroidMediaPlayer::PlaybackState::Paused:
+    case AndroidMediaPlayer::PlaybackState::PlaybackCompleted:
+        return true;
+    default:
+        return false;
+    }
+}
+}
+
+PlayerSyncGroup::PlayerSyncGroup(QObject *parent) :
+    QObject(parent),
+    mRunning(false),
+    mStartPending(false),
+    mClockBase(0),
+    mTolerance(DEFAULT_TOLERANCE_MS),
+    mSeekThreshold(DEFAULT_SEEK_THRESHOLD_MS),
+    mCorrectionWindow(DEFAULT_CORRECTION_WINDOW_MS),
+    mMaxRateDeviation(DEFAULT_MAX_RATE_DEVIATION)
+{
+    mCorrectionTimer.setInterval(DEFAULT_CORRECTION_INTERVAL_MS);
+    mCorrectionTimer.setTimerType(Qt::PreciseTimer);
+    connect(&mCorrectionTimer, &QTimer::timeout, this, &PlayerSyncGroup::onCorrectionTimer);
+}
+
+PlayerSyncGroup::~PlayerSyncGroup()
+{
+    while (!mMembers.isEmpty()) {
+        removePlayer(mMembers.first().player);
+    }
+}
+
+void PlayerSyncGroup::addPlayer(AndroidMediaPlayer *player)
+{
+    if (!player) {
+        return;
+    }
+    for (const Member &member : mMembers) {
+        if (member.player == player) {
+            return;
+        }
+    }
+    Member member;
+    member.player = player;
+    mMembers.append(member);
+    connect(player, &QObject::destroyed, this, [this, player] {
+        for (int i = 0; i < mMembers.size(); ++i) {
+            if (mMembers.at(i).player == player) {
+                mMembers.removeAt(i);
+                break;
+            }
+        }
+        onPlaybackStateChanged();
+    });
+    connect(player, &AndroidMediaPlayer::playbackStateChanged, this, &PlayerSyncGroup::onPlaybackStateChanged);
+
+    if (mRunning && isReady(player->playbackState())) {
+        join(mMembers.last());
+    }
+}
+
+void PlayerSyncGroup::removePlayer(AndroidMediaPlayer *player)
+{
+    for (int i = 0; i < mMembers.size(); ++i) {
+        if (mMembers.at(i).player != player) {
+            continue;
+        }
+        if (player->playbackState() == AndroidMediaPlayer::PlaybackState::Started) {
+            player->setPlaybackRate(1);
+        }
+        disconnect(player, nullptr, this, nullptr);
+        mMembers.removeAt(i);
+        onPlaybackStateChanged();
+        return;
+    }
+}
+
+void PlayerSyncGroup::start()
+{
+    if (mRunning) {
+        return;
+    }
+    mStartClock.start();
+    Trace::asyncBegin("sync", "start", this);
+    mStartPending = true;
+    onPlaybackStateChanged();
+}
+
+void PlayerSyncGroup::pause()
+{
+    if (mStartPending) {
+        mStartPending = false;
+        Trace::asyncEnd("sync", "start", this);
+    }
+    if (!mRunning) {
+        return;
+    }
+    mClockBase = position();
+    mCorrectionTimer.stop();
+    for (Member &member : mMembers) {
+        if (member.player->playbackState() == AndroidMediaPlayer::PlaybackState::Started) {
+            member.player->pause();
+        }
+        member.settling = false;
+    }
+    setRunning(false);
+}
+
+void PlayerSyncGroup::seekTo(qint64 position)
+{
+    mClockBase = qMax<qint64>(0, position);
+    if (mRunning) {
+        mClock.start();
+    }
+    for (Member &member : mMembers) {
+        if (isReady(member.player->playbackState())) {
+            member.player->seekTo(long(mClockBase));
+            member.settling = true;
+        }
+    }
+}
+
+qint64 PlayerSyncGroup::position() const
+{
+    return mRunning ? mClockBase + mClock.elapsed() : mClockBase;
+}
+
+bool PlayerSyncGroup::running() const
+{
+    return mRunning;
+}
+
+int PlayerSyncGroup::tolerance() const
+{
+    return mTolerance;
+}
+
+int PlayerSyncGroup::seekThreshold() const
+{
+    return mSeekThreshold;
+}
+
+int PlayerSyncGroup::correctionInterval() const
+{
+    return mCorrectionTimer.interval();
+}
+
+int PlayerSyncGroup::correctionWindow() const
+{
+    return mCorrectionWindow;
+}
+
+qreal PlayerSyncGroup::maxRateDeviation() const
+{
+    return mMaxRateDeviation;
+}
+
+QVariantMap PlayerSyncGroup::stats() const
+{
+    QVariantList members;
+    for (const Member &member : mMembers) {
+        const LatencyHistogram &drift = member.driftHistogram;
+        members.append(QVariantMap{
+                           {"source", member.player->getDataSource()},
+                           {"driftMs", member.drift},
+                           {"maxDriftMs", member.maxDrift},
+                           {"meanDriftUs", drift.mean()},
+                           {"p50DriftUs", drift.percentile(50)},
+                           {"p99DriftUs", drift.percentile(99)},
+                           {"samples", drift.count()},
+                           {"seeks", member.seeks},
+                           {"rateChanges", member.rateChanges},
+                           {"rate", member.player->playbackRate()},
+                           {"fixedRate", member.fixedRate}
+                       });
+    }
+    return {
+        {"running", mRunning},
+        {"positionMs", position()},
+        {"corrections", mStats.corrections},
+        {"spreadMs", mStats.spread},
+        {"maxSpreadMs", mStats.maxSpread},
+        {"startLatencyMs", mStats.startLatency},
+        {"members", members}
+    };
+}
+
+void PlayerSyncGroup::resetStats()
+{
+    mStats = {};
+    for (Member &member : mMembers) {
+        member.maxDrift = 0;
+        member.seeks = 0;
+        member.rateChanges = 0;
+        member.driftHistogram.clear();
+    }
+}
+
+void PlayerSyncGroup::setTolerance(int tolerance)
+{
+    if (mTolerance == tolerance || tolerance < 0)
+        return;
+    mTolerance = tolerance;
+    emit toleranceChanged(mTolerance);
+}
+
+void PlayerSyncGroup::setSeekThreshold(int seekThreshold)
+{
+    if (mSeekThreshold == seekThreshold || seekThreshold <= 0)
+        return;
+    mSeekThreshold = seekThreshold;
+    emit seekThresholdChanged(mSeekThreshold);
+}
+
+void PlayerSyncGroup::setCorrectionInterval(int correctionInterval)
+{
+    if (mCorrectionTimer.interval() == correctionInterval || correctionInterval <= 0)
+        return;
+    mCorrectionTimer.setInterval(correctionInterval);
+    emit correctionIntervalChanged(correctionInterval);
+}
+
+void PlayerSyncGroup::setCorrectionWindow(int correctionWindow)
+{
+    if (mCorrectionWindow == correctionWindow || correctionWindow <= 0)
+        return;
+    mCorrectionWindow = correctionWindow;
+    emit correctionWindowChanged(mCorrectionWindow);
+}
+
+void PlayerSyncGroup::setMaxRateDeviation(qreal maxRateDeviation)
+{
+    if (qFuzzyCompare(mMaxRateDeviation, maxRateDeviation) || maxRateDeviation < 0 || maxRateDeviation >= 1)
+        return;
+    mMaxRateDeviation = maxRateDeviation;
+    emit maxRateDeviationChanged(mMaxRateDeviation);
+}
+
+void PlayerSyncGroup::onCorrectionTimer()
+{
+    TRACE_SPAN("sync", "correct");
+    const qint64 clock = position();
+    qint64 minDrift = 0;
+    qint64 maxDrift = 0;
+    int measured = 0;
+    ++mStats.corrections;
+
+    for (Member &member : mMembers) {
+        AndroidMediaPlayer *player = member.player;
+        if (player->playbackState() != AndroidMediaPlayer::PlaybackState::Started) {
+            continue;
+        }
+        if (member.settling) {
+            member.settling = false;
+            continue;
+        }
+
+        const qint64 drift = player->currentPosition() - clock;
+        const qint64 absDrift = qAbs(drift);
+        member.drift = drift;
+        member.maxDrift = qMax(member.maxDrift, absDrift);
+        member.driftHistogram.record(absDrift * 1000);
+        minDrift = measured ? qMin(minDrift, drift) : drift;
+        maxDrift = measured ? qMax(maxDrift, drift) : drift;
+        ++measured;
+
+        if (absDrift >= mSeekThreshold) {
+            PLAYER_DEBUG(Player) << player->getDataSource() << "drift:" << drift << "ms, seeking";
+            setRate(member, 1);
+            player->seekTo(long(clock));
+            member.settling = true;
+            ++member.seeks;
+        } else if (absDrift > mTolerance && !member.fixedRate) {
+            // ahead of the clock plays slower, behind it faster
+            const qreal deviation = qBound(-mMaxRateDeviation, qreal(drift) / mCorrectionWindow, mMaxRateDeviation);
+            setRate(member, 1 - deviation);
+        } else {
+            setRate(member, 1);
+        }
+    }
+
+    mStats.spread = maxDrift - minDrift;
+    mStats.maxSpread = qMax(mStats.maxSpread, mStats.spread);
+}
+
+void PlayerSyncGroup::onPlaybackStateChanged()
+{
+    if (mRunning) {
+        // members prepared after the group started
+        for (Member &member : mMembers) {
+            if (member.player->playbackState() == AndroidMediaPlayer::PlaybackState::Prepared) {
+                join(member);
+            }
+        }
+        return;
+    }
+    if (!mStartPending || mMembers.isEmpty()) {
+        return;
+    }
+    for (const Member &member : mMembers) {
+        if (!isReady(member.player->playbackState())) {
+            return;
+        }
+    }
+    startMembers();
+}
+
+void PlayerSyncGroup::startMembers()
+{
+    mStartPending = false;
+    for (Member &member : mMembers) {
+        member.settling = member.player->currentPosition() != mClockBase;
+        if (member.settling) {
+            member.player->seekTo(long(mClockBase));
+        }
+    }
+    // back to back on this thread, the remaining skew is the time the
+    // backends take to start and is corrected like any other drift
+    for (Member &member : mMembers) {
+        member.player->start();
+    }
+    mClock.start();
+    mStats.startLatency = mStartClock.elapsed();
+    Trace::asyncEnd("sync", "start", this);
+    PLAYER_DEBUG(Player) << mMembers.size() << "players started in" << mStats.startLatency << "ms";
+    mCorrectionTimer.start();
+    setRunning(true);
+}
+
+void PlayerSyncGroup::join(Member &member)
+{
+    // a prepared player starts in a few tens of ms, seeking ahead of the
+    // clock is not worth it
+    member.player->seekTo(long(position()));
+    member.player->start();
+    member.settling = true;
+}
+
+void PlayerSyncGroup::setRunning(bool running)
+{
+    if (mRunning == running)
+        return;
+    mRunning = running;
+    emit runningChanged(mRunning);
+}
+
+void PlayerSyncGroup::setRate(Member &member, qreal rate)
+{
+    const qreal current = member.player->playbackRate();
+    if (qFuzzyCompare(rate, current) || (rate != 1 && qAbs(rate - current) < RATE_STEP)) {
+        return;
+    }
+    if (!member.player->setPlaybackRate(rate)) {
+        PLAYER_DEBUG(Player) << member.player->getDataSource() << "rate can't be changed, correcting by seeks";
+        member.fixedRate = true;
+        return;
+    }
+    ++member.rateChanges;
+}
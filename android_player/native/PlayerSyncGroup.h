@@ -0,0 +1,129 @@
+#ifndef PLAYERSYNCGROUP_H
+#define PLAYERSYNCGROUP_H
+
+#include "LatencyHistogram.h"
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QTimer>
+#include <QVariantMap>
+
+class AndroidMediaPlayer;
+
+// Keeps the players of a video wall aligned to a shared master clock.
+//
+// The clock is a monotonic clock owned by the group, not one of the players,
+// so a member that stalls does not drag the others with it. start() waits
+// until every member is prepared and starts them together; from then on the
+// position of each started member is compared with the clock every
+// correctionInterval ms:
+//
+//  - drift within tolerance: the member plays at normal speed;
+//  - drift above tolerance: the playback rate is nudged by drift /
+//    correctionWindow, at most maxRateDeviation, so the member catches up
+//    without a visible jump;
+//  - drift above seekThreshold: the member seeks to the clock, and is left
+//    alone for a correction interval while the seek completes.
+//
+// Members that can't change their rate (MediaPlayer before API 23) are only
+// corrected by seeks. Members should not use autoStart, and a member that
+// is paused, completed or not yet prepared is not corrected.
+class PlayerSyncGroup : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool running READ running NOTIFY runningChanged)
+    Q_PROPERTY(int tolerance READ tolerance WRITE setTolerance NOTIFY toleranceChanged)
+    Q_PROPERTY(int seekThreshold READ seekThreshold WRITE setSeekThreshold NOTIFY seekThresholdChanged)
+    Q_PROPERTY(int correctionInterval READ correctionInterval WRITE setCorrectionInterval NOTIFY correctionIntervalChanged)
+    Q_PROPERTY(int correctionWindow READ correctionWindow WRITE setCorrectionWindow NOTIFY correctionWindowChanged)
+    Q_PROPERTY(qreal maxRateDeviation READ maxRateDeviation WRITE setMaxRateDeviation NOTIFY maxRateDeviationChanged)
+
+public:
+    PlayerSyncGroup(QObject *parent = nullptr);
+    ~PlayerSyncGroup();
+
+    Q_INVOKABLE void addPlayer(AndroidMediaPlayer *player);
+    Q_INVOKABLE void removePlayer(AndroidMediaPlayer *player);
+    // Starts the members and the clock once every member is prepared.
+    Q_INVOKABLE void start();
+    Q_INVOKABLE void pause();
+    Q_INVOKABLE void seekTo(qint64 position);
+    // Position of the master clock in ms.
+    Q_INVOKABLE qint64 position() const;
+
+    bool running() const;
+    int tolerance() const;
+    int seekThreshold() const;
+    int correctionInterval() const;
+    int correctionWindow() const;
+    qreal maxRateDeviation() const;
+
+    // Drift of every member against the clock, the corrections applied and
+    // the spread between the members that were furthest apart.
+    Q_INVOKABLE QVariantMap stats() const;
+    Q_INVOKABLE void resetStats();
+
+signals:
+    void runningChanged(bool running);
+    void toleranceChanged(int tolerance);
+    void seekThresholdChanged(int seekThreshold);
+    void correctionIntervalChanged(int correctionInterval);
+    void correctionWindowChanged(int correctionWindow);
+    void maxRateDeviationChanged(qreal maxRateDeviation);
+
+public slots:
+    void setTolerance(int tolerance);
+    void setSeekThreshold(int seekThreshold);
+    void setCorrectionInterval(int correctionInterval);
+    void setCorrectionWindow(int correctionWindow);
+    void setMaxRateDeviation(qreal maxRateDeviation);
+
+private slots:
+    void onCorrectionTimer();
+    void onPlaybackStateChanged();
+
+private:
+    struct Member {
+        AndroidMediaPlayer *player = nullptr;
+        // a seek was issued on the last correction
+        bool settling = false;
+        // the backend refused a rate change
+        bool fixedRate = false;
+        qint64 drift = 0;
+        qint64 maxDrift = 0;
+        quint64 seeks = 0;
+        quint64 rateChanges = 0;
+        // |drift| in us, the unit of LatencyHistogram
+        LatencyHistogram driftHistogram;
+    };
+
+    void startMembers();
+    // starts a member that became ready while the group runs
+    void join(Member &member);
+    void setRunning(bool running);
+    void setRate(Member &member, qreal rate);
+
+    QList<Member> mMembers;
+    bool mRunning;
+    bool mStartPending;
+    // the clock is mClockBase + mClock.elapsed() while running
+    qint64 mClockBase;
+    QElapsedTimer mClock;
+    QTimer mCorrectionTimer;
+    int mTolerance;
+    int mSeekThreshold;
+    int mCorrectionWindow;
+    qreal mMaxRateDeviation;
+
+    struct {
+        quint64 corrections = 0;
+        qint64 spread = 0;
+        qint64 maxSpread = 0;
+        // from start() to the members being started
+        qint64 startLatency = 0;
+    } mStats;
+    QElapsedTimer mStartClock;
+};
+
+#endif // PLAYERSYNCGROUP_H
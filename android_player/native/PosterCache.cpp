@@ -0,0 +1,146 @@
+#include "PosterCache.h"
+#include "CallTiming.h"
+#include "MemoryPressure.h"
+#include "PlayerLog.h"
+#include "Trace.h"
+
+#include <QAndroidJniEnvironment>
+#include <QAndroidJniObject>
+#include <QtConcurrent>
+
+namespace {
+const qint64 DEFAULT_CAPACITY = 16 * 1024 * 1024;
+// after the clip cache, posters are what keeps a scrolled grid from flashing
+const int PRIORITY_POSTERS = 30;
+
+QImage extractPoster(const QString &source, const QSize &size)
+{
+    QAndroidJniEnvironment env;
+    const QAndroidJniObject &&bitmap = TIMED_CALL("PosterExtractor.extract",
+        QAndroidJniObject::callStaticObjectMethod("com/vadim/android/PosterExtractor",
+                                                  "extract",
+                                                  "(Ljava/lang/String;II)Landroid/graphics/Bitmap;",
+                                                  QAndroidJniObject::fromString(source).object(),
+                                                  jint(size.width()), jint(size.height())));
+    if (env->ExceptionCheck()) {
+        env->ExceptionClear();
+        return {};
+    }
+    if (!bitmap.isValid()) {
+        return {};
+    }
+
+    TIME_CALL("copyBitmap");
+    const jint width = bitmap.callMethod<jint>("getWidth");
+    const jint height = bitmap.callMethod<jint>("getHeight");
+    // Bitmap.getPixels() returns non-premultiplied 0xAARRGGBB ints whatever the
+    // config, the layout of QImage::Format_ARGB32 with no padding at 4 bytes
+    QImage image(width, height, QImage::Format_ARGB32);
+    const jintArray pixels = env->NewIntArray(width * height);
+    bitmap.callMethod<void>("getPixels", "([IIIIIII)V",
+                            pixels, jint(0), width, jint(0), jint(0), width, height);
+    env->GetIntArrayRegion(pixels, 0, width * height, reinterpret_cast<jint *>(image.bits()));
+    env->DeleteLocalRef(pixels);
+    bitmap.callMethod<void>("recycle");
+    if (env->ExceptionCheck()) {
+        env->ExceptionClear();
+        return {};
+    }
+    return image;
+}
+}
+
+PosterCache &PosterCache::instance()
+{
+    static PosterCache cache;
+    return cache;
+}
+
+PosterCache::PosterCache() :
+    mCapacity(DEFAULT_CAPACITY)
+{
+    mPool.setMaxThreadCount(1);
+    MemoryPressure::instance().addReclaimer("posters", MemoryPressure::RunningLow, PRIORITY_POSTERS, [this](int level) {
+        return trim(level >= MemoryPressure::RunningCritical ? 0 : stats().size / 2);
+    });
+}
+
+QImage PosterCache::poster(const QString &source, const QSize &size)
+{
+    QMutexLocker locker(&mMutex);
+    const auto it = mIndex.find(source);
+    if (it != mIndex.end()) {
+        mLru.splice(mLru.begin(), mLru, it.value());
+        ++mStats.hits;
+        return mLru.front().image;
+    }
+    if (mPending.contains(source) || mFailed.contains(source) || size.isEmpty()) {
+        return {};
+    }
+
+    ++mStats.misses;
+    mPending.insert(source);
+    QtConcurrent::run(&mPool, [this, source, size] {
+        extract(source, size);
+    });
+    return {};
+}
+
+void PosterCache::setCapacity(qint64 bytes)
+{
+    QMutexLocker locker(&mMutex);
+    mCapacity = qMax<qint64>(0, bytes);
+    evict(mCapacity);
+}
+
+qint64 PosterCache::trim(qint64 bytes)
+{
+    QMutexLocker locker(&mMutex);
+    return evict(qMax<qint64>(0, bytes));
+}
+
+PosterCache::Stats PosterCache::stats() const
+{
+    QMutexLocker locker(&mMutex);
+    Stats stats = mStats;
+    stats.capacity = mCapacity;
+    stats.posters = mIndex.size();
+    return stats;
+}
+
+void PosterCache::extract(const QString &source, const QSize &size)
+{
+    TRACE_SPAN("poster", "extract");
+    const QImage &&image = extractPoster(source, size);
+
+    QMutexLocker locker(&mMutex);
+    mPending.remove(source);
+    ++mStats.extractions;
+    if (image.isNull()) {
+        PLAYER_DEBUG(Cache) << "no poster for" << source;
+        ++mStats.failures;
+        mFailed.insert(source);
+        return;
+    }
+    mLru.push_front({source, image});
+    mIndex.insert(source, mLru.begin());
+    mStats.size += image.sizeInBytes();
+    evict(mCapacity);
+    locker.unlock();
+
+    emit posterReady(source);
+}
+
+qint64 PosterCache::evict(qint64 targetSize)
+{
+    qint64 released = 0;
+    while (mStats.size > targetSize && !mLru.empty()) {
+        const Entry &entry = mLru.back();
+        mStats.size -= entry.image.sizeInBytes();
+        released += entry.image.sizeInBytes();
+        ++mStats.evictions;
+        mIndex.remove(entry.source);
+        mLru.pop_back();
+    }
+    return released;
+}
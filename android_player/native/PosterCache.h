@@ -0,0 +1,80 @@
+#ifndef POSTERCACHE_H
+#define POSTERCACHE_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+
+#include <list>
+
+// Process-wide cache of poster frames, a frame near the start of a source
+// scaled to fit the size it is first requested at. Posters are extracted with
+// MediaMetadataRetriever on a single background thread so they don't compete
+// with the decoders of playing players; the least recently used ones are
+// dropped when the cache grows over its capacity.
+//
+// The cache registers with MemoryPressure and is dropped on critical trim
+// levels, posters are extracted again when they are requested.
+class PosterCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Stats {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        quint64 extractions = 0;
+        quint64 failures = 0;
+        quint64 evictions = 0;
+        qint64 size = 0;
+        qint64 capacity = 0;
+        int posters = 0;
+    };
+
+    static PosterCache &instance();
+
+    // Returns a null image while the poster is extracted, posterReady() is
+    // emitted once it is available. Sources that failed are not retried and
+    // stay null.
+    QImage poster(const QString &source, const QSize &size);
+
+    void setCapacity(qint64 bytes);
+    // Drops posters until the cache holds at most the given number of bytes.
+    // Returns the number of bytes released.
+    qint64 trim(qint64 bytes);
+    Stats stats() const;
+
+signals:
+    // Emitted from the extraction thread.
+    void posterReady(const QString &source);
+
+private:
+    PosterCache();
+    Q_DISABLE_COPY(PosterCache)
+
+    // extraction thread
+    void extract(const QString &source, const QSize &size);
+    // mMutex must be held
+    qint64 evict(qint64 targetSize);
+
+    struct Entry {
+        QString source;
+        QImage image;
+    };
+
+    mutable QMutex mMutex;
+    std::list<Entry> mLru;
+    QHash<QString, std::list<Entry>::iterator> mIndex;
+    QSet<QString> mPending;
+    QSet<QString> mFailed;
+    qint64 mCapacity;
+    Stats mStats;
+    QThreadPool mPool;
+};
+
+#endif // POSTERCACHE_H
@@ -1,10 +1,48 @@
 #include "QSurfaceTexture.h"
+#include "CallTiming.h"
+#include "PlayerLog.h"
+#include "Trace.h"
 
 #include <QAndroidJniEnvironment>
+#include <QQuickWindow>
 #include <QSGGeometryNode>
 #include <QSGSimpleMaterialShader>
 #include <QDateTime>
 
+#include <chrono>
+
+namespace {
+// must match TestPatternSource.MARKER_BITS
+const int MARKER_BITS = 64;
+// decoded latencies above this are garbage, e.g. a marker from a stale frame
+const qint64 MAX_LATENCY_MS = 10000;
+
+#ifdef Q_OS_ANDROID
+const GLenum TEXTURE_TARGET = GL_TEXTURE_EXTERNAL_OES;
+#define SAMPLER_PRELUDE "#extension GL_OES_EGL_image_external : require\nprecision mediump float;\n"
+#define SAMPLER_TYPE "samplerExternalOES"
+#else
+// desktop builds draw the simulated SurfaceTexture into a 2D texture
+const GLenum TEXTURE_TARGET = GL_TEXTURE_2D;
+#define SAMPLER_PRELUDE ""
+#define SAMPLER_TYPE "sampler2D"
+#endif
+
+bool isWhite(quint32 rgba)
+{
+    // GL_RGBA bytes in memory order
+    const auto *bytes = reinterpret_cast<const quint8 *>(&rgba);
+    return bytes[0] + 2 * bytes[1] + bytes[2] >= 2 * 255;
+}
+
+// SystemClock.uptimeMillis() on the Java side
+quint32 uptimeMs()
+{
+    return quint32(std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+}
+
 struct State {
     // the texture transform matrix
     QMatrix4x4 uSTMatrix;
@@ -36,11 +74,10 @@ class SurfaceTextureShader : QSGSimpleMaterialShader<State>
 
     const char *fragmentShader() const override {
         return
-                "#extension GL_OES_EGL_image_external : require                     \n"
-                "precision mediump float;                                           \n"
+                SAMPLER_PRELUDE
                 "varying vec2 vTextureCoord;                                        \n"
                 "uniform lowp float qt_Opacity;                                     \n"
-                "uniform samplerExternalOES sTexture;                               \n"
+                "uniform " SAMPLER_TYPE " sTexture;                                 \n"
                 "void main() {                                                      \n"
                 "  gl_FragColor = texture2D(sTexture, vTextureCoord) * qt_Opacity;  \n"
                 "}";
@@ -55,7 +92,7 @@ class SurfaceTextureShader : QSGSimpleMaterialShader<State>
     {
         program()->setUniformValue(m_uSTMatrixLoc, state->uSTMatrix);
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_EXTERNAL_OES, state->textureId);
+        glBindTexture(TEXTURE_TARGET, state->textureId);
     }
 
     void resolveUniforms() override
@@ -101,7 +138,7 @@ public:
         updateTexMethod = env->GetMethodID(env->FindClass("android/graphics/SurfaceTexture"), "updateTexImage", "()V");
         getTransformMatrixMethod = env->GetMethodID(env->FindClass("android/graphics/SurfaceTexture"), "getTransformMatrix", "([F)V");
 
-        qDebug() << Q_FUNC_INFO;
+        PLAYER_DEBUG(Surface);
     }
 
     ~SurfaceTextureNode() override
@@ -122,6 +159,7 @@ private:
     jmethodID getTransformMatrixMethod;
     jobject obj;
     QAndroidJniEnvironment env;
+    bool m_firstFrame = true;
 
 };
 
@@ -132,16 +170,25 @@ void SurfaceTextureNode::preprocess()
     if (!mat)
         return;
 
+    TRACE_SPAN("surface", "updateTexImage");
+
     // update the texture content
-    env->CallVoidMethod(obj, updateTexMethod);
+    TIMED_CALL("updateTexImage", env->CallVoidMethod(obj, updateTexMethod));
 //    m_surfaceTexture.callMethod<void>("updateTexImage");
 
     // get the new texture transform matrix
-    env->CallVoidMethod(obj, getTransformMatrixMethod, m_uSTMatrixArray);
+    TIMED_CALL("getTransformMatrix", env->CallVoidMethod(obj, getTransformMatrixMethod, m_uSTMatrixArray));
 //    m_surfaceTexture.callMethod<void>("getTransformMatrix", "([F)V", m_uSTMatrixArray);
 
     env->GetFloatArrayRegion(m_uSTMatrixArray, 0, 16, mat->state()->uSTMatrix.data());
 
+    // the timestamp stays 0 until a frame was latched
+    if (m_firstFrame && Trace::enabled()
+            && TIMED_CALL("getTimestamp", m_surfaceTexture.callMethod<jlong>("getTimestamp")) != 0) {
+        m_firstFrame = false;
+        Trace::instant("surface", "firstFrame");
+    }
+
     //    qDebug() << QDateTime::currentDateTime().toMSecsSinceEpoch() << "preprocess finish";
 
 //    jfloat* data = env->GetFloatArrayElements(m_uSTMatrixArray, NULL);
@@ -154,54 +201,220 @@ void SurfaceTextureNode::preprocess()
 QSurfaceTexture::QSurfaceTexture(QQuickItem *parent)
     : QQuickItem(parent)
 {
-    qDebug() << Q_FUNC_INFO;
+    PLAYER_DEBUG(Surface);
     setFlags(ItemHasContents);
+    connect(this, &QQuickItem::windowChanged, this, &QSurfaceTexture::connectWindow);
 }
 
 QSurfaceTexture::~QSurfaceTexture()
 {
     // Delete our texture
     if (mTextureId) {
-        glBindTexture(GL_TEXTURE_EXTERNAL_OES, 0);
+        glBindTexture(TEXTURE_TARGET, 0);
         glDeleteTextures(1, &mTextureId);
     }
 }
 
 const QAndroidJniObject &QSurfaceTexture::surfaceTexture() const { return mSurfaceTexture; }
 
+bool QSurfaceTexture::measureLatency() const
+{
+    return mMeasureLatency;
+}
+
+bool QSurfaceTexture::blending() const
+{
+    return mBlending;
+}
+
+QVariantMap QSurfaceTexture::latencyStats() const
+{
+    QMutexLocker lock(&mLatencyMutex);
+    QVariantList buckets;
+    for (int i = 0; i < LatencyHistogram::BucketCount; ++i) {
+        buckets.append(mLatency.bucket(i));
+    }
+    return {
+        {"frames", mLatency.count()},
+        {"decodeErrors", mDecodeErrors},
+        {"repeatedFrames", mRepeatedFrames},
+        {"droppedFrames", mDroppedFrames},
+        {"meanUs", mLatency.mean()},
+        {"p50Us", mLatency.percentile(50)},
+        {"p99Us", mLatency.percentile(99)},
+        {"maxUs", mLatency.max()},
+        {"buckets", buckets}
+    };
+}
+
+void QSurfaceTexture::resetLatencyStats()
+{
+    QMutexLocker lock(&mLatencyMutex);
+    mLatency.clear();
+    mLastMarkerFrame = -1;
+    mDecodeErrors = 0;
+    mRepeatedFrames = 0;
+    mDroppedFrames = 0;
+}
+
+qint64 QSurfaceTexture::textureBytes() const
+{
+    if (!mTextureId) {
+        return 0;
+    }
+#ifdef Q_OS_ANDROID
+    // an external texture has no storage, it samples the buffer last acquired
+    // from the queue, which the player counts
+    return 0;
+#else
+    // the RGBA copy of the last frame updateTexImage() uploads
+    return qint64(mVideoSize.width()) * mVideoSize.height() * 4;
+#endif
+}
+
+void QSurfaceTexture::setVideoSize(int width, int height)
+{
+    if (mVideoSize == QSize(width, height))
+        return;
+    mVideoSize = QSize(width, height);
+    if (mSurfaceTexture.isValid()) {
+        TIME_CALL("setDefaultBufferSize");
+        mSurfaceTexture.callMethod<void>("setDefaultBufferSize", "(II)V", jint(width), jint(height));
+    }
+    update();
+}
+
+void QSurfaceTexture::setMeasureLatency(bool measureLatency)
+{
+    if (mMeasureLatency == measureLatency)
+        return;
+    mMeasureLatency = measureLatency;
+    connectWindow(window());
+    update();
+    emit measureLatencyChanged(mMeasureLatency);
+}
+
+void QSurfaceTexture::setBlending(bool blending)
+{
+    if (mBlending == blending)
+        return;
+    mBlending = blending;
+    update();
+    emit blendingChanged(mBlending);
+}
+
+void QSurfaceTexture::connectWindow(QQuickWindow *window)
+{
+    disconnect(mAfterRenderingConnection);
+    disconnect(mFrameSwappedConnection);
+    if (!mMeasureLatency || !window) {
+        return;
+    }
+    // both are emitted on the render thread
+    mAfterRenderingConnection = connect(window, &QQuickWindow::afterRendering,
+                                        this, &QSurfaceTexture::readMarker, Qt::DirectConnection);
+    mFrameSwappedConnection = connect(window, &QQuickWindow::frameSwapped,
+                                      this, &QSurfaceTexture::onFrameSwapped, Qt::DirectConnection);
+}
+
+void QSurfaceTexture::readMarker()
+{
+    if (mMarkerWidth < MARKER_BITS) {
+        return;
+    }
+    TRACE_SPAN("surface", "readMarker");
+
+    // one pixel row through the middle of each marker row
+    mMarkerPixels.resize(2 * mMarkerWidth);
+    glReadPixels(mMarkerX, mMarkerRows[0], mMarkerWidth, 1, GL_RGBA, GL_UNSIGNED_BYTE, mMarkerPixels.data());
+    glReadPixels(mMarkerX, mMarkerRows[1], mMarkerWidth, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                 mMarkerPixels.data() + mMarkerWidth);
+
+    quint64 marker = 0;
+    for (int bit = 0; bit < MARKER_BITS; ++bit) {
+        const int x = (2 * bit + 1) * mMarkerWidth / (2 * MARKER_BITS);
+        const bool value = isWhite(mMarkerPixels.at(x));
+        if (value == isWhite(mMarkerPixels.at(mMarkerWidth + x))) {
+            // the rows must be complementary
+            QMutexLocker lock(&mLatencyMutex);
+            ++mDecodeErrors;
+            return;
+        }
+        marker = (marker << 1) | (value ? 1 : 0);
+    }
+    mMarker = marker;
+    mMarkerPending = true;
+}
+
+void QSurfaceTexture::onFrameSwapped()
+{
+    if (!mMarkerPending) {
+        return;
+    }
+    mMarkerPending = false;
+    const qint64 frame = qint64(mMarker >> 32);
+    const quint32 drawnAt = quint32(mMarker);
+    // wraps like the 32 bits of uptime in the marker
+    const qint64 latency = qint64(quint32(uptimeMs() - drawnAt));
+
+    QMutexLocker lock(&mLatencyMutex);
+    if (frame == mLastMarkerFrame) {
+        ++mRepeatedFrames;
+        return;
+    }
+    if (mLastMarkerFrame >= 0 && frame > mLastMarkerFrame + 1) {
+        mDroppedFrames += quint64(frame - mLastMarkerFrame - 1);
+    }
+    mLastMarkerFrame = frame;
+    if (latency <= MAX_LATENCY_MS) {
+        mLatency.record(latency * 1000);
+    }
+}
+
 QSGNode *QSurfaceTexture::updatePaintNode(QSGNode *n, QQuickItem::UpdatePaintNodeData *)
 {
 //    qDebug() << QDateTime::currentDateTime().toMSecsSinceEpoch() << "updatePaintNode start";
+    TRACE_SPAN("surface", "updatePaintNode");
     SurfaceTextureNode *node = static_cast<SurfaceTextureNode *>(n);
     if (!node) {
-        qDebug() << QDateTime::currentDateTime().toMSecsSinceEpoch() << "updatePaintNode finish";
+        PLAYER_DEBUG(Surface) << "creating the texture";
 
         // Create texture
         glGenTextures(1, &mTextureId);
-        glBindTexture(GL_TEXTURE_EXTERNAL_OES, mTextureId);
+        glBindTexture(TEXTURE_TARGET, mTextureId);
 
         // Can't do mipmapping with camera source
-        glTexParameterf(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameterf(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameterf(TEXTURE_TARGET, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameterf(TEXTURE_TARGET, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
 
         // Clamp to edge is the only option
 //        glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 //        glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
+#ifdef Q_OS_ANDROID
         glDisable(GL_TEXTURE_2D);
         glEnable(GL_TEXTURE_EXTERNAL_OES);
-
-        // Create surface texture Java object
-        mSurfaceTexture = QAndroidJniObject("android/graphics/SurfaceTexture", "(I)V", mTextureId);
-
-        // We need to setOnFrameAvailableListener, to be notify when a new frame was decoded
-        // and is ready to be displayed. Check android/src/com/kdab/android/SurfaceTextureListener.java
-        // file for implementation details.
-        mSurfaceTexture.callMethod<void>("setOnFrameAvailableListener",
-                                          "(Landroid/graphics/SurfaceTexture$OnFrameAvailableListener;)V",
-                                          QAndroidJniObject("com/vadim/android/SurfaceTextureListener",
-                                                            "(J)V", jlong(this)).object());
+#endif
+
+        {
+            TIME_CALL("createSurfaceTexture");
+            // Create surface texture Java object
+            mSurfaceTexture = QAndroidJniObject("android/graphics/SurfaceTexture", "(I)V", mTextureId);
+
+            // We need to setOnFrameAvailableListener, to be notify when a new frame was decoded
+            // and is ready to be displayed. Check android/src/com/kdab/android/SurfaceTextureListener.java
+            // file for implementation details.
+            mSurfaceTexture.callMethod<void>("setOnFrameAvailableListener",
+                                              "(Landroid/graphics/SurfaceTexture$OnFrameAvailableListener;)V",
+                                              QAndroidJniObject("com/vadim/android/SurfaceTextureListener",
+                                                                "(J)V", jlong(this)).object());
+
+            if (!mVideoSize.isEmpty()) {
+                mSurfaceTexture.callMethod<void>("setDefaultBufferSize", "(II)V",
+                                                 jint(mVideoSize.width()), jint(mVideoSize.height()));
+            }
+        }
 
         // Create our SurfaceTextureNode
         node = new SurfaceTextureNode(mSurfaceTexture, mTextureId);
@@ -215,8 +428,25 @@ QSGNode *QSurfaceTexture::updatePaintNode(QSGNode *n, QQuickItem::UpdatePaintNod
     rect.setBottom(tmp);
 
     QSGGeometry::updateTexturedRectGeometry(node->geometry(), rect, QRectF(0, 0, 1, 1));
+    node->material()->setFlag(QSGMaterial::Blending, mBlending);
     node->markDirty(QSGNode::DirtyGeometry | QSGNode::DirtyMaterial);
 
+    // the GUI thread is blocked here, hand the marker geometry to readMarker()
+    mMarkerWidth = 0;
+    if (mMeasureLatency && window() && !mVideoSize.isEmpty()) {
+        const qreal ratio = window()->effectiveDevicePixelRatio();
+        const QRectF &&scene = mapRectToScene(boundingRect());
+        // marker blocks are square in video pixels, the video is stretched
+        // over the item
+        const qreal block = height() * mVideoSize.width() / MARKER_BITS / mVideoSize.height();
+        const int windowHeight = qRound(window()->height() * ratio);
+        mMarkerX = qRound(scene.x() * ratio);
+        mMarkerWidth = qRound(scene.width() * ratio);
+        for (int row = 0; row < 2; ++row) {
+            mMarkerRows[row] = windowHeight - 1 - qRound((scene.y() + (row + 0.5) * block) * ratio);
+        }
+    }
+
     //    qDebug() << QDateTime::currentDateTime().toMSecsSinceEpoch() << "updatePaintNode finish";
     return node;
 }
@@ -225,6 +455,7 @@ extern "C" void Java_com_vadim_android_SurfaceTextureListener_frameAvailable(JNI
 {
     // a new frame was decoded, let's update our item
 //    qDebug() << QDateTime::currentDateTime().toMSecsSinceEpoch() << "frameAvailable";
+    Trace::instant("surface", "frameAvailable");
     QMetaObject::invokeMethod(reinterpret_cast<QSurfaceTexture *>(ptr), "update", Qt::QueuedConnection);
 //    QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
 }
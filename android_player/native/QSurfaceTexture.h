@@ -1,13 +1,25 @@
 #ifndef QSURFACETEXTURE_H
 #define QSURFACETEXTURE_H
 
+#include "LatencyHistogram.h"
+
 #include <QAndroidJniEnvironment>
 #include <QAndroidJniObject>
+#include <QMutex>
 #include <QQuickItem>
+#include <QVariantMap>
+#include <QVector>
 
 class QSurfaceTexture : public QQuickItem
 {
     Q_OBJECT
+    // Reads the marker of "testpattern:" frames back from the window after
+    // every frame and measures how long ago the frame was drawn when the
+    // window frame showing it is swapped, see TestPatternSource.java.
+    Q_PROPERTY(bool measureLatency READ measureLatency WRITE setMeasureLatency NOTIFY measureLatencyChanged)
+    // Blends the video over what is below it, on by default. Off, the
+    // renderer draws it in its opaque pass unless the item is translucent.
+    Q_PROPERTY(bool blending READ blending WRITE setBlending NOTIFY blendingChanged)
 public:
     QSurfaceTexture(QQuickItem *parent = nullptr);
     ~QSurfaceTexture();
@@ -15,19 +27,61 @@ public:
     // returns surfaceTexture Java object.
     const QAndroidJniObject &surfaceTexture() const;
 
+    bool measureLatency() const;
+    bool blending() const;
+    Q_INVOKABLE QVariantMap latencyStats() const;
+    Q_INVOKABLE void resetLatencyStats();
+    // Estimated bytes of the texture the frames are drawn from.
+    qint64 textureBytes() const;
+
+public slots:
+    // Sizes the buffers of frames drawn with the CPU, decoders size their own.
+    void setVideoSize(int width, int height);
+    void setMeasureLatency(bool measureLatency);
+    void setBlending(bool blending);
+
     // QQuickItem interface
 protected:
     QSGNode *updatePaintNode(QSGNode *n, UpdatePaintNodeData *) override;
 
 signals:
     void surfaceTextureChanged(QSurfaceTexture *surfaceTexture);
+    void measureLatencyChanged(bool measureLatency);
+    void blendingChanged(bool blending);
 
 private:
+    void connectWindow(QQuickWindow *window);
+    // render thread
+    void readMarker();
+    void onFrameSwapped();
+
     // our texture
     uint32_t mTextureId = 0;
 
     // Java SurfaceTexture object
     QAndroidJniObject mSurfaceTexture;
+
+    QSize mVideoSize;
+    bool mMeasureLatency = false;
+    bool mBlending = true;
+    QMetaObject::Connection mAfterRenderingConnection;
+    QMetaObject::Connection mFrameSwappedConnection;
+
+    // marker rows in window framebuffer coordinates, set in updatePaintNode
+    int mMarkerX = 0;
+    int mMarkerWidth = 0;
+    int mMarkerRows[2] = {};
+    // render thread
+    QVector<quint32> mMarkerPixels;
+    bool mMarkerPending = false;
+    quint64 mMarker = 0;
+
+    mutable QMutex mLatencyMutex;
+    LatencyHistogram mLatency;
+    qint64 mLastMarkerFrame = -1;
+    quint64 mDecodeErrors = 0;
+    quint64 mRepeatedFrames = 0;
+    quint64 mDroppedFrames = 0;
 };
 
 #endif // QSURFACETEXTURE_H
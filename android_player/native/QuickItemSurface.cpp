@@ -1,11 +1,16 @@
 #include "QuickItemSurface.h"
+#include "CallTiming.h"
+#include "Trace.h"
 
 #include <QGuiApplication>
+#include <QPointer>
 #include <QScreen>
 #include <QtAndroid>
 
 QuickItemPlayerSurface::QuickItemPlayerSurface(QQuickItem *parent) :
-    QQuickItem (parent)
+    QQuickItem (parent),
+    mView(std::make_shared<View>()),
+    mReady(false)
 {
     connect(this, &QQuickItem::xChanged, this, &QuickItemPlayerSurface::onGeometyChanged);
     connect(this, &QQuickItem::yChanged, this, &QuickItemPlayerSurface::onGeometyChanged);
@@ -13,6 +18,60 @@ QuickItemPlayerSurface::QuickItemPlayerSurface(QQuickItem *parent) :
     connect(this, &QQuickItem::heightChanged, this, &QuickItemPlayerSurface::onGeometyChanged);
 }
 
+QuickItemPlayerSurface::~QuickItemPlayerSurface()
+{
+    postToView([](const QAndroidJniObject &view) {
+        TIME_CALL("async:removePlayerSurface");
+        QtAndroid::androidActivity().callMethod<void>("removePlayerSurface",
+                                                      "(Landroid/view/View;)V",
+                                                      view.object());
+    });
+}
+
+QAndroidJniObject QuickItemPlayerSurface::view() const
+{
+    return mReadyView;
+}
+
+bool QuickItemPlayerSurface::ready() const
+{
+    return mReady;
+}
+
+void QuickItemPlayerSurface::postToView(const ViewOperation &operation)
+{
+    // runOnAndroidThread() keeps the order, the view is created by the first
+    // runnable posted for the item
+    const auto view = mView;
+    QtAndroid::runOnAndroidThread([view, operation] {
+        operation(view->object);
+    });
+}
+
+void QuickItemPlayerSurface::createView(const std::function<QAndroidJniObject()> &factory)
+{
+    Trace::asyncBegin("surface", "createView", this);
+    const auto view = mView;
+    const QPointer<QuickItemPlayerSurface> item(this);
+    QtAndroid::runOnAndroidThread([view, factory, item] {
+        view->object = factory();
+        const QAndroidJniObject object = view->object;
+        QMetaObject::invokeMethod(qApp, [item, object] {
+            if (item) {
+                item->setReady(object);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void QuickItemPlayerSurface::setReady(const QAndroidJniObject &view)
+{
+    Trace::asyncEnd("surface", "createView", this);
+    mReadyView = view;
+    mReady = true;
+    emit readyChanged(mReady);
+}
+
 QRect QuickItemPlayerSurface::toPhycalGeometry(qreal x, qreal y, qreal w, qreal h)
 {
     const auto ratio = qApp->primaryScreen()->devicePixelRatio();
@@ -26,13 +85,19 @@ QRect QuickItemPlayerSurface::toPhycalGeometry(qreal x, qreal y, qreal w, qreal
 
 void QuickItemPlayerSurface::onGeometyChanged()
 {
-    QtAndroid::runOnAndroidThreadSync([this] {
-        const auto &&rect = toPhycalGeometry(x(), y(), width(), height());
+    const auto &&rect = toPhycalGeometry(x(), y(), width(), height());
+    // the id is only a key for the span, the item may be gone by the time
+    // the view is moved
+    const void *id = this;
+    Trace::asyncBegin("surface", "geometrySync", id);
+    postToView([rect, id](const QAndroidJniObject &view) {
+        TIME_CALL("async:setPlayerSurfaceGeometry");
         QtAndroid::androidActivity().callMethod<void>("setPlayerSurfaceGeometry",
                                                       "(Landroid/view/View;IIII)V",
-                                                      jobject(view().object()),
+                                                      view.object(),
                                                       jint(rect.x()), jint(rect.y()),
                                                       jint(rect.width()), jint(rect.height()));
+        Trace::asyncEnd("surface", "geometrySync", id);
     });
 }
 
@@ -40,12 +105,16 @@ void QuickItemPlayerSurface::componentComplete()
 {
     QQuickItem::componentComplete();
 
-    QtAndroid::runOnAndroidThreadSync([this] {
-        const auto &&rect = toPhycalGeometry(x(), y(), width(), height());
+    const auto &&rect = toPhycalGeometry(x(), y(), width(), height());
+    const void *id = this;
+    Trace::asyncBegin("surface", "addSurface", id);
+    postToView([rect, id](const QAndroidJniObject &view) {
+        TIME_CALL("async:addPlayerSurface");
         QtAndroid::androidActivity().callMethod<void>("addPlayerSurface",
                                                       "(Landroid/view/View;IIII)V",
-                                                      jobject(view().object()),
+                                                      view.object(),
                                                       jint(rect.x()), jint(rect.y()),
                                                       jint(rect.width()), jint(rect.height()));
+        Trace::asyncEnd("surface", "addSurface", id);
     });
 }
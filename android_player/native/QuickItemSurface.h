@@ -4,14 +4,33 @@
 #include <QAndroidJniObject>
 #include <QQuickItem>
 
+#include <functional>
+#include <memory>
 
+// Quick item that places a Java view in the player layout behind the Qt
+// surface. The view is created, laid out and removed on the Android UI thread
+// without blocking the GUI thread; the item is ready once the view exists.
 class QuickItemPlayerSurface : public QQuickItem
 {
     Q_OBJECT
+    Q_PROPERTY(bool ready READ ready NOTIFY readyChanged)
 public:
+    using ViewOperation = std::function<void(const QAndroidJniObject &view)>;
+
     QuickItemPlayerSurface(QQuickItem *parent = nullptr);
+    ~QuickItemPlayerSurface() override;
+
+    // Invalid until ready.
+    QAndroidJniObject view() const;
+    bool ready() const;
+    // Runs the operation with the view on the Android UI thread. Operations run
+    // in the order they were posted and after the view was created, so they
+    // can be posted before the item is ready. They may run after the item was
+    // destroyed and must not refer to it.
+    void postToView(const ViewOperation &operation);
 
-    virtual QAndroidJniObject view() const = 0;
+signals:
+    void readyChanged(bool ready);
 
 public slots:
     Q_INVOKABLE virtual void setVideoSize(int width, int height) = 0;
@@ -21,9 +40,23 @@ private slots:
 
 protected:
     void componentComplete() override;
+    // To be called once by the constructor of the subclass. The factory runs on
+    // the Android UI thread and must not refer to the item either.
+    void createView(const std::function<QAndroidJniObject()> &factory);
 
 protected:
     static QRect toPhycalGeometry(qreal x, qreal y, qreal w, qreal h);
+
+private:
+    void setReady(const QAndroidJniObject &view);
+
+    // written by the Android UI thread only, shared with the operations in flight
+    struct View {
+        QAndroidJniObject object;
+    };
+    std::shared_ptr<View> mView;
+    QAndroidJniObject mReadyView;
+    bool mReady;
 };
 
 #endif // QUICKITEMSURFACE_H
@@ -0,0 +1,339 @@
+#include "ResumeStore.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const quint64 JOURNAL_MAGIC = 0x314c4e524a4d5352; // "RSMJRNL1"
+const qint64 HEADER_SIZE = sizeof(JOURNAL_MAGIC);
+const qint64 INITIAL_CAPACITY = 64 * 1024;
+const int MAX_KEY_SIZE = 0xffff;
+const qint64 REMOVED_POSITION = -1;
+
+struct RecordHeader {
+    quint32 checksum;
+    quint16 keySize;
+    quint16 reserved;
+    qint64 position;
+};
+static_assert(sizeof(RecordHeader) == 16, "journal records must stay 8-byte aligned");
+
+// records are padded so that the next header is aligned
+qint64 recordSize(int keySize)
+{
+    return (qint64(sizeof(RecordHeader)) + keySize + 7) & ~qint64(7);
+}
+
+quint32 checksum(quint16 keySize, qint64 position, const char *key)
+{
+    // FNV-1a
+    quint32 hash = 2166136261u;
+    const auto feed = [&hash](const void *data, size_t size) {
+        const auto *bytes = static_cast<const quint8 *>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+    };
+    feed(&keySize, sizeof(keySize));
+    feed(&position, sizeof(position));
+    feed(key, keySize);
+    return hash;
+}
+
+void writeRecord(char *destination, const QByteArray &key, qint64 position)
+{
+    RecordHeader header;
+    header.keySize = quint16(key.size());
+    header.reserved = 0;
+    header.position = position;
+    header.checksum = checksum(header.keySize, position, key.constData());
+    const qint64 size = recordSize(key.size());
+    memcpy(destination + sizeof(header), key.constData(), size_t(key.size()));
+    memset(destination + sizeof(header) + key.size(), 0, size_t(size - qint64(sizeof(header)) - key.size()));
+    memcpy(destination, &header, sizeof(header));
+}
+}
+
+ResumeStore &ResumeStore::instance()
+{
+    static ResumeStore store;
+    return store;
+}
+
+ResumeStore::ResumeStore() :
+    mFd(-1),
+    mData(nullptr),
+    mCapacity(0),
+    mUsed(0),
+    mLiveSize(0)
+{
+    const QString &&dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    if (!dir.isEmpty() && QDir().mkpath(dir)) {
+        open(dir + "/resume.journal");
+    }
+}
+
+ResumeStore::~ResumeStore()
+{
+    close();
+}
+
+bool ResumeStore::open(const QString &path)
+{
+    QMutexLocker locker(&mMutex);
+    unmap();
+    if (mFd >= 0) {
+        ::close(mFd);
+    }
+    mPath = path;
+    mPositions.clear();
+    mLiveSize = 0;
+    mUsed = 0;
+
+    mFd = ::open(QFile::encodeName(path).constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    struct stat st;
+    if (mFd < 0 || fstat(mFd, &st) != 0 || !map(qMax<qint64>(INITIAL_CAPACITY, st.st_size))) {
+        qWarning() << Q_FUNC_INFO << "can't map" << path << strerror(errno);
+        if (mFd >= 0) {
+            ::close(mFd);
+            mFd = -1;
+        }
+        return false;
+    }
+    load();
+    return true;
+}
+
+void ResumeStore::close()
+{
+    QMutexLocker locker(&mMutex);
+    unmap();
+    if (mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
+}
+
+qint64 ResumeStore::position(const QString &key) const
+{
+    QMutexLocker locker(&mMutex);
+    return mPositions.value(key.toUtf8(), -1);
+}
+
+void ResumeStore::setPosition(const QString &key, qint64 position)
+{
+    const QByteArray &&utf8 = key.toUtf8();
+    if (utf8.isEmpty() || utf8.size() > MAX_KEY_SIZE || position < 0) {
+        return;
+    }
+
+    QMutexLocker locker(&mMutex);
+    const auto it = mPositions.find(utf8);
+    if (it != mPositions.end()) {
+        if (*it == position) {
+            return;
+        }
+        *it = position;
+    } else {
+        mPositions.insert(utf8, position);
+        mLiveSize += recordSize(utf8.size());
+    }
+    append(utf8, position);
+}
+
+void ResumeStore::remove(const QString &key)
+{
+    const QByteArray &&utf8 = key.toUtf8();
+    QMutexLocker locker(&mMutex);
+    if (!mPositions.remove(utf8)) {
+        return;
+    }
+    mLiveSize -= recordSize(utf8.size());
+    append(utf8, REMOVED_POSITION);
+}
+
+void ResumeStore::compact()
+{
+    QMutexLocker locker(&mMutex);
+    if (mData) {
+        compactLocked();
+    }
+}
+
+ResumeStore::Stats ResumeStore::stats() const
+{
+    QMutexLocker locker(&mMutex);
+    Stats stats = mStats;
+    stats.entries = mPositions.size();
+    stats.journalSize = mUsed;
+    stats.liveSize = HEADER_SIZE + mLiveSize;
+    return stats;
+}
+
+bool ResumeStore::map(qint64 capacity)
+{
+    if (mFd < 0 || ftruncate(mFd, off_t(capacity)) != 0) {
+        return false;
+    }
+    void *data = mmap(nullptr, size_t(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    unmap();
+    mData = static_cast<char *>(data);
+    mCapacity = capacity;
+    return true;
+}
+
+void ResumeStore::unmap()
+{
+    if (mData) {
+        munmap(mData, size_t(mCapacity));
+        mData = nullptr;
+        mCapacity = 0;
+    }
+}
+
+void ResumeStore::load()
+{
+    quint64 magic;
+    memcpy(&magic, mData, sizeof(magic));
+    if (magic != JOURNAL_MAGIC) {
+        memset(mData, 0, size_t(mCapacity));
+        memcpy(mData, &JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        mUsed = HEADER_SIZE;
+        return;
+    }
+
+    qint64 offset = HEADER_SIZE;
+    bool torn = false;
+    while (offset + qint64(sizeof(RecordHeader)) <= mCapacity) {
+        RecordHeader header;
+        memcpy(&header, mData + offset, sizeof(header));
+        if (header.keySize == 0) {
+            break;
+        }
+        const qint64 size = recordSize(header.keySize);
+        const char *key = mData + offset + sizeof(header);
+        if (offset + size > mCapacity
+                || header.checksum != checksum(header.keySize, header.position, key)) {
+            torn = true;
+            break;
+        }
+
+        const QByteArray utf8(key, header.keySize);
+        if (header.position == REMOVED_POSITION) {
+            mPositions.remove(utf8);
+        } else {
+            mPositions.insert(utf8, header.position);
+        }
+        offset += size;
+    }
+    mUsed = offset;
+    if (torn) {
+        // a record cut short by a crash, make sure nothing behind it is replayed
+        memset(mData + mUsed, 0, size_t(mCapacity - mUsed));
+    }
+
+    for (auto it = mPositions.cbegin(); it != mPositions.cend(); ++it) {
+        mLiveSize += recordSize(it.key().size());
+    }
+    if (mUsed - HEADER_SIZE > 2 * mLiveSize && mUsed > INITIAL_CAPACITY / 2) {
+        compactLocked();
+    }
+}
+
+bool ResumeStore::append(const QByteArray &key, qint64 position)
+{
+    if (!mData) {
+        return false;
+    }
+
+    const qint64 size = recordSize(key.size());
+    if (mUsed + size > mCapacity) {
+        // the in-memory positions already include this change
+        if (HEADER_SIZE + mLiveSize <= mCapacity / 2 && compactLocked()) {
+            return true;
+        }
+        qint64 capacity = qMax(mCapacity, INITIAL_CAPACITY) * 2;
+        while (mUsed + size > capacity) {
+            capacity *= 2;
+        }
+        if (!map(capacity)) {
+            qWarning() << Q_FUNC_INFO << "can't grow the journal to" << capacity;
+            return false;
+        }
+    }
+
+    writeRecord(mData + mUsed, key, position);
+    mUsed += size;
+    mStats.appendedBytes += quint64(size);
+    return true;
+}
+
+bool ResumeStore::compactLocked()
+{
+    const qint64 size = HEADER_SIZE + mLiveSize;
+    qint64 capacity = INITIAL_CAPACITY;
+    while (capacity < 2 * size) {
+        capacity *= 2;
+    }
+
+    QByteArray journal(int(size), Qt::Uninitialized);
+    memcpy(journal.data(), &JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    qint64 offset = HEADER_SIZE;
+    for (auto it = mPositions.cbegin(); it != mPositions.cend(); ++it) {
+        writeRecord(journal.data() + offset, it.key(), it.value());
+        offset += recordSize(it.key().size());
+    }
+
+    // write the new journal next to the old one and swap them, a crash
+    // in between leaves the old journal in place
+    const QByteArray &&path = QFile::encodeName(mPath);
+    const QByteArray &&tmpPath = path + ".tmp";
+    const int fd = ::open(tmpPath.constData(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        qWarning() << Q_FUNC_INFO << "can't create" << tmpPath << strerror(errno);
+        return false;
+    }
+    qint64 written = 0;
+    while (written < size) {
+        const ssize_t result = ::pwrite(fd, journal.constData() + written, size_t(size - written), off_t(written));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            break;
+        }
+        written += result;
+    }
+    if (written != size || ::rename(tmpPath.constData(), path.constData()) != 0) {
+        qWarning() << Q_FUNC_INFO << "can't write" << tmpPath << strerror(errno);
+        ::close(fd);
+        ::unlink(tmpPath.constData());
+        return false;
+    }
+
+    unmap();
+    ::close(mFd);
+    mFd = fd;
+    if (!map(capacity)) {
+        qWarning() << Q_FUNC_INFO << "can't map the compacted journal" << strerror(errno);
+        ::close(mFd);
+        mFd = -1;
+        return false;
+    }
+    mUsed = size;
+    mStats.compactedBytes += quint64(size);
+    ++mStats.compactions;
+    return true;
+}
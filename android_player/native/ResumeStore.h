@@ -0,0 +1,70 @@
+#ifndef RESUMESTORE_H
+#define RESUMESTORE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+// Process-wide store of playback positions keyed by media source.
+//
+// Positions live in memory and every change is appended to a journal that is
+// mmap'd, so recording a position is a memcpy into the page cache rather than
+// a write() or fsync() on the caller's thread; the kernel writes the pages
+// back. Records carry a checksum and a torn tail is dropped on load. When the
+// journal fills up it is compacted to the live records, or grown when most
+// records are live.
+class ResumeStore
+{
+public:
+    struct Stats {
+        int entries = 0;
+        qint64 journalSize = 0;
+        qint64 liveSize = 0;
+        // bytes appended for position updates and bytes rewritten by compaction
+        quint64 appendedBytes = 0;
+        quint64 compactedBytes = 0;
+        quint64 compactions = 0;
+    };
+
+    // Opens the journal in the application data directory on first use.
+    static ResumeStore &instance();
+
+    ~ResumeStore();
+
+    // Replaces the current journal. Returns false if the file can't be mapped,
+    // the store then keeps positions in memory only.
+    bool open(const QString &path);
+    void close();
+
+    // Returns -1 if there is no saved position.
+    qint64 position(const QString &key) const;
+    void setPosition(const QString &key, qint64 position);
+    void remove(const QString &key);
+    // Rewrites the journal with the live records only.
+    void compact();
+    Stats stats() const;
+
+private:
+    ResumeStore();
+    Q_DISABLE_COPY(ResumeStore)
+
+    // mMutex must be held
+    bool map(qint64 capacity);
+    void unmap();
+    void load();
+    bool append(const QByteArray &key, qint64 position);
+    bool compactLocked();
+
+    mutable QMutex mMutex;
+    QString mPath;
+    int mFd;
+    char *mData;
+    qint64 mCapacity;
+    qint64 mUsed;
+    qint64 mLiveSize;
+    QHash<QByteArray, qint64> mPositions;
+    Stats mStats;
+};
+
+#endif // RESUMESTORE_H
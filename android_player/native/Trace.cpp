@@ -0,0 +1,250 @@
+#include "Trace.h"
+
+#include <QtGlobal>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+
+#ifdef Q_OS_LINUX
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+// per thread, a few minutes of per-frame events on the render thread; past
+// that the oldest events are overwritten
+const quint64 BUFFER_EVENTS = 8192;
+// buffers of exited threads kept for new threads, the rest are freed
+const size_t SPARE_BUFFERS = 4;
+
+// Fields are relaxed atomics so exportJson() can copy a slot while the thread
+// overwrites it, the copy is thrown away then.
+struct Event {
+    std::atomic<qint64> timestampUs{0};
+    std::atomic<const char *> category{nullptr};
+    std::atomic<const char *> name{nullptr};
+    std::atomic<const void *> id{nullptr};
+    std::atomic<char> phase{0};
+};
+
+// A ring written only by its thread. Event n goes to slot n % BUFFER_EVENTS.
+// claimed is the number of events the thread has started to write, published
+// the number it has finished; exportJson() copies the events below published
+// and keeps those the thread can't have overwritten by claimed.
+struct ThreadBuffer {
+    int tid = 0;
+    char name[17] = {};
+    bool exited = false; // guarded by buffersMutex
+    std::atomic<quint64> generation{0};
+    std::atomic<quint64> claimed{0};
+    std::atomic<quint64> published{0};
+    std::unique_ptr<Event[]> events{new Event[BUFFER_EVENTS]};
+};
+
+std::mutex buffersMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+std::vector<std::shared_ptr<ThreadBuffer>> spareBuffers;
+std::atomic<quint64> generation{0};
+
+void retire(const std::shared_ptr<ThreadBuffer> &buffer)
+{
+    buffers.erase(std::find(buffers.begin(), buffers.end(), buffer));
+    if (spareBuffers.size() < SPARE_BUFFERS) {
+        spareBuffers.push_back(buffer);
+    }
+}
+
+// The calling thread's buffer, taken from the spares or allocated, and given
+// back when the thread exits. The events of an exited thread stay in the
+// trace until the next start().
+class ThreadSlot
+{
+public:
+    ThreadSlot()
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        if (spareBuffers.empty()) {
+            mBuffer = std::make_shared<ThreadBuffer>();
+        } else {
+            mBuffer = std::move(spareBuffers.back());
+            spareBuffers.pop_back();
+            mBuffer->exited = false;
+            mBuffer->generation.store(0, std::memory_order_relaxed);
+            std::fill(std::begin(mBuffer->name), std::end(mBuffer->name), '\0');
+        }
+#ifdef Q_OS_LINUX
+        mBuffer->tid = int(syscall(SYS_gettid));
+        prctl(PR_GET_NAME, mBuffer->name, 0, 0, 0);
+#endif
+        for (char &c : mBuffer->name) {
+            if (c == '"' || c == '\\') {
+                c = '_';
+            }
+        }
+        buffers.push_back(mBuffer);
+    }
+
+    ~ThreadSlot()
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        if (mBuffer->generation.load(std::memory_order_relaxed) == generation.load(std::memory_order_relaxed)) {
+            mBuffer->exited = true;
+        } else {
+            retire(mBuffer);
+        }
+    }
+
+    ThreadBuffer *buffer() const
+    {
+        return mBuffer.get();
+    }
+
+private:
+    ThreadSlot(const ThreadSlot &) = delete;
+    ThreadSlot &operator=(const ThreadSlot &) = delete;
+
+    std::shared_ptr<ThreadBuffer> mBuffer;
+};
+
+qint64 nowUs()
+{
+    // CLOCK_MONOTONIC, the clock systrace and Perfetto use on Android
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+namespace Trace {
+
+std::atomic<bool> gEnabled{false};
+
+void start()
+{
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        const auto exited = buffers;
+        for (const auto &buffer : exited) {
+            if (buffer->exited) {
+                retire(buffer);
+            }
+        }
+    }
+    generation.fetch_add(1, std::memory_order_relaxed);
+    gEnabled.store(true, std::memory_order_release);
+}
+
+void stop()
+{
+    gEnabled.store(false, std::memory_order_release);
+}
+
+void record(char phase, const char *category, const char *name, const void *id)
+{
+    thread_local const ThreadSlot slot;
+    ThreadBuffer *buffer = slot.buffer();
+
+    const quint64 current = generation.load(std::memory_order_relaxed);
+    if (buffer->generation.load(std::memory_order_relaxed) != current) {
+        buffer->claimed.store(0, std::memory_order_relaxed);
+        buffer->published.store(0, std::memory_order_relaxed);
+        buffer->generation.store(current, std::memory_order_release);
+    }
+
+    const quint64 index = buffer->published.load(std::memory_order_relaxed);
+    buffer->claimed.store(index + 1, std::memory_order_relaxed);
+    // a reader that sees any of the stores below also sees the claim
+    std::atomic_thread_fence(std::memory_order_release);
+    Event &event = buffer->events[index % BUFFER_EVENTS];
+    event.timestampUs.store(nowUs(), std::memory_order_relaxed);
+    event.category.store(category, std::memory_order_relaxed);
+    event.name.store(name, std::memory_order_relaxed);
+    event.id.store(id, std::memory_order_relaxed);
+    event.phase.store(phase, std::memory_order_relaxed);
+    buffer->published.store(index + 1, std::memory_order_release);
+}
+
+QByteArray exportJson()
+{
+    const quint64 current = generation.load(std::memory_order_relaxed);
+    const int pid = int(getpid());
+    quint64 dropped = 0;
+
+    QByteArray json("{\"traceEvents\":[");
+    bool first = true;
+    const auto append = [&json, &first](const QByteArray &event) {
+        if (!first) {
+            json += ",\n";
+        }
+        first = false;
+        json += event;
+    };
+
+    struct Copy {
+        qint64 timestampUs;
+        const char *category;
+        const char *name;
+        const void *id;
+        char phase;
+    };
+    std::lock_guard<std::mutex> lock(buffersMutex);
+    for (const auto &buffer : buffers) {
+        if (buffer->generation.load(std::memory_order_acquire) != current) {
+            continue;
+        }
+        const quint64 published = buffer->published.load(std::memory_order_acquire);
+        const quint64 oldest = published > BUFFER_EVENTS ? published - BUFFER_EVENTS : 0;
+        std::vector<Copy> events;
+        events.reserve(size_t(published - oldest));
+        for (quint64 i = oldest; i < published; ++i) {
+            const Event &event = buffer->events[i % BUFFER_EVENTS];
+            events.push_back({event.timestampUs.load(std::memory_order_relaxed),
+                              event.category.load(std::memory_order_relaxed),
+                              event.name.load(std::memory_order_relaxed),
+                              event.id.load(std::memory_order_relaxed),
+                              event.phase.load(std::memory_order_relaxed)});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (buffer->generation.load(std::memory_order_relaxed) != current) {
+            continue;
+        }
+        // the slots the thread has claimed since may hold newer events
+        const quint64 claimed = buffer->claimed.load(std::memory_order_relaxed);
+        const quint64 valid = claimed > BUFFER_EVENTS ? claimed - BUFFER_EVENTS : 0;
+        const size_t skip = size_t(std::min(published, std::max(oldest, valid)) - oldest);
+        dropped += std::max(oldest, valid);
+        if (buffer->name[0]) {
+            append(QByteArray("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":") + QByteArray::number(pid)
+                   + ",\"tid\":" + QByteArray::number(buffer->tid)
+                   + ",\"args\":{\"name\":\"" + buffer->name + "\"}}");
+        }
+        for (size_t i = skip; i < events.size(); ++i) {
+            const Copy &event = events[i];
+            QByteArray line = QByteArray("{\"name\":\"") + event.name
+                    + "\",\"cat\":\"" + event.category
+                    + "\",\"ph\":\"" + event.phase
+                    + "\",\"ts\":" + QByteArray::number(event.timestampUs)
+                    + ",\"pid\":" + QByteArray::number(pid)
+                    + ",\"tid\":" + QByteArray::number(buffer->tid);
+            if (event.phase == 'b' || event.phase == 'e') {
+                line += ",\"id\":\"0x" + QByteArray::number(quintptr(event.id), 16) + '"';
+            } else if (event.phase == 'i') {
+                line += ",\"s\":\"t\"";
+            }
+            line += '}';
+            append(line);
+        }
+    }
+
+    json += "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":\"";
+    json += QByteArray::number(dropped);
+    json += "\"}}";
+    return json;
+}
+
+}
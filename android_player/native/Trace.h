@@ -0,0 +1,107 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QByteArray>
+
+#include <atomic>
+
+// Trace events in the Chrome trace-event format, viewable in chrome://tracing
+// or Perfetto. Events go to a ring owned by the calling thread, so recording
+// one takes no lock; exportJson() merges the rings into JSON. A full ring
+// overwrites its oldest events, the trace keeps the last few minutes of each
+// thread. The ring of an exited thread is reused by a later one.
+//
+// Names and categories must be string literals, only the pointers are stored.
+// While tracing is off, recording costs the load of one atomic flag.
+//
+//     TRACE_SPAN("player", "setDataSource");
+//     Trace::asyncBegin("player", "prepare", this);
+namespace Trace {
+
+extern std::atomic<bool> gEnabled;
+
+inline bool enabled()
+{
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+// Drops the events recorded so far and starts recording.
+void start();
+void stop();
+// Returns the recorded events as a Chrome trace JSON object, with the number
+// of overwritten events as droppedEvents.
+QByteArray exportJson();
+
+void record(char phase, const char *category, const char *name, const void *id = nullptr);
+
+// Nested span on the calling thread.
+inline void begin(const char *category, const char *name)
+{
+    if (enabled()) {
+        record('B', category, name);
+    }
+}
+
+inline void end(const char *category, const char *name)
+{
+    if (enabled()) {
+        record('E', category, name);
+    }
+}
+
+inline void instant(const char *category, const char *name)
+{
+    if (enabled()) {
+        record('i', category, name);
+    }
+}
+
+// Span that may end on another thread or in another callback, matched by id.
+inline void asyncBegin(const char *category, const char *name, const void *id)
+{
+    if (enabled()) {
+        record('b', category, name, id);
+    }
+}
+
+inline void asyncEnd(const char *category, const char *name, const void *id)
+{
+    if (enabled()) {
+        record('e', category, name, id);
+    }
+}
+
+class Span
+{
+public:
+    Span(const char *category, const char *name) :
+        mCategory(enabled() ? category : nullptr),
+        mName(name)
+    {
+        if (mCategory) {
+            record('B', mCategory, mName);
+        }
+    }
+
+    ~Span()
+    {
+        if (mCategory) {
+            record('E', mCategory, mName);
+        }
+    }
+
+private:
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+    const char *const mCategory;
+    const char *const mName;
+};
+
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(category, name) const Trace::Span TRACE_CONCAT(traceSpan, __LINE__)(category, name)
+
+#endif // TRACE_H
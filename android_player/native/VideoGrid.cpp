@@ -0,0 +1,478 @@
+#include "VideoGrid.h"
+#include "AndroidMediaPlayer.h"
+#include "PlayerLog.h"
+#include "PosterCache.h"
+#include "QSurfaceTexture.h"
+#include "Trace.h"
+
+#include <QQuickWindow>
+#include <QSGSimpleRectNode>
+#include <QSGSimpleTextureNode>
+#include <QSet>
+
+namespace {
+const int DEFAULT_MAX_PLAYERS = 4;
+const qreal DEFAULT_CELL_SIZE = 160;
+const QColor PLACEHOLDER_COLOR(0x20, 0x20, 0x20);
+
+// Owns the poster textures, deleted on the render thread with the node.
+class PostersNode : public QSGNode
+{
+public:
+    ~PostersNode() override
+    {
+        qDeleteAll(textures);
+    }
+
+    QHash<QString, QSGTexture *> textures;
+};
+
+QRectF fitted(const QRectF &cell, const QSize &image)
+{
+    const QSizeF &&size = QSizeF(image).scaled(cell.size(), Qt::KeepAspectRatio);
+    return {cell.center().x() - size.width() / 2, cell.center().y() - size.height() / 2,
+            size.width(), size.height()};
+}
+}
+
+VideoGrid::VideoGrid(QQuickItem *parent) :
+    QQuickItem(parent),
+    mCellWidth(DEFAULT_CELL_SIZE),
+    mCellHeight(DEFAULT_CELL_SIZE),
+    mContentY(0),
+    mScrollDirection(1),
+    mMaxPlayers(DEFAULT_MAX_PLAYERS),
+    mPrefetchCells(-1),
+    mFirstVisible(0),
+    mLastVisible(-1)
+{
+    setFlag(ItemHasContents);
+    // players of prefetched cells are laid out outside the viewport
+    setClip(true);
+    connect(&PosterCache::instance(), &PosterCache::posterReady, this, &VideoGrid::onPosterReady);
+}
+
+QStringList VideoGrid::sources() const
+{
+    return mSources;
+}
+
+qreal VideoGrid::cellWidth() const
+{
+    return mCellWidth;
+}
+
+qreal VideoGrid::cellHeight() const
+{
+    return mCellHeight;
+}
+
+qreal VideoGrid::contentY() const
+{
+    return mContentY;
+}
+
+qreal VideoGrid::contentHeight() const
+{
+    const int cols = columns();
+    return ((mSources.size() + cols - 1) / cols) * mCellHeight;
+}
+
+int VideoGrid::maxPlayers() const
+{
+    return mMaxPlayers;
+}
+
+int VideoGrid::prefetchCells() const
+{
+    // a row ahead unless set
+    return mPrefetchCells < 0 ? columns() : mPrefetchCells;
+}
+
+QVariantMap VideoGrid::stats() const
+{
+    int bound = 0;
+    int live = 0;
+    for (const Slot &slot : mSlots) {
+        bound += slot.cell >= 0;
+        live += slot.live;
+    }
+    const PosterCache::Stats &&posters = PosterCache::instance().stats();
+    return {
+        {"players", mSlots.size()},
+        {"bound", bound},
+        {"live", live},
+        {"bindings", mStats.bindings},
+        {"prefetchHits", mStats.prefetchHits},
+        {"prefetchMisses", mStats.prefetchMisses},
+        {"posters", QVariantMap{
+             {"hits", posters.hits},
+             {"misses", posters.misses},
+             {"extractions", posters.extractions},
+             {"failures", posters.failures},
+             {"evictions", posters.evictions},
+             {"size", posters.size},
+             {"capacity", posters.capacity},
+             {"count", posters.posters}
+         }}
+    };
+}
+
+void VideoGrid::setSources(const QStringList &sources)
+{
+    if (mSources == sources)
+        return;
+    mSources = sources;
+    // cells now show other sources
+    for (Slot &slot : mSlots) {
+        unbind(slot);
+    }
+    polish();
+    emit sourcesChanged(mSources);
+    emit contentHeightChanged(contentHeight());
+}
+
+void VideoGrid::setCellWidth(qreal cellWidth)
+{
+    if (qFuzzyCompare(mCellWidth, cellWidth) || cellWidth <= 0)
+        return;
+    mCellWidth = cellWidth;
+    polish();
+    emit cellWidthChanged(mCellWidth);
+    emit contentHeightChanged(contentHeight());
+}
+
+void VideoGrid::setCellHeight(qreal cellHeight)
+{
+    if (qFuzzyCompare(mCellHeight, cellHeight) || cellHeight <= 0)
+        return;
+    mCellHeight = cellHeight;
+    polish();
+    emit cellHeightChanged(mCellHeight);
+    emit contentHeightChanged(contentHeight());
+}
+
+void VideoGrid::setContentY(qreal contentY)
+{
+    if (qFuzzyCompare(mContentY, contentY))
+        return;
+    mScrollDirection = contentY > mContentY ? 1 : -1;
+    mContentY = contentY;
+    polish();
+    emit contentYChanged(mContentY);
+}
+
+void VideoGrid::setMaxPlayers(int maxPlayers)
+{
+    maxPlayers = qMax(0, maxPlayers);
+    if (mMaxPlayers == maxPlayers)
+        return;
+    mMaxPlayers = maxPlayers;
+    polish();
+    emit maxPlayersChanged(mMaxPlayers);
+}
+
+void VideoGrid::setPrefetchCells(int prefetchCells)
+{
+    if (mPrefetchCells == prefetchCells)
+        return;
+    mPrefetchCells = prefetchCells;
+    polish();
+    emit prefetchCellsChanged(prefetchCells);
+}
+
+QSGNode *VideoGrid::updatePaintNode(QSGNode *node, UpdatePaintNodeData *)
+{
+    TRACE_SPAN("grid", "updatePaintNode");
+    auto root = static_cast<PostersNode *>(node);
+    if (!root) {
+        root = new PostersNode;
+    }
+    // rebuilt every time, there are a few dozen visible cells at most
+    while (QSGNode *child = root->firstChild()) {
+        root->removeChildNode(child);
+        delete child;
+    }
+
+    QSet<int> liveCells;
+    for (const Slot &slot : mSlots) {
+        if (slot.live) {
+            liveCells.insert(slot.cell);
+        }
+    }
+
+    QHash<QString, QSGTexture *> textures;
+    for (int cell = mFirstVisible; cell <= mLastVisible; ++cell) {
+        if (liveCells.contains(cell)) {
+            continue;
+        }
+        const QRectF &&rect = cellRect(cell);
+        const QImage &poster = mPosters.value(cell);
+        if (poster.isNull()) {
+            root->appendChildNode(new QSGSimpleRectNode(rect, PLACEHOLDER_COLOR));
+            continue;
+        }
+        const QString &source = mSources.at(cell);
+        QSGTexture *&texture = textures[source];
+        if (!texture) {
+            texture = root->textures.take(source);
+        }
+        if (!texture) {
+            texture = window()->createTextureFromImage(poster);
+        }
+        auto textureNode = new QSGSimpleTextureNode;
+        textureNode->setTexture(texture);
+        textureNode->setRect(fitted(rect, poster.size()));
+        textureNode->setFiltering(QSGTexture::Linear);
+        root->appendChildNode(textureNode);
+    }
+    // the textures of cells that scrolled out
+    qDeleteAll(root->textures);
+    root->textures = textures;
+    return root;
+}
+
+void VideoGrid::updatePolish()
+{
+    updateCells();
+}
+
+void VideoGrid::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChanged(newGeometry, oldGeometry);
+    if (newGeometry.size() != oldGeometry.size()) {
+        polish();
+        emit contentHeightChanged(contentHeight());
+    }
+}
+
+void VideoGrid::componentComplete()
+{
+    QQuickItem::componentComplete();
+    polish();
+}
+
+void VideoGrid::onPosterReady(const QString &source)
+{
+    for (int cell = mFirstVisible; cell <= mLastVisible && cell < mSources.size(); ++cell) {
+        if (mSources.at(cell) == source) {
+            polish();
+            return;
+        }
+    }
+}
+
+int VideoGrid::columns() const
+{
+    return qMax(1, int(width() / mCellWidth));
+}
+
+QRectF VideoGrid::cellRect(int cell) const
+{
+    const int cols = columns();
+    return {(cell % cols) * mCellWidth, (cell / cols) * mCellHeight - mContentY, mCellWidth, mCellHeight};
+}
+
+bool VideoGrid::cellVisible(int cell) const
+{
+    return cell >= mFirstVisible && cell <= mLastVisible;
+}
+
+void VideoGrid::updateCells()
+{
+    TRACE_SPAN("grid", "updateCells");
+    const int count = mSources.size();
+    const int cols = columns();
+    if (count == 0 || height() <= 0) {
+        mFirstVisible = 0;
+        mLastVisible = -1;
+    } else {
+        const int firstRow = qMax(0, int(mContentY / mCellHeight));
+        const int lastRow = qMax(0, int((mContentY + height()) / mCellHeight));
+        mFirstVisible = qMin(count, firstRow * cols);
+        mLastVisible = qMin(count - 1, (lastRow + 1) * cols - 1);
+    }
+
+    // visible cells first, then the ones about to appear in the scroll direction
+    QVector<int> wanted;
+    for (int cell = mFirstVisible; cell <= mLastVisible; ++cell) {
+        wanted.append(cell);
+    }
+    for (int i = 1; i <= prefetchCells(); ++i) {
+        const int cell = mScrollDirection > 0 ? mLastVisible + i : mFirstVisible - i;
+        if (cell >= 0 && cell < count) {
+            wanted.append(cell);
+        }
+    }
+    if (wanted.size() > mMaxPlayers) {
+        wanted.resize(mMaxPlayers);
+    }
+
+    while (mSlots.size() > mMaxPlayers) {
+        const Slot slot = mSlots.takeLast();
+        delete slot.player;
+        delete slot.surface;
+    }
+
+    QSet<int> bound;
+    QVector<int> freeSlots;
+    for (int i = 0; i < mSlots.size(); ++i) {
+        if (mSlots.at(i).cell >= 0 && wanted.contains(mSlots.at(i).cell)) {
+            bound.insert(mSlots.at(i).cell);
+        } else {
+            freeSlots.append(i);
+        }
+    }
+    for (const int cell : wanted) {
+        if (bound.contains(cell)) {
+            continue;
+        }
+        if (freeSlots.isEmpty()) {
+            addSlot();
+            freeSlots.append(mSlots.size() - 1);
+        }
+        bind(mSlots[freeSlots.takeFirst()], cell);
+    }
+    for (const int index : freeSlots) {
+        unbind(mSlots[index]);
+    }
+
+    mPosters.clear();
+    const qreal ratio = window() ? window()->effectiveDevicePixelRatio() : 1;
+    const QSize posterSize(qRound(mCellWidth * ratio), qRound(mCellHeight * ratio));
+    QSet<int> liveCells;
+    for (Slot &slot : mSlots) {
+        if (slot.cell < 0) {
+            continue;
+        }
+        const QRectF &&rect = cellRect(slot.cell);
+        slot.surface->setPosition(rect.topLeft());
+        slot.surface->setSize(rect.size());
+
+        const bool visible = cellVisible(slot.cell);
+        switch (slot.player->playbackState()) {
+        case AndroidMediaPlayer::PlaybackState::Idle:
+            // the decoder was released under memory pressure, start() restores it
+        case AndroidMediaPlayer::PlaybackState::Prepared:
+        case AndroidMediaPlayer::PlaybackState::Paused:
+        case AndroidMediaPlayer::PlaybackState::PlaybackCompleted:
+            if (visible) {
+                slot.player->start();
+            }
+            break;
+        case AndroidMediaPlayer::PlaybackState::Started:
+            if (!visible) {
+                slot.player->pause();
+            }
+            break;
+        default:
+            break;
+        }
+        if (visible && slot.prefetched) {
+            slot.prefetched = false;
+            ++mStats.prefetchHits;
+        }
+        if (slot.live) {
+            liveCells.insert(slot.cell);
+        }
+    }
+    for (int cell = mFirstVisible; cell <= mLastVisible; ++cell) {
+        if (!liveCells.contains(cell)) {
+            mPosters.insert(cell, PosterCache::instance().poster(mSources.at(cell), posterSize));
+        }
+    }
+    update();
+}
+
+void VideoGrid::addSlot()
+{
+    const int index = mSlots.size();
+    Slot slot;
+    slot.surface = new QSurfaceTexture(this);
+    // below the posters, which are left out for live cells
+    slot.surface->setZ(-1);
+    slot.surface->setVisible(false);
+    slot.player = new AndroidMediaPlayer(this);
+    slot.player->setLoops(true);
+    slot.player->setSurfaceView(slot.surface);
+    connect(slot.player, &AndroidMediaPlayer::playbackStateChanged, this, [this, index] {
+        onPlaybackStateChanged(index);
+    });
+    mSlots.append(slot);
+}
+
+void VideoGrid::bind(Slot &slot, int cell)
+{
+    PLAYER_DEBUG(Player) << "cell" << cell << mSources.at(cell);
+    ++mStats.bindings;
+    slot.cell = cell;
+    slot.live = false;
+    slot.prefetched = !cellVisible(cell);
+    if (!slot.prefetched) {
+        ++mStats.prefetchMisses;
+    }
+    slot.surface->setVisible(true);
+
+    AndroidMediaPlayer *player = slot.player;
+    switch (player->playbackState()) {
+    case AndroidMediaPlayer::PlaybackState::Prepared:
+    case AndroidMediaPlayer::PlaybackState::Started:
+    case AndroidMediaPlayer::PlaybackState::Paused:
+    case AndroidMediaPlayer::PlaybackState::PlaybackCompleted:
+        player->stop();
+        player->reset();
+        break;
+    case AndroidMediaPlayer::PlaybackState::Idle:
+        break;
+    default:
+        player->reset();
+        break;
+    }
+    player->setDataSource(mSources.at(cell));
+}
+
+void VideoGrid::unbind(Slot &slot)
+{
+    if (slot.cell < 0) {
+        return;
+    }
+    slot.cell = -1;
+    slot.live = false;
+    slot.prefetched = false;
+    slot.surface->setVisible(false);
+    // the decoder is kept for the next cell, or released under memory pressure
+    if (slot.player->playbackState() == AndroidMediaPlayer::PlaybackState::Started) {
+        slot.player->pause();
+    }
+}
+
+void VideoGrid::onPlaybackStateChanged(int index)
+{
+    Slot &slot = mSlots[index];
+    if (slot.cell < 0) {
+        return;
+    }
+    switch (slot.player->playbackState()) {
+    case AndroidMediaPlayer::PlaybackState::Prepared:
+        if (cellVisible(slot.cell)) {
+            slot.player->start();
+        }
+        break;
+    case AndroidMediaPlayer::PlaybackState::Started:
+        if (!slot.live) {
+            slot.live = true;
+            polish();
+        }
+        break;
+    case AndroidMediaPlayer::PlaybackState::Idle:
+    case AndroidMediaPlayer::PlaybackState::Initialized:
+    case AndroidMediaPlayer::PlaybackState::Error:
+        if (slot.live) {
+            slot.live = false;
+            polish();
+        }
+        break;
+    default:
+        break;
+    }
+}
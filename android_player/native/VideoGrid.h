@@ -0,0 +1,116 @@
+#ifndef VIDEOGRID_H
+#define VIDEOGRID_H
+
+#include <QHash>
+#include <QImage>
+#include <QQuickItem>
+#include <QStringList>
+#include <QVariantMap>
+#include <QVector>
+
+class AndroidMediaPlayer;
+class QSurfaceTexture;
+
+// Grid of video previews that plays the visible cells with a bounded pool of
+// players, so a gallery of a thousand sources costs no more than maxPlayers
+// players and SurfaceTextures.
+//
+// The grid does not scroll by itself: bind contentY to a Flickable and give
+// the Flickable the contentHeight of the grid. As cells scroll into view the
+// players of cells that left it are bound to them, the cells about to appear
+// in the scroll direction are prepared ahead and start as soon as they
+// become visible. Cells without a playing player show their poster frame from
+// PosterCache, or a placeholder while it is extracted.
+class VideoGrid : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(QStringList sources READ sources WRITE setSources NOTIFY sourcesChanged)
+    Q_PROPERTY(qreal cellWidth READ cellWidth WRITE setCellWidth NOTIFY cellWidthChanged)
+    Q_PROPERTY(qreal cellHeight READ cellHeight WRITE setCellHeight NOTIFY cellHeightChanged)
+    Q_PROPERTY(qreal contentY READ contentY WRITE setContentY NOTIFY contentYChanged)
+    Q_PROPERTY(qreal contentHeight READ contentHeight NOTIFY contentHeightChanged)
+    Q_PROPERTY(int maxPlayers READ maxPlayers WRITE setMaxPlayers NOTIFY maxPlayersChanged)
+    Q_PROPERTY(int prefetchCells READ prefetchCells WRITE setPrefetchCells NOTIFY prefetchCellsChanged)
+
+public:
+    VideoGrid(QQuickItem *parent = nullptr);
+
+    QStringList sources() const;
+    qreal cellWidth() const;
+    qreal cellHeight() const;
+    qreal contentY() const;
+    qreal contentHeight() const;
+    int maxPlayers() const;
+    int prefetchCells() const;
+
+    // Bindings, prefetch hits and misses, live players and the poster cache.
+    Q_INVOKABLE QVariantMap stats() const;
+
+signals:
+    void sourcesChanged(const QStringList &sources);
+    void cellWidthChanged(qreal cellWidth);
+    void cellHeightChanged(qreal cellHeight);
+    void contentYChanged(qreal contentY);
+    void contentHeightChanged(qreal contentHeight);
+    void maxPlayersChanged(int maxPlayers);
+    void prefetchCellsChanged(int prefetchCells);
+
+public slots:
+    void setSources(const QStringList &sources);
+    void setCellWidth(qreal cellWidth);
+    void setCellHeight(qreal cellHeight);
+    void setContentY(qreal contentY);
+    void setMaxPlayers(int maxPlayers);
+    void setPrefetchCells(int prefetchCells);
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *node, UpdatePaintNodeData *) override;
+    void updatePolish() override;
+    void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+    void componentComplete() override;
+
+private slots:
+    void onPosterReady(const QString &source);
+
+private:
+    struct Slot {
+        AndroidMediaPlayer *player = nullptr;
+        QSurfaceTexture *surface = nullptr;
+        int cell = -1;
+        // the player has started and covers the poster
+        bool live = false;
+        // bound before the cell became visible
+        bool prefetched = false;
+    };
+
+    int columns() const;
+    QRectF cellRect(int cell) const;
+    bool cellVisible(int cell) const;
+    void updateCells();
+    void addSlot();
+    void bind(Slot &slot, int cell);
+    void unbind(Slot &slot);
+    void onPlaybackStateChanged(int index);
+
+    QStringList mSources;
+    qreal mCellWidth;
+    qreal mCellHeight;
+    qreal mContentY;
+    // 1 when scrolling down, -1 when scrolling up
+    int mScrollDirection;
+    int mMaxPlayers;
+    int mPrefetchCells;
+    QVector<Slot> mSlots;
+    int mFirstVisible;
+    int mLastVisible;
+    // posters of the visible cells without a live player, read by updatePaintNode
+    QHash<int, QImage> mPosters;
+
+    struct {
+        quint64 bindings = 0;
+        quint64 prefetchHits = 0;
+        quint64 prefetchMisses = 0;
+    } mStats;
+};
+
+#endif // VIDEOGRID_H
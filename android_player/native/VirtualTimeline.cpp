@@ -0,0 +1,66 @@
+#include "VirtualTimeline.h"
+
+void VirtualTimeline::reset(int partCount)
+{
+    mDurations.assign(size_t(qMax(0, partCount)), -1);
+}
+
+int VirtualTimeline::partCount() const
+{
+    return int(mDurations.size());
+}
+
+void VirtualTimeline::setPartDuration(int part, qint64 durationMs)
+{
+    if (part >= 0 && part < partCount()) {
+        mDurations[size_t(part)] = durationMs;
+    }
+}
+
+qint64 VirtualTimeline::partDuration(int part) const
+{
+    return part >= 0 && part < partCount() ? mDurations[size_t(part)] : -1;
+}
+
+bool VirtualTimeline::isComplete() const
+{
+    for (const qint64 duration : mDurations) {
+        if (duration < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+qint64 VirtualTimeline::partOffset(int part) const
+{
+    qint64 offset = 0;
+    for (int i = 0; i < part && i < partCount(); ++i) {
+        offset += qMax<qint64>(0, mDurations[size_t(i)]);
+    }
+    return offset;
+}
+
+qint64 VirtualTimeline::duration() const
+{
+    return partOffset(partCount());
+}
+
+std::pair<int, qint64> VirtualTimeline::locate(qint64 positionMs) const
+{
+    if (mDurations.empty()) {
+        return {-1, 0};
+    }
+    qint64 offset = 0;
+    positionMs = qMax<qint64>(0, positionMs);
+    for (int i = 0; i < partCount(); ++i) {
+        const qint64 duration = qMax<qint64>(0, mDurations[size_t(i)]);
+        if (positionMs < offset + duration) {
+            return {i, positionMs - offset};
+        }
+        offset += duration;
+    }
+    // past the end: clamp to the end of the last part
+    const int last = partCount() - 1;
+    return {last, qMax<qint64>(0, mDurations[size_t(last)])};
+}
@@ -0,0 +1,32 @@
+#ifndef VIRTUALTIMELINE_H
+#define VIRTUALTIMELINE_H
+
+#include <QtGlobal>
+
+#include <utility>
+#include <vector>
+
+// Maps a single global timeline onto an ordered list of parts.
+// Part durations may become known one by one; unknown parts count as empty.
+class VirtualTimeline
+{
+public:
+    void reset(int partCount);
+
+    int partCount() const;
+    void setPartDuration(int part, qint64 durationMs);
+    qint64 partDuration(int part) const;
+    bool isComplete() const;
+
+    // Global time at which the given part starts.
+    qint64 partOffset(int part) const;
+    qint64 duration() const;
+
+    // Returns the part and the position inside it for a global position.
+    std::pair<int, qint64> locate(qint64 positionMs) const;
+
+private:
+    std::vector<qint64> mDurations;
+};
+
+#endif // VIRTUALTIMELINE_H
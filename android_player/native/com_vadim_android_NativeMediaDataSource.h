@@ -0,0 +1,37 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class com_vadim_android_NativeMediaDataSource */
+
+#ifndef _Included_com_vadim_android_NativeMediaDataSource
+#define _Included_com_vadim_android_NativeMediaDataSource
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     com_vadim_android_NativeMediaDataSource
+ * Method:    readAt
+ * Signature: (JJ[BII)I
+ */
+JNIEXPORT jint JNICALL Java_com_vadim_android_NativeMediaDataSource_readAt
+  (JNIEnv *, jclass, jlong, jlong, jbyteArray, jint, jint);
+
+/*
+ * Class:     com_vadim_android_NativeMediaDataSource
+ * Method:    getSize
+ * Signature: (J)J
+ */
+JNIEXPORT jlong JNICALL Java_com_vadim_android_NativeMediaDataSource_getSize
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_vadim_android_NativeMediaDataSource
+ * Method:    close
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_vadim_android_NativeMediaDataSource_close
+  (JNIEnv *, jclass, jlong);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
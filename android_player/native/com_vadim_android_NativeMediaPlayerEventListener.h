@@ -39,6 +39,14 @@ JNIEXPORT void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onE
 JNIEXPORT void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onBuffering
   (JNIEnv *, jclass, jlong, jboolean);
 
+/*
+ * Class:     com_vadim_android_NativeMediaPlayerEventListener
+ * Method:    onBufferingUpdate
+ * Signature: (JI)V
+ */
+JNIEXPORT void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onBufferingUpdate
+  (JNIEnv *, jclass, jlong, jint);
+
 /*
  * Class:     com_vadim_android_NativeMediaPlayerEventListener
  * Method:    onPause
@@ -63,6 +71,30 @@ JNIEXPORT void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onP
 JNIEXPORT void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onVideoSizeChanged
   (JNIEnv *, jclass, jlong, jint, jint);
 
+/*
+ * Class:     com_vadim_android_NativeMediaPlayerEventListener
+ * Method:    onSeekComplete
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onSeekComplete
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_vadim_android_NativeMediaPlayerEventListener
+ * Method:    onNextPartStarted
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onNextPartStarted
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     com_vadim_android_NativeMediaPlayerEventListener
+ * Method:    onSuspended
+ * Signature: (JZ)V
+ */
+JNIEXPORT void JNICALL Java_com_vadim_android_NativeMediaPlayerEventListener_onSuspended
+  (JNIEnv *, jclass, jlong, jboolean);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,21 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class com_vadim_android_NativeMemoryPressureListener */
+
+#ifndef _Included_com_vadim_android_NativeMemoryPressureListener
+#define _Included_com_vadim_android_NativeMemoryPressureListener
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     com_vadim_android_NativeMemoryPressureListener
+ * Method:    onMemoryTrimmed
+ * Signature: (I)V
+ */
+JNIEXPORT void JNICALL Java_com_vadim_android_NativeMemoryPressureListener_onMemoryTrimmed
+  (JNIEnv *, jclass, jint);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
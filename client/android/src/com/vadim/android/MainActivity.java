@@ -52,4 +52,9 @@ public class MainActivity extends org.qtproject.qt5.android.bindings.QtActivity
     public void addPlayerSurface(View surfaceView, int x, int y, int width, int height) {
         playerSurfaceActivity.addPlayerSurface(surfaceView, x, y, width, height);
     }
+
+    @Override
+    public void removePlayerSurface(View surfaceView) {
+        playerSurfaceActivity.removePlayerSurface(surfaceView);
+    }
 }
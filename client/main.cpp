@@ -4,6 +4,9 @@
 #include <native/AndroidSurfaceView.h>
 #include <native/QSurfaceTexture.h>
 #include <native/AndroidMediaPlayer.h>
+#include <native/PlayerDiagnostics.h>
+#include <native/PlayerSyncGroup.h>
+#include <native/VideoGrid.h>
 
 int main(int argc, char *argv[])
 {
@@ -14,6 +17,13 @@ int main(int argc, char *argv[])
     qmlRegisterType<AndroidMediaPlayer>("com.vadim.android", 1, 0, "AndroidMediaPlayer");
     qmlRegisterType<AndroidSurfaceView>("com.vadim.android", 1, 0, "AndroidSurfaceView");
     qmlRegisterType<QSurfaceTexture>("com.vadim.android", 1, 0, "SurfaceTexture");
+    qmlRegisterType<PlayerSyncGroup>("com.vadim.android", 1, 0, "PlayerSyncGroup");
+    qmlRegisterType<VideoGrid>("com.vadim.android", 1, 0, "VideoGrid");
+    qmlRegisterSingletonType<PlayerDiagnostics>("com.vadim.android", 1, 0, "PlayerDiagnostics",
+                                                [](QQmlEngine *, QJSEngine *) -> QObject * {
+        QQmlEngine::setObjectOwnership(&PlayerDiagnostics::instance(), QQmlEngine::CppOwnership);
+        return &PlayerDiagnostics::instance();
+    });
 
     QQmlApplicationEngine engine;
     engine.load(QUrl(QStringLiteral("qrc:/main.qml")));